@@ -119,10 +119,25 @@ struct golioth_credential
     };
 };
 
+/// Transport used to exchange CoAP messages with Golioth
+enum golioth_client_transport
+{
+    /// CoAP over DTLS (RFC 7252)
+    GOLIOTH_CLIENT_TRANSPORT_DTLS,
+    /// CoAP over TLS (RFC 8323), with BERT blocks for blockwise transfers.
+    ///
+    /// Only supported by the libcoap-based ports, when libcoap is built with TCP support
+    /// (the GOLIOTH_COAP_TCP CMake option on Linux). Suited to wired gateways, where TCP
+    /// windowing moves large OTA images and Stream uploads faster than DTLS blocks.
+    GOLIOTH_CLIENT_TRANSPORT_TLS,
+};
+
 /// Golioth client configuration, passed into golioth_client_create
 struct golioth_client_config
 {
     struct golioth_credential credentials;
+    /// Defaults to GOLIOTH_CLIENT_TRANSPORT_DTLS when zero-initialized
+    enum golioth_client_transport transport;
 };
 
 /// Callback function type for client events
@@ -286,6 +301,77 @@ typedef void (*golioth_post_cb_fn)(struct golioth_client *client,
                                    size_t payload_size,
                                    void *arg);
 
+/// Response timeout and retry budget of a single asynchronous request
+///
+/// Lets latency-sensitive requests fail fast and bulk requests be patient, instead of every
+/// request waiting up to CONFIG_GOLIOTH_COAP_RESPONSE_TIMEOUT_S. A zero-initialized policy keeps
+/// the defaults.
+///
+/// A request that runs out of its own timeout or retry budget completes with
+/// GOLIOTH_ERR_TIMEOUT, but unlike a timeout with the default policy, it is not treated as a
+/// sign that the connection to the server was lost.
+struct golioth_request_policy
+{
+    /// Time to wait for a response once the request has been sent, in milliseconds.
+    /// 0 waits up to CONFIG_GOLIOTH_COAP_RESPONSE_TIMEOUT_S.
+    uint32_t timeout_ms;
+    /// Maximum number of transmissions of the request, including the first one.
+    /// 0 keeps the default of the CoAP transport (4 transmissions).
+    uint8_t max_transmissions;
+};
+
+/// Length of the token identifying a blockwise upload to the server, in bytes
+#define GOLIOTH_BLOCKWISE_TOKEN_LEN 8
+
+/// Progress of a resumable blockwise upload
+///
+/// Everything before \p block_idx has been acknowledged by the server, so an interrupted upload
+/// continues from there with the same token.
+struct golioth_blockwise_checkpoint
+{
+    /// Token identifying the upload to the server
+    uint8_t token[GOLIOTH_BLOCKWISE_TOKEN_LEN];
+    /// Index of the next block to send
+    uint32_t block_idx;
+    /// Size of the blocks counted by block_idx, in bytes
+    uint32_t block_size;
+};
+
+/// Storage for the checkpoints of resumable blockwise uploads
+///
+/// Checkpoints are identified by the path of the upload, so only one resumable upload per path
+/// can be in progress at a time. The functions are called from the thread running the upload,
+/// never from the Golioth CoAP thread.
+struct golioth_blockwise_checkpoint_store
+{
+    /// Read the checkpoint of the upload to \p path. Return GOLIOTH_ERR_NO_MORE_DATA if there is
+    /// none, in which case the upload starts from the first block.
+    enum golioth_status (*load)(const char *path,
+                                struct golioth_blockwise_checkpoint *checkpoint,
+                                void *arg);
+    /// Persist the checkpoint of the upload to \p path. Called whenever the server has
+    /// acknowledged another GOLIOTH_BLOCKWISE_CHECKPOINT_INTERVAL bytes, until the last block.
+    enum golioth_status (*save)(const char *path,
+                                const struct golioth_blockwise_checkpoint *checkpoint,
+                                void *arg);
+    /// Forget the checkpoint of the upload to \p path. Called once the server has responded to
+    /// the last block, or rejected the upload, as it can't be resumed either way.
+    void (*clear)(const char *path, void *arg);
+    /// User argument passed to the functions above. Can be NULL.
+    void *arg;
+};
+
+/// Callback function type to release a caller-owned payload buffer
+///
+/// Used by the zero-copy ("nocopy") request functions, which take ownership of the payload buffer
+/// instead of copying it. Will be called exactly once, from the Golioth CoAP thread, when the
+/// payload has been serialized into a CoAP message (or the request is dropped before it could be
+/// sent). After this call, the SDK will not access \p buf again.
+///
+/// @param buf The payload buffer that was passed to the request function
+/// @param arg User argument, copied from the original request. Can be NULL.
+typedef void (*golioth_payload_release_fn)(uint8_t *buf, void *arg);
+
 /// Create a Golioth client
 ///
 /// Dynamically creates a client and returns an opaque handle to the client.
@@ -396,6 +482,39 @@ void golioth_client_set_packet_loss_percent(uint8_t percent);
 /// @return The thread handle of the client thread
 golioth_sys_thread_t golioth_client_get_thread(struct golioth_client *client);
 
+/// Size of the buffer needed by golioth_client_dns_cache_save()
+#define GOLIOTH_CLIENT_DNS_CACHE_SAVE_SIZE (6 + CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS * 17)
+
+/// Save the cached addresses of the Golioth server, e.g. to flash.
+///
+/// Restoring them with golioth_client_dns_cache_load() after a reboot lets the client connect
+/// even if the hostname cannot be resolved, and try the address that worked last time first.
+///
+/// @param client The client handle
+/// @param buf Output buffer
+/// @param buf_size Size of @p buf. GOLIOTH_CLIENT_DNS_CACHE_SAVE_SIZE is always enough.
+///
+/// @return Number of bytes written to @p buf, 0 if there is nothing to save or @p buf is too small
+size_t golioth_client_dns_cache_save(struct golioth_client *client,
+                                     uint8_t *buf,
+                                     size_t buf_size);
+
+/// Restore addresses saved with golioth_client_dns_cache_save()
+///
+/// Should be called before golioth_client_start(). Restored addresses are used without resolving
+/// the hostname for the rest of their TTL, and after that only when resolving fails.
+///
+/// @param client The client handle
+/// @param buf Data returned by golioth_client_dns_cache_save()
+/// @param len Size of @p buf
+///
+/// @retval GOLIOTH_OK addresses restored
+/// @retval GOLIOTH_ERR_NULL client is NULL
+/// @retval GOLIOTH_ERR_INVALID_FORMAT @p buf does not contain saved addresses
+enum golioth_status golioth_client_dns_cache_load(struct golioth_client *client,
+                                                  const uint8_t *buf,
+                                                  size_t len);
+
 /// @}
 
 #ifdef __cplusplus
@@ -39,6 +39,22 @@ extern "C"
 #define CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS 10
 #endif
 
+#ifndef CONFIG_GOLIOTH_COAP_REQUEST_MSG_POOL_SIZE
+#define CONFIG_GOLIOTH_COAP_REQUEST_MSG_POOL_SIZE 4
+#endif
+
+#ifndef CONFIG_GOLIOTH_COAP_REQUEST_BATCH_SIZE
+#define CONFIG_GOLIOTH_COAP_REQUEST_BATCH_SIZE 8
+#endif
+
+#ifndef CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_HIGH_PRIO_MAX_ITEMS
+#define CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_HIGH_PRIO_MAX_ITEMS 4
+#endif
+
+#ifndef CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_LOW_PRIO_MAX_ITEMS
+#define CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_LOW_PRIO_MAX_ITEMS 10
+#endif
+
 #ifndef CONFIG_GOLIOTH_COAP_THREAD_PRIORITY
 #define CONFIG_GOLIOTH_COAP_THREAD_PRIORITY 5
 #endif
@@ -51,20 +67,89 @@ extern "C"
 #define CONFIG_GOLIOTH_COAP_KEEPALIVE_INTERVAL_S 9
 #endif
 
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE 64
+#endif
+
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS
+#endif
+
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE 256
+#endif
+
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_NUM_BLOCKS
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_NUM_BLOCKS 4
+#endif
+
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE 1024
+#endif
+
+#ifndef CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS
+#define CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS 4
+#endif
+
+#ifndef CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS
+#define CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS 1
+#endif
+
+#ifndef CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MIN_MS
+#define CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MIN_MS 1000
+#endif
+
+#ifndef CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MAX_MS
+#define CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MAX_MS 60000
+#endif
+
+#ifndef CONFIG_GOLIOTH_DNS_CACHE_TTL_S
+#define CONFIG_GOLIOTH_DNS_CACHE_TTL_S 600
+#endif
+
+#ifndef CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS
+#define CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS 4
+#endif
+
 #ifndef CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS
 #define CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS 8
 #endif
 
+#ifndef CONFIG_GOLIOTH_MAX_NUM_OBSERVE_SUBSCRIBERS
+#define CONFIG_GOLIOTH_MAX_NUM_OBSERVE_SUBSCRIBERS 4
+#endif
+
 #ifndef CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_BLOCK_SIZE
 /* Valid values: 16, 32, 64, 128, 256, 512, 1024 */
 #define CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_BLOCK_SIZE 1024
 #endif
 
+#ifndef CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_WINDOW_SIZE
+#define CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_WINDOW_SIZE 4
+#endif
+
+#ifndef CONFIG_GOLIOTH_BLOCKWISE_BERT_MAX_BLOCK_SIZE
+/* Multiple of 1024. Only used with GOLIOTH_CLIENT_TRANSPORT_TLS */
+#define CONFIG_GOLIOTH_BLOCKWISE_BERT_MAX_BLOCK_SIZE 16384
+#endif
+
 #ifndef CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE
 /* Valid values: 16, 32, 64, 128, 256, 512, 1024 */
 #define CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE 1024
 #endif
 
+#ifndef CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_WINDOW_SIZE
+#define CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_WINDOW_SIZE 1
+#endif
+
+#ifndef CONFIG_GOLIOTH_BLOCKWISE_CHECKPOINT_INTERVAL
+#define CONFIG_GOLIOTH_BLOCKWISE_CHECKPOINT_INTERVAL 8192
+#endif
+
+#ifndef CONFIG_GOLIOTH_COAP_PATH_MTU
+#define CONFIG_GOLIOTH_COAP_PATH_MTU 1280
+#endif
+
 #ifndef CONFIG_GOLIOTH_FW_UPDATE_THREAD_STACK_SIZE
 #define CONFIG_GOLIOTH_FW_UPDATE_THREAD_STACK_SIZE 4096
 #endif
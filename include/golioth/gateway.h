@@ -30,6 +30,10 @@ struct blockwise_transfer *golioth_gateway_uplink_start(struct golioth_client *c
 /// An optional callback and callback argument may be supplied. The callback will be called after
 /// the block is uploaded to provide access to status and CoAP response codes.
 ///
+/// The block is copied before this function returns, and the next block may be sent before the
+/// callback of the previous one has been called, as long as the server accepts blocks of an upload
+/// in flight together. Blocks are sent in the order of the calls.
+///
 /// @param ctx Block upload context used for all blocks in a related upload operation
 /// @param block_idx The index of the block being sent
 /// @param buf The buffer where the data for this block is located
@@ -30,7 +30,8 @@ extern "C"
     STATUS(GOLIOTH_ERR_NACK)                 \
     STATUS(GOLIOTH_ERR_BAD_REQUEST) /* 15 */ \
     STATUS(GOLIOTH_ERR_INVALID_BLOCK_SIZE)   \
-    STATUS(GOLIOTH_ERR_COAP_RESPONSE)
+    STATUS(GOLIOTH_ERR_COAP_RESPONSE)        \
+    STATUS(GOLIOTH_ERR_OFFLINE)
 
 #define GENERATE_GOLIOTH_STATUS_ENUM(code) code,
 enum golioth_status
@@ -94,6 +94,7 @@ struct golioth_thread_config
 
 golioth_sys_thread_t golioth_sys_thread_create(const struct golioth_thread_config *config);
 void golioth_sys_thread_destroy(golioth_sys_thread_t thread);
+void golioth_sys_thread_yield(void);
 
 /*--------------------------------------------------
  * Malloc/Free
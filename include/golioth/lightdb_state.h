@@ -32,6 +32,11 @@ extern "C"
 /// the request was acknowledged by the server) or a timeout occurs (response
 /// never received).
 ///
+/// With CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_SETS, this and the other
+/// asynchronous set functions replace a set to the same path that is still
+/// waiting in the request queue. Only the latest value is sent, and the
+/// callbacks of all replaced sets are called with its result.
+///
 /// @param client The client handle from @ref golioth_client_create
 /// @param path The path in LightDB state to set (e.g. "my_integer")
 /// @param value The value to set at path
@@ -148,6 +153,36 @@ enum golioth_status golioth_lightdb_set_async(struct golioth_client *client,
                                               golioth_set_cb_fn callback,
                                               void *callback_arg);
 
+/// Set an object in LightDB state at a particular path asynchronously, with its own timeout and
+/// retry budget
+///
+/// Same as @ref golioth_lightdb_set_async, except that the response timeout and number of
+/// transmissions are taken from \p policy. These sets are never coalesced.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path in LightDB state to set (e.g. "my_integer")
+/// @param content_type The serialization format of buf
+/// @param buf A buffer containing the object to send
+/// @param buf_len Length of buf
+/// @param policy Response timeout and retry budget of this request
+/// @param callback Callback to call on response received or timeout. Can be NULL.
+/// @param callback_arg Callback argument, passed directly when callback invoked. Can be NULL.
+///
+/// @retval GOLIOTH_OK request enqueued
+/// @retval GOLIOTH_ERR_NULL invalid client handle or policy
+/// @retval GOLIOTH_ERR_INVALID_STATE client is not running, currently stopped
+/// @retval GOLIOTH_ERR_MEM_ALLOC memory allocation error
+/// @retval GOLIOTH_ERR_QUEUE_FULL request queue is full, this request is dropped
+enum golioth_status golioth_lightdb_set_async_with_policy(
+    struct golioth_client *client,
+    const char *path,
+    enum golioth_content_type content_type,
+    const uint8_t *buf,
+    size_t buf_len,
+    const struct golioth_request_policy *policy,
+    golioth_set_cb_fn callback,
+    void *callback_arg);
+
 /// Set am object in LightDB state at a particular path synchronously
 ///
 /// The serialization format of the object is specified by the content_type argument.
@@ -190,6 +225,26 @@ enum golioth_status golioth_lightdb_get_async(struct golioth_client *client,
                                               golioth_get_cb_fn callback,
                                               void *callback_arg);
 
+/// Get data in LightDB state at a particular path asynchronously, with its own timeout and retry
+/// budget
+///
+/// Same as @ref golioth_lightdb_get_async, except that the response timeout and number of
+/// transmissions are taken from \p policy.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path in LightDB state to get (e.g. "my_integer")
+/// @param content_type The serialization format to request for the path
+/// @param policy Response timeout and retry budget of this request
+/// @param callback Callback to call on response received or timeout. Can be NULL.
+/// @param callback_arg Callback argument, passed directly when callback invoked. Can be NULL.
+enum golioth_status golioth_lightdb_get_async_with_policy(
+    struct golioth_client *client,
+    const char *path,
+    enum golioth_content_type content_type,
+    const struct golioth_request_policy *policy,
+    golioth_get_cb_fn callback,
+    void *callback_arg);
+
 /// Get an integer in LightDB state at a particular path synchronously.
 ///
 /// This function will block until one of three things happen (whichever comes first):
@@ -263,6 +318,29 @@ enum golioth_status golioth_lightdb_delete_async(struct golioth_client *client,
                                                  golioth_set_cb_fn callback,
                                                  void *callback_arg);
 
+/// Delete a path in LightDB state asynchronously, with its own timeout and retry budget
+///
+/// Same as @ref golioth_lightdb_delete_async, except that the response timeout and number of
+/// transmissions are taken from \p policy.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path in LightDB state to delete (e.g. "my_integer")
+/// @param policy Response timeout and retry budget of this request
+/// @param callback Callback to call on response received or timeout. Can be NULL.
+/// @param callback_arg Callback argument, passed directly when callback invoked. Can be NULL.
+///
+/// @retval GOLIOTH_OK request enqueued
+/// @retval GOLIOTH_ERR_NULL invalid client handle or policy
+/// @retval GOLIOTH_ERR_INVALID_STATE client is not running, currently stopped
+/// @retval GOLIOTH_ERR_MEM_ALLOC memory allocation error
+/// @retval GOLIOTH_ERR_QUEUE_FULL request queue is full, this request is dropped
+enum golioth_status golioth_lightdb_delete_async_with_policy(
+    struct golioth_client *client,
+    const char *path,
+    const struct golioth_request_policy *policy,
+    golioth_set_cb_fn callback,
+    void *callback_arg);
+
 /// Delete a path in LightDB state synchronously
 ///
 /// This function will block until one of three things happen (whichever comes first):
@@ -315,6 +393,28 @@ enum golioth_status golioth_lightdb_observe_async(struct golioth_client *client,
                                                   golioth_get_cb_fn callback,
                                                   void *callback_arg);
 
+/// Stop observing a path in LightDB state
+///
+/// Observing a path that is already observed with the same content type shares the existing
+/// observation, and notifications are delivered to every callback registered for it. This
+/// removes the callback registered by @ref golioth_lightdb_observe_async with the same
+/// arguments. The observation on the server is released when its last callback is removed.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path passed to @ref golioth_lightdb_observe_async
+/// @param content_type The content type passed to @ref golioth_lightdb_observe_async
+/// @param callback The callback passed to @ref golioth_lightdb_observe_async
+/// @param callback_arg The callback argument passed to @ref golioth_lightdb_observe_async
+///
+/// @retval GOLIOTH_OK callback removed
+/// @retval GOLIOTH_ERR_NULL invalid client handle
+/// @retval GOLIOTH_ERR_INVALID_STATE no such callback, or the observation is not established yet
+enum golioth_status golioth_lightdb_observe_cancel(struct golioth_client *client,
+                                                   const char *path,
+                                                   enum golioth_content_type content_type,
+                                                   golioth_get_cb_fn callback,
+                                                   void *callback_arg);
+
 /// @}
 
 #ifdef __cplusplus
@@ -49,6 +49,70 @@ enum golioth_status golioth_stream_set_async(struct golioth_client *client,
                                              golioth_set_cb_fn callback,
                                              void *callback_arg);
 
+/// Set an object in stream at a particular path asynchronously, with its own timeout and retry
+/// budget
+///
+/// Same as @ref golioth_stream_set_async, except that the response timeout and number of
+/// transmissions are taken from \p policy, e.g. to fail fast on an alarm that is useless once
+/// it is late.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path in stream to set (e.g. "my_obj")
+/// @param content_type The serialization format of buf
+/// @param buf A buffer containing the object to send
+/// @param buf_len Length of buf
+/// @param policy Response timeout and retry budget of this request
+/// @param callback Callback to call on response received or timeout. Can be NULL.
+/// @param callback_arg Callback argument, passed directly when callback invoked. Can be NULL.
+///
+/// @retval GOLIOTH_OK request enqueued
+/// @retval GOLIOTH_ERR_NULL invalid client handle or policy
+/// @retval GOLIOTH_ERR_INVALID_STATE client is not running, currently stopped
+/// @retval GOLIOTH_ERR_MEM_ALLOC memory allocation error
+/// @retval GOLIOTH_ERR_QUEUE_FULL request queue is full, this request is dropped
+enum golioth_status golioth_stream_set_async_with_policy(
+    struct golioth_client *client,
+    const char *path,
+    enum golioth_content_type content_type,
+    const uint8_t *buf,
+    size_t buf_len,
+    const struct golioth_request_policy *policy,
+    golioth_set_cb_fn callback,
+    void *callback_arg);
+
+/// Set an object in stream at a particular path asynchronously, without copying buf
+///
+/// Same as @ref golioth_stream_set_async, except that the SDK takes ownership of \p buf
+/// instead of making its own copy. \p buf_release is called once the payload has been
+/// serialized into a CoAP message (or the request is dropped), after which the caller may
+/// reuse or free the buffer. If this function returns an error, ownership is not transferred
+/// and \p buf_release is not called.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path in stream to set (e.g. "my_obj")
+/// @param content_type The serialization format of buf
+/// @param buf A buffer containing the object to send. Must stay valid until released.
+/// @param buf_len Length of buf
+/// @param buf_release Function to call when buf is no longer needed by the SDK
+/// @param buf_release_arg Argument passed to buf_release. Can be NULL.
+/// @param callback Callback to call on response received or timeout. Can be NULL.
+/// @param callback_arg Callback argument, passed directly when callback invoked. Can be NULL.
+///
+/// @retval GOLIOTH_OK request enqueued
+/// @retval GOLIOTH_ERR_NULL invalid client handle, buf or buf_release
+/// @retval GOLIOTH_ERR_INVALID_STATE client is not running, currently stopped
+/// @retval GOLIOTH_ERR_MEM_ALLOC memory allocation error
+/// @retval GOLIOTH_ERR_QUEUE_FULL request queue is full, this request is dropped
+enum golioth_status golioth_stream_set_async_nocopy(struct golioth_client *client,
+                                                    const char *path,
+                                                    enum golioth_content_type content_type,
+                                                    uint8_t *buf,
+                                                    size_t buf_len,
+                                                    golioth_payload_release_fn buf_release,
+                                                    void *buf_release_arg,
+                                                    golioth_set_cb_fn callback,
+                                                    void *callback_arg);
+
 /// Set an object in stream at a particular path synchronously
 ///
 /// This function will block until one of three things happen (whichever comes first):
@@ -81,7 +145,8 @@ enum golioth_status golioth_stream_set_sync(struct golioth_client *client,
 /// written to buffer.
 ///
 /// @param block_idx The index of the block to fill
-/// @param block_buffer The buffer that this callback should fill
+/// @param block_buffer The buffer that this callback should fill. It is sent as is, so it must
+///        not be accessed after the callback returns.
 /// @param block_size (in/out) Contains the maximum size of block_buffer, and
 ///        should be set to the size of data actually placed in block_buffer.
 ///        Value must be > 0 when this function returns GOLIOTH_OK.
@@ -112,6 +177,33 @@ enum golioth_status golioth_stream_set_blockwise_sync(struct golioth_client *cli
                                                       stream_read_block_cb cb,
                                                       void *arg);
 
+/// Set an object in stream at a particular path synchronously, resuming an interrupted upload
+///
+/// Same as @ref golioth_stream_set_blockwise_sync, except that the progress of the upload is saved
+/// to \p store as the server acknowledges blocks, every GOLIOTH_BLOCKWISE_CHECKPOINT_INTERVAL
+/// bytes. If an earlier upload to \p path was
+/// interrupted, e.g. because the connection was lost, calling this function again (after
+/// reconnecting or rebooting) continues the upload with the same token, and \p cb is only called
+/// for the blocks the server has not acknowledged yet. The first \p block_idx passed to \p cb
+/// may therefore be non-zero, and the block size passed in may differ from the max block size.
+///
+/// The checkpoint is cleared once the server has responded to the last block, or has rejected the
+/// upload. Resuming relies on the server still holding the blocks received so far.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path in stream to set (e.g. "my_obj")
+/// @param content_type The content type of the object (e.g. JSON or CBOR)
+/// @param cb A callback that will be used to fill each block in the transfer
+/// @param arg An optional user provided argument that will be passed to cb
+/// @param store Storage for the checkpoint of the upload
+enum golioth_status golioth_stream_set_blockwise_sync_resumable(
+    struct golioth_client *client,
+    const char *path,
+    enum golioth_content_type content_type,
+    stream_read_block_cb cb,
+    void *arg,
+    const struct golioth_blockwise_checkpoint_store *store);
+
 /// Create a multipart blockwise upload context
 ///
 /// Creates the context and returns a pointer to it. This context is used to associate all blocks of
@@ -125,6 +217,28 @@ struct blockwise_transfer *golioth_stream_blockwise_start(struct golioth_client
                                                           const char *path,
                                                           enum golioth_content_type content_type);
 
+/// Create a multipart blockwise upload context, resuming an interrupted upload
+///
+/// Same as @ref golioth_stream_blockwise_start, except that the progress of the upload is saved to
+/// \p store as the server acknowledges blocks, every GOLIOTH_BLOCKWISE_CHECKPOINT_INTERVAL bytes.
+/// Progress is saved from the calling thread, when the next block is sent with
+/// @ref golioth_stream_blockwise_set_block_async and when the context is destroyed. If an earlier
+/// upload to \p path was interrupted, the context continues it with the same token, and
+/// \p block_idx is set to the first block that still has to be sent. Otherwise \p block_idx is
+/// set to 0.
+///
+/// @param client The client handle from @ref golioth_client_create
+/// @param path The path in stream to set (e.g. "my_obj")
+/// @param content_type The content type of the object (e.g. JSON or CBOR)
+/// @param store Storage for the checkpoint of the upload
+/// @param block_idx (out) Index of the first block to send
+struct blockwise_transfer *golioth_stream_blockwise_resume(
+    struct golioth_client *client,
+    const char *path,
+    enum golioth_content_type content_type,
+    const struct golioth_blockwise_checkpoint_store *store,
+    uint32_t *block_idx);
+
 /// Destroy a multi-block upload context
 ///
 /// Free the memory allocated for a given multi-block upload context.
@@ -145,6 +259,10 @@ void golioth_stream_blockwise_finish(struct blockwise_transfer *ctx);
 /// An optional callback and callback argument may be supplied. The callback will be called after
 /// the block is uploaded to provide access to status and CoAP response codes.
 ///
+/// The block is copied before this function returns, and the next block may be sent before the
+/// callback of the previous one has been called, as long as the server accepts blocks of an upload
+/// in flight together. Blocks are sent in the order of the calls.
+///
 /// @param ctx Block upload context used for all blocks in a related upload operation
 /// @param block_idx The index of the block being sent
 /// @param block_buffer The buffer where the data for this block is located
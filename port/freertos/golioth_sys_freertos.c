@@ -193,6 +193,11 @@ void golioth_sys_thread_destroy(golioth_sys_thread_t thread)
     vTaskDelete((TaskHandle_t) thread);
 }
 
+void golioth_sys_thread_yield(void)
+{
+    taskYIELD();
+}
+
 /*--------------------------------------------------
  * Misc
  *------------------------------------------------*/
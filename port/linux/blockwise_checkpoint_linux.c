@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <golioth/client.h>
+#include <golioth/golioth_sys.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "golioth_sys_linux.h"
+
+#define TAG "blockwise_checkpoint_linux"
+
+/// Marks a file as a checkpoint in the layout below, changed whenever the layout changes
+#define CHECKPOINT_FILE_MAGIC 0x474b5031
+
+struct checkpoint_file
+{
+    uint32_t magic;
+    struct golioth_blockwise_checkpoint checkpoint;
+};
+
+// Function to build the name of the file holding the checkpoint of the upload to path. Slashes of
+// the path are replaced, so that all checkpoints are files in dir.
+static void checkpoint_file_name(char *name,
+                                 size_t name_size,
+                                 const char *dir,
+                                 const char *path,
+                                 const char *suffix)
+{
+    snprintf(name, name_size, "%s/%s.checkpoint%s", dir, path, suffix);
+
+    char *c = &name[strnlen(name, strlen(dir) + 1)];
+    for (size_t i = 0; i < strlen(path) && *c != '\0'; i++, c++)
+    {
+        if (*c == '/')
+        {
+            *c = '_';
+        }
+    }
+}
+
+static enum golioth_status checkpoint_file_load(const char *path,
+                                                struct golioth_blockwise_checkpoint *checkpoint,
+                                                void *arg)
+{
+    char name[PATH_MAX];
+    checkpoint_file_name(name, sizeof(name), arg, path, "");
+
+    FILE *fp = fopen(name, "rb");
+    if (NULL == fp)
+    {
+        return (errno == ENOENT) ? GOLIOTH_ERR_NO_MORE_DATA : GOLIOTH_ERR_IO;
+    }
+
+    struct checkpoint_file file;
+    size_t num_read = fread(&file, sizeof(file), 1, fp);
+    fclose(fp);
+
+    if (num_read != 1 || file.magic != CHECKPOINT_FILE_MAGIC)
+    {
+        GLTH_LOGW(TAG, "Ignoring invalid checkpoint %s", name);
+        return GOLIOTH_ERR_INVALID_FORMAT;
+    }
+
+    *checkpoint = file.checkpoint;
+    return GOLIOTH_OK;
+}
+
+// The checkpoint is written to a temporary file first and then renamed, so that a crash while
+// saving leaves the previous checkpoint in place
+static enum golioth_status checkpoint_file_save(
+    const char *path,
+    const struct golioth_blockwise_checkpoint *checkpoint,
+    void *arg)
+{
+    char name[PATH_MAX];
+    char tmp_name[PATH_MAX];
+    checkpoint_file_name(name, sizeof(name), arg, path, "");
+    checkpoint_file_name(tmp_name, sizeof(tmp_name), arg, path, ".tmp");
+
+    FILE *fp = fopen(tmp_name, "wb");
+    if (NULL == fp)
+    {
+        GLTH_LOGE(TAG, "Failed to open %s, errno: %d", tmp_name, errno);
+        return GOLIOTH_ERR_IO;
+    }
+
+    struct checkpoint_file file = {
+        .magic = CHECKPOINT_FILE_MAGIC,
+        .checkpoint = *checkpoint,
+    };
+    bool written = (fwrite(&file, sizeof(file), 1, fp) == 1) && (fflush(fp) == 0)
+        && (fsync(fileno(fp)) == 0);
+
+    if (fclose(fp) != 0 || !written || rename(tmp_name, name) != 0)
+    {
+        GLTH_LOGE(TAG, "Failed to write %s, errno: %d", name, errno);
+        unlink(tmp_name);
+        return GOLIOTH_ERR_IO;
+    }
+
+    return GOLIOTH_OK;
+}
+
+static void checkpoint_file_clear(const char *path, void *arg)
+{
+    char name[PATH_MAX];
+    checkpoint_file_name(name, sizeof(name), arg, path, "");
+
+    if (unlink(name) != 0 && errno != ENOENT)
+    {
+        GLTH_LOGW(TAG, "Failed to remove %s, errno: %d", name, errno);
+    }
+}
+
+void golioth_sys_linux_checkpoint_store_init(struct golioth_blockwise_checkpoint_store *store,
+                                             const char *dir)
+{
+    store->load = checkpoint_file_load;
+    store->save = checkpoint_file_save;
+    store->clear = checkpoint_file_clear;
+    store->arg = (void *) dir;
+}
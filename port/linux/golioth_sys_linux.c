@@ -11,12 +11,18 @@
 #include <openssl/evp.h>
 #include <poll.h>
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
 #include <signal.h>
 #include <string.h>
 #include <sys/eventfd.h>
 #include <time.h>
 #include <unistd.h>
+#if defined(CONFIG_GOLIOTH_LINUX_EPOLL)
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
+#include "golioth_sys_linux.h"
 #include "../utils/hex.h"
 
 
@@ -191,6 +197,197 @@ int golioth_sys_sem_get_fd(golioth_sys_sem_t sem)
  * Software Timers
  *------------------------------------------------*/
 
+#if defined(CONFIG_GOLIOTH_LINUX_EPOLL)
+
+// Timers are timerfds in a single epoll set. Their callbacks run one at a time
+// in a dedicated thread, not in signal context, and keep firing while the CoAP
+// thread is blocked connecting or waiting to reconnect.
+typedef struct
+{
+    int fd;
+    struct golioth_timer_config config;
+} wrapped_timer_t;
+
+static int timers_epoll_fd = -1;
+static pthread_once_t timers_once = PTHREAD_ONCE_INIT;
+// Recursive, so that callbacks may destroy timers
+static pthread_mutex_t timers_mutex;
+
+static void timers_dispatch(void)
+{
+    pthread_mutex_lock(&timers_mutex);
+
+    while (true)
+    {
+        // One timer at a time, so a callback destroying another timer can't
+        // leave a stale pointer behind in an events array
+        struct epoll_event event;
+        if (epoll_wait(timers_epoll_fd, &event, 1, 0) <= 0)
+        {
+            break;
+        }
+
+        // Fails with EAGAIN if the timer was restarted since epoll_wait()
+        wrapped_timer_t *wt = event.data.ptr;
+        uint64_t num_expirations;
+        if (read(wt->fd, &num_expirations, sizeof(num_expirations)) != sizeof(num_expirations))
+        {
+            continue;
+        }
+
+        if (wt->config.fn)
+        {
+            wt->config.fn(wt, wt->config.user_arg);
+        }
+    }
+
+    pthread_mutex_unlock(&timers_mutex);
+}
+
+static void *timers_thread(void *arg)
+{
+    while (true)
+    {
+        // Only wait here, the timers are read with timers_mutex held
+        struct epoll_event event;
+        int num_events = epoll_wait(timers_epoll_fd, &event, 1, -1);
+        if (num_events < 0 && errno != EINTR)
+        {
+            GLTH_LOGE(TAG, "epoll_wait errno: %d", errno);
+            return NULL;
+        }
+
+        timers_dispatch();
+    }
+
+    return NULL;
+}
+
+static void timers_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&timers_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        GLTH_LOGE(TAG, "epoll_create1 errno: %d", errno);
+        return;
+    }
+    timers_epoll_fd = epoll_fd;
+
+    pthread_t thread;
+    int err = pthread_create(&thread, NULL, timers_thread, NULL);
+    if (err)
+    {
+        GLTH_LOGE(TAG, "pthread_create err: %d", err);
+        close(epoll_fd);
+        timers_epoll_fd = -1;
+        return;
+    }
+    pthread_detach(thread);
+}
+
+static int timers_fd(void)
+{
+    pthread_once(&timers_once, timers_init);
+    return timers_epoll_fd;
+}
+
+golioth_sys_timer_t golioth_sys_timer_create(const struct golioth_timer_config *config)
+{
+    int epoll_fd = timers_fd();
+    if (epoll_fd < 0)
+    {
+        return NULL;
+    }
+
+    // Note: config.name is unused
+    wrapped_timer_t *wt = (wrapped_timer_t *) golioth_sys_malloc(sizeof(wrapped_timer_t));
+    if (!wt)
+    {
+        return NULL;
+    }
+    memcpy(&wt->config, config, sizeof(wt->config));
+
+    // Created disarmed, until golioth_sys_timer_start()
+    wt->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (wt->fd < 0)
+    {
+        goto error;
+    }
+
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.ptr = wt,
+    };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wt->fd, &event) < 0)
+    {
+        close(wt->fd);
+        goto error;
+    }
+
+    return (golioth_sys_timer_t) wt;
+
+error:
+    GLTH_LOGE(TAG, "timer_create errno: %d", errno);
+    golioth_sys_free(wt);
+    return NULL;
+}
+
+bool golioth_sys_timer_start(golioth_sys_timer_t timer)
+{
+    wrapped_timer_t *wt = (wrapped_timer_t *) timer;
+
+    struct timespec spec = {
+        .tv_sec = wt->config.expiration_ms / 1000,
+        .tv_nsec = (wt->config.expiration_ms % 1000) * 1000000,
+    };
+
+    struct itimerspec ispec = {
+        .it_interval = spec,
+        .it_value = spec,
+    };
+
+    int err = timerfd_settime(wt->fd, 0, &ispec, NULL);
+    if (err)
+    {
+        GLTH_LOGE(TAG, "timer_start errno: %d", errno);
+        return false;
+    }
+
+    return true;
+}
+
+bool golioth_sys_timer_reset(golioth_sys_timer_t timer)
+{
+    // timerfd_settime() restarts the countdown and discards pending
+    // expirations, so there is no need to disarm first
+    return golioth_sys_timer_start(timer);
+}
+
+void golioth_sys_timer_destroy(golioth_sys_timer_t timer)
+{
+    wrapped_timer_t *wt = (wrapped_timer_t *) timer;
+    if (!wt)
+    {
+        return;
+    }
+
+    // Not while a dispatch may be about to call into this timer
+    pthread_mutex_lock(&timers_mutex);
+    epoll_ctl(timers_epoll_fd, EPOLL_CTL_DEL, wt->fd, NULL);
+    close(wt->fd);
+    pthread_mutex_unlock(&timers_mutex);
+
+    golioth_sys_free(wt);
+}
+
+#else /* CONFIG_GOLIOTH_LINUX_EPOLL */
+
 // Wrap timer_t to also capture user's config
 typedef struct
 {
@@ -326,6 +523,8 @@ void golioth_sys_timer_destroy(golioth_sys_timer_t timer)
     golioth_sys_free(wt);
 }
 
+#endif /* CONFIG_GOLIOTH_LINUX_EPOLL */
+
 /*--------------------------------------------------
  * Threads
  *------------------------------------------------*/
@@ -379,6 +578,11 @@ void golioth_sys_thread_destroy(golioth_sys_thread_t thread)
     // process exits.
 }
 
+void golioth_sys_thread_yield(void)
+{
+    sched_yield();
+}
+
 /*--------------------------------------------------
  * Hash
  *------------------------------------------------*/
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <golioth/client.h>
+
+/// Set up a checkpoint store for resumable blockwise uploads, keeping each checkpoint in a file
+///
+/// Checkpoints are named after the path of their upload, and written atomically so that an
+/// interrupted save leaves the previous checkpoint in place.
+///
+/// @param store The store to set up, e.g. to pass to
+///        golioth_stream_set_blockwise_sync_resumable()
+/// @param dir Existing directory to keep the checkpoint files in. Must stay valid as long as
+///        the store is in use.
+void golioth_sys_linux_checkpoint_store_init(struct golioth_blockwise_checkpoint_store *store,
+                                             const char *dir);
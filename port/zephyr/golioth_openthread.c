@@ -5,6 +5,8 @@
  */
 
 #include "zephyr/kernel.h"
+#include <string.h>
+#include <zephyr/sys/util.h>
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(golioth_openthread);
 
@@ -13,37 +15,76 @@ LOG_MODULE_REGISTER(golioth_openthread);
 #include <zephyr/net/openthread.h>
 #include <openthread/error.h>
 
+#include "golioth_openthread.h"
+
 struct ot_dns_resolve_context
 {
-    otIp6Address golioth_addr;
     otDnsQueryConfig query_config;
     struct k_sem sem;
-    char *ipv6;
+    uint8_t (*addrs)[16];
+    size_t max_addrs;
+    size_t num_addrs;
+    uint32_t ttl_s;
     int err;
 };
 
-/* Callback for NAT64 IPv6 translated Golioth System Server address from the DNS query response */
+/* Callback for NAT64 IPv6 translated Golioth System Server addresses from the DNS query response */
 static void ot_dns_callback(otError aError, const otDnsAddressResponse *aResponse, void *aContext)
 {
     struct ot_dns_resolve_context *context = aContext;
+    otIp6Address addr;
+    uint32_t ttl;
+
+    context->err = aError;
+    context->ttl_s = UINT32_MAX;
 
-    if (!aError && !otDnsAddressResponseGetAddress(aResponse, 0, &context->golioth_addr, NULL))
+    while (!aError && context->num_addrs < context->max_addrs
+           && !otDnsAddressResponseGetAddress(aResponse, context->num_addrs, &addr, &ttl))
     {
-        otIp6AddressToString(&context->golioth_addr, context->ipv6, OT_IP6_ADDRESS_STRING_SIZE);
+        memcpy(context->addrs[context->num_addrs], addr.mFields.m8, sizeof(addr.mFields.m8));
+        context->num_addrs++;
+        context->ttl_s = MIN(context->ttl_s, ttl);
     }
 
-    context->err = aError;
+    if (!aError && context->num_addrs == 0)
+    {
+        context->err = OT_ERROR_NOT_FOUND;
+    }
 
     k_sem_give(&context->sem);
 }
 
 int golioth_ot_synthesize_ipv6_address(char *hostname, char *ipv6_addr_buffer)
+{
+    uint8_t addr[1][16];
+    size_t num_addrs = 1;
+    uint32_t ttl_s;
+    otIp6Address ip6_addr;
+    int err;
+
+    err = golioth_ot_synthesize_ipv6_addresses(hostname, addr, &num_addrs, &ttl_s);
+    if (err)
+    {
+        return err;
+    }
+
+    memcpy(ip6_addr.mFields.m8, addr[0], sizeof(ip6_addr.mFields.m8));
+    otIp6AddressToString(&ip6_addr, ipv6_addr_buffer, OT_IP6_ADDRESS_STRING_SIZE);
+
+    return 0;
+}
+
+int golioth_ot_synthesize_ipv6_addresses(const char *hostname,
+                                         uint8_t (*addrs)[16],
+                                         size_t *num_addrs,
+                                         uint32_t *ttl_s)
 {
     int err;
     otIp4Address dns_server_addr;
 
     struct ot_dns_resolve_context ot_dns_context = {
-        .ipv6 = ipv6_addr_buffer,
+        .addrs = addrs,
+        .max_addrs = *num_addrs,
     };
 
     k_sem_init(&ot_dns_context.sem, 0, 1);
@@ -79,5 +120,8 @@ int golioth_ot_synthesize_ipv6_address(char *hostname, char *ipv6_addr_buffer)
 
     k_sem_take(&ot_dns_context.sem, K_FOREVER);
 
+    *num_addrs = ot_dns_context.num_addrs;
+    *ttl_s = ot_dns_context.ttl_s;
+
     return ot_dns_context.err;
 }
@@ -284,6 +284,11 @@ void golioth_sys_thread_destroy(golioth_sys_thread_t gthread)
     golioth_sys_free(thread);
 }
 
+void golioth_sys_thread_yield(void)
+{
+    k_yield();
+}
+
 /*--------------------------------------------------
  * Hash
  *------------------------------------------------*/
@@ -7,6 +7,9 @@
 #ifndef __GOLIOTH_OPENTHREAD_H__
 #define __GOLIOTH_OPENTHREAD_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
 /**
  * @brief Synthesize IPv6 address from a given host name
  *
@@ -21,4 +24,23 @@
  */
 int golioth_ot_synthesize_ipv6_address(char *hostname, char *ipv6_addr_buffer);
 
+/**
+ * @brief Synthesize all IPv6 addresses of a given host name
+ *
+ * Same as golioth_ot_synthesize_ipv6_address(), but returns every address of the DNS response,
+ * along with the TTL of the records, so that they can be cached.
+ *
+ * @param[in] hostname Pointer to the host name for which to querry the addresses
+ * @param[out] addrs Array for the synthesized IPv6 addresses, in network byte order
+ * @param[in,out] num_addrs Capacity of @p addrs on input, number of addresses on output
+ * @param[out] ttl_s Lowest TTL of the returned addresses, in seconds
+ *
+ * @retval 0 On success
+ * @retval <0 On failure
+ */
+int golioth_ot_synthesize_ipv6_addresses(const char *hostname,
+                                         uint8_t (*addrs)[16],
+                                         size_t *num_addrs,
+                                         uint32_t *ttl_s);
+
 #endif /* __GOLIOTH_OPENTHREAD_H__ */
@@ -10,6 +10,8 @@
 #include <assert.h>
 #include "coap_client.h"
 #include "coap_blockwise.h"
+#include "golioth_util.h"
+#include "payload_pool.h"
 
 LOG_TAG_DEFINE(coap_blockwise);
 
@@ -19,6 +21,59 @@ _Static_assert(BLOCKSIZE_TO_SZX(CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_BLOCK_SIZE
 _Static_assert(BLOCKSIZE_TO_SZX(CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE) != -1,
                "GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE must be "
                "one of the following: 16,32,64,128,256,512,1024");
+_Static_assert(CONFIG_GOLIOTH_BLOCKWISE_BERT_MAX_BLOCK_SIZE % GOLIOTH_COAP_BERT_UNIT_SIZE == 0,
+               "GOLIOTH_BLOCKWISE_BERT_MAX_BLOCK_SIZE must be a multiple of 1024");
+_Static_assert(GOLIOTH_BLOCKWISE_TOKEN_LEN == GOLIOTH_COAP_TOKEN_LEN,
+               "Checkpoints must hold a whole CoAP token");
+
+/// Blocks in flight at most. libcoap ports send no more than GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS
+/// requests at a time, so a larger window would only hold blocks in the request queue.
+#if defined(__ZEPHYR__)
+#define DOWNLOAD_WINDOW_SIZE CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_WINDOW_SIZE
+#define UPLOAD_WINDOW_SIZE CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_WINDOW_SIZE
+#else
+#define INFLIGHT_CAPPED(window_size)                                          \
+    (((window_size) < CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS)              \
+         ? (window_size)                                                      \
+         : CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS)
+#define DOWNLOAD_WINDOW_SIZE INFLIGHT_CAPPED(CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_WINDOW_SIZE)
+#define UPLOAD_WINDOW_SIZE INFLIGHT_CAPPED(CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_WINDOW_SIZE)
+#endif
+
+/// Margin over twice the fastest round trip seen before a response counts as lost
+#define GOLIOTH_BLOCKWISE_RTT_MARGIN_MS 250
+
+/// Smallest block size transfers shrink to on their own when responses are lost
+#define GOLIOTH_BLOCKWISE_ADAPTIVE_MIN_BLOCK_SIZE 256
+
+/// Timely responses in a row, with the window fully open, before trying larger blocks
+#define GOLIOTH_BLOCKWISE_ADAPTIVE_GROW_AFTER 16
+
+/// Times a downloaded block is requested again after its request timed out, before giving up
+#define GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_RETRIES 3
+
+/// Bytes of a datagram taken by IPv6, UDP, the DTLS record (with Connection ID) and the CoAP
+/// header and options of a block, on top of the block itself
+#define GOLIOTH_BLOCKWISE_DATAGRAM_OVERHEAD 192
+
+_Static_assert(CONFIG_GOLIOTH_COAP_PATH_MTU >= GOLIOTH_BLOCKWISE_DATAGRAM_OVERHEAD + 16,
+               "GOLIOTH_COAP_PATH_MTU is too small to carry a block");
+
+/// What a blockwise transfer has learned about the path to the server
+struct blockwise_link
+{
+    /// Block size to use, adapted between min_szx and max_szx
+    size_t szx;
+    size_t min_szx;
+    size_t max_szx;
+    /// Number of blocks in flight, adapted between 1 and max_window_size
+    size_t window_size;
+    size_t max_window_size;
+    size_t num_timely;
+    size_t num_timely_at_max_window;
+    uint64_t min_rtt_ms;
+    size_t num_rtt_samples;
+};
 
 struct blockwise_transfer
 {
@@ -27,9 +82,63 @@ struct blockwise_transfer
     uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
     const char *path_prefix;
     const char *path;
+    /// Where the progress of a resumable upload is saved, NULL if the upload isn't resumable
+    const struct golioth_blockwise_checkpoint_store *store;
+    /// Bytes acknowledged as of the last checkpoint saved
+    size_t checkpoint_offset;
+    /// Responses of a resumable multi-part upload, NULL for any other upload
+    struct multipart_progress *multipart;
+
+    enum golioth_status status;
+    struct golioth_coap_rsp_code coap_rsp_code;
+};
+
+/// Blocks of a multi-part upload that can be waiting for their response at the same time: a full
+/// request queue, and the ones in flight
+#define NUM_CHECKPOINTED_BLOCKS                           \
+    (CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_LOW_PRIO_MAX_ITEMS \
+     + CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS)
+
+/// A block of a resumable multi-part upload, waiting for its response
+struct checkpointed_block
+{
+    struct blockwise_transfer *ctx;
+    uint32_t block_idx;
+    bool is_last;
+    bool in_use;
+    golioth_set_block_cb_fn set_cb;
+    void *callback_arg;
+};
+
+/// Progress of a resumable multi-part upload. Responses are recorded by the COAP thread, and
+/// checkpoints saved from the application's thread, so the store is never called on the COAP
+/// thread.
+struct multipart_progress
+{
+    golioth_sys_mutex_t mutex;
+    struct checkpointed_block blocks[NUM_CHECKPOINTED_BLOCKS];
+    /// Index of the next block to send, as acknowledged by the server
+    uint32_t acked_block_idx;
+    /// The server responded to the last block, or rejected the upload
+    bool is_finished;
+};
+
+/// A block sent in a blockwise upload, waiting for its response
+struct post_block_slot
+{
+    struct post_block_ctx *ctx;
+    uint32_t block_idx;
+    /// Number of blocks of block_size in a BERT block, 1 otherwise
+    uint32_t num_blocks;
+    bool is_bert;
+    bool is_last;
+    bool done;
+    uint64_t sent_ms;
+    uint64_t rtt_ms;
 
     enum golioth_status status;
     struct golioth_coap_rsp_code coap_rsp_code;
+    size_t negotiated_blocksize_szx;
 };
 
 struct post_block_ctx
@@ -41,22 +150,91 @@ struct post_block_ctx
 
     bool is_last;
     size_t block_size;
+    /// Next block to read
     uint32_t block_idx;
+    /// Size of the BERT blocks sent, each filled with several blocks of block_size. 0 if BERT is
+    /// not used.
+    size_t bert_block_size;
+    /// Payload buffer the next block is read into. It is handed over to the COAP client along with
+    /// the block, so the application's data is only copied once more, into the CoAP message.
     uint8_t *block_buffer;
+    size_t block_buffer_size;
     read_block_cb read_cb;
     void *callback_arg;
 
+    /// Block read ahead into block_buffer while earlier blocks are in flight
+    bool has_pending;
+    uint32_t pending_idx;
+    uint32_t pending_num_blocks;
+    size_t pending_len;
+
+    /// Whether the server accepted the block size sent. Until then, one block at a time.
+    bool block_size_confirmed;
+    size_t window_size;
+    /// Only its block size is used, the window is set by block_size_confirmed
+    struct blockwise_link link;
+    /// Sent blocks, oldest first starting at slots[oldest]
+    size_t oldest;
+    size_t num_outstanding;
+    /// Outstanding blocks sent before the block size changed, their responses are ignored
+    size_t num_stale;
+    struct post_block_slot slots[UPLOAD_WINDOW_SIZE];
+
     struct blockwise_transfer transfer_ctx;
 };
 
+struct get_block_ctx;
+
+/// A block requested in a windowed download, held until all blocks before it are delivered
+struct get_block_slot
+{
+    struct get_block_ctx *ctx;
+    uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
+    uint32_t block_idx;
+    uint64_t sent_ms;
+    /// Times this block was requested again after timing out
+    uint8_t num_retries;
+    bool in_use;
+    bool received;
+
+    enum golioth_status status;
+    bool has_rsp_code;
+    struct golioth_coap_rsp_code coap_rsp_code;
+    bool is_last;
+    size_t len;
+    /// Part of the reorder buffer, NULL if the window never exceeds one block
+    uint8_t *data;
+};
+
 struct get_block_ctx
 {
     size_t block_size;
+    /// Last block handed to get_cb
     uint32_t block_idx;
+    /// Size of the BERT blocks requested, handed to get_cb in blocks of block_size. 0 if BERT is
+    /// not used.
+    size_t bert_block_size;
     golioth_get_block_cb_fn get_cb;
     golioth_end_block_cb_fn end_cb;
     void *callback_arg;
 
+    struct blockwise_link link;
+    /// Block size of the requests outstanding, which follows link.szx. Smaller blocks are
+    /// collected in assembly_buffer until they add up to one of block_size.
+    size_t transfer_szx;
+    uint8_t *assembly_buffer;
+    size_t assembly_len;
+
+    /// Indexes in blocks of the transfer block size
+    uint32_t next_deliver_idx;
+    uint32_t next_request_idx;
+    size_t num_outstanding;
+    /// end_cb has been called, ctx is freed once no request is outstanding
+    bool done;
+
+    uint8_t *reorder_buffer;
+    struct get_block_slot slots[DOWNLOAD_WINDOW_SIZE];
+
     struct blockwise_transfer transfer_ctx;
 };
 
@@ -71,17 +249,186 @@ static void blockwise_transfer_init(struct blockwise_transfer *ctx,
     ctx->path_prefix = path_prefix;
     ctx->path = path;
     ctx->content_type = content_type;
+    ctx->store = NULL;
+    ctx->checkpoint_offset = 0;
+    ctx->multipart = NULL;
     golioth_coap_next_token(ctx->token);
 }
 
 // Function to free the blockwise_transfer structure
 static void blockwise_transfer_free(struct blockwise_transfer *ctx)
 {
+    if (ctx->multipart)
+    {
+        golioth_sys_mutex_destroy(ctx->multipart->mutex);
+        golioth_sys_free(ctx->multipart);
+    }
     golioth_sys_free(ctx);
 }
 
+#if defined(CONFIG_GOLIOTH_BLOCKWISE_ADAPTIVE_BLOCK_SIZE)
+// Largest block size that fits in a single datagram on a path of CONFIG_GOLIOTH_COAP_PATH_MTU
+static size_t path_mtu_szx(void)
+{
+    size_t szx = 0;
+
+    while (szx < BLOCKSIZE_TO_SZX(1024)
+           && SZX_TO_BLOCKSIZE(szx + 1)
+                  <= CONFIG_GOLIOTH_COAP_PATH_MTU - GOLIOTH_BLOCKWISE_DATAGRAM_OVERHEAD)
+    {
+        szx++;
+    }
+
+    return szx;
+}
+#endif
+
+// Function to start a transfer at the largest block size allowed, with a single block in flight.
+// The block size is only adapted when is_adaptive, i.e. not over reliable transports.
+static void blockwise_link_init(struct blockwise_link *link,
+                                size_t max_block_size,
+                                size_t max_window_size,
+                                bool is_adaptive)
+{
+    memset(link, 0, sizeof(*link));
+
+    link->max_szx = BLOCKSIZE_TO_SZX(max_block_size);
+    link->min_szx = link->max_szx;
+
+#if defined(CONFIG_GOLIOTH_BLOCKWISE_ADAPTIVE_BLOCK_SIZE)
+    if (is_adaptive)
+    {
+        link->max_szx = min(link->max_szx, path_mtu_szx());
+        link->min_szx =
+            min(link->max_szx, BLOCKSIZE_TO_SZX(GOLIOTH_BLOCKWISE_ADAPTIVE_MIN_BLOCK_SIZE));
+    }
+#endif
+
+    link->szx = link->max_szx;
+    link->window_size = 1;
+    link->max_window_size = max_window_size;
+}
+
+// Grow the window by one block per window of timely responses, and the block size once the window
+// has been fully open for a while. A response that took long enough that it was likely
+// retransmitted, or queued behind too many others, halves the window. With a single block in
+// flight, it shrinks the block size instead, as large datagrams are the first to be dropped on
+// paths with a smaller MTU than expected.
+static void blockwise_link_update(struct blockwise_link *link,
+                                  enum golioth_status status,
+                                  uint64_t rtt_ms)
+{
+    bool lost = (status == GOLIOTH_ERR_TIMEOUT)
+        || (link->num_rtt_samples > 0
+            && rtt_ms > 2 * link->min_rtt_ms + GOLIOTH_BLOCKWISE_RTT_MARGIN_MS);
+
+    if (lost)
+    {
+        if (link->window_size == 1 && link->szx > link->min_szx)
+        {
+            link->szx--;
+            GLTH_LOGD(TAG, "Block size shrunk to %zu", SZX_TO_BLOCKSIZE(link->szx));
+        }
+        link->window_size = max(link->window_size / 2, 1);
+        link->num_timely = 0;
+        link->num_timely_at_max_window = 0;
+        return;
+    }
+
+    if (link->num_rtt_samples == 0 || rtt_ms < link->min_rtt_ms)
+    {
+        link->min_rtt_ms = rtt_ms;
+    }
+    link->num_rtt_samples++;
+
+    if (++link->num_timely >= link->window_size)
+    {
+        link->num_timely = 0;
+        link->window_size = min(link->window_size + 1, link->max_window_size);
+    }
+
+    if (link->window_size == link->max_window_size
+        && ++link->num_timely_at_max_window >= GOLIOTH_BLOCKWISE_ADAPTIVE_GROW_AFTER)
+    {
+        link->num_timely_at_max_window = 0;
+        if (link->szx < link->max_szx)
+        {
+            link->szx++;
+            /* Larger blocks take longer, so round trips are measured again */
+            link->num_rtt_samples = 0;
+            GLTH_LOGD(TAG, "Block size grown to %zu", SZX_TO_BLOCKSIZE(link->szx));
+        }
+    }
+}
+
 /* Blockwise Uploads related functions */
 
+// Function to pick up the token and progress of an interrupted upload from its checkpoint.
+// Returns false if there is no usable checkpoint, in which case the upload starts over.
+static bool load_checkpoint(struct blockwise_transfer *ctx,
+                            size_t max_block_size,
+                            struct golioth_blockwise_checkpoint *checkpoint)
+{
+    if (NULL == ctx->store)
+    {
+        return false;
+    }
+
+    if (GOLIOTH_OK != ctx->store->load(ctx->path, checkpoint, ctx->store->arg))
+    {
+        return false;
+    }
+
+    if (checkpoint->block_size > max_block_size || BLOCKSIZE_TO_SZX(checkpoint->block_size) == -1)
+    {
+        GLTH_LOGW(TAG, "Ignoring checkpoint with block size %" PRIu32, checkpoint->block_size);
+        return false;
+    }
+
+    GLTH_LOGI(TAG, "Resuming upload to %s at block %" PRIu32, ctx->path, checkpoint->block_idx);
+    memcpy(ctx->token, checkpoint->token, sizeof(ctx->token));
+    ctx->checkpoint_offset = (size_t) checkpoint->block_idx * checkpoint->block_size;
+    return true;
+}
+
+// Function to record that the server has acknowledged all blocks before block_idx. Only saved
+// once CONFIG_GOLIOTH_BLOCKWISE_CHECKPOINT_INTERVAL more bytes have been acknowledged since the
+// last checkpoint, an interrupted upload sends those again.
+static void save_checkpoint(struct blockwise_transfer *ctx, uint32_t block_idx, size_t block_size)
+{
+    if (NULL == ctx->store)
+    {
+        return;
+    }
+
+    size_t offset = (size_t) block_idx * block_size;
+    if (offset < ctx->checkpoint_offset + CONFIG_GOLIOTH_BLOCKWISE_CHECKPOINT_INTERVAL)
+    {
+        return;
+    }
+    ctx->checkpoint_offset = offset;
+
+    struct golioth_blockwise_checkpoint checkpoint = {
+        .block_idx = block_idx,
+        .block_size = block_size,
+    };
+    memcpy(checkpoint.token, ctx->token, sizeof(checkpoint.token));
+
+    enum golioth_status status = ctx->store->save(ctx->path, &checkpoint, ctx->store->arg);
+    if (GOLIOTH_OK != status)
+    {
+        GLTH_LOGW(TAG, "Failed to save upload checkpoint: %d", status);
+    }
+}
+
+static void clear_checkpoint(const struct blockwise_transfer *ctx)
+{
+    if (ctx->store)
+    {
+        ctx->store->clear(ctx->path, ctx->store->arg);
+    }
+}
+
 // Blockwise upload's internal callback function that the COAP client calls
 static void on_block_sent(struct golioth_client *client,
                           enum golioth_status status,
@@ -91,25 +438,31 @@ static void on_block_sent(struct golioth_client *client,
                           void *arg)
 {
     assert(arg);
-    struct post_block_ctx *ctx = arg;
-    ctx->status = status;
-    ctx->coap_rsp_code.code_class = coap_rsp_code->code_class;
-    ctx->coap_rsp_code.code_detail = coap_rsp_code->code_detail;
-    ctx->negotiated_blocksize_szx = BLOCKSIZE_TO_SZX(block_size);
-
-    golioth_sys_sem_give(ctx->sem);
+    struct post_block_slot *slot = arg;
+    slot->status = status;
+    slot->coap_rsp_code.code_class = coap_rsp_code->code_class;
+    slot->coap_rsp_code.code_detail = coap_rsp_code->code_detail;
+    slot->negotiated_blocksize_szx = (block_size > GOLIOTH_COAP_BERT_UNIT_SIZE)
+        ? GOLIOTH_COAP_BERT_SZX
+        : BLOCKSIZE_TO_SZX(block_size);
+    slot->rtt_ms = golioth_sys_now_ms() - slot->sent_ms;
+    slot->done = true;
+
+    golioth_sys_sem_give(slot->ctx->sem);
 }
 
 // Function to call the application's read block callback for obtaining
 // blockwise upload data
 static enum golioth_status call_read_block_callback(struct post_block_ctx *ctx,
+                                                    uint32_t block_idx,
+                                                    uint8_t *block_buffer,
                                                     size_t *block_buffer_len)
 {
     /* Do not allow user callback to directly change ctx->block_size value */
     size_t block_size = ctx->block_size;
 
-    enum golioth_status status = ctx->read_cb(ctx->block_idx,
-                                              ctx->block_buffer,
+    enum golioth_status status = ctx->read_cb(block_idx,
+                                              block_buffer,
                                               &block_size,
                                               &ctx->is_last,
                                               ctx->callback_arg);
@@ -139,65 +492,300 @@ static int recalculate_next_block_idx(int from_idx, size_t from_larger_szx, size
     return next_idx_before_recalc * size_change_multiplier;
 }
 
-// Function to upload a single block
-static enum golioth_status upload_single_block(struct golioth_client *client,
-                                               struct post_block_ctx *ctx,
-                                               size_t block_size)
-{
-    assert(block_size > 0 && block_size <= ctx->block_size);
-
-    enum golioth_status err = golioth_coap_client_set_block(client,
-                                                            ctx->transfer_ctx.token,
-                                                            ctx->transfer_ctx.path_prefix,
-                                                            ctx->transfer_ctx.path,
-                                                            ctx->is_last,
-                                                            ctx->transfer_ctx.content_type,
-                                                            ctx->block_idx,
-                                                            ctx->negotiated_blocksize_szx,
-                                                            ctx->block_buffer,
-                                                            block_size,
-                                                            on_block_sent,
-                                                            ctx,
-                                                            false,
-                                                            GOLIOTH_SYS_WAIT_FOREVER);
-    if (GOLIOTH_OK == err)
+// Function to fill the buffer with as many blocks as fit in a BERT block
+static enum golioth_status read_bert_block(struct post_block_ctx *ctx,
+                                           size_t *block_buffer_len,
+                                           uint32_t *num_blocks)
+{
+    enum golioth_status status = GOLIOTH_OK;
+    size_t len = 0;
+
+    *num_blocks = 0;
+
+    while (!ctx->is_last && len < ctx->bert_block_size)
+    {
+        size_t block_len;
+        status = call_read_block_callback(ctx,
+                                          ctx->block_idx + *num_blocks,
+                                          &ctx->block_buffer[len],
+                                          &block_len);
+        if (status != GOLIOTH_OK)
+        {
+            break;
+        }
+
+        len += block_len;
+        (*num_blocks)++;
+    }
+
+    *block_buffer_len = len;
+    return status;
+}
+
+// Function to read the next block into the block buffer, to be sent once the window allows it
+static enum golioth_status read_pending_block(struct post_block_ctx *ctx)
+{
+    enum golioth_status status;
+
+    ctx->pending_idx = ctx->block_idx;
+    ctx->pending_num_blocks = 1;
+
+    if (NULL == ctx->block_buffer)
+    {
+        /* The previous one went out with the block before */
+        ctx->block_buffer = golioth_payload_pool_alloc(ctx->block_buffer_size);
+        if (NULL == ctx->block_buffer)
+        {
+            return GOLIOTH_ERR_MEM_ALLOC;
+        }
+    }
+
+    if (ctx->bert_block_size)
+    {
+        status = read_bert_block(ctx, &ctx->pending_len, &ctx->pending_num_blocks);
+    }
+    else
+    {
+        status = call_read_block_callback(ctx,
+                                          ctx->block_idx,
+                                          ctx->block_buffer,
+                                          &ctx->pending_len);
+    }
+
+    if (status == GOLIOTH_OK)
+    {
+        ctx->block_idx += ctx->pending_num_blocks;
+        ctx->has_pending = true;
+    }
+
+    return status;
+}
+
+static void release_block_buffer(uint8_t *buf, void *arg)
+{
+    golioth_payload_pool_free(buf);
+}
+
+// Function to send the block read ahead. The block buffer goes along with the request, and is
+// freed by the COAP client once the block has been copied into a CoAP message.
+static enum golioth_status send_pending_block(struct golioth_client *client,
+                                              struct post_block_ctx *ctx)
+{
+    assert(ctx->has_pending && ctx->num_outstanding < ctx->window_size);
+
+    struct post_block_slot *slot =
+        &ctx->slots[(ctx->oldest + ctx->num_outstanding) % ARRAY_SIZE(ctx->slots)];
+
+    slot->ctx = ctx;
+    slot->block_idx = ctx->pending_idx;
+    slot->num_blocks = ctx->pending_num_blocks;
+    slot->is_bert = (ctx->bert_block_size != 0);
+    slot->is_last = ctx->is_last;
+    slot->done = false;
+    /* Until the COAP client stores the time the block actually went out */
+    slot->sent_ms = golioth_sys_now_ms();
+
+    ctx->has_pending = false;
+
+    enum golioth_status status = golioth_coap_client_set_block_nocopy(
+        client,
+        ctx->transfer_ctx.token,
+        ctx->transfer_ctx.path_prefix,
+        ctx->transfer_ctx.path,
+        ctx->is_last,
+        ctx->transfer_ctx.content_type,
+        slot->block_idx,
+        slot->is_bert ? GOLIOTH_COAP_BERT_SZX : ctx->negotiated_blocksize_szx,
+        ctx->block_buffer,
+        ctx->pending_len,
+        release_block_buffer,
+        NULL,
+        on_block_sent,
+        slot,
+        &slot->sent_ms,
+        false,
+        GOLIOTH_SYS_WAIT_FOREVER);
+    if (GOLIOTH_OK == status)
+    {
+        /* Owned by the COAP client now, otherwise it's kept for the next block */
+        ctx->block_buffer = NULL;
+        ctx->num_outstanding++;
+    }
+
+    return status;
+}
+
+// Function to move to the block size the link asks for. Only called when no block is in flight,
+// as blocks read ahead are cut at the old size.
+static void switch_upload_block_size(struct post_block_ctx *ctx)
+{
+    if (ctx->link.szx == (size_t) BLOCKSIZE_TO_SZX(ctx->block_size)
+        || (ctx->is_last && !ctx->has_pending))
+    {
+        return;
+    }
+
+    /* A larger block must start where one of that size would, so growing may have to wait */
+    uint32_t next_idx = ctx->has_pending ? ctx->pending_idx : ctx->block_idx;
+    size_t offset = next_idx * ctx->block_size;
+    size_t block_size = SZX_TO_BLOCKSIZE(ctx->link.szx);
+    if (offset % block_size != 0)
+    {
+        return;
+    }
+
+    ctx->has_pending = false;
+    ctx->is_last = false;
+    ctx->block_idx = offset / block_size;
+    ctx->block_size = block_size;
+    ctx->negotiated_blocksize_szx = ctx->link.szx;
+    ctx->block_size_confirmed = false;
+    ctx->window_size = 1;
+}
+
+// Function to wait for the response to the oldest block in flight, and adjust to the block size
+// the server answered with, or the one the link calls for
+static enum golioth_status retire_oldest_block(struct post_block_ctx *ctx)
+{
+    struct post_block_slot *slot = &ctx->slots[ctx->oldest];
+
+    while (!slot->done)
     {
         golioth_sys_sem_take(ctx->sem, GOLIOTH_SYS_WAIT_FOREVER);
-        err = ctx->status;
+    }
 
-        if (ctx->negotiated_blocksize_szx < BLOCKSIZE_TO_SZX(ctx->block_size))
+    ctx->oldest = (ctx->oldest + 1) % ARRAY_SIZE(ctx->slots);
+    ctx->num_outstanding--;
+
+    if (ctx->num_stale > 0)
+    {
+        ctx->num_stale--;
+        return GOLIOTH_OK;
+    }
+
+    ctx->status = slot->status;
+    ctx->coap_rsp_code = slot->coap_rsp_code;
+
+    if (slot->status != GOLIOTH_OK)
+    {
+        return slot->status;
+    }
+
+    bool size_changed = false;
+    ctx->negotiated_blocksize_szx = slot->negotiated_blocksize_szx;
+
+    if (slot->is_bert && ctx->negotiated_blocksize_szx != GOLIOTH_COAP_BERT_SZX)
+    {
+        GLTH_LOGW(TAG, "Server does not accept BERT blocks, falling back to single blocks");
+        ctx->bert_block_size = 0;
+        ctx->block_idx = slot->block_idx + slot->num_blocks;
+        size_changed = true;
+    }
+
+    if (ctx->negotiated_blocksize_szx < BLOCKSIZE_TO_SZX(ctx->block_size))
+    {
+        /* Recalculate index so what was sent is now based on the new block_size */
+        ctx->block_idx = recalculate_next_block_idx(slot->block_idx + slot->num_blocks - 1,
+                                                    BLOCKSIZE_TO_SZX(ctx->block_size),
+                                                    ctx->negotiated_blocksize_szx);
+
+        /* Store the new blocksize for future blocks */
+        ctx->block_size = SZX_TO_BLOCKSIZE(ctx->negotiated_blocksize_szx);
+        size_changed = true;
+
+        /* Never grow past what the server asked for */
+        ctx->link.szx = ctx->negotiated_blocksize_szx;
+        ctx->link.max_szx = ctx->link.szx;
+        ctx->link.min_szx = min(ctx->link.min_szx, ctx->link.szx);
+    }
+
+    if (size_changed)
+    {
+        /* Blocks read or sent since were cut at the old size, so read them again */
+        if (ctx->has_pending)
+        {
+            ctx->has_pending = false;
+            ctx->is_last = false;
+        }
+        ctx->num_stale = ctx->num_outstanding;
+        ctx->block_size_confirmed = false;
+        ctx->window_size = 1;
+
+        /* The next block at the new size starts right after what was acknowledged */
+        save_checkpoint(&ctx->transfer_ctx, ctx->block_idx, ctx->block_size);
+    }
+    else
+    {
+        if (!slot->is_last)
+        {
+            save_checkpoint(&ctx->transfer_ctx,
+                            slot->block_idx + slot->num_blocks,
+                            ctx->block_size);
+        }
+
+        if (!ctx->block_size_confirmed)
         {
-            /* Recalculate index so what was sent is now based on the new block_size */
-            int next_block_idx = recalculate_next_block_idx(ctx->block_idx,
-                                                            BLOCKSIZE_TO_SZX(ctx->block_size),
-                                                            ctx->negotiated_blocksize_szx);
+            ctx->block_size_confirmed = true;
+            ctx->window_size = ARRAY_SIZE(ctx->slots);
+        }
 
-            /* Subtract 1 to indicate the block we just sent; inc happens after return */
-            ctx->block_idx = next_block_idx - 1;
+        if (!slot->is_bert)
+        {
+            blockwise_link_update(&ctx->link, GOLIOTH_OK, slot->rtt_ms);
+        }
 
-            /* Store the new blocksize for future blocks */
-            ctx->block_size = SZX_TO_BLOCKSIZE(ctx->negotiated_blocksize_szx);
+        if (ctx->link.szx < (size_t) BLOCKSIZE_TO_SZX(ctx->block_size))
+        {
+            /* Stop sending at the old size */
+            ctx->window_size = 1;
+        }
+
+        if (ctx->num_outstanding == 0)
+        {
+            switch_upload_block_size(ctx);
         }
     }
 
-    return err;
+    return GOLIOTH_OK;
 }
 
 // Function to manage blockwise upload and handle errors
+//
+// The next block is read while the previous ones are in flight. Until the server has accepted the
+// block size, blocks are sent one at a time, as the response may ask for smaller blocks.
 static enum golioth_status process_blockwise_uploads(struct golioth_client *client,
                                                      struct post_block_ctx *ctx)
 {
-    size_t block_buffer_len = ctx->block_size;
-    enum golioth_status status = call_read_block_callback(ctx, &block_buffer_len);
-    if (status == GOLIOTH_OK)
+    enum golioth_status status = GOLIOTH_OK;
+
+    while (true)
     {
-        status = upload_single_block(client, ctx, block_buffer_len);
+        bool can_read_ahead = ctx->block_size_confirmed || ctx->num_outstanding == 0;
+
+        if (status == GOLIOTH_OK && !ctx->has_pending && !ctx->is_last && can_read_ahead)
+        {
+            status = read_pending_block(ctx);
+        }
+
+        if (status == GOLIOTH_OK && ctx->has_pending && ctx->num_outstanding < ctx->window_size)
+        {
+            status = send_pending_block(client, ctx);
+            continue;
+        }
+
+        if (ctx->num_outstanding == 0)
+        {
+            break;
+        }
+
+        /* After an error, keep collecting the responses to blocks already sent */
+        enum golioth_status block_status = retire_oldest_block(ctx);
         if (status == GOLIOTH_OK)
         {
-            /* Only advance block_idx if block was uploaded successfully */
-            ctx->block_idx++;
+            status = block_status;
         }
     }
+
     return status;
 }
 
@@ -208,6 +796,26 @@ enum golioth_status golioth_blockwise_post(struct golioth_client *client,
                                            read_block_cb read_cb,
                                            golioth_set_cb_fn set_cb,
                                            void *callback_arg)
+{
+    return golioth_blockwise_post_resumable(client,
+                                            path_prefix,
+                                            path,
+                                            content_type,
+                                            read_cb,
+                                            set_cb,
+                                            callback_arg,
+                                            NULL);
+}
+
+enum golioth_status golioth_blockwise_post_resumable(
+    struct golioth_client *client,
+    const char *path_prefix,
+    const char *path,
+    enum golioth_content_type content_type,
+    read_block_cb read_cb,
+    golioth_set_cb_fn set_cb,
+    void *callback_arg,
+    const struct golioth_blockwise_checkpoint_store *store)
 {
     enum golioth_status status = GOLIOTH_ERR_FAIL;
     if (NULL == client || NULL == path || NULL == read_cb)
@@ -225,34 +833,74 @@ enum golioth_status golioth_blockwise_post(struct golioth_client *client,
 
     blockwise_transfer_init(&ctx->transfer_ctx, client, path_prefix, path, content_type);
 
-    ctx->block_buffer = golioth_sys_malloc(CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE);
+    /* BERT block numbers count 1024 byte units, so blocks of any other size can't be merged */
+    ctx->bert_block_size =
+        (CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE == GOLIOTH_COAP_BERT_UNIT_SIZE)
+        ? golioth_coap_client_bert_block_size(client)
+        : 0;
+
+    ctx->block_buffer_size =
+        max(ctx->bert_block_size, CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE);
+    ctx->block_buffer = golioth_payload_pool_alloc(ctx->block_buffer_size);
     if (NULL == ctx->block_buffer)
     {
         goto finish_with_post_block_ctx;
     }
 
-    ctx->sem = golioth_sys_sem_create(1, 0);
+    ctx->sem = golioth_sys_sem_create(ARRAY_SIZE(ctx->slots), 0);
     if (NULL == ctx->sem)
     {
         goto finish_with_block_buffer;
     }
 
+    /* Over a reliable transport, blocks are neither fragmented by the path nor lost */
+    blockwise_link_init(&ctx->link,
+                        CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE,
+                        1,
+                        golioth_coap_client_bert_block_size(client) == 0);
+
     ctx->status = GOLIOTH_ERR_FAIL, ctx->is_last = false;
-    ctx->block_size = CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE;
+    ctx->block_size = SZX_TO_BLOCKSIZE(ctx->link.szx);
     ctx->block_idx = 0;
     ctx->read_cb = read_cb;
     ctx->callback_arg = callback_arg;
-    ctx->negotiated_blocksize_szx =
-        BLOCKSIZE_TO_SZX(CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE);
-
-    while (false == ctx->is_last)
+    ctx->negotiated_blocksize_szx = ctx->link.szx;
+    ctx->has_pending = false;
+    ctx->block_size_confirmed = false;
+    ctx->window_size = 1;
+    ctx->oldest = 0;
+    ctx->num_outstanding = 0;
+    ctx->num_stale = 0;
+
+    struct golioth_blockwise_checkpoint checkpoint;
+    ctx->transfer_ctx.store = store;
+    if (load_checkpoint(&ctx->transfer_ctx,
+                        CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE,
+                        &checkpoint))
     {
-        if ((status = process_blockwise_uploads(client, ctx)) != GOLIOTH_OK)
+        ctx->block_idx = checkpoint.block_idx;
+        ctx->block_size = checkpoint.block_size;
+        ctx->negotiated_blocksize_szx = BLOCKSIZE_TO_SZX(ctx->block_size);
+        ctx->link.szx = ctx->negotiated_blocksize_szx;
+        ctx->link.min_szx = min(ctx->link.min_szx, ctx->link.szx);
+        ctx->link.max_szx = max(ctx->link.max_szx, ctx->link.szx);
+
+        /* BERT block numbers count 1024 byte units */
+        if (ctx->block_size != GOLIOTH_COAP_BERT_UNIT_SIZE)
         {
-            break;
+            ctx->bert_block_size = 0;
         }
     }
 
+    status = process_blockwise_uploads(client, ctx);
+
+    /* An upload the server has responded to for good can't be resumed, keep the checkpoint of
+     * any other */
+    if (status == GOLIOTH_OK || status == GOLIOTH_ERR_COAP_RESPONSE)
+    {
+        clear_checkpoint(&ctx->transfer_ctx);
+    }
+
     if (set_cb)
     {
 
@@ -276,7 +924,7 @@ enum golioth_status golioth_blockwise_post(struct golioth_client *client,
     golioth_sys_sem_destroy(ctx->sem);
 
 finish_with_block_buffer:
-    free(ctx->block_buffer);
+    golioth_payload_pool_free(ctx->block_buffer);
 
 finish_with_post_block_ctx:
     free(ctx);
@@ -327,6 +975,87 @@ finish_with_ctx:
     return NULL;
 }
 
+// Create an async upload context that picks up where an interrupted upload to the same path left
+// off, according to its checkpoint
+struct blockwise_transfer *golioth_blockwise_upload_resume(
+    struct golioth_client *client,
+    const char *path_prefix,
+    const char *path,
+    enum golioth_content_type content_type,
+    const struct golioth_blockwise_checkpoint_store *store,
+    uint32_t *block_idx)
+{
+    if (NULL == store || NULL == block_idx)
+    {
+        return NULL;
+    }
+
+    struct blockwise_transfer *ctx =
+        golioth_blockwise_upload_start(client, path_prefix, path, content_type);
+    if (NULL == ctx)
+    {
+        return NULL;
+    }
+
+    ctx->multipart = golioth_sys_malloc(sizeof(struct multipart_progress));
+    if (NULL == ctx->multipart)
+    {
+        golioth_blockwise_upload_finish(ctx);
+        return NULL;
+    }
+    memset(ctx->multipart, 0, sizeof(struct multipart_progress));
+
+    ctx->multipart->mutex = golioth_sys_mutex_create();
+    if (NULL == ctx->multipart->mutex)
+    {
+        golioth_sys_free(ctx->multipart);
+        ctx->multipart = NULL;
+        golioth_blockwise_upload_finish(ctx);
+        return NULL;
+    }
+
+    /* Blocks of multi-part uploads are always sent at the max block size */
+    struct golioth_blockwise_checkpoint checkpoint;
+    ctx->store = store;
+    *block_idx = 0;
+    if (load_checkpoint(ctx, CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE, &checkpoint))
+    {
+        if (checkpoint.block_size == CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE)
+        {
+            *block_idx = checkpoint.block_idx;
+        }
+        else
+        {
+            golioth_coap_next_token(ctx->token);
+            ctx->checkpoint_offset = 0;
+        }
+    }
+    ctx->multipart->acked_block_idx = *block_idx;
+
+    return ctx;
+}
+
+// Function to save the progress the COAP thread recorded for a multi-part upload, from the
+// application's thread
+static void flush_multipart_checkpoint(struct blockwise_transfer *ctx)
+{
+    struct multipart_progress *progress = ctx->multipart;
+
+    golioth_sys_mutex_lock(progress->mutex, GOLIOTH_SYS_WAIT_FOREVER);
+    uint32_t acked_block_idx = progress->acked_block_idx;
+    bool is_finished = progress->is_finished;
+    golioth_sys_mutex_unlock(progress->mutex);
+
+    if (is_finished)
+    {
+        clear_checkpoint(ctx);
+    }
+    else
+    {
+        save_checkpoint(ctx, acked_block_idx, CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE);
+    }
+}
+
 // Destroy an async upload context
 void golioth_blockwise_upload_finish(struct blockwise_transfer *ctx)
 {
@@ -336,11 +1065,67 @@ void golioth_blockwise_upload_finish(struct blockwise_transfer *ctx)
         return;
     }
 
+    if (ctx->multipart)
+    {
+        flush_multipart_checkpoint(ctx);
+    }
+
     /* ctx->path was allocated in golioth_blockwise_upload_start() */
     free((char *) ctx->path);
     blockwise_transfer_free(ctx);
 }
 
+// Function to record the progress of a resumable multi-part upload once a block is acknowledged,
+// before handing the response to the application
+static void on_checkpointed_block_sent(struct golioth_client *client,
+                                       enum golioth_status status,
+                                       const struct golioth_coap_rsp_code *coap_rsp_code,
+                                       const char *path,
+                                       size_t block_size,
+                                       void *arg)
+{
+    struct checkpointed_block *block = arg;
+    struct multipart_progress *progress = block->ctx->multipart;
+    golioth_set_block_cb_fn set_cb = block->set_cb;
+    void *callback_arg = block->callback_arg;
+
+    golioth_sys_mutex_lock(progress->mutex, GOLIOTH_SYS_WAIT_FOREVER);
+    if ((status == GOLIOTH_OK && block->is_last) || status == GOLIOTH_ERR_COAP_RESPONSE)
+    {
+        progress->is_finished = true;
+    }
+    else if (status == GOLIOTH_OK)
+    {
+        progress->acked_block_idx = max(progress->acked_block_idx, block->block_idx + 1);
+    }
+    block->in_use = false;
+    golioth_sys_mutex_unlock(progress->mutex);
+
+    if (set_cb)
+    {
+        set_cb(client, status, coap_rsp_code, path, block_size, callback_arg);
+    }
+}
+
+// Function to find a free block slot of a resumable multi-part upload
+static struct checkpointed_block *take_checkpointed_block(struct multipart_progress *progress)
+{
+    struct checkpointed_block *block = NULL;
+
+    golioth_sys_mutex_lock(progress->mutex, GOLIOTH_SYS_WAIT_FOREVER);
+    for (size_t i = 0; i < ARRAY_SIZE(progress->blocks) && !block; i++)
+    {
+        if (!progress->blocks[i].in_use)
+        {
+            block = &progress->blocks[i];
+            block->in_use = true;
+        }
+    }
+    golioth_sys_mutex_unlock(progress->mutex);
+
+    return block;
+}
+
 // Send a single block asynchronously
 enum golioth_status golioth_blockwise_upload_block(struct blockwise_transfer *ctx,
                                                    uint32_t block_idx,
@@ -357,7 +1142,28 @@ enum golioth_status golioth_blockwise_upload_block(struct blockwise_transfer *ct
         return GOLIOTH_ERR_NULL;
     }
 
-    return golioth_coap_client_set_block(
+    struct checkpointed_block *block = NULL;
+    if (ctx->multipart)
+    {
+        flush_multipart_checkpoint(ctx);
+
+        block = take_checkpointed_block(ctx->multipart);
+        if (NULL == block)
+        {
+            return GOLIOTH_ERR_QUEUE_FULL;
+        }
+
+        block->ctx = ctx;
+        block->block_idx = block_idx;
+        block->is_last = is_last;
+        block->set_cb = set_cb;
+        block->callback_arg = callback_arg;
+
+        set_cb = on_checkpointed_block_sent;
+        callback_arg = block;
+    }
+
+    enum golioth_status status = golioth_coap_client_set_block(
         ctx->client,
         ctx->token,
         ctx->path_prefix,
@@ -372,12 +1178,246 @@ enum golioth_status golioth_blockwise_upload_block(struct blockwise_transfer *ct
         callback_arg,
         is_synchronous,
         timeout_s);
+    if (GOLIOTH_OK != status && block)
+    {
+        golioth_sys_mutex_lock(ctx->multipart->mutex, GOLIOTH_SYS_WAIT_FOREVER);
+        block->in_use = false;
+        golioth_sys_mutex_unlock(ctx->multipart->mutex);
+    }
+
+    return status;
 }
 
 /* Blockwise Downloads related functions */
 
-static enum golioth_status download_single_block(struct golioth_client *client,
-                                                 struct get_block_ctx *ctx);
+// Function to hand a received block to the application. A BERT block is handed over as several
+// blocks of ctx->block_size, leaving ctx->block_idx at the last one.
+static enum golioth_status deliver_blocks(struct golioth_client *client,
+                                          struct get_block_ctx *ctx,
+                                          const char *path,
+                                          const uint8_t *payload,
+                                          size_t payload_size,
+                                          bool is_last)
+{
+    enum golioth_status status;
+    size_t offset = 0;
+
+    if (!is_last && payload_size % ctx->block_size != 0)
+    {
+        GLTH_LOGE(TAG,
+                  "Received block of %zu bytes, not a multiple of %zu",
+                  payload_size,
+                  ctx->block_size);
+        return GOLIOTH_ERR_INVALID_BLOCK_SIZE;
+    }
+
+    while (true)
+    {
+        size_t block_len = min(payload_size - offset, ctx->block_size);
+        bool is_last_in_payload = (offset + block_len >= payload_size);
+
+        status = ctx->get_cb(client,
+                             path,
+                             ctx->block_idx,
+                             &payload[offset],
+                             block_len,
+                             is_last && is_last_in_payload,
+                             ctx->block_size,
+                             ctx->callback_arg);
+
+        offset += block_len;
+
+        if (GOLIOTH_OK != status || is_last_in_payload)
+        {
+            return status;
+        }
+
+        ctx->block_idx++;
+    }
+}
+
+static void on_block_rcvd(struct golioth_client *client,
+                          enum golioth_status status,
+                          const struct golioth_coap_rsp_code *coap_rsp_code,
+                          const char *path,
+                          const uint8_t *payload,
+                          size_t payload_size,
+                          bool is_last,
+                          void *arg);
+
+static struct get_block_slot *slot_for_block(struct get_block_ctx *ctx, uint32_t block_idx)
+{
+    return &ctx->slots[block_idx % ctx->link.max_window_size];
+}
+
+static void free_get_block_ctx(struct get_block_ctx *ctx)
+{
+    golioth_sys_free(ctx->reorder_buffer);
+    golioth_sys_free(ctx->assembly_buffer);
+    golioth_sys_free(ctx);
+}
+
+// Function to request a single block
+static enum golioth_status request_block(struct golioth_client *client,
+                                         struct get_block_ctx *ctx,
+                                         uint32_t block_idx,
+                                         uint8_t num_retries)
+{
+    struct get_block_slot *slot = slot_for_block(ctx, block_idx);
+    assert(!slot->in_use);
+
+    /* Responses are matched by token, so each outstanding request needs its own */
+    golioth_coap_next_token(slot->token);
+    slot->block_idx = block_idx;
+    slot->num_retries = num_retries;
+    slot->received = false;
+    /* Until the COAP client stores the time the request actually went out */
+    slot->sent_ms = golioth_sys_now_ms();
+    slot->in_use = true;
+    ctx->num_outstanding++;
+
+    enum golioth_status status =
+        golioth_coap_client_get_block(client,
+                                      slot->token,
+                                      ctx->transfer_ctx.path_prefix,
+                                      ctx->transfer_ctx.path,
+                                      ctx->transfer_ctx.content_type,
+                                      block_idx,
+                                      ctx->bert_block_size
+                                          ? ctx->bert_block_size
+                                          : SZX_TO_BLOCKSIZE(ctx->transfer_szx),
+                                      on_block_rcvd,
+                                      slot,
+                                      &slot->sent_ms,
+                                      false,
+                                      GOLIOTH_SYS_WAIT_FOREVER);
+    if (GOLIOTH_OK != status)
+    {
+        slot->in_use = false;
+        ctx->num_outstanding--;
+    }
+
+    return status;
+}
+
+// Function to check whether the next block can be requested at the transfer block size, switching
+// to the one the link asks for once it can. Requests at the old size are answered first, and a
+// larger block must start where one of that size would.
+static bool ready_to_request(struct get_block_ctx *ctx)
+{
+    if (ctx->link.szx == ctx->transfer_szx)
+    {
+        return true;
+    }
+
+    size_t offset = (size_t) ctx->next_request_idx << (ctx->transfer_szx + 4);
+    if (offset % SZX_TO_BLOCKSIZE(ctx->link.szx) != 0)
+    {
+        return true;
+    }
+
+    if (ctx->num_outstanding > 0)
+    {
+        return false;
+    }
+
+    ctx->next_request_idx = offset >> (ctx->link.szx + 4);
+    ctx->next_deliver_idx = ctx->next_request_idx;
+    ctx->transfer_szx = ctx->link.szx;
+    return true;
+}
+
+// Function to keep window_size blocks past the next one to deliver requested
+static enum golioth_status fill_window(struct golioth_client *client, struct get_block_ctx *ctx)
+{
+    ctx->next_request_idx = max(ctx->next_request_idx, ctx->next_deliver_idx);
+
+    while (ctx->next_request_idx < ctx->next_deliver_idx + ctx->link.window_size
+           && ready_to_request(ctx))
+    {
+        enum golioth_status status = request_block(client, ctx, ctx->next_request_idx, 0);
+        if (GOLIOTH_OK != status)
+        {
+            /* Try again on the next response, unless none is outstanding */
+            return (ctx->num_outstanding > 0) ? GOLIOTH_OK : status;
+        }
+
+        ctx->next_request_idx++;
+    }
+
+    return GOLIOTH_OK;
+}
+
+// Function to collect a block smaller than ctx->block_size, and hand it to the application along
+// with the ones before it once they add up to a full block
+static enum golioth_status assemble_block(struct golioth_client *client,
+                                          struct get_block_ctx *ctx,
+                                          size_t offset,
+                                          const char *path,
+                                          const uint8_t *payload,
+                                          size_t payload_size,
+                                          bool is_last)
+{
+    if (!is_last && payload_size != SZX_TO_BLOCKSIZE(ctx->transfer_szx))
+    {
+        GLTH_LOGE(TAG,
+                  "Received block of %zu bytes, expected %zu",
+                  payload_size,
+                  SZX_TO_BLOCKSIZE(ctx->transfer_szx));
+        return GOLIOTH_ERR_INVALID_BLOCK_SIZE;
+    }
+
+    ctx->assembly_len = offset % ctx->block_size;
+    memcpy(&ctx->assembly_buffer[ctx->assembly_len], payload, payload_size);
+    ctx->assembly_len += payload_size;
+
+    if (!is_last && ctx->assembly_len < ctx->block_size)
+    {
+        return GOLIOTH_OK;
+    }
+
+    return deliver_blocks(client,
+                          ctx,
+                          path,
+                          ctx->assembly_buffer,
+                          ctx->assembly_len,
+                          is_last);
+}
+
+// Function to deliver the next block in order, returns true if the download has ended
+static bool complete_block(struct golioth_client *client,
+                           struct get_block_ctx *ctx,
+                           struct get_block_slot *slot,
+                           enum golioth_status status,
+                           const struct golioth_coap_rsp_code *coap_rsp_code,
+                           const char *path,
+                           const uint8_t *payload,
+                           size_t payload_size,
+                           bool is_last)
+{
+    size_t offset = (size_t) slot->block_idx << (ctx->transfer_szx + 4);
+
+    slot->in_use = false;
+    ctx->block_idx = offset / ctx->block_size;
+
+    if (GOLIOTH_OK == status)
+    {
+        status = (SZX_TO_BLOCKSIZE(ctx->transfer_szx) < ctx->block_size)
+            ? assemble_block(client, ctx, offset, path, payload, payload_size, is_last)
+            : deliver_blocks(client, ctx, path, payload, payload_size, is_last);
+    }
+
+    if (is_last || GOLIOTH_OK != status)
+    {
+        ctx->end_cb(client, status, coap_rsp_code, path, ctx->block_idx, ctx->callback_arg);
+        ctx->done = true;
+        return true;
+    }
+
+    /* A BERT response may have held several blocks, which deliver_blocks counted */
+    ctx->next_deliver_idx = ctx->bert_block_size ? ctx->block_idx + 1 : slot->block_idx + 1;
+    return false;
+}
 
 // Blockwise download's internal callback function that the COAP client calls
 static void on_block_rcvd(struct golioth_client *client,
@@ -391,55 +1431,100 @@ static void on_block_rcvd(struct golioth_client *client,
 {
     // assert valid values of arg, payload size and block_buffer
     assert(arg);
-    assert(payload_size <= CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_BLOCK_SIZE);
-    struct get_block_ctx *ctx = arg;
+    struct get_block_slot *slot = arg;
+    struct get_block_ctx *ctx = slot->ctx;
+    assert(payload_size <= max(ctx->bert_block_size, ctx->block_size));
 
-    if (GOLIOTH_OK == status)
+    ctx->num_outstanding--;
+
+    if (ctx->done)
     {
-        status = ctx->get_cb(client,
-                             path,
-                             ctx->block_idx,
-                             payload,
-                             payload_size,
-                             is_last,
-                             ctx->block_size,
-                             ctx->callback_arg);
+        /* Requested past the end, or after an error */
+        slot->in_use = false;
+        if (ctx->num_outstanding == 0)
+        {
+            free_get_block_ctx(ctx);
+        }
+        return;
     }
 
-    if (is_last || GOLIOTH_OK != status)
+    blockwise_link_update(&ctx->link, status, golioth_sys_now_ms() - slot->sent_ms);
+
+    if (GOLIOTH_ERR_TIMEOUT == status && slot->num_retries < GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_RETRIES)
     {
-        ctx->end_cb(client, status, coap_rsp_code, path, ctx->block_idx, ctx->callback_arg);
+        /* The window has been shrunk above, so ask for this block again before giving up on the
+         * whole download. Blocks after it are kept, and delivered once it arrives. */
+        GLTH_LOGW(TAG, "Block %" PRIu32 " timed out, requesting it again", slot->block_idx);
+        slot->in_use = false;
+        if (GOLIOTH_OK == request_block(client, ctx, slot->block_idx, slot->num_retries + 1))
+        {
+            return;
+        }
+        slot->in_use = true;
+    }
 
-        golioth_sys_free(ctx);
+    bool ended = false;
+
+    if (slot->block_idx != ctx->next_deliver_idx)
+    {
+        /* Arrived ahead of an earlier block, hold on to it until that one is delivered */
+        slot->received = true;
+        slot->status = status;
+        slot->has_rsp_code = (coap_rsp_code != NULL);
+        if (coap_rsp_code)
+        {
+            slot->coap_rsp_code = *coap_rsp_code;
+        }
+        slot->is_last = is_last;
+        slot->len = (GOLIOTH_OK == status) ? payload_size : 0;
+        memcpy(slot->data, payload, slot->len);
     }
     else
     {
-        ctx->block_idx++;
-        status = download_single_block(client, ctx);
+        ended = complete_block(client,
+                               ctx,
+                               slot,
+                               status,
+                               coap_rsp_code,
+                               path,
+                               payload,
+                               payload_size,
+                               is_last);
+
+        while (!ended)
+        {
+            struct get_block_slot *next = slot_for_block(ctx, ctx->next_deliver_idx);
+            if (!next->in_use || !next->received || next->block_idx != ctx->next_deliver_idx)
+            {
+                break;
+            }
+
+            ended = complete_block(client,
+                                   ctx,
+                                   next,
+                                   next->status,
+                                   next->has_rsp_code ? &next->coap_rsp_code : NULL,
+                                   path,
+                                   next->data,
+                                   next->len,
+                                   next->is_last);
+        }
+    }
+
+    if (!ended)
+    {
+        status = fill_window(client, ctx);
         if (GOLIOTH_OK != status)
         {
             ctx->end_cb(client, status, NULL, path, ctx->block_idx, ctx->callback_arg);
-
-            golioth_sys_free(ctx);
+            ctx->done = true;
         }
     }
-}
 
-// Function to download a single block
-static enum golioth_status download_single_block(struct golioth_client *client,
-                                                 struct get_block_ctx *ctx)
-{
-    return golioth_coap_client_get_block(client,
-                                         ctx->transfer_ctx.token,
-                                         ctx->transfer_ctx.path_prefix,
-                                         ctx->transfer_ctx.path,
-                                         ctx->transfer_ctx.content_type,
-                                         ctx->block_idx,
-                                         ctx->block_size,
-                                         on_block_rcvd,
-                                         ctx,
-                                         false,
-                                         GOLIOTH_SYS_WAIT_FOREVER);
+    if (ctx->done && ctx->num_outstanding == 0)
+    {
+        free_get_block_ctx(ctx);
+    }
 }
 
 enum golioth_status golioth_blockwise_get(struct golioth_client *client,
@@ -461,14 +1546,68 @@ enum golioth_status golioth_blockwise_get(struct golioth_client *client,
     {
         return GOLIOTH_ERR_MEM_ALLOC;
     }
+    memset(ctx, 0, sizeof(*ctx));
 
     blockwise_transfer_init(&ctx->transfer_ctx, client, path_prefix, path, content_type);
 
     ctx->block_size = CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_BLOCK_SIZE;
+    /* BERT block numbers count 1024 byte units, so blocks of any other size can't be merged */
+    ctx->bert_block_size =
+        (CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_BLOCK_SIZE == GOLIOTH_COAP_BERT_UNIT_SIZE)
+        ? golioth_coap_client_bert_block_size(client)
+        : 0;
     ctx->get_cb = block_cb;
     ctx->end_cb = end_cb;
     ctx->callback_arg = callback_arg;
     ctx->block_idx = block_idx;
 
-    return download_single_block(client, ctx);
+    /* The number of blocks in a BERT response is only known once it arrives, so BERT blocks are
+     * requested one at a time. Each of them already covers many round trips worth of blocks.
+     * Over a reliable transport, blocks are neither fragmented by the path nor lost. */
+    blockwise_link_init(&ctx->link,
+                        ctx->block_size,
+                        ctx->bert_block_size ? 1 : DOWNLOAD_WINDOW_SIZE,
+                        golioth_coap_client_bert_block_size(client) == 0);
+
+    /* block_idx counts blocks of block_size, requests count blocks of the transfer size */
+    ctx->transfer_szx = ctx->link.szx;
+    ctx->next_deliver_idx = block_idx << (BLOCKSIZE_TO_SZX(ctx->block_size) - ctx->transfer_szx);
+    ctx->next_request_idx = ctx->next_deliver_idx;
+
+    if (ctx->link.max_window_size > 1)
+    {
+        ctx->reorder_buffer = golioth_sys_malloc(ctx->link.max_window_size * ctx->block_size);
+        if (NULL == ctx->reorder_buffer)
+        {
+            golioth_sys_free(ctx);
+            return GOLIOTH_ERR_MEM_ALLOC;
+        }
+    }
+
+    if (ctx->link.min_szx < (size_t) BLOCKSIZE_TO_SZX(ctx->block_size))
+    {
+        ctx->assembly_buffer = golioth_sys_malloc(ctx->block_size);
+        if (NULL == ctx->assembly_buffer)
+        {
+            free_get_block_ctx(ctx);
+            return GOLIOTH_ERR_MEM_ALLOC;
+        }
+    }
+
+    for (size_t i = 0; i < ctx->link.max_window_size; i++)
+    {
+        ctx->slots[i].ctx = ctx;
+        ctx->slots[i].data = ctx->reorder_buffer ? &ctx->reorder_buffer[i * ctx->block_size] : NULL;
+    }
+
+    /* Only the first block is requested here, the window opens from the COAP client's thread as
+     * responses arrive, which keeps all further changes to ctx on that thread */
+    ctx->next_request_idx++;
+    enum golioth_status status = request_block(client, ctx, ctx->next_deliver_idx, 0);
+    if (GOLIOTH_OK != status)
+    {
+        free_get_block_ctx(ctx);
+    }
+
+    return status;
 }
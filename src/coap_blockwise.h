@@ -28,12 +28,43 @@ enum golioth_status golioth_blockwise_post(struct golioth_client *client,
                                            golioth_set_cb_fn callback,
                                            void *callback_arg);
 
+/* Resumable Blockwise Upload
+ *
+ * Same as golioth_blockwise_post(), except that the progress of the upload is saved to store as
+ * blocks are acknowledged, every CONFIG_GOLIOTH_BLOCKWISE_CHECKPOINT_INTERVAL bytes. An upload to
+ * the same path that was interrupted continues from its checkpoint, with the same token, calling
+ * cb for the remaining blocks only.
+ */
+enum golioth_status golioth_blockwise_post_resumable(
+    struct golioth_client *client,
+    const char *path_prefix,
+    const char *path,
+    enum golioth_content_type content_type,
+    read_block_cb cb,
+    golioth_set_cb_fn callback,
+    void *callback_arg,
+    const struct golioth_blockwise_checkpoint_store *store);
+
 /* Blockwise Multi-Part Upload */
 struct blockwise_transfer *golioth_blockwise_upload_start(struct golioth_client *client,
                                                           const char *path_prefix,
                                                           const char *path,
                                                           enum golioth_content_type content_type);
 
+/* Same as golioth_blockwise_upload_start(), saving the progress of the upload to store as blocks
+ * are acknowledged. Progress is saved from golioth_blockwise_upload_block() and
+ * golioth_blockwise_upload_finish(), in the caller's thread. block_idx is set to the first block
+ * to send, which is past the blocks already acknowledged if an upload to the same path was
+ * interrupted.
+ */
+struct blockwise_transfer *golioth_blockwise_upload_resume(
+    struct golioth_client *client,
+    const char *path_prefix,
+    const char *path,
+    enum golioth_content_type content_type,
+    const struct golioth_blockwise_checkpoint_store *store,
+    uint32_t *block_idx);
+
 void golioth_blockwise_upload_finish(struct blockwise_transfer *ctx);
 
 enum golioth_status golioth_blockwise_upload_block(struct blockwise_transfer *ctx,
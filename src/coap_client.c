@@ -9,6 +9,7 @@
 #include <string.h>
 #include <golioth/golioth_debug.h>
 #include "golioth_util.h"
+#include "payload_pool.h"
 
 #ifdef __ZEPHYR__
 #include "coap_client_zephyr.h"
@@ -18,7 +19,27 @@
 
 LOG_TAG_DEFINE(golioth_coap_client);
 
-static golioth_sys_mutex_t token_mut;
+// Cache of completion objects for synchronous requests
+static golioth_sys_mutex_t completion_mut;
+static struct golioth_coap_completion *free_completions;
+
+// Coalescable sets that are still in a request queue, newest first
+static golioth_sys_mutex_t coalesce_mut;
+static struct golioth_coap_request_msg *queued_coalescable;
+
+// Queued request descriptor, with room for the longest path
+struct request_msg_slot
+{
+    struct golioth_coap_request_msg msg;
+    char path[CONFIG_GOLIOTH_COAP_MAX_PATH_LEN + 1];
+};
+
+// Only pointers go through the request queues. Descriptors come from this slab, or from the
+// heap once it's exhausted, so its size doesn't depend on the queue capacities.
+static golioth_sys_mutex_t request_msg_mut;
+static struct request_msg_slot request_msg_slab[CONFIG_GOLIOTH_COAP_REQUEST_MSG_POOL_SIZE];
+// Linked through next_coalescable, which is unused while a descriptor is free
+static struct golioth_coap_request_msg *free_request_msgs;
 
 bool golioth_client_is_connected(struct golioth_client *client)
 {
@@ -26,54 +47,524 @@ bool golioth_client_is_connected(struct golioth_client *client)
     {
         return false;
     }
-    return client->session_connected;
+    return client->conn_state == GOLIOTH_COAP_CONN_CONNECTED;
+}
+
+void golioth_coap_completion_mutex_create(void)
+{
+    /* Called by golioth_client_create(); created once, never destroyed */
+    if (!completion_mut)
+    {
+        completion_mut = golioth_sys_mutex_create();
+        assert(completion_mut);
+    }
+}
+
+void golioth_coap_coalesce_mutex_create(void)
+{
+    /* Called by golioth_client_create(); created once, never destroyed */
+    if (!coalesce_mut)
+    {
+        coalesce_mut = golioth_sys_mutex_create();
+        assert(coalesce_mut);
+    }
 }
 
-void golioth_coap_token_mutex_create(void)
+void golioth_coap_request_msg_slab_init(void)
 {
     /* Called by golioth_client_create(); created once, never destroyed */
-    if (!token_mut)
+    if (request_msg_mut)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(request_msg_slab); i++)
+    {
+        request_msg_slab[i].msg.next_coalescable = free_request_msgs;
+        free_request_msgs = &request_msg_slab[i].msg;
+    }
+
+    request_msg_mut = golioth_sys_mutex_create();
+    assert(request_msg_mut);
+}
+
+static bool is_slab_request_msg(const struct golioth_coap_request_msg *req)
+{
+    const struct request_msg_slot *slot = (const struct request_msg_slot *) req;
+
+    return slot >= request_msg_slab && slot < request_msg_slab + ARRAY_SIZE(request_msg_slab);
+}
+
+/// Allocate a request descriptor, from the slab unless it's exhausted
+///
+/// @param path_len Length of the path to store along with the descriptor
+/// @param[out] path_buf Room for the path and its terminator
+static struct golioth_coap_request_msg *request_msg_alloc(size_t path_len, char **path_buf)
+{
+    struct golioth_coap_request_msg *req = NULL;
+
+    if (request_msg_mut && golioth_sys_mutex_lock(request_msg_mut, GOLIOTH_SYS_WAIT_FOREVER))
+    {
+        req = free_request_msgs;
+        if (req)
+        {
+            free_request_msgs = req->next_coalescable;
+        }
+        golioth_sys_mutex_unlock(request_msg_mut);
+    }
+
+    if (req)
+    {
+        *path_buf = ((struct request_msg_slot *) req)->path;
+        return req;
+    }
+
+    // Only as large as this path needs
+    req = golioth_sys_malloc(sizeof(struct golioth_coap_request_msg) + path_len + 1);
+    if (req)
+    {
+        *path_buf = (char *) (req + 1);
+    }
+
+    return req;
+}
+
+void golioth_coap_request_msg_mark_sent(struct golioth_coap_request_msg *req)
+{
+    uint64_t *sent_ms = NULL;
+
+    if (req->type == GOLIOTH_COAP_REQUEST_GET_BLOCK)
+    {
+        sent_ms = req->get_block.sent_ms;
+    }
+    else if (req->type == GOLIOTH_COAP_REQUEST_POST_BLOCK)
+    {
+        sent_ms = req->post_block.sent_ms;
+    }
+
+    if (sent_ms)
+    {
+        *sent_ms = golioth_sys_now_ms();
+    }
+}
+
+void golioth_coap_request_msg_free(struct golioth_coap_request_msg *req)
+{
+    if (!req)
+    {
+        return;
+    }
+
+    if (!is_slab_request_msg(req))
     {
-        token_mut = golioth_sys_mutex_create();
-        assert(token_mut);
+        golioth_sys_free(req);
+        return;
     }
+
+    golioth_sys_mutex_lock(request_msg_mut, GOLIOTH_SYS_WAIT_FOREVER);
+    req->next_coalescable = free_request_msgs;
+    free_request_msgs = req;
+    golioth_sys_mutex_unlock(request_msg_mut);
 }
 
-void golioth_coap_next_token(uint8_t token[GOLIOTH_COAP_TOKEN_LEN])
+/* Called with completion_mut held */
+static void completion_put_locked(struct golioth_coap_completion *completion)
 {
-    static uint8_t stored_token[GOLIOTH_COAP_TOKEN_LEN] = {0};
-    static bool token_is_initialized = false;
+    // If the user thread timed out before the coap thread signalled, done_sem
+    // is still given. Drain it so the next user of this completion doesn't see it.
+    golioth_sys_sem_take(completion->done_sem, 0);
 
-    golioth_sys_mutex_lock(token_mut, GOLIOTH_SYS_WAIT_FOREVER);
+    completion->next = free_completions;
+    free_completions = completion;
+}
 
-    /* Systems without a hardware-backed random source need to seed rand. Waiting until now
-     * introduces the variability of the network connection time to receive a different ms count on
-     * each power cycle to use as the seed. */
-    if (!token_is_initialized)
+static void completion_unref(struct golioth_coap_completion *completion)
+{
+    golioth_sys_mutex_lock(completion_mut, GOLIOTH_SYS_WAIT_FOREVER);
+    if (--completion->refcount == 0)
     {
-        uint32_t rnd = 0;
-        golioth_sys_srand(golioth_sys_now_ms());
+        completion_put_locked(completion);
+    }
+    golioth_sys_mutex_unlock(completion_mut);
+}
+
+struct golioth_coap_completion *golioth_coap_completion_acquire(void)
+{
+    struct golioth_coap_completion *completion = NULL;
+
+    golioth_sys_mutex_lock(completion_mut, GOLIOTH_SYS_WAIT_FOREVER);
+    if (free_completions)
+    {
+        completion = free_completions;
+        free_completions = completion->next;
+    }
+    golioth_sys_mutex_unlock(completion_mut);
+
+    if (!completion)
+    {
+        // Cache is empty, so create a new one. It will be added to the cache when
+        // released, so the cache grows to the number of concurrent sync requests.
+        completion = golioth_sys_malloc(sizeof(struct golioth_coap_completion));
+        if (!completion)
+        {
+            return NULL;
+        }
+        memset(completion, 0, sizeof(struct golioth_coap_completion));
 
-        for (int i = 0; i < GOLIOTH_COAP_TOKEN_LEN; i++)
+        completion->done_sem = golioth_sys_sem_create(1, 0);
+        if (!completion->done_sem)
         {
-            if (i % 4 == 0)
+            golioth_sys_free(completion);
+            return NULL;
+        }
+    }
+
+    completion->status = GOLIOTH_OK;
+    completion->next = NULL;
+    // One reference for the user thread and one for the coap thread
+    completion->refcount = 2;
+
+    return completion;
+}
+
+void golioth_coap_completion_release(struct golioth_coap_completion *completion)
+{
+    if (!completion)
+    {
+        return;
+    }
+
+    golioth_sys_mutex_lock(completion_mut, GOLIOTH_SYS_WAIT_FOREVER);
+    completion->refcount = 0;
+    completion_put_locked(completion);
+    golioth_sys_mutex_unlock(completion_mut);
+}
+
+enum golioth_status golioth_coap_completion_wait(struct golioth_coap_completion *completion,
+                                                 int32_t timeout_s)
+{
+    int32_t tmo_ms = timeout_s * 1000;
+    if (timeout_s == GOLIOTH_SYS_WAIT_FOREVER)
+    {
+        tmo_ms = GOLIOTH_SYS_WAIT_FOREVER;
+    }
+
+    bool completed = golioth_sys_sem_take(completion->done_sem, tmo_ms);
+
+    // Read the result before dropping our reference, as the completion may be
+    // reused by another request as soon as both references are gone.
+    enum golioth_status status = completed ? completion->status : GOLIOTH_ERR_TIMEOUT;
+
+    completion_unref(completion);
+
+    return status;
+}
+
+void golioth_coap_completion_signal(struct golioth_coap_completion *completion,
+                                    enum golioth_status status)
+{
+    completion->status = status;
+    golioth_sys_sem_give(completion->done_sem);
+
+    // Don't wait for the user thread. Whichever side drops the last reference
+    // returns the completion to the cache.
+    completion_unref(completion);
+}
+
+golioth_mbox_t golioth_coap_request_queue_create(void)
+{
+    const size_t num_items[GOLIOTH_COAP_REQUEST_NUM_PRIOS] = {
+        [GOLIOTH_COAP_REQUEST_PRIO_HIGH] = CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_HIGH_PRIO_MAX_ITEMS,
+        [GOLIOTH_COAP_REQUEST_PRIO_NORMAL] = CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS,
+        [GOLIOTH_COAP_REQUEST_PRIO_LOW] = CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_LOW_PRIO_MAX_ITEMS,
+    };
+
+    return golioth_mbox_create_prio(num_items,
+                                    GOLIOTH_COAP_REQUEST_NUM_PRIOS,
+                                    sizeof(struct golioth_coap_request_msg *));
+}
+
+static bool path_prefix_is(const struct golioth_coap_request_msg *request_msg, const char *prefix)
+{
+    return request_msg->path_prefix && (strcmp(request_msg->path_prefix, prefix) == 0);
+}
+
+/// Classify a request by the service that issued it.
+static enum golioth_coap_request_prio request_prio(
+    const struct golioth_coap_request_msg *request_msg)
+{
+    switch (request_msg->type)
+    {
+        case GOLIOTH_COAP_REQUEST_GET_BLOCK:
+        case GOLIOTH_COAP_REQUEST_POST_BLOCK:
+            return GOLIOTH_COAP_REQUEST_PRIO_LOW;
+        case GOLIOTH_COAP_REQUEST_OBSERVE:
+        case GOLIOTH_COAP_REQUEST_OBSERVE_RELEASE:
+            return GOLIOTH_COAP_REQUEST_PRIO_HIGH;
+        default:
+            break;
+    }
+
+    // Stream, and cloud logs (which are posted to "logs" with an empty prefix)
+    if (path_prefix_is(request_msg, ".s/")
+        || (path_prefix_is(request_msg, "") && strcmp(request_msg->path, "logs") == 0))
+    {
+        return GOLIOTH_COAP_REQUEST_PRIO_LOW;
+    }
+
+    // RPC, settings and OTA
+    if (path_prefix_is(request_msg, ".rpc/") || path_prefix_is(request_msg, ".c/")
+        || path_prefix_is(request_msg, ".u/") || path_prefix_is(request_msg, ".u/c/"))
+    {
+        return GOLIOTH_COAP_REQUEST_PRIO_HIGH;
+    }
+
+    return GOLIOTH_COAP_REQUEST_PRIO_NORMAL;
+}
+
+/// Copy the request and its path into a descriptor and pass it to the coap thread.
+///
+/// Only a pointer goes through the request queue. Descriptors come from a slab of
+/// CONFIG_GOLIOTH_COAP_REQUEST_MSG_POOL_SIZE entries, then from the heap. The coap thread
+/// frees the descriptor with golioth_coap_request_msg_free() once it's done with it.
+///
+/// @param queued_msg_out if not NULL, set to the queued descriptor
+static enum golioth_status enqueue_request(struct golioth_client *client,
+                                           const struct golioth_coap_request_msg *request_msg,
+                                           struct golioth_coap_request_msg **queued_msg_out)
+{
+#if !defined(CONFIG_GOLIOTH_COAP_OFFLINE_HOLD_REQUESTS)
+    // The server could not be reached, so fail now instead of waiting out the response timeout.
+    // Observations are kept across reconnects, so those still go to the coap thread, which
+    // stores them in the observation table until the session is re-established.
+    if (client->conn_state == GOLIOTH_COAP_CONN_OFFLINE
+        && request_msg->type != GOLIOTH_COAP_REQUEST_OBSERVE
+        && request_msg->type != GOLIOTH_COAP_REQUEST_OBSERVE_RELEASE)
+    {
+        return GOLIOTH_ERR_OFFLINE;
+    }
+#endif
+
+    size_t path_len = request_msg->path ? strlen(request_msg->path) : 0;
+    char *path_buf = NULL;
+    struct golioth_coap_request_msg *queued_msg = request_msg_alloc(path_len, &path_buf);
+    if (!queued_msg)
+    {
+        return GOLIOTH_ERR_MEM_ALLOC;
+    }
+    memcpy(queued_msg, request_msg, sizeof(struct golioth_coap_request_msg));
+    memcpy(path_buf, request_msg->path ? request_msg->path : "", path_len + 1);
+    queued_msg->path = path_buf;
+
+    bool sent = golioth_mbox_try_send_prio(client->request_queue,
+                                           &queued_msg,
+                                           request_prio(request_msg));
+    if (!sent)
+    {
+        golioth_coap_request_msg_free(queued_msg);
+        return GOLIOTH_ERR_QUEUE_FULL;
+    }
+
+    if (queued_msg_out)
+    {
+        *queued_msg_out = queued_msg;
+    }
+
+    return GOLIOTH_OK;
+}
+
+static bool is_same_set(const struct golioth_coap_request_msg *a,
+                        const struct golioth_coap_request_msg *b)
+{
+    return a->client == b->client && strcmp(a->path_prefix, b->path_prefix) == 0
+        && strcmp(a->path, b->path) == 0;
+}
+
+/* Called with coalesce_mut held */
+static enum golioth_status merge_into_queued(struct golioth_coap_request_msg *queued,
+                                             const struct golioth_coap_request_msg *request_msg)
+{
+    if (queued->post.callback_set)
+    {
+        struct golioth_coap_merged_callback *merged =
+            golioth_sys_malloc(sizeof(struct golioth_coap_merged_callback));
+        if (!merged)
+        {
+            return GOLIOTH_ERR_MEM_ALLOC;
+        }
+
+        merged->callback = queued->post.callback_set;
+        merged->arg = queued->post.arg;
+        merged->next = queued->post.merged_callbacks;
+        queued->post.merged_callbacks = merged;
+    }
+
+    // The older value will never be sent
+    golioth_coap_request_msg_release_payload(queued);
+
+    queued->post.content_type = request_msg->post.content_type;
+    queued->post.payload = request_msg->post.payload;
+    queued->post.payload_size = request_msg->post.payload_size;
+    queued->post.payload_release = request_msg->post.payload_release;
+    queued->post.payload_release_arg = request_msg->post.payload_release_arg;
+    queued->post.callback_set = request_msg->post.callback_set;
+    queued->post.arg = request_msg->post.arg;
+
+    return GOLIOTH_OK;
+}
+
+/// Merge the request into a queued set to the same path, or enqueue it if there is none.
+static enum golioth_status enqueue_coalesced(struct golioth_client *client,
+                                             const struct golioth_coap_request_msg *request_msg)
+{
+    enum golioth_status status = GOLIOTH_OK;
+
+    // Held while enqueueing, so the coap thread can't receive the new request
+    // before it's on the list
+    golioth_sys_mutex_lock(coalesce_mut, GOLIOTH_SYS_WAIT_FOREVER);
+
+    for (struct golioth_coap_request_msg *queued = queued_coalescable; queued;
+         queued = queued->next_coalescable)
+    {
+        if (is_same_set(queued, request_msg))
+        {
+            status = merge_into_queued(queued, request_msg);
+            if (status == GOLIOTH_OK)
             {
-                rnd = golioth_sys_rand();
+                goto unlock;
             }
+            // Couldn't merge, so queue the request on its own
+            break;
+        }
+    }
+
+    struct golioth_coap_request_msg *queued_msg = NULL;
+    status = enqueue_request(client, request_msg, &queued_msg);
+    if (status == GOLIOTH_OK)
+    {
+        queued_msg->next_coalescable = queued_coalescable;
+        queued_coalescable = queued_msg;
+    }
+
+unlock:
+    golioth_sys_mutex_unlock(coalesce_mut);
+
+    return status;
+}
+
+size_t golioth_coap_request_queue_recv(golioth_mbox_t request_queue,
+                                       struct golioth_coap_request_msg **request_msgs,
+                                       size_t max_request_msgs,
+                                       int32_t timeout_ms)
+{
+    size_t num_request_msgs =
+        golioth_mbox_recv_batch(request_queue, request_msgs, max_request_msgs, timeout_ms);
 
-            stored_token[i] = (uint8_t) (rnd >> (i % 4));
+    for (size_t i = 0; i < num_request_msgs; i++)
+    {
+        struct golioth_coap_request_msg *req = request_msgs[i];
+        if (req->type != GOLIOTH_COAP_REQUEST_POST || !req->post.coalesce)
+        {
+            continue;
         }
 
-        token_is_initialized = true;
+        golioth_sys_mutex_lock(coalesce_mut, GOLIOTH_SYS_WAIT_FOREVER);
+        for (struct golioth_coap_request_msg **link = &queued_coalescable; *link;
+             link = &(*link)->next_coalescable)
+        {
+            if (*link == req)
+            {
+                *link = req->next_coalescable;
+                break;
+            }
+        }
+        golioth_sys_mutex_unlock(coalesce_mut);
     }
 
-    uint64_t new_token = 0;
-    memcpy(&new_token, stored_token, GOLIOTH_COAP_TOKEN_LEN);
-    new_token++;
-    memcpy(stored_token, &new_token, GOLIOTH_COAP_TOKEN_LEN);
-    memcpy(token, stored_token, GOLIOTH_COAP_TOKEN_LEN);
+    return num_request_msgs;
+}
 
-    golioth_sys_mutex_unlock(token_mut);
+void golioth_coap_request_msg_call_merged_callbacks(struct golioth_client *client,
+                                                    struct golioth_coap_request_msg *req,
+                                                    enum golioth_status status,
+                                                    const struct golioth_coap_rsp_code *rsp_code)
+{
+    if (req->type != GOLIOTH_COAP_REQUEST_POST)
+    {
+        return;
+    }
+
+    struct golioth_coap_merged_callback *merged = req->post.merged_callbacks;
+    req->post.merged_callbacks = NULL;
+
+    while (merged)
+    {
+        struct golioth_coap_merged_callback *next = merged->next;
+
+        merged->callback(client, status, rsp_code, req->path, merged->arg);
+        golioth_sys_free(merged);
+
+        merged = next;
+    }
+}
+
+void golioth_coap_request_msg_free_merged_callbacks(struct golioth_coap_request_msg *req)
+{
+    if (req->type != GOLIOTH_COAP_REQUEST_POST)
+    {
+        return;
+    }
+
+    struct golioth_coap_merged_callback *merged = req->post.merged_callbacks;
+    req->post.merged_callbacks = NULL;
+
+    while (merged)
+    {
+        struct golioth_coap_merged_callback *next = merged->next;
+        golioth_sys_free(merged);
+        merged = next;
+    }
+}
+
+void golioth_coap_request_msg_release_payload(struct golioth_coap_request_msg *req)
+{
+    uint8_t **payload = NULL;
+    golioth_payload_release_fn payload_release = NULL;
+    void *payload_release_arg = NULL;
+
+    if (req->type == GOLIOTH_COAP_REQUEST_POST)
+    {
+        payload = &req->post.payload;
+        payload_release = req->post.payload_release;
+        payload_release_arg = req->post.payload_release_arg;
+    }
+    else if (req->type == GOLIOTH_COAP_REQUEST_POST_BLOCK)
+    {
+        payload = &req->post_block.payload;
+        payload_release = req->post_block.payload_release;
+        payload_release_arg = req->post_block.payload_release_arg;
+    }
+    else
+    {
+        return;
+    }
+
+    if (!*payload)
+    {
+        return;
+    }
+
+    if (payload_release)
+    {
+        payload_release(*payload, payload_release_arg);
+    }
+    else
+    {
+        // free dynamically allocated user payload copy
+        golioth_payload_pool_free(*payload);
+    }
+
+    *payload = NULL;
 }
 
 enum golioth_status golioth_coap_client_empty(struct golioth_client *client,
@@ -101,63 +592,32 @@ enum golioth_status golioth_coap_client_empty(struct golioth_client *client,
         .type = GOLIOTH_COAP_REQUEST_EMPTY,
         .ageout_ms = ageout_ms,
     };
-    enum golioth_status status = GOLIOTH_OK;
 
     if (is_synchronous)
     {
-        // Created here, deleted by coap thread (or here if fail to create or enqueue)
-        request_msg.request_complete_event = golioth_event_group_create();
-        if (!request_msg.request_complete_event)
+        // Acquired here, released by coap thread (or here if fail to enqueue)
+        request_msg.completion = golioth_coap_completion_acquire();
+        if (!request_msg.completion)
         {
-            GLTH_LOGW(TAG, "Failed to create event group");
+            GLTH_LOGW(TAG, "Failed to acquire request completion");
             return GOLIOTH_ERR_MEM_ALLOC;
         }
-
-        request_msg.request_complete_ack_sem = golioth_sys_sem_create(1, 0);
-        if (!request_msg.request_complete_ack_sem)
-        {
-            GLTH_LOGW(TAG, "Failed to create semaphore");
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            return GOLIOTH_ERR_MEM_ALLOC;
-        }
-
-        request_msg.status = &status;
     }
 
-    bool sent = golioth_mbox_try_send(client->request_queue, &request_msg);
-    if (!sent)
+    enum golioth_status status = enqueue_request(client, &request_msg, NULL);
+    if (status != GOLIOTH_OK)
     {
-        GLTH_LOGW(TAG, "Failed to enqueue request, queue full");
+        GLTH_LOGW(TAG, "Failed to enqueue request: %s", golioth_status_to_str(status));
         if (is_synchronous)
         {
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
+            golioth_coap_completion_release(request_msg.completion);
         }
-        return GOLIOTH_ERR_QUEUE_FULL;
+        return status;
     }
 
     if (is_synchronous)
     {
-        int32_t tmo_ms = timeout_s * 1000;
-        if (timeout_s == GOLIOTH_SYS_WAIT_FOREVER)
-        {
-            tmo_ms = GOLIOTH_SYS_WAIT_FOREVER;
-        }
-        uint32_t bits =
-            golioth_event_group_wait_bits(request_msg.request_complete_event,
-                                          RESPONSE_RECEIVED_EVENT_BIT | RESPONSE_TIMEOUT_EVENT_BIT,
-                                          true,  // clear bits after waiting
-                                          tmo_ms);
-
-        // Notify CoAP thread that we received the event
-        golioth_sys_sem_give(request_msg.request_complete_ack_sem);
-
-        if ((bits == 0) || (bits & RESPONSE_TIMEOUT_EVENT_BIT))
-        {
-            return GOLIOTH_ERR_TIMEOUT;
-        }
-
-        return status;
+        return golioth_coap_completion_wait(request_msg.completion, timeout_s);
     }
     return GOLIOTH_OK;
 }
@@ -171,6 +631,7 @@ static enum golioth_status golioth_coap_client_set_internal(
     size_t payload_size,
     enum golioth_coap_request_type type,
     void *request_params,
+    const struct golioth_request_policy *policy,
     bool is_synchronous,
     int32_t timeout_s)
 {
@@ -180,8 +641,12 @@ static enum golioth_status golioth_coap_client_set_internal(
     }
 
     struct golioth_coap_request_msg request_msg = {};
-    enum golioth_status status = GOLIOTH_OK;
     uint8_t *request_payload = NULL;
+    bool payload_is_copy = false;
+    golioth_payload_release_fn payload_release =
+        (type == GOLIOTH_COAP_REQUEST_POST_BLOCK)
+            ? ((struct golioth_coap_post_block_params *) request_params)->payload_release
+            : ((struct golioth_coap_post_params *) request_params)->payload_release;
 
     memcpy(request_msg.token, token, GOLIOTH_COAP_TOKEN_LEN);
 
@@ -191,20 +656,26 @@ static enum golioth_status golioth_coap_client_set_internal(
         return GOLIOTH_ERR_INVALID_STATE;
     }
 
-    if (strlen(path) > sizeof(request_msg.path) - 1)
+    if (strlen(path) > CONFIG_GOLIOTH_COAP_MAX_PATH_LEN)
     {
-        GLTH_LOGE(TAG, "Path too long: %zu > %zu", strlen(path), sizeof(request_msg.path) - 1);
+        GLTH_LOGE(TAG, "Path too long: %zu > %d", strlen(path), CONFIG_GOLIOTH_COAP_MAX_PATH_LEN);
         return GOLIOTH_ERR_INVALID_FORMAT;
     }
 
-    if (payload_size > 0)
+    if (payload_release)
+    {
+        // Caller transferred ownership of the payload buffer, so it is used
+        // as-is and handed back via payload_release after sending.
+        request_payload = (uint8_t *) payload;
+    }
+    else if (payload_size > 0)
     {
         // We will allocate memory and copy the payload
         // to avoid payload lifetime and thread-safety issues.
         //
         // This memory will be free'd by the CoAP thread after handling the request,
         // or in this function if we fail to enqueue the request.
-        request_payload = (uint8_t *) golioth_sys_malloc(payload_size);
+        request_payload = (uint8_t *) golioth_payload_pool_alloc(payload_size);
         if (!request_payload)
         {
             GLTH_LOGE(TAG, "Payload alloc failure");
@@ -212,6 +683,7 @@ static enum golioth_status golioth_coap_client_set_internal(
         }
         memset(request_payload, 0, payload_size);
         memcpy(request_payload, payload, payload_size);
+        payload_is_copy = true;
     }
 
     uint64_t ageout_ms = GOLIOTH_SYS_WAIT_FOREVER;
@@ -220,39 +692,30 @@ static enum golioth_status golioth_coap_client_set_internal(
         ageout_ms = golioth_sys_now_ms() + (1000 * timeout_s);
     }
 
+    request_msg.client = client;
     request_msg.type = type;
     request_msg.path_prefix = path_prefix;
     request_msg.ageout_ms = ageout_ms;
+    if (policy)
+    {
+        request_msg.policy = *policy;
+    }
 
-    strncpy(request_msg.path, path, sizeof(request_msg.path) - 1);
+    request_msg.path = path;
 
     if (is_synchronous)
     {
-        // Created here, deleted by coap thread (or here if fail to create or enqueue)
-        request_msg.request_complete_event = golioth_event_group_create();
-        if (!request_msg.request_complete_event)
+        // Acquired here, released by coap thread (or here if fail to enqueue)
+        request_msg.completion = golioth_coap_completion_acquire();
+        if (!request_msg.completion)
         {
-            GLTH_LOGW(TAG, "Failed to create event group");
-            if (request_payload)
+            GLTH_LOGW(TAG, "Failed to acquire request completion");
+            if (payload_is_copy)
             {
-                golioth_sys_free(request_payload);
+                golioth_payload_pool_free(request_payload);
             }
             return GOLIOTH_ERR_MEM_ALLOC;
         }
-
-        request_msg.request_complete_ack_sem = golioth_sys_sem_create(1, 0);
-        if (!request_msg.request_complete_ack_sem)
-        {
-            GLTH_LOGW(TAG, "Failed to create semaphore");
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            if (request_payload)
-            {
-                golioth_sys_free(request_payload);
-            }
-            return GOLIOTH_ERR_MEM_ALLOC;
-        }
-
-        request_msg.status = &status;
     }
 
     if (type == GOLIOTH_COAP_REQUEST_POST_BLOCK)
@@ -269,48 +732,30 @@ static enum golioth_status golioth_coap_client_set_internal(
         request_msg.post.payload_size = payload_size;
     }
 
-    bool sent = golioth_mbox_try_send(client->request_queue, &request_msg);
-    if (!sent)
+    enum golioth_status status = (type == GOLIOTH_COAP_REQUEST_POST && request_msg.post.coalesce)
+        ? enqueue_coalesced(client, &request_msg)
+        : enqueue_request(client, &request_msg, NULL);
+    if (status != GOLIOTH_OK)
     {
         /* NOTE: Logging a message here when cloud logging is enabled can cause
          *       a loop where the logging thread attempts to enqueue a message,
          *       the mbox is full, so coap_client writes a log, which the
          *       logging thread attempts to send to the cloud, and so on.
          */
-        if (request_payload)
+        if (payload_is_copy)
         {
-            golioth_sys_free(request_payload);
+            golioth_payload_pool_free(request_payload);
         }
         if (is_synchronous)
         {
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
+            golioth_coap_completion_release(request_msg.completion);
         }
-        return GOLIOTH_ERR_QUEUE_FULL;
+        return status;
     }
 
     if (is_synchronous)
     {
-        int32_t tmo_ms = timeout_s * 1000;
-        if (timeout_s == GOLIOTH_SYS_WAIT_FOREVER)
-        {
-            tmo_ms = GOLIOTH_SYS_WAIT_FOREVER;
-        }
-        uint32_t bits =
-            golioth_event_group_wait_bits(request_msg.request_complete_event,
-                                          RESPONSE_RECEIVED_EVENT_BIT | RESPONSE_TIMEOUT_EVENT_BIT,
-                                          true,  // clear bits after waiting
-                                          tmo_ms);
-
-        // Notify CoAP thread that we received the event
-        golioth_sys_sem_give(request_msg.request_complete_ack_sem);
-
-        if ((bits == 0) || (bits & RESPONSE_TIMEOUT_EVENT_BIT))
-        {
-            return GOLIOTH_ERR_TIMEOUT;
-        }
-
-        return status;
+        return golioth_coap_completion_wait(request_msg.completion, timeout_s);
     }
     return GOLIOTH_OK;
 }
@@ -341,6 +786,7 @@ enum golioth_status golioth_coap_client_post(struct golioth_client *client,
                                             payload_size,
                                             GOLIOTH_COAP_REQUEST_POST,
                                             &params,
+                                            NULL,
                                             is_synchronous,
                                             timeout_s);
 }
@@ -370,10 +816,114 @@ enum golioth_status golioth_coap_client_set(struct golioth_client *client,
                                             payload_size,
                                             GOLIOTH_COAP_REQUEST_POST,
                                             &params,
+                                            NULL,
+                                            is_synchronous,
+                                            timeout_s);
+}
+
+enum golioth_status golioth_coap_client_set_nocopy(struct golioth_client *client,
+                                                   const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+                                                   const char *path_prefix,
+                                                   const char *path,
+                                                   enum golioth_content_type content_type,
+                                                   uint8_t *payload,
+                                                   size_t payload_size,
+                                                   golioth_payload_release_fn payload_release,
+                                                   void *payload_release_arg,
+                                                   golioth_set_cb_fn callback,
+                                                   void *callback_arg,
+                                                   bool is_synchronous,
+                                                   int32_t timeout_s)
+{
+    if (!payload || !payload_release)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    struct golioth_coap_post_params params = {
+        .content_type = content_type,
+        .payload_release = payload_release,
+        .payload_release_arg = payload_release_arg,
+        .callback_set = callback,
+        .arg = callback_arg,
+    };
+    return golioth_coap_client_set_internal(client,
+                                            token,
+                                            path_prefix,
+                                            path,
+                                            payload,
+                                            payload_size,
+                                            GOLIOTH_COAP_REQUEST_POST,
+                                            &params,
+                                            NULL,
                                             is_synchronous,
                                             timeout_s);
 }
 
+enum golioth_status golioth_coap_client_set_coalesced(struct golioth_client *client,
+                                                      const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+                                                      const char *path_prefix,
+                                                      const char *path,
+                                                      enum golioth_content_type content_type,
+                                                      const uint8_t *payload,
+                                                      size_t payload_size,
+                                                      golioth_set_cb_fn callback,
+                                                      void *callback_arg)
+{
+    struct golioth_coap_post_params params = {
+        .content_type = content_type,
+        .callback_set = callback,
+        .arg = callback_arg,
+        .coalesce = true,
+    };
+    return golioth_coap_client_set_internal(client,
+                                            token,
+                                            path_prefix,
+                                            path,
+                                            payload,
+                                            payload_size,
+                                            GOLIOTH_COAP_REQUEST_POST,
+                                            &params,
+                                            NULL,
+                                            false,
+                                            GOLIOTH_SYS_WAIT_FOREVER);
+}
+
+enum golioth_status golioth_coap_client_set_with_policy(
+    struct golioth_client *client,
+    const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+    const char *path_prefix,
+    const char *path,
+    enum golioth_content_type content_type,
+    const uint8_t *payload,
+    size_t payload_size,
+    const struct golioth_request_policy *policy,
+    golioth_set_cb_fn callback,
+    void *callback_arg)
+{
+    if (!policy)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    struct golioth_coap_post_params params = {
+        .content_type = content_type,
+        .callback_set = callback,
+        .arg = callback_arg,
+    };
+    return golioth_coap_client_set_internal(client,
+                                            token,
+                                            path_prefix,
+                                            path,
+                                            payload,
+                                            payload_size,
+                                            GOLIOTH_COAP_REQUEST_POST,
+                                            &params,
+                                            policy,
+                                            false,
+                                            GOLIOTH_SYS_WAIT_FOREVER);
+}
+
 enum golioth_status golioth_coap_client_set_block(struct golioth_client *client,
                                                   const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
                                                   const char *path_prefix,
@@ -405,17 +955,68 @@ enum golioth_status golioth_coap_client_set_block(struct golioth_client *client,
                                             payload_size,
                                             GOLIOTH_COAP_REQUEST_POST_BLOCK,
                                             &params,
+                                            NULL,
                                             is_synchronous,
                                             timeout_s);
 }
 
-enum golioth_status golioth_coap_client_delete(struct golioth_client *client,
-                                               const char *path_prefix,
-                                               const char *path,
-                                               golioth_set_cb_fn callback,
-                                               void *callback_arg,
-                                               bool is_synchronous,
-                                               int32_t timeout_s)
+enum golioth_status golioth_coap_client_set_block_nocopy(
+    struct golioth_client *client,
+    const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+    const char *path_prefix,
+    const char *path,
+    bool is_last,
+    enum golioth_content_type content_type,
+    size_t block_index,
+    size_t block_szx,
+    uint8_t *payload,
+    size_t payload_size,
+    golioth_payload_release_fn payload_release,
+    void *payload_release_arg,
+    golioth_set_block_cb_fn callback,
+    void *callback_arg,
+    uint64_t *sent_ms,
+    bool is_synchronous,
+    int32_t timeout_s)
+{
+    if (!payload || !payload_release)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    struct golioth_coap_post_block_params params = {
+        .is_last = is_last,
+        .content_type = content_type,
+        .block_index = block_index,
+        .block_szx = block_szx,
+        .payload_release = payload_release,
+        .payload_release_arg = payload_release_arg,
+        .callback = callback,
+        .arg = callback_arg,
+        .sent_ms = sent_ms,
+    };
+    return golioth_coap_client_set_internal(client,
+                                            token,
+                                            path_prefix,
+                                            path,
+                                            payload,
+                                            payload_size,
+                                            GOLIOTH_COAP_REQUEST_POST_BLOCK,
+                                            &params,
+                                            NULL,
+                                            is_synchronous,
+                                            timeout_s);
+}
+
+static enum golioth_status golioth_coap_client_delete_internal(
+    struct golioth_client *client,
+    const char *path_prefix,
+    const char *path,
+    golioth_set_cb_fn callback,
+    void *callback_arg,
+    const struct golioth_request_policy *policy,
+    bool is_synchronous,
+    int32_t timeout_s)
 {
     if (!client || !path)
     {
@@ -447,73 +1048,86 @@ enum golioth_status golioth_coap_client_delete(struct golioth_client *client,
             },
         .ageout_ms = ageout_ms,
     };
+    if (policy)
+    {
+        request_msg.policy = *policy;
+    }
 
-    if (strlen(path) > sizeof(request_msg.path) - 1)
+    if (strlen(path) > CONFIG_GOLIOTH_COAP_MAX_PATH_LEN)
     {
-        GLTH_LOGE(TAG, "Path too long: %zu > %zu", strlen(path), sizeof(request_msg.path) - 1);
+        GLTH_LOGE(TAG, "Path too long: %zu > %d", strlen(path), CONFIG_GOLIOTH_COAP_MAX_PATH_LEN);
         return GOLIOTH_ERR_INVALID_FORMAT;
     }
-    strncpy(request_msg.path, path, sizeof(request_msg.path) - 1);
-
-    enum golioth_status status = GOLIOTH_OK;
+    request_msg.path = path;
 
     if (is_synchronous)
     {
-        // Created here, deleted by coap thread (or here if fail to create or enqueue)
-        request_msg.request_complete_event = golioth_event_group_create();
-        if (!request_msg.request_complete_event)
-        {
-            GLTH_LOGW(TAG, "Failed to create event group");
-            return GOLIOTH_ERR_MEM_ALLOC;
-        }
-
-        request_msg.request_complete_ack_sem = golioth_sys_sem_create(1, 0);
-        if (!request_msg.request_complete_ack_sem)
+        // Acquired here, released by coap thread (or here if fail to enqueue)
+        request_msg.completion = golioth_coap_completion_acquire();
+        if (!request_msg.completion)
         {
-            GLTH_LOGW(TAG, "Failed to create semaphore");
-            golioth_event_group_destroy(request_msg.request_complete_event);
+            GLTH_LOGW(TAG, "Failed to acquire request completion");
             return GOLIOTH_ERR_MEM_ALLOC;
         }
-
-        request_msg.status = &status;
     }
 
-    bool sent = golioth_mbox_try_send(client->request_queue, &request_msg);
-    if (!sent)
+    enum golioth_status status = enqueue_request(client, &request_msg, NULL);
+    if (status != GOLIOTH_OK)
     {
-        GLTH_LOGW(TAG, "Failed to enqueue request, queue full");
+        GLTH_LOGW(TAG, "Failed to enqueue request: %s", golioth_status_to_str(status));
         if (is_synchronous)
         {
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
+            golioth_coap_completion_release(request_msg.completion);
         }
-        return GOLIOTH_ERR_QUEUE_FULL;
+        return status;
     }
 
     if (is_synchronous)
     {
-        int32_t tmo_ms = timeout_s * 1000;
-        if (timeout_s == GOLIOTH_SYS_WAIT_FOREVER)
-        {
-            tmo_ms = GOLIOTH_SYS_WAIT_FOREVER;
-        }
-        uint32_t bits =
-            golioth_event_group_wait_bits(request_msg.request_complete_event,
-                                          RESPONSE_RECEIVED_EVENT_BIT | RESPONSE_TIMEOUT_EVENT_BIT,
-                                          true,  // clear bits after waiting
-                                          tmo_ms);
-
-        // Notify CoAP thread that we received the event
-        golioth_sys_sem_give(request_msg.request_complete_ack_sem);
+        return golioth_coap_completion_wait(request_msg.completion, timeout_s);
+    }
+    return GOLIOTH_OK;
+}
 
-        if ((bits == 0) || (bits & RESPONSE_TIMEOUT_EVENT_BIT))
-        {
-            return GOLIOTH_ERR_TIMEOUT;
-        }
+enum golioth_status golioth_coap_client_delete(struct golioth_client *client,
+                                               const char *path_prefix,
+                                               const char *path,
+                                               golioth_set_cb_fn callback,
+                                               void *callback_arg,
+                                               bool is_synchronous,
+                                               int32_t timeout_s)
+{
+    return golioth_coap_client_delete_internal(client,
+                                               path_prefix,
+                                               path,
+                                               callback,
+                                               callback_arg,
+                                               NULL,
+                                               is_synchronous,
+                                               timeout_s);
+}
 
-        return status;
+enum golioth_status golioth_coap_client_delete_with_policy(
+    struct golioth_client *client,
+    const char *path_prefix,
+    const char *path,
+    const struct golioth_request_policy *policy,
+    golioth_set_cb_fn callback,
+    void *callback_arg)
+{
+    if (!policy)
+    {
+        return GOLIOTH_ERR_NULL;
     }
-    return GOLIOTH_OK;
+
+    return golioth_coap_client_delete_internal(client,
+                                               path_prefix,
+                                               path,
+                                               callback,
+                                               callback_arg,
+                                               policy,
+                                               false,
+                                               GOLIOTH_SYS_WAIT_FOREVER);
 }
 
 static enum golioth_status golioth_coap_client_get_internal(
@@ -523,6 +1137,7 @@ static enum golioth_status golioth_coap_client_get_internal(
     const char *path,
     enum golioth_coap_request_type type,
     void *request_params,
+    const struct golioth_request_policy *policy,
     bool is_synchronous,
     int32_t timeout_s)
 {
@@ -544,41 +1159,34 @@ static enum golioth_status golioth_coap_client_get_internal(
     }
 
     struct golioth_coap_request_msg request_msg = {};
-    enum golioth_status status = GOLIOTH_OK;
     request_msg.type = type;
     request_msg.path_prefix = path_prefix;
 
     memcpy(request_msg.token, token, GOLIOTH_COAP_TOKEN_LEN);
 
-    if (strlen(path) > sizeof(request_msg.path) - 1)
+    if (strlen(path) > CONFIG_GOLIOTH_COAP_MAX_PATH_LEN)
     {
-        GLTH_LOGE(TAG, "Path too long: %zu > %zu", strlen(path), sizeof(request_msg.path) - 1);
+        GLTH_LOGE(TAG, "Path too long: %zu > %d", strlen(path), CONFIG_GOLIOTH_COAP_MAX_PATH_LEN);
         return GOLIOTH_ERR_INVALID_FORMAT;
     }
-    strncpy(request_msg.path, path, sizeof(request_msg.path) - 1);
+    request_msg.path = path;
 
     if (is_synchronous)
     {
-        // Created here, deleted by coap thread (or here if fail to create or enqueue)
-        request_msg.request_complete_event = golioth_event_group_create();
-        if (!request_msg.request_complete_event)
+        // Acquired here, released by coap thread (or here if fail to enqueue)
+        request_msg.completion = golioth_coap_completion_acquire();
+        if (!request_msg.completion)
         {
-            GLTH_LOGW(TAG, "Failed to create event group");
+            GLTH_LOGW(TAG, "Failed to acquire request completion");
             return GOLIOTH_ERR_MEM_ALLOC;
         }
-
-        request_msg.request_complete_ack_sem = golioth_sys_sem_create(1, 0);
-        if (!request_msg.request_complete_ack_sem)
-        {
-            GLTH_LOGW(TAG, "Failed to create semaphore");
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            return GOLIOTH_ERR_MEM_ALLOC;
-        }
-
-        request_msg.status = &status;
     }
 
     request_msg.ageout_ms = ageout_ms;
+    if (policy)
+    {
+        request_msg.policy = *policy;
+    }
     if (type == GOLIOTH_COAP_REQUEST_GET_BLOCK)
     {
         request_msg.get_block = *(struct golioth_coap_get_block_params *) request_params;
@@ -589,40 +1197,20 @@ static enum golioth_status golioth_coap_client_get_internal(
         request_msg.get = *(struct golioth_coap_get_params *) request_params;
     }
 
-    bool sent = golioth_mbox_try_send(client->request_queue, &request_msg);
-    if (!sent)
+    enum golioth_status status = enqueue_request(client, &request_msg, NULL);
+    if (status != GOLIOTH_OK)
     {
-        GLTH_LOGE(TAG, "Failed to enqueue request, queue full");
+        GLTH_LOGE(TAG, "Failed to enqueue request: %s", golioth_status_to_str(status));
         if (is_synchronous)
         {
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
+            golioth_coap_completion_release(request_msg.completion);
         }
-        return GOLIOTH_ERR_QUEUE_FULL;
+        return status;
     }
 
     if (is_synchronous)
     {
-        int32_t tmo_ms = timeout_s * 1000;
-        if (timeout_s == GOLIOTH_SYS_WAIT_FOREVER)
-        {
-            tmo_ms = GOLIOTH_SYS_WAIT_FOREVER;
-        }
-        uint32_t bits =
-            golioth_event_group_wait_bits(request_msg.request_complete_event,
-                                          RESPONSE_RECEIVED_EVENT_BIT | RESPONSE_TIMEOUT_EVENT_BIT,
-                                          true,  // clear bits after waiting
-                                          tmo_ms);
-
-        // Notify CoAP thread that we received the event
-        golioth_sys_sem_give(request_msg.request_complete_ack_sem);
-
-        if ((bits == 0) || (bits & RESPONSE_TIMEOUT_EVENT_BIT))
-        {
-            return GOLIOTH_ERR_TIMEOUT;
-        }
-
-        return status;
+        return golioth_coap_completion_wait(request_msg.completion, timeout_s);
     }
     return GOLIOTH_OK;
 }
@@ -648,10 +1236,42 @@ enum golioth_status golioth_coap_client_get(struct golioth_client *client,
                                             path,
                                             GOLIOTH_COAP_REQUEST_GET,
                                             &params,
+                                            NULL,
                                             is_synchronous,
                                             timeout_s);
 }
 
+enum golioth_status golioth_coap_client_get_with_policy(
+    struct golioth_client *client,
+    const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+    const char *path_prefix,
+    const char *path,
+    enum golioth_content_type content_type,
+    const struct golioth_request_policy *policy,
+    golioth_get_cb_fn callback,
+    void *callback_arg)
+{
+    if (!policy)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    struct golioth_coap_get_params params = {
+        .content_type = content_type,
+        .callback = callback,
+        .arg = callback_arg,
+    };
+    return golioth_coap_client_get_internal(client,
+                                            token,
+                                            path_prefix,
+                                            path,
+                                            GOLIOTH_COAP_REQUEST_GET,
+                                            &params,
+                                            policy,
+                                            false,
+                                            GOLIOTH_SYS_WAIT_FOREVER);
+}
+
 enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
                                                   const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
                                                   const char *path_prefix,
@@ -661,6 +1281,7 @@ enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
                                                   size_t block_size,
                                                   coap_get_block_cb_fn callback,
                                                   void *arg,
+                                                  uint64_t *sent_ms,
                                                   bool is_synchronous,
                                                   int32_t timeout_s)
 {
@@ -670,6 +1291,7 @@ enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
         .block_size = block_size,
         .callback = callback,
         .arg = arg,
+        .sent_ms = sent_ms,
     };
     return golioth_coap_client_get_internal(client,
                                             token,
@@ -677,6 +1299,7 @@ enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
                                             path,
                                             GOLIOTH_COAP_REQUEST_GET_BLOCK,
                                             &params,
+                                            NULL,
                                             is_synchronous,
                                             timeout_s);
 }
@@ -717,18 +1340,18 @@ enum golioth_status golioth_coap_client_observe(struct golioth_client *client,
 
     memcpy(request_msg.token, token, GOLIOTH_COAP_TOKEN_LEN);
 
-    if (strlen(path) > sizeof(request_msg.path) - 1)
+    if (strlen(path) > CONFIG_GOLIOTH_COAP_MAX_PATH_LEN)
     {
-        GLTH_LOGE(TAG, "Path too long: %zu > %zu", strlen(path), sizeof(request_msg.path) - 1);
+        GLTH_LOGE(TAG, "Path too long: %zu > %d", strlen(path), CONFIG_GOLIOTH_COAP_MAX_PATH_LEN);
         return GOLIOTH_ERR_INVALID_FORMAT;
     }
-    strncpy(request_msg.path, path, sizeof(request_msg.path) - 1);
+    request_msg.path = path;
 
-    bool sent = golioth_mbox_try_send(client->request_queue, &request_msg);
-    if (!sent)
+    enum golioth_status status = enqueue_request(client, &request_msg, NULL);
+    if (status != GOLIOTH_OK)
     {
-        GLTH_LOGW(TAG, "Failed to enqueue request, queue full");
-        return GOLIOTH_ERR_QUEUE_FULL;
+        GLTH_LOGW(TAG, "Failed to enqueue request: %s", golioth_status_to_str(status));
+        return status;
     }
 
     return GOLIOTH_OK;
@@ -766,19 +1389,19 @@ enum golioth_status golioth_coap_client_observe_release(struct golioth_client *c
             },
     };
 
-    if (strlen(path) > sizeof(request_msg.path) - 1)
+    if (strlen(path) > CONFIG_GOLIOTH_COAP_MAX_PATH_LEN)
     {
-        GLTH_LOGE(TAG, "Path too long: %zu > %zu", strlen(path), sizeof(request_msg.path) - 1);
+        GLTH_LOGE(TAG, "Path too long: %zu > %d", strlen(path), CONFIG_GOLIOTH_COAP_MAX_PATH_LEN);
         return GOLIOTH_ERR_INVALID_FORMAT;
     }
-    strncpy(request_msg.path, path, sizeof(request_msg.path) - 1);
+    request_msg.path = path;
     memcpy(request_msg.token, token, GOLIOTH_COAP_TOKEN_LEN);
 
-    bool sent = golioth_mbox_try_send(client->request_queue, &request_msg);
-    if (!sent)
+    enum golioth_status status = enqueue_request(client, &request_msg, NULL);
+    if (status != GOLIOTH_OK)
     {
-        GLTH_LOGE(TAG, "Failed to enqueue request, queue full");
-        return GOLIOTH_ERR_QUEUE_FULL;
+        GLTH_LOGE(TAG, "Failed to enqueue request: %s", golioth_status_to_str(status));
+        return status;
     }
 
     return GOLIOTH_OK;
@@ -795,6 +1418,26 @@ void golioth_coap_client_cancel_observations_by_prefix(struct golioth_client *cl
     golioth_cancel_all_observations_by_prefix(client, prefix);
 }
 
+enum golioth_status golioth_coap_client_observe_cancel(struct golioth_client *client,
+                                                       const char *path_prefix,
+                                                       const char *path,
+                                                       enum golioth_content_type content_type,
+                                                       golioth_get_cb_fn callback,
+                                                       void *callback_arg)
+{
+    if (!client || !path)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    return golioth_cancel_observation(client,
+                                      path_prefix,
+                                      path,
+                                      content_type,
+                                      callback,
+                                      callback_arg);
+}
+
 void golioth_client_register_event_callback(struct golioth_client *client,
                                             golioth_client_event_cb_fn callback,
                                             void *arg)
@@ -821,6 +1464,28 @@ golioth_sys_thread_t golioth_client_get_thread(struct golioth_client *client)
     return client->coap_thread_handle;
 }
 
+size_t golioth_client_dns_cache_save(struct golioth_client *client,
+                                     uint8_t *buf,
+                                     size_t buf_size)
+{
+    if (!client)
+    {
+        return 0;
+    }
+    return golioth_dns_cache_save(&client->dns_cache, buf, buf_size);
+}
+
+enum golioth_status golioth_client_dns_cache_load(struct golioth_client *client,
+                                                  const uint8_t *buf,
+                                                  size_t len)
+{
+    if (!client)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+    return golioth_dns_cache_load(&client->dns_cache, buf, len);
+}
+
 bool golioth_client_wait_for_connect(struct golioth_client *client, int timeout_ms)
 {
     const uint32_t poll_period_ms = 100;
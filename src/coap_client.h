@@ -8,11 +8,7 @@
 #include <golioth/client.h>
 #include <golioth/config.h>
 #include <golioth/golioth_sys.h>
-#include "event_group.h"
-
-/// Event group bits for request_complete_event
-#define RESPONSE_RECEIVED_EVENT_BIT (1 << 0)
-#define RESPONSE_TIMEOUT_EVENT_BIT (1 << 1)
+#include "mbox.h"
 
 #define GOLIOTH_COAP_TOKEN_LEN 8
 
@@ -28,6 +24,11 @@
 
 #define SZX_TO_BLOCKSIZE(szx) ((size_t) (1 << (szx + 4)))
 
+/// SZX of BERT blocks (RFC 8323 section 6). BERT blocks carry a multiple of
+/// GOLIOTH_COAP_BERT_UNIT_SIZE bytes, and their block numbers count units of that size.
+#define GOLIOTH_COAP_BERT_SZX 7
+#define GOLIOTH_COAP_BERT_UNIT_SIZE 1024
+
 /// Internal callback for blockwise get requests
 ///
 /// Will be called repeatedly, once for each block received from the server, on timeout (i.e.
@@ -60,14 +61,26 @@ typedef void (*coap_get_block_cb_fn)(struct golioth_client *client,
                                      size_t payload_size,
                                      bool is_last,
                                      void *arg);
+/// Callback of an asynchronous set that was merged into a newer one while queued
+struct golioth_coap_merged_callback
+{
+    golioth_set_cb_fn callback;
+    void *arg;
+    struct golioth_coap_merged_callback *next;
+};
+
 struct golioth_coap_post_params
 {
     enum golioth_content_type content_type;
     // CoAP payload assumed to be dynamically allocated before enqueue
-    // and freed after dequeue.
+    // and freed after dequeue, unless payload_release is set.
     uint8_t *payload;
     // Size of payload, in bytes
     size_t payload_size;
+    // If set, payload is owned by the caller and released with this
+    // function instead of being freed.
+    golioth_payload_release_fn payload_release;
+    void *payload_release_arg;
     union
     {
         golioth_set_cb_fn callback_set;
@@ -75,6 +88,11 @@ struct golioth_coap_post_params
     };
     void *arg;
     bool callback_is_post;
+    // If set, a newer set to the same path replaces this one while it's
+    // still queued. See golioth_coap_client_set_coalesced().
+    bool coalesce;
+    // Callbacks of the sets that were replaced by this one
+    struct golioth_coap_merged_callback *merged_callbacks;
 };
 
 struct golioth_coap_post_block_params
@@ -84,12 +102,18 @@ struct golioth_coap_post_block_params
     size_t block_index;
     size_t block_szx;
     // CoAP payload assumed to be dynamically allocated before enqueue
-    // and freed after dequeue.
+    // and freed after dequeue, unless payload_release is set.
     uint8_t *payload;
     // Size of payload, in bytes
     size_t payload_size;
+    // If set, payload is owned by the caller and released with this
+    // function instead of being freed.
+    golioth_payload_release_fn payload_release;
+    void *payload_release_arg;
     golioth_set_block_cb_fn callback;
     void *arg;
+    // If set, the coap thread stores the time the block was sent here
+    uint64_t *sent_ms;
 };
 
 struct golioth_coap_get_params
@@ -106,6 +130,8 @@ struct golioth_coap_get_block_params
     size_t block_size;
     coap_get_block_cb_fn callback;
     void *arg;
+    // If set, the coap thread stores the time the block was requested here
+    uint64_t *sent_ms;
 };
 
 struct golioth_coap_delete_params
@@ -121,6 +147,37 @@ struct golioth_coap_observe_params
     void *arg;
 };
 
+/// Priority classes of the request queue, highest first.
+///
+/// Each class has its own capacity. The coap thread always sends from the
+/// highest priority class that has requests queued.
+enum golioth_coap_request_prio
+{
+    /// Control traffic: RPC replies, settings, OTA manifest and state, observations
+    GOLIOTH_COAP_REQUEST_PRIO_HIGH,
+    /// Everything that is neither control nor bulk traffic
+    GOLIOTH_COAP_REQUEST_PRIO_NORMAL,
+    /// Bulk traffic: cloud logs, Stream data, blockwise transfers
+    GOLIOTH_COAP_REQUEST_PRIO_LOW,
+    GOLIOTH_COAP_REQUEST_NUM_PRIOS,
+};
+
+/// State of the connection to the server, driven by the coap thread. Kept in an _Atomic field, so
+/// plain reads and writes are atomic.
+enum golioth_coap_conn_state
+{
+    /// The client is not running
+    GOLIOTH_COAP_CONN_IDLE,
+    /// Connecting, or waiting for the first response of the session. Queued requests are held
+    /// until the server has responded.
+    GOLIOTH_COAP_CONN_CONNECTING,
+    /// The server has responded on the current session
+    GOLIOTH_COAP_CONN_CONNECTED,
+    /// The server could not be reached, waiting for the next reconnect attempt. Unless
+    /// CONFIG_GOLIOTH_COAP_OFFLINE_HOLD_REQUESTS is set, requests fail with GOLIOTH_ERR_OFFLINE.
+    GOLIOTH_COAP_CONN_OFFLINE,
+};
+
 enum golioth_coap_request_type
 {
     GOLIOTH_COAP_REQUEST_EMPTY,
@@ -140,7 +197,9 @@ struct golioth_coap_request_msg
     // The CoAP path string (everything after coaps://coap.golioth.io/).
     // Assumption: path_prefix is a string literal (i.e. we don't need to strcpy).
     const char *path_prefix;
-    char path[CONFIG_GOLIOTH_COAP_MAX_PATH_LEN + 1];
+    // At most CONFIG_GOLIOTH_COAP_MAX_PATH_LEN characters. Points to the caller's string until
+    // the request is enqueued, then to a copy stored along with the queued descriptor.
+    const char *path;
     uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
     enum golioth_coap_request_type type;
     union
@@ -156,42 +215,132 @@ struct golioth_coap_request_msg
     /// This is checked when reqeusts are pulled out of the queue and when responses are received.
     /// Primarily intended to be used for synchronous requests, to avoid blocking forever.
     uint64_t ageout_ms;
+    /// Response timeout and retry budget once the request has been sent.
+    /// Zero-initialized for the defaults.
+    struct golioth_request_policy policy;
     bool got_response;
     bool got_nack;
-    enum golioth_status *status;
 
     /// (sync request only) Notification from coap thread to user sync function that
     /// request is completed.
-    /// Created in user sync function, deleted by coap thread.
     ///
-    /// Bit 0: response received
-    /// Bit 1: timeout
-    golioth_event_group_t request_complete_event;
+    /// Acquired in user sync function, signalled by coap thread.
+    struct golioth_coap_completion *completion;
 
-    /// (sync request only) Notification from user sync function to coap thread, acknowledge it
-    /// received request_complete_event.
-    ///
-    /// Created in user sync function, deleted by coap thread.
-    ///
-    /// Used by the coap thread to know when it's safe
-    /// to delete request_complete_event and this semaphore.
-    golioth_sys_sem_t request_complete_ack_sem;
+    /// Next queued request that can be coalesced (see golioth_coap_client_set_coalesced())
+    struct golioth_coap_request_msg *next_coalescable;
 };
 
-struct golioth_coap_observe_info
+/// Completion object for synchronous requests.
+///
+/// Completions are cached and reused, so a synchronous request doesn't need to
+/// create and destroy semaphores each time.
+struct golioth_coap_completion
 {
-    bool in_use;
-    struct golioth_coap_request_msg req;
+    /// Given by the coap thread when the request is completed
+    golioth_sys_sem_t done_sem;
+
+    /// Result of the request, valid once done_sem has been given
+    enum golioth_status status;
+
+    /// Held by the user sync function and by the coap thread. The completion
+    /// goes back to the cache when both have dropped their reference, so
+    /// neither side has to wait for the other. Protected by the cache mutex.
+    uint8_t refcount;
+
+    /// Next free completion in the cache
+    struct golioth_coap_completion *next;
 };
 
-/// Create the mutex that makes CoAP token generation thread-safe.
-void golioth_coap_token_mutex_create(void);
+/// Prepare CoAP token generation. Called by golioth_client_create().
+void golioth_coap_token_init(void);
 
-/// Generate a unique CoAP token.
+/// Generate a unique CoAP token. Thread-safe, and lock-free where the target
+/// has lock-free 32-bit atomics.
 ///
 /// @param token byte array where new token will be stored.
 void golioth_coap_next_token(uint8_t token[GOLIOTH_COAP_TOKEN_LEN]);
 
+/// Create the request queue, with one priority level per golioth_coap_request_prio.
+golioth_mbox_t golioth_coap_request_queue_create(void);
+
+/// Create the mutex that protects the cache of completion objects.
+void golioth_coap_completion_mutex_create(void);
+
+/// Create the mutex that protects the list of queued requests that can be coalesced.
+void golioth_coap_coalesce_mutex_create(void);
+
+/// Set up the fixed pool of request descriptors, see CONFIG_GOLIOTH_COAP_REQUEST_MSG_POOL_SIZE.
+void golioth_coap_request_msg_slab_init(void);
+
+/// (coap thread) Record that \p req has been sent to the server, for requests that asked for
+/// their send time.
+void golioth_coap_request_msg_mark_sent(struct golioth_coap_request_msg *req);
+
+/// (coap thread) Free a request descriptor received from the request queue.
+void golioth_coap_request_msg_free(struct golioth_coap_request_msg *req);
+
+/// (coap thread) Receive up to \p max_request_msgs requests from the request queue.
+///
+/// Same as golioth_mbox_recv_batch(), but received requests can no longer be
+/// coalesced with newer ones.
+///
+/// @return number of requests received
+size_t golioth_coap_request_queue_recv(golioth_mbox_t request_queue,
+                                       struct golioth_coap_request_msg **request_msgs,
+                                       size_t max_request_msgs,
+                                       int32_t timeout_ms);
+
+/// (coap thread) Call the callbacks of the sets that were merged into \p req, and free them.
+///
+/// Called wherever the request's own callback is called, with the same arguments.
+void golioth_coap_request_msg_call_merged_callbacks(struct golioth_client *client,
+                                                    struct golioth_coap_request_msg *req,
+                                                    enum golioth_status status,
+                                                    const struct golioth_coap_rsp_code *rsp_code);
+
+/// (coap thread) Free the callbacks merged into \p req without calling them.
+///
+/// For requests that are dropped without calling their own callback either.
+void golioth_coap_request_msg_free_merged_callbacks(struct golioth_coap_request_msg *req);
+
+/// Get a completion object for a synchronous request.
+///
+/// The completion starts with one reference for the caller, dropped by
+/// golioth_coap_completion_wait(), and one for the coap thread, dropped by
+/// golioth_coap_completion_signal().
+///
+/// @return completion, or NULL if one could not be allocated
+struct golioth_coap_completion *golioth_coap_completion_acquire(void);
+
+/// Return a completion object to the cache, e.g. if the request could not be enqueued.
+void golioth_coap_completion_release(struct golioth_coap_completion *completion);
+
+/// (user thread) Wait for the coap thread to complete the request.
+///
+/// @param completion completion from golioth_coap_completion_acquire()
+/// @param timeout_s timeout in seconds, or GOLIOTH_SYS_WAIT_FOREVER
+///
+/// @return status of the request, or GOLIOTH_ERR_TIMEOUT if not completed in time
+enum golioth_status golioth_coap_completion_wait(struct golioth_coap_completion *completion,
+                                                 int32_t timeout_s);
+
+/// (coap thread) Complete the request and wake up the waiting user thread.
+///
+/// Never blocks on the user thread, which may already have timed out.
+///
+/// @param completion completion from the request
+/// @param status status to return to the user thread
+void golioth_coap_completion_signal(struct golioth_coap_completion *completion,
+                                    enum golioth_status status);
+
+/// Release the payload of a POST or POST_BLOCK request after it has been
+/// sent or dropped, by freeing the SDK-owned copy or handing the buffer back
+/// to its owner.
+///
+/// @param req request whose payload should be released. No-op for other request types.
+void golioth_coap_request_msg_release_payload(struct golioth_coap_request_msg *req);
+
 enum golioth_status golioth_coap_client_empty(struct golioth_client *client,
                                               bool is_synchronous,
                                               int32_t timeout_s);
@@ -220,6 +369,57 @@ enum golioth_status golioth_coap_client_set(struct golioth_client *client,
                                             bool is_synchronous,
                                             int32_t timeout_s);
 
+/// Same as golioth_coap_client_set(), but without copying the payload.
+///
+/// On success, ownership of \p payload is transferred to the SDK. It will be
+/// handed back via \p payload_release once it has been serialized into a CoAP
+/// message (or the request is dropped). On error, ownership stays with the
+/// caller and \p payload_release is not called.
+enum golioth_status golioth_coap_client_set_nocopy(struct golioth_client *client,
+                                                   const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+                                                   const char *path_prefix,
+                                                   const char *path,
+                                                   enum golioth_content_type content_type,
+                                                   uint8_t *payload,
+                                                   size_t payload_size,
+                                                   golioth_payload_release_fn payload_release,
+                                                   void *payload_release_arg,
+                                                   golioth_set_cb_fn callback,
+                                                   void *callback_arg,
+                                                   bool is_synchronous,
+                                                   int32_t timeout_s);
+
+/// Same as golioth_coap_client_set() with is_synchronous = false, except that
+/// the latest value wins.
+///
+/// If an earlier coalesced set to the same path is still in the request queue,
+/// its payload is replaced by \p payload instead of queueing another request.
+/// The replaced set's callback is merged into the remaining request, so both
+/// callbacks are called with the result of the value that is actually sent.
+enum golioth_status golioth_coap_client_set_coalesced(struct golioth_client *client,
+                                                      const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+                                                      const char *path_prefix,
+                                                      const char *path,
+                                                      enum golioth_content_type content_type,
+                                                      const uint8_t *payload,
+                                                      size_t payload_size,
+                                                      golioth_set_cb_fn callback,
+                                                      void *callback_arg);
+
+/// Same as golioth_coap_client_set() with is_synchronous = false, except that the response
+/// timeout and retry budget are taken from \p policy.
+enum golioth_status golioth_coap_client_set_with_policy(
+    struct golioth_client *client,
+    const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+    const char *path_prefix,
+    const char *path,
+    enum golioth_content_type content_type,
+    const uint8_t *payload,
+    size_t payload_size,
+    const struct golioth_request_policy *policy,
+    golioth_set_cb_fn callback,
+    void *callback_arg);
+
 enum golioth_status golioth_coap_client_set_block(struct golioth_client *client,
                                                   const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
                                                   const char *path_prefix,
@@ -235,6 +435,35 @@ enum golioth_status golioth_coap_client_set_block(struct golioth_client *client,
                                                   bool is_synchronous,
                                                   int32_t timeout_s);
 
+/// Same as golioth_coap_client_set_block(), but without copying the payload.
+///
+/// On success, ownership of \p payload is transferred to the SDK. It will be
+/// handed back via \p payload_release once it has been serialized into a CoAP
+/// message (or the request is dropped). On error, ownership stays with the
+/// caller and \p payload_release is not called.
+///
+/// If \p sent_ms is not NULL, the time the block is sent to the server is stored there before
+/// \p callback is called, for round-trip time measurements. It is left untouched if the block
+/// is never sent.
+enum golioth_status golioth_coap_client_set_block_nocopy(
+    struct golioth_client *client,
+    const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+    const char *path_prefix,
+    const char *path,
+    bool is_last,
+    enum golioth_content_type content_type,
+    size_t block_index,
+    size_t block_szx,
+    uint8_t *payload,
+    size_t payload_size,
+    golioth_payload_release_fn payload_release,
+    void *payload_release_arg,
+    golioth_set_block_cb_fn callback,
+    void *callback_arg,
+    uint64_t *sent_ms,
+    bool is_synchronous,
+    int32_t timeout_s);
+
 enum golioth_status golioth_coap_client_delete(struct golioth_client *client,
                                                const char *path_prefix,
                                                const char *path,
@@ -243,6 +472,16 @@ enum golioth_status golioth_coap_client_delete(struct golioth_client *client,
                                                bool is_synchronous,
                                                int32_t timeout_s);
 
+/// Same as golioth_coap_client_delete() with is_synchronous = false, except that the response
+/// timeout and retry budget are taken from \p policy.
+enum golioth_status golioth_coap_client_delete_with_policy(
+    struct golioth_client *client,
+    const char *path_prefix,
+    const char *path,
+    const struct golioth_request_policy *policy,
+    golioth_set_cb_fn callback,
+    void *callback_arg);
+
 enum golioth_status golioth_coap_client_get(struct golioth_client *client,
                                             const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
                                             const char *path_prefix,
@@ -253,6 +492,32 @@ enum golioth_status golioth_coap_client_get(struct golioth_client *client,
                                             bool is_synchronous,
                                             int32_t timeout_s);
 
+/// Same as golioth_coap_client_get() with is_synchronous = false, except that the response
+/// timeout and retry budget are taken from \p policy.
+enum golioth_status golioth_coap_client_get_with_policy(
+    struct golioth_client *client,
+    const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+    const char *path_prefix,
+    const char *path,
+    enum golioth_content_type content_type,
+    const struct golioth_request_policy *policy,
+    golioth_get_cb_fn callback,
+    void *callback_arg);
+
+/// Get the size of the BERT blocks that can be used on the current session.
+///
+/// A golioth_coap_client_get_block() with a larger \p block_size than GOLIOTH_COAP_BERT_UNIT_SIZE,
+/// or a golioth_coap_client_set_block() with GOLIOTH_COAP_BERT_SZX, requests a BERT block. Block
+/// indices of BERT blocks are in units of GOLIOTH_COAP_BERT_UNIT_SIZE.
+///
+/// @return Maximum size of BERT blocks, in bytes, or 0 if BERT blocks can't be used
+size_t golioth_coap_client_bert_block_size(struct golioth_client *client);
+
+/// Request a single block of \p path.
+///
+/// If \p sent_ms is not NULL, the time the request is sent to the server is stored there before
+/// \p callback is called, for round-trip time measurements. It is left untouched if the request
+/// is never sent.
 enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
                                                   const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
                                                   const char *path_prefix,
@@ -262,6 +527,7 @@ enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
                                                   size_t block_size,
                                                   coap_get_block_cb_fn callback,
                                                   void *callback_arg,
+                                                  uint64_t *sent_ms,
                                                   bool is_synchronous,
                                                   int32_t timeout_s);
 
@@ -285,6 +551,15 @@ void golioth_coap_client_cancel_all_observations(struct golioth_client *client);
 void golioth_coap_client_cancel_observations_by_prefix(struct golioth_client *client,
                                                        const char *prefix);
 
+/// Remove a local subscriber added by golioth_coap_client_observe(). The observation on the
+/// server is released along with its last subscriber.
+enum golioth_status golioth_coap_client_observe_cancel(struct golioth_client *client,
+                                                       const char *path_prefix,
+                                                       const char *path,
+                                                       enum golioth_content_type content_type,
+                                                       golioth_get_cb_fn callback,
+                                                       void *callback_arg);
+
 /// Getters, for internal SDK code to access data within the
 /// coap client struct.
 golioth_sys_thread_t golioth_coap_client_get_thread(struct golioth_client *client);
@@ -8,23 +8,50 @@
 #include <netdb.h>      // struct addrinfo
 #include <sys/param.h>  // MIN
 #include <coap3/coap.h>
+#if defined(CONFIG_GOLIOTH_LINUX_EPOLL)
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
 #include <golioth/golioth_debug.h>
 #include <golioth/golioth_status.h>
 #include <golioth/golioth_sys.h>
 #include "coap_client.h"
 #include "golioth_util.h"
 #include "mbox.h"
+#include "payload_pool.h"
 #include "coap_client_libcoap.h"
 
 LOG_TAG_DEFINE(golioth_coap_client_libcoap);
 
+// Room left for the header and options of a message carrying a BERT block
+#define BERT_HEADER_ROOM (64 + CONFIG_GOLIOTH_COAP_MAX_PATH_LEN)
+
 static bool _initialized;
 
-static bool token_matches_request(const struct golioth_coap_request_msg *req, const coap_pdu_t *pdu)
+static struct golioth_coap_request_msg *find_inflight_request(struct golioth_client *client,
+                                                              const coap_pdu_t *pdu)
 {
-    coap_bin_const_t rcvd_token = coap_pdu_get_token(pdu);
-    bool len_matches = (rcvd_token.length == GOLIOTH_COAP_TOKEN_LEN);
-    return (len_matches && (0 == memcmp(rcvd_token.s, req->token, GOLIOTH_COAP_TOKEN_LEN)));
+    if (!pdu)
+    {
+        return NULL;
+    }
+
+    coap_bin_const_t token = coap_pdu_get_token(pdu);
+    coap_opt_iterator_t opt_iter;
+    coap_opt_t *block_opt = coap_check_option(pdu, COAP_OPTION_BLOCK1, &opt_iter);
+    struct golioth_coap_inflight_block1 block1;
+
+    if (block_opt)
+    {
+        block1.num = coap_opt_block_num(block_opt);
+        block1.szx = COAP_OPT_BLOCK_SZX(block_opt);
+    }
+
+    return golioth_coap_inflight_find(&client->inflight,
+                                      token.s,
+                                      token.length,
+                                      block_opt ? &block1 : NULL);
 }
 
 static void notify_observers(const coap_pdu_t *received,
@@ -34,30 +61,16 @@ static void notify_observers(const coap_pdu_t *received,
                              enum golioth_status status,
                              const struct golioth_coap_rsp_code *coap_rsp_code)
 {
-    // scan observations, check for token match
-    for (int i = 0; i < CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS; i++)
-    {
-        const struct golioth_coap_observe_info *obs_info = &client->observations[i];
-        golioth_get_cb_fn callback = obs_info->req.observe.callback;
-
-        if (!obs_info->in_use || !callback)
-        {
-            continue;
-        }
-
-        coap_bin_const_t rcvd_token = coap_pdu_get_token(received);
-        bool len_matches = (rcvd_token.length == GOLIOTH_COAP_TOKEN_LEN);
-        if (len_matches && (0 == memcmp(rcvd_token.s, obs_info->req.token, GOLIOTH_COAP_TOKEN_LEN)))
-        {
-            callback(client,
-                     status,
-                     coap_rsp_code,
-                     obs_info->req.path,
-                     data,
-                     data_len,
-                     obs_info->req.observe.arg);
-        }
-    }
+    coap_bin_const_t rcvd_token = coap_pdu_get_token(received);
+
+    golioth_coap_observations_notify(&client->observations,
+                                     client,
+                                     rcvd_token.s,
+                                     rcvd_token.length,
+                                     status,
+                                     coap_rsp_code,
+                                     data,
+                                     data_len);
 }
 
 static coap_response_t coap_response_handler(coap_session_t *session,
@@ -93,13 +106,13 @@ static coap_response_t coap_response_handler(coap_session_t *session,
     coap_get_data(received, &data_len, &data);
 
     // Get the original/pending request info
-    struct golioth_coap_request_msg *req = client->pending_req;
+    struct golioth_coap_request_msg *req = find_inflight_request(client, received);
 
     if (req)
     {
-        if (req->status)
+        if (req->completion)
         {
-            *req->status = status;
+            req->completion->status = status;
         }
 
         if (req->type == GOLIOTH_COAP_REQUEST_EMPTY)
@@ -145,7 +158,7 @@ static coap_response_t coap_response_handler(coap_session_t *session,
                   (uint32_t) data_len);
     }
 
-    if (req && token_matches_request(req, received))
+    if (req)
     {
         req->got_response = true;
 
@@ -233,6 +246,10 @@ static coap_response_t coap_response_handler(coap_session_t *session,
                                                req->post.arg);
                     }
                 }
+                golioth_coap_request_msg_call_merged_callbacks(client,
+                                                               req,
+                                                               status,
+                                                               &coap_rsp_code);
             }
             else if (req->type == GOLIOTH_COAP_REQUEST_POST_BLOCK)
             {
@@ -292,7 +309,6 @@ static void nack_handler(coap_session_t *session,
 {
     coap_context_t *context = coap_session_get_context(session);
     struct golioth_client *client = coap_get_app_data(context);
-    struct golioth_coap_request_msg *req = client->pending_req;
 
     switch (reason)
     {
@@ -309,10 +325,17 @@ static void nack_handler(coap_session_t *session,
             GLTH_LOGE(TAG, "Received nack reason: %d", reason);
     }
 
+    struct golioth_coap_request_msg *req = find_inflight_request(client, sent);
     if (req)
     {
         req->got_nack = true;
     }
+    else if (!sent)
+    {
+        // Not associated with a specific PDU (e.g. DTLS failure), so it applies
+        // to everything in flight.
+        golioth_coap_inflight_nack_all(&client->inflight);
+    }
 }
 
 #if GOLIOTH_OVERRIDE_LIBCOAP_LOG_HANDLER
@@ -337,48 +360,110 @@ static void coap_log_handler(coap_log_t level, const char *message)
 }
 #endif /* GOLIOTH_OVERRIDE_LIBCOAP_LOG_HANDLER */
 
-// DNS lookup of host_uri
-static enum golioth_status get_coap_dst_address(const coap_uri_t *host_uri,
-                                                coap_address_t *dst_addr)
+// DNS lookup of hostname, returning all addresses in the order of the resolver
+static enum golioth_status dns_lookup(const char *hostname,
+                                      struct golioth_dns_cache_addr *addrs,
+                                      size_t max_addrs,
+                                      size_t *num_addrs)
 {
     struct addrinfo hints = {
         .ai_socktype = SOCK_DGRAM,
         .ai_family = AF_UNSPEC,
     };
     struct addrinfo *ainfo = NULL;
-    const char *hostname = (const char *) host_uri->host.s;
     int error = getaddrinfo(hostname, NULL, &hints, &ainfo);
     if (error != 0)
     {
         GLTH_LOGE(TAG, "DNS lookup failed for destination ainfo %s. error: %d", hostname, error);
         return GOLIOTH_ERR_DNS_LOOKUP;
     }
-    if (!ainfo)
+
+    *num_addrs = 0;
+    for (struct addrinfo *ai = ainfo; ai && *num_addrs < max_addrs; ai = ai->ai_next)
+    {
+        struct golioth_dns_cache_addr *addr = &addrs[*num_addrs];
+
+        switch (ai->ai_family)
+        {
+            case AF_INET:
+                addr->family = GOLIOTH_DNS_CACHE_IPV4;
+                memcpy(addr->addr,
+                       &((struct sockaddr_in *) ai->ai_addr)->sin_addr,
+                       sizeof(struct in_addr));
+                break;
+            case AF_INET6:
+                addr->family = GOLIOTH_DNS_CACHE_IPV6;
+                memcpy(addr->addr,
+                       &((struct sockaddr_in6 *) ai->ai_addr)->sin6_addr,
+                       sizeof(struct in6_addr));
+                break;
+            default:
+                continue;
+        }
+        (*num_addrs)++;
+    }
+    freeaddrinfo(ainfo);
+
+    if (*num_addrs == 0)
     {
         GLTH_LOGE(TAG, "DNS lookup %s did not return any addresses", hostname);
         return GOLIOTH_ERR_DNS_LOOKUP;
     }
 
-    coap_address_init(dst_addr);
+    return GOLIOTH_OK;
+}
+
+// Get the address to connect to, from the DNS cache or by resolving hostname
+static enum golioth_status get_coap_dst_address(struct golioth_client *client,
+                                                const char *hostname,
+                                                uint16_t port,
+                                                coap_address_t *dst_addr)
+{
+    struct golioth_dns_cache_addr addrs[CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS];
+    size_t num_addrs = golioth_dns_cache_lookup(&client->dns_cache, false, addrs, 1);
 
-    switch (ainfo->ai_family)
+    if (num_addrs == 0)
     {
-        case AF_INET:
-            memcpy(&dst_addr->addr.sin, ainfo->ai_addr, sizeof(dst_addr->addr.sin));
-            dst_addr->addr.sin.sin_port = htons(host_uri->port);
-            dst_addr->size = sizeof(dst_addr->addr.sin);
-            break;
-        case AF_INET6:
-            memcpy(&dst_addr->addr.sin6, ainfo->ai_addr, sizeof(dst_addr->addr.sin6));
-            dst_addr->addr.sin6.sin6_port = htons(host_uri->port);
-            dst_addr->size = sizeof(dst_addr->addr.sin6);
-            break;
-        default:
-            GLTH_LOGE(TAG, "DNS lookup response failed");
-            freeaddrinfo(ainfo);
+        enum golioth_status status = dns_lookup(hostname, addrs, ARRAY_SIZE(addrs), &num_addrs);
+        if (status == GOLIOTH_OK)
+        {
+            // getaddrinfo() does not report the TTL of the records
+            golioth_dns_cache_store(&client->dns_cache,
+                                    addrs,
+                                    num_addrs,
+                                    CONFIG_GOLIOTH_DNS_CACHE_TTL_S);
+        }
+
+        // Either the addresses just stored, or stale ones if the lookup failed
+        num_addrs = golioth_dns_cache_lookup(&client->dns_cache, true, addrs, 1);
+        if (num_addrs == 0)
+        {
             return GOLIOTH_ERR_DNS_LOOKUP;
+        }
+        if (status != GOLIOTH_OK)
+        {
+            GLTH_LOGW(TAG, "Using cached address of %s", hostname);
+        }
+    }
+
+    client->session_addr = addrs[0];
+
+    coap_address_init(dst_addr);
+
+    if (addrs[0].family == GOLIOTH_DNS_CACHE_IPV4)
+    {
+        dst_addr->addr.sin.sin_family = AF_INET;
+        memcpy(&dst_addr->addr.sin.sin_addr, addrs[0].addr, sizeof(struct in_addr));
+        dst_addr->addr.sin.sin_port = htons(port);
+        dst_addr->size = sizeof(dst_addr->addr.sin);
+    }
+    else
+    {
+        dst_addr->addr.sin6.sin6_family = AF_INET6;
+        memcpy(&dst_addr->addr.sin6.sin6_addr, addrs[0].addr, sizeof(struct in6_addr));
+        dst_addr->addr.sin6.sin6_port = htons(port);
+        dst_addr->size = sizeof(dst_addr->addr.sin6);
     }
-    freeaddrinfo(ainfo);
 
     return GOLIOTH_OK;
 }
@@ -453,7 +538,7 @@ static void golioth_coap_add_block1(coap_pdu_t *request,
                                     size_t block_szx,
                                     bool is_last)
 {
-    assert(block_szx <= COAP_MAX_BLOCK_SZX);
+    assert(block_szx <= COAP_MAX_BLOCK_SZX || block_szx == GOLIOTH_COAP_BERT_SZX);
     coap_block_t block = {
         .num = block_index,
         .m = !is_last,
@@ -468,7 +553,9 @@ static void golioth_coap_add_block1(coap_pdu_t *request,
 
 static void golioth_coap_add_block2(coap_pdu_t *request, size_t block_index, size_t block_size)
 {
-    size_t szx = BLOCKSIZE_TO_SZX(block_size);
+    // Larger blocks than 1024 bytes are BERT blocks, block_index is then in 1024 byte units
+    size_t szx = (block_size > GOLIOTH_COAP_BERT_UNIT_SIZE) ? GOLIOTH_COAP_BERT_SZX
+                                                            : BLOCKSIZE_TO_SZX(block_size);
     assert(szx != -1);
     coap_block_t block = {
         .num = block_index,
@@ -639,59 +726,69 @@ static enum golioth_status add_observation(struct golioth_coap_request_msg *req,
                                            struct golioth_client *client,
                                            coap_session_t *session)
 {
-    // scan for available (not used) observation slot
     struct golioth_coap_observe_info *obs_info = NULL;
-    bool found_slot = false;
-    for (int i = 0; i < CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS; i++)
+    bool is_new = false;
+    enum golioth_status status =
+        golioth_coap_observations_add(&client->observations, req, &obs_info, &is_new);
+    if (status == GOLIOTH_ERR_QUEUE_FULL)
     {
-        obs_info = &client->observations[i];
-        if (!obs_info->in_use)
-        {
-            found_slot = true;
-            break;
-        }
+        GLTH_LOGE(TAG, "Unable to observe path %s, no slots available", req->path);
+        return status;
+    }
+    if (status != GOLIOTH_OK)
+    {
+        GLTH_LOGE(TAG, "Unable to store observation of path %s: %d", req->path, status);
+        return status;
     }
 
-    if (!found_slot)
+    if (!is_new)
     {
-        GLTH_LOGE(TAG, "Unable to observe path %s, no slots available", req->path);
-        return GOLIOTH_ERR_QUEUE_FULL;
+        // Already observed, so only fetch the current value for the new subscriber. The request
+        // is sent as a GET right away, and kept in flight like one, so the subscriber is called
+        // with the response or the error.
+        GLTH_LOGD(TAG, "Sharing observation of path %s", req->path);
+        struct golioth_coap_get_params get = {
+            .content_type = req->observe.content_type,
+            .callback = req->observe.callback,
+            .arg = req->observe.arg,
+        };
+        req->type = GOLIOTH_COAP_REQUEST_GET;
+        req->get = get;
+        golioth_coap_get(req, session);
+        return GOLIOTH_OK;
     }
 
     int err = golioth_coap_observe(req, client, session, false);
     if (err)
     {
-        return err;
+        golioth_coap_observations_remove(&client->observations, obs_info);
     }
 
-    obs_info->in_use = true;
-    memcpy(&obs_info->req, req, sizeof(obs_info->req));
-
-    return GOLIOTH_OK;
+    return err;
 }
 
+static void release_observation(struct golioth_client *client,
+                                struct golioth_coap_observe_info *obs_info)
+{
+    golioth_coap_client_observe_release(client,
+                                        obs_info->req.token,
+                                        obs_info->req.path_prefix,
+                                        obs_info->req.path,
+                                        obs_info->req.observe.content_type,
+                                        NULL);
+    golioth_coap_observations_free(obs_info);
+}
 
 void golioth_cancel_all_observations_by_prefix(struct golioth_client *client, const char *prefix)
 {
-    struct golioth_coap_observe_info *obs_info = NULL;
-    for (int i = 0; i < CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS; i++)
-    {
-        obs_info = &client->observations[i];
-        if (obs_info->in_use)
-        {
-            if ((prefix != NULL) && (strcmp(prefix, obs_info->req.path_prefix) != 0))
-            {
-                continue;
-            }
+    struct golioth_coap_observe_info *obs_info =
+        golioth_coap_observations_take_by_prefix(&client->observations, prefix);
 
-            obs_info->in_use = false;
-            golioth_coap_client_observe_release(client,
-                                                obs_info->req.token,
-                                                obs_info->req.path_prefix,
-                                                obs_info->req.path,
-                                                obs_info->req.observe.content_type,
-                                                NULL);
-        }
+    while (obs_info)
+    {
+        struct golioth_coap_observe_info *next = obs_info->prefix_next;
+        release_observation(client, obs_info);
+        obs_info = next;
     }
 }
 
@@ -700,17 +797,52 @@ void golioth_cancel_all_observations(struct golioth_client *client)
     golioth_cancel_all_observations_by_prefix(client, NULL);
 }
 
-static void reestablish_observations(struct golioth_client *client, coap_session_t *session)
+enum golioth_status golioth_cancel_observation(struct golioth_client *client,
+                                               const char *path_prefix,
+                                               const char *path,
+                                               enum golioth_content_type content_type,
+                                               golioth_get_cb_fn callback,
+                                               void *arg)
 {
-    struct golioth_coap_observe_info *obs_info = NULL;
-    for (int i = 0; i < CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS; i++)
+    struct golioth_coap_observe_info *released = NULL;
+    enum golioth_status status = golioth_coap_observations_unsubscribe(&client->observations,
+                                                                       path_prefix,
+                                                                       path,
+                                                                       content_type,
+                                                                       callback,
+                                                                       arg,
+                                                                       &released);
+
+    // Release the observation on the server along with its last subscriber
+    if (released)
     {
-        obs_info = &client->observations[i];
-        if (obs_info->in_use)
-        {
-            golioth_coap_observe(&obs_info->req, client, session, false);
-        }
+        release_observation(client, released);
     }
+
+    return status;
+}
+
+struct reestablish_ctx
+{
+    struct golioth_client *client;
+    coap_session_t *session;
+};
+
+static void reestablish_observation(struct golioth_coap_observe_info *obs_info, void *arg)
+{
+    struct reestablish_ctx *ctx = arg;
+
+    golioth_coap_observe(&obs_info->req, ctx->client, ctx->session, false);
+}
+
+static void reestablish_observations(struct golioth_client *client, coap_session_t *session)
+{
+    struct reestablish_ctx ctx = {
+        .client = client,
+        .session = session,
+    };
+
+    golioth_coap_observations_foreach(&client->observations, reestablish_observation, &ctx);
 }
 
 static enum golioth_status create_context(struct golioth_client *client, coap_context_t **context)
@@ -731,6 +863,14 @@ static enum golioth_status create_context(struct golioth_client *client, coap_co
     coap_register_event_handler(*context, event_handler);
     coap_register_nack_handler(*context, nack_handler);
 
+    if (client->config.transport == GOLIOTH_CLIENT_TRANSPORT_TLS)
+    {
+        // Let the server know it may send BERT blocks as large as we request
+        coap_context_set_csm_max_message_size(*context,
+                                              CONFIG_GOLIOTH_BLOCKWISE_BERT_MAX_BLOCK_SIZE
+                                                  + BERT_HEADER_ROOM);
+    }
+
     return GOLIOTH_OK;
 }
 
@@ -754,6 +894,18 @@ static enum golioth_status create_session(struct golioth_client *client,
                                           coap_context_t *context,
                                           coap_session_t **session)
 {
+    coap_proto_t proto = COAP_PROTO_DTLS;
+
+    if (client->config.transport == GOLIOTH_CLIENT_TRANSPORT_TLS)
+    {
+        if (!coap_tcp_is_supported() || !coap_tls_is_supported())
+        {
+            GLTH_LOGE(TAG, "CoAP over TLS needs libcoap built with TCP and TLS support");
+            return GOLIOTH_ERR_NOT_IMPLEMENTED;
+        }
+        proto = COAP_PROTO_TLS;
+    }
+
     // Split URI for host
     coap_uri_t host_uri = {};
     int uri_status = coap_split_uri((const uint8_t *) CONFIG_GOLIOTH_COAP_HOST_URI,
@@ -765,14 +917,18 @@ static enum golioth_status create_session(struct golioth_client *client,
         return GOLIOTH_ERR_INVALID_FORMAT;
     }
 
+    char client_sni[256] = {};
+    memcpy(client_sni, host_uri.host.s, MIN(host_uri.host.length, sizeof(client_sni) - 1));
+
     // Get destination address of host
     coap_address_t dst_addr = {};
-    GOLIOTH_STATUS_RETURN_IF_ERROR(get_coap_dst_address(&host_uri, &dst_addr));
-
-    GLTH_LOGI(TAG, "Start CoAP session with host: %s", CONFIG_GOLIOTH_COAP_HOST_URI);
+    GOLIOTH_STATUS_RETURN_IF_ERROR(
+        get_coap_dst_address(client, client_sni, host_uri.port, &dst_addr));
 
-    char client_sni[256] = {};
-    memcpy(client_sni, host_uri.host.s, MIN(host_uri.host.length, sizeof(client_sni) - 1));
+    GLTH_LOGI(TAG,
+              "Start CoAP session with host: %s (%s)",
+              CONFIG_GOLIOTH_COAP_HOST_URI,
+              (proto == COAP_PROTO_TLS) ? "TLS" : "DTLS");
 
     enum golioth_auth_type auth_type = client->config.credentials.auth_type;
 
@@ -790,8 +946,7 @@ static enum golioth_status create_session(struct golioth_client *client,
             .psk_info.key.s = (const uint8_t *) psk_creds.psk,
             .psk_info.key.length = psk_creds.psk_len,
         };
-        *session =
-            coap_new_client_session_psk2(context, NULL, &dst_addr, COAP_PROTO_DTLS, &dtls_psk);
+        *session = coap_new_client_session_psk2(context, NULL, &dst_addr, proto, &dtls_psk);
     }
     else if (auth_type == GOLIOTH_TLS_AUTH_TYPE_PKI)
     {
@@ -827,8 +982,7 @@ static enum golioth_status create_session(struct golioth_client *client,
                         },
                 },
         };
-        *session =
-            coap_new_client_session_pki(context, NULL, &dst_addr, COAP_PROTO_DTLS, &dtls_pki);
+        *session = coap_new_client_session_pki(context, NULL, &dst_addr, proto, &dtls_pki);
     }
     else
     {
@@ -842,117 +996,325 @@ static enum golioth_status create_session(struct golioth_client *client,
         return GOLIOTH_ERR_MEM_ALLOC;
     }
 
+    // Let libcoap transmit as many confirmable requests as we keep in flight,
+    // instead of holding them back in its own delay queue.
+    coap_session_set_nstart(*session, CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS);
+
     return GOLIOTH_OK;
 }
 
-static enum golioth_status coap_io_loop_once(struct golioth_client *client,
-                                             coap_context_t *context,
-                                             coap_session_t *session)
+static void call_request_callback_with_error(struct golioth_client *client,
+                                             struct golioth_coap_request_msg *req,
+                                             enum golioth_status status)
 {
-    struct golioth_coap_request_msg request_msg = {};
-    int mbox_fd = golioth_sys_sem_get_fd(client->request_queue->fill_count_sem);
+    // TODO - simplify, put callback directly in request which removes if/else branches
+    if (req->type == GOLIOTH_COAP_REQUEST_GET && req->get.callback)
+    {
+        req->get.callback(client, status, NULL, req->path, NULL, 0, req->get.arg);
+    }
+    else if (req->type == GOLIOTH_COAP_REQUEST_GET_BLOCK && req->get_block.callback)
+    {
+        req->get_block
+            .callback(client, status, NULL, req->path, NULL, 0, false, req->get_block.arg);
+    }
+    else if (req->type == GOLIOTH_COAP_REQUEST_POST && req->post.callback_post)
+    {
+        if (req->post.callback_is_post)
+        {
+            req->post.callback_post(client, status, NULL, req->path, NULL, 0, req->post.arg);
+        }
+        else
+        {
+            req->post.callback_set(client, status, NULL, req->path, req->post.arg);
+        }
+    }
+    else if (req->type == GOLIOTH_COAP_REQUEST_POST_BLOCK && req->post_block.callback)
+    {
+        req->post_block.callback(client,
+                                 status,
+                                 NULL,
+                                 req->path,
+                                 req->post_block.block_szx,
+                                 req->post_block.arg);
+    }
+    else if (req->type == GOLIOTH_COAP_REQUEST_DELETE && req->delete.callback)
+    {
+        req->delete.callback(client, status, NULL, req->path, req->delete.arg);
+    }
+
+    golioth_coap_request_msg_call_merged_callbacks(client, req, status, NULL);
+}
+
+static void complete_request(struct golioth_coap_request_msg *req)
+{
+    if (req->completion)
+    {
+        // Response status was stored in the completion by the response handler
+        enum golioth_status status =
+            req->got_response ? req->completion->status : GOLIOTH_ERR_TIMEOUT;
+
+        golioth_coap_completion_signal(req->completion, status);
+    }
+}
+
+static bool has_request_policy(const struct golioth_coap_request_msg *req)
+{
+    return req->policy.timeout_ms != 0 || req->policy.max_transmissions != 0;
+}
+
+// Time to wait for a response once the request has been sent
+static uint64_t response_timeout_ms(const struct golioth_coap_request_msg *req,
+                                    coap_session_t *session)
+{
+    uint64_t timeout_ms = (req->policy.timeout_ms != 0)
+        ? req->policy.timeout_ms
+        : (uint64_t) CONFIG_GOLIOTH_COAP_RESPONSE_TIMEOUT_S * 1000;
 
-    if (mbox_fd >= 0)
+    // Nothing is retransmitted over TLS, TCP takes care of it
+    if (req->policy.max_transmissions != 0 && coap_session_get_proto(session) == COAP_PROTO_DTLS)
     {
-        fd_set readfds;
+        // libcoap only has a retransmission limit per session, so stop waiting
+        // once libcoap would have given up after max_transmissions instead:
+        // ACK_TIMEOUT * ACK_RANDOM_FACTOR * (2^n - 1)
+        coap_fixed_point_t ack_timeout = coap_session_get_ack_timeout(session);
+        coap_fixed_point_t random_factor = coap_session_get_ack_random_factor(session);
+        uint32_t num_tx = min(req->policy.max_transmissions,
+                              coap_session_get_max_retransmit(session) + 1);
 
-        FD_ZERO(&readfds);
-        FD_SET(mbox_fd, &readfds);
+        uint64_t ack_window_ms = (ack_timeout.integer_part * 1000 + ack_timeout.fractional_part)
+            * (random_factor.integer_part * 1000 + random_factor.fractional_part) / 1000;
 
-        coap_io_process_with_fds(context, COAP_IO_WAIT, mbox_fd + 1, &readfds, NULL, NULL);
+        timeout_ms = min(timeout_ms, ack_window_ms * ((1ULL << num_tx) - 1));
+    }
+
+    return timeout_ms;
+}
 
-        if (!FD_ISSET(mbox_fd, &readfds))
+static void add_inflight_request(struct golioth_client *client,
+                                 coap_session_t *session,
+                                 struct golioth_coap_request_msg *req)
+{
+    uint64_t deadline_ms = golioth_sys_now_ms() + response_timeout_ms(req, session);
+
+    golioth_coap_inflight_add(&client->inflight, req, min(deadline_ms, req->ageout_ms));
+}
+
+// Returns time in ms until the nearest in-flight request deadline, or -1 if
+// there are no requests in flight.
+static int32_t next_inflight_deadline_ms(struct golioth_client *client)
+{
+    return golioth_coap_inflight_next_deadline_ms(&client->inflight,
+                                                  golioth_sys_now_ms(),
+                                                  CONFIG_GOLIOTH_COAP_RESPONSE_TIMEOUT_S * 1000);
+}
+
+struct inflight_done_ctx
+{
+    struct golioth_client *client;
+    coap_session_t *session;
+    enum golioth_status status;
+    bool got_response;
+};
+
+static void inflight_request_done(struct golioth_coap_request_msg *req,
+                                  enum golioth_coap_inflight_result result,
+                                  void *arg)
+{
+    struct inflight_done_ctx *ctx = arg;
+
+    switch (result)
+    {
+        case GOLIOTH_COAP_INFLIGHT_RESPONSE:
+            ctx->got_response = true;
+            break;
+        case GOLIOTH_COAP_INFLIGHT_NACK:
+            GLTH_LOGE(TAG, "Got NACKed request");
+            ctx->status = GOLIOTH_ERR_NACK;
+            break;
+        case GOLIOTH_COAP_INFLIGHT_TIMEOUT:
+            GLTH_LOGE(TAG,
+                      "Receive timeout, type %d, path %s%s",
+                      req->type,
+                      req->path_prefix,
+                      req->path);
+
+            if (coap_session_get_state(ctx->session) == COAP_SESSION_STATE_HANDSHAKE)
+            {
+                // TODO - customize error message based on PSK vs cert usage
+                GLTH_LOGE(TAG, "DTLS handshake failed. Maybe your PSK-ID or PSK is incorrect?");
+            }
+
+            // Call user's callback with GOLIOTH_ERR_TIMEOUT
+            call_request_callback_with_error(ctx->client, req, GOLIOTH_ERR_TIMEOUT);
+
+            // A request that ran out of its own, possibly tight, budget says
+            // nothing about the session, so only the default timeout reconnects
+            if (!has_request_policy(req))
+            {
+                ctx->status = GOLIOTH_ERR_TIMEOUT;
+            }
+            break;
+        case GOLIOTH_COAP_INFLIGHT_CANCELLED:
+            call_request_callback_with_error(ctx->client, req, GOLIOTH_ERR_FAIL);
+            break;
+    }
+
+    complete_request(req);
+    golioth_coap_request_msg_free(req);
+}
+
+// Cancel all requests still waiting for a response, e.g. when the session ends
+static void cancel_inflight_requests(struct golioth_client *client)
+{
+    struct inflight_done_ctx ctx = {
+        .client = client,
+        .status = GOLIOTH_OK,
+    };
+
+    golioth_coap_inflight_cancel_all(&client->inflight, inflight_request_done, &ctx);
+}
+
+// Largest BERT block that fits in the messages the server accepts, 0 if BERT can't be used
+static size_t session_bert_block_size(coap_session_t *session)
+{
+    if (coap_session_get_proto(session) != COAP_PROTO_TLS)
+    {
+        return 0;
+    }
+
+    size_t max_pdu_size = coap_session_max_pdu_size(session);
+    if (max_pdu_size < BERT_HEADER_ROOM + 2 * GOLIOTH_COAP_BERT_UNIT_SIZE)
+    {
+        return 0;
+    }
+
+    size_t block_size = min(max_pdu_size - BERT_HEADER_ROOM,
+                            CONFIG_GOLIOTH_BLOCKWISE_BERT_MAX_BLOCK_SIZE);
+
+    return block_size - (block_size % GOLIOTH_COAP_BERT_UNIT_SIZE);
+}
+
+// Complete in-flight requests that received a response, were NACKed, or timed out
+static enum golioth_status process_inflight_requests(struct golioth_client *client,
+                                                     coap_session_t *session)
+{
+    struct inflight_done_ctx ctx = {
+        .client = client,
+        .session = session,
+        .status = GOLIOTH_OK,
+        .got_response = false,
+    };
+
+    golioth_coap_inflight_process(&client->inflight,
+                                  golioth_sys_now_ms(),
+                                  inflight_request_done,
+                                  &ctx);
+
+    enum golioth_status status = ctx.status;
+    bool got_response = ctx.got_response;
+
+    if (status == GOLIOTH_ERR_TIMEOUT)
+    {
+        if (client->conn_state != GOLIOTH_COAP_CONN_CONNECTED)
         {
-            return GOLIOTH_OK;
+            // Never got a response, try the next address on the following session
+            golioth_dns_cache_mark_bad(&client->dns_cache, &client->session_addr);
         }
-
-        bool got_request_msg = golioth_mbox_recv(client->request_queue, &request_msg, 0);
-        if (!got_request_msg)
+        golioth_sys_client_disconnected(client);
+        if (client->event_callback && client->conn_state == GOLIOTH_COAP_CONN_CONNECTED)
         {
-            GLTH_LOGE(TAG, "Failed to get request_message from mbox");
-            return GOLIOTH_ERR_IO;
+            client->event_callback(client,
+                                   GOLIOTH_CLIENT_EVENT_DISCONNECTED,
+                                   client->event_callback_arg);
         }
+        // Only a connection attempt that never got a response means the server is
+        // unreachable. A live session may just have lost a response, so it reconnects
+        // and keeps the queue.
+        client->conn_state = (client->conn_state == GOLIOTH_COAP_CONN_CONNECTED)
+            ? GOLIOTH_COAP_CONN_CONNECTING
+            : GOLIOTH_COAP_CONN_OFFLINE;
+        return status;
     }
-    else
+
+    if (status != GOLIOTH_OK)
+    {
+        return status;
+    }
+
+    if (got_response && client->conn_state != GOLIOTH_COAP_CONN_CONNECTED)
     {
-        // Wait for request message, with timeout
-        bool got_request_msg = golioth_mbox_recv(client->request_queue,
-                                                 &request_msg,
-                                                 CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_TIMEOUT_MS);
-        if (!got_request_msg)
+        // Transitioned from not connected to connected
+        GLTH_LOGI(TAG, "Golioth CoAP client connected");
+        golioth_dns_cache_mark_good(&client->dns_cache, &client->session_addr);
+        // The server's Max-Message-Size is known by now, it came before any response
+        client->bert_block_size = session_bert_block_size(session);
+        golioth_sys_client_connected(client);
+        if (client->event_callback)
         {
-            // No requests, so process other pending IO (e.g. observations)
-            GLTH_LOGV(TAG, "Idle io process start");
-            coap_io_process(context, COAP_IO_NO_WAIT);
-            GLTH_LOGV(TAG, "Idle io process end");
-            return GOLIOTH_OK;
+            client->event_callback(client,
+                                   GOLIOTH_CLIENT_EVENT_CONNECTED,
+                                   client->event_callback_arg);
         }
+        golioth_coap_reconnect_backoff_reset(&client->reconnect_backoff);
+        client->conn_state = GOLIOTH_COAP_CONN_CONNECTED;
     }
 
+    return GOLIOTH_OK;
+}
+
+// Takes ownership of request_msg, which is either freed or kept in the in-flight window
+static void handle_request_msg(struct golioth_client *client,
+                               coap_session_t *session,
+                               struct golioth_coap_request_msg *request_msg)
+{
     // Make sure the request isn't too old
-    if (golioth_sys_now_ms() > request_msg.ageout_ms)
+    if (golioth_sys_now_ms() > request_msg->ageout_ms)
     {
         GLTH_LOGW(TAG,
                   "Ignoring request that has aged out, type %d, path %s",
-                  request_msg.type,
-                  (request_msg.path ? request_msg.path : "N/A"));
+                  request_msg->type,
+                  (request_msg->path ? request_msg->path : "N/A"));
 
-        if (request_msg.type == GOLIOTH_COAP_REQUEST_POST && request_msg.post.payload_size > 0)
-        {
-            golioth_sys_free(request_msg.post.payload);
-        }
-
-        if (request_msg.type == GOLIOTH_COAP_REQUEST_POST_BLOCK
-            && request_msg.post_block.payload_size > 0)
-        {
-            golioth_sys_free(request_msg.post_block.payload);
-        }
-
-        if (request_msg.request_complete_event)
-        {
-            assert(request_msg.request_complete_ack_sem);
-            golioth_event_group_destroy(request_msg.request_complete_event);
-            golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
-        }
-        return GOLIOTH_OK;
+        golioth_coap_request_msg_release_payload(request_msg);
+        complete_request(request_msg);
+        golioth_coap_request_msg_free(request_msg);
+        return;
     }
 
     int err;
     // Handle message and send request to server
     bool request_is_valid = true;
-    switch (request_msg.type)
+    switch (request_msg->type)
     {
         case GOLIOTH_COAP_REQUEST_EMPTY:
             GLTH_LOGD(TAG, "Handle EMPTY");
-            golioth_coap_empty(&request_msg, session);
+            golioth_coap_empty(request_msg, session);
             break;
         case GOLIOTH_COAP_REQUEST_GET:
-            GLTH_LOGD(TAG, "Handle GET %s", request_msg.path);
-            golioth_coap_get(&request_msg, session);
+            GLTH_LOGD(TAG, "Handle GET %s", request_msg->path);
+            golioth_coap_get(request_msg, session);
             break;
         case GOLIOTH_COAP_REQUEST_GET_BLOCK:
-            GLTH_LOGD(TAG, "Handle GET_BLOCK %s", request_msg.path);
-            golioth_coap_get_block(&request_msg, client, session);
+            GLTH_LOGD(TAG, "Handle GET_BLOCK %s", request_msg->path);
+            golioth_coap_get_block(request_msg, client, session);
             break;
         case GOLIOTH_COAP_REQUEST_POST:
-            GLTH_LOGD(TAG, "Handle POST %s", request_msg.path);
-            golioth_coap_post(&request_msg, session);
-            assert(request_msg.post.payload);
-            golioth_sys_free(request_msg.post.payload);
+            GLTH_LOGD(TAG, "Handle POST %s", request_msg->path);
+            golioth_coap_post(request_msg, session);
+            golioth_coap_request_msg_release_payload(request_msg);
             break;
         case GOLIOTH_COAP_REQUEST_POST_BLOCK:
-            GLTH_LOGD(TAG, "Handle POST_BLOCK %s", request_msg.path);
-            golioth_coap_post_block(&request_msg, client, session);
-            assert(request_msg.post_block.payload);
-            golioth_sys_free(request_msg.post_block.payload);
+            GLTH_LOGD(TAG, "Handle POST_BLOCK %s", request_msg->path);
+            golioth_coap_post_block(request_msg, client, session);
+            golioth_coap_request_msg_release_payload(request_msg);
             break;
         case GOLIOTH_COAP_REQUEST_DELETE:
-            GLTH_LOGD(TAG, "Handle DELETE %s", request_msg.path);
-            golioth_coap_delete(&request_msg, session);
+            GLTH_LOGD(TAG, "Handle DELETE %s", request_msg->path);
+            golioth_coap_delete(request_msg, session);
             break;
         case GOLIOTH_COAP_REQUEST_OBSERVE:
-            GLTH_LOGD(TAG, "Handle OBSERVE %s", request_msg.path);
-            err = add_observation(&request_msg, client, session);
+            GLTH_LOGD(TAG, "Handle OBSERVE %s", request_msg->path);
+            err = add_observation(request_msg, client, session);
             if (err)
             {
                 GLTH_LOGE(TAG, "Error adding observation: %d", err);
@@ -960,217 +1322,311 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client,
             }
             break;
         case GOLIOTH_COAP_REQUEST_OBSERVE_RELEASE:
-            GLTH_LOGD(TAG, "Handle OBSERVE CANCEL %s", request_msg.path);
-            err = golioth_coap_observe(&request_msg, client, session, true);
+            GLTH_LOGD(TAG, "Handle OBSERVE CANCEL %s", request_msg->path);
+            err = golioth_coap_observe(request_msg, client, session, true);
             if (err == COAP_INVALID_MID)
             {
                 GLTH_LOGE(TAG,
                           "Unable to release observed path %s, cannot send CoAP PDU",
-                          request_msg.path);
+                          request_msg->path);
                 request_is_valid = false;
             }
             break;
         default:
-            GLTH_LOGW(TAG, "Unknown request_msg type: %u", request_msg.type);
+            GLTH_LOGW(TAG, "Unknown request_msg type: %u", request_msg->type);
             request_is_valid = false;
             break;
     }
 
     if (!request_is_valid)
     {
-        return GOLIOTH_OK;
+        golioth_coap_request_msg_free_merged_callbacks(request_msg);
+        complete_request(request_msg);
+        golioth_coap_request_msg_free(request_msg);
+        return;
     }
 
     // If we get here, then a confirmable request has been sent to the server,
-    // and we should wait for a response.
-    client->pending_req = &request_msg;
-    request_msg.got_response = false;
-    int32_t time_spent_waiting_ms = 0;
-    int32_t timeout_ms = CONFIG_GOLIOTH_COAP_RESPONSE_TIMEOUT_S * 1000;
+    // and we should wait for a response. The in-flight window keeps the descriptor
+    // until then.
+    golioth_coap_request_msg_mark_sent(request_msg);
+    add_inflight_request(client, session, request_msg);
+}
 
-    if (request_msg.ageout_ms != GOLIOTH_SYS_WAIT_FOREVER)
+// Send the whole batch back-to-back, then service IO once for all of them
+static void handle_request_msgs(struct golioth_client *client,
+                                coap_session_t *session,
+                                struct golioth_coap_request_msg **request_msgs,
+                                size_t num_request_msgs)
+{
+    for (size_t i = 0; i < num_request_msgs; i++)
     {
-        int32_t time_till_ageout_ms = (int32_t) (request_msg.ageout_ms - golioth_sys_now_ms());
-        timeout_ms = min(timeout_ms, time_till_ageout_ms);
+        handle_request_msg(client, session, request_msgs[i]);
     }
+}
 
-    bool io_error = false;
-    while (time_spent_waiting_ms < timeout_ms)
+// Number of queued requests that may be sent now
+//
+// Until the server has answered, only one request is sent at a time. It
+// doubles as the connectivity probe, so an unreachable server costs a single
+// response timeout instead of one for every request in the queue.
+static size_t num_requests_to_send(struct golioth_client *client, size_t batch_size)
+{
+    if (client->conn_state != GOLIOTH_COAP_CONN_CONNECTED)
     {
-        int32_t remaining_ms = timeout_ms - time_spent_waiting_ms;
-        int32_t wait_ms = min(1000, remaining_ms);
-        int32_t num_ms = coap_io_process(context, wait_ms);
-        if (num_ms < 0)
-        {
-            io_error = true;
-            break;
-        }
-        else
-        {
-            time_spent_waiting_ms += num_ms;
-            if (request_msg.got_response)
-            {
-                GLTH_LOGD(TAG, "Received response in %" PRId32 " ms", time_spent_waiting_ms);
-                break;
-            }
-            else if (request_msg.got_nack)
-            {
-                GLTH_LOGE(TAG, "Got NACKed request");
-                break;
-            }
-            else
-            {
-                // During normal operation, there will be other kinds of IO to process,
-                // in which case we will get here.
-                // Since we haven't received the response yet, just keep waiting.
-            }
-        }
+        return (client->inflight.num_reqs == 0) ? 1 : 0;
     }
-    client->pending_req = NULL;
 
-    if (request_msg.request_complete_event)
+    return min(batch_size, golioth_coap_inflight_num_free(&client->inflight));
+}
+
+#if defined(CONFIG_GOLIOTH_LINUX_EPOLL)
+
+enum
+{
+    EPOLL_EVENT_COAP,
+    EPOLL_EVENT_REQUEST_QUEUE,
+    NUM_EPOLL_EVENTS,
+};
+
+static int epoll_add(int epoll_fd, int fd, uint32_t event_id)
+{
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.u32 = event_id,
+    };
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+// The CoAP thread sleeps in a single epoll_wait() on libcoap's own epoll fd
+// (socket and retransmission timer) and the request queue eventfd. golioth_sys
+// timers have a thread of their own.
+static enum golioth_status create_epoll_set(struct golioth_client *client,
+                                            coap_context_t *context)
+{
+    int coap_fd = coap_context_get_coap_fd(context);
+    if (coap_fd < 0)
     {
-        assert(request_msg.request_complete_ack_sem);
+        GLTH_LOGE(TAG, "libcoap was built without epoll support");
+        return GOLIOTH_ERR_NOT_IMPLEMENTED;
+    }
 
-        if (request_msg.got_response)
-        {
-            golioth_event_group_set_bits(request_msg.request_complete_event,
-                                         RESPONSE_RECEIVED_EVENT_BIT);
-        }
-        else
+    client->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (client->epoll_fd < 0)
+    {
+        GLTH_LOGE(TAG, "epoll_create1 errno: %d", errno);
+        return GOLIOTH_ERR_IO;
+    }
+    client->epoll_request_queue_armed = true;
+
+    int mbox_fd = golioth_sys_sem_get_fd(client->request_queue->fill_count_sem);
+    if (epoll_add(client->epoll_fd, coap_fd, EPOLL_EVENT_COAP) < 0
+        || epoll_add(client->epoll_fd, mbox_fd, EPOLL_EVENT_REQUEST_QUEUE) < 0)
+    {
+        GLTH_LOGE(TAG, "epoll_ctl errno: %d", errno);
+        close(client->epoll_fd);
+        client->epoll_fd = -1;
+        return GOLIOTH_ERR_IO;
+    }
+
+    return GOLIOTH_OK;
+}
+
+// Stop watching the request queue while the in-flight window is full, so
+// queued requests don't keep epoll_wait() from blocking
+static void epoll_watch_request_queue(struct golioth_client *client, bool watch)
+{
+    if (watch == client->epoll_request_queue_armed)
+    {
+        return;
+    }
+
+    struct epoll_event event = {
+        .events = watch ? EPOLLIN : 0,
+        .data.u32 = EPOLL_EVENT_REQUEST_QUEUE,
+    };
+    int mbox_fd = golioth_sys_sem_get_fd(client->request_queue->fill_count_sem);
+    if (epoll_ctl(client->epoll_fd, EPOLL_CTL_MOD, mbox_fd, &event) < 0)
+    {
+        GLTH_LOGW(TAG, "epoll_ctl errno: %d", errno);
+        return;
+    }
+
+    client->epoll_request_queue_armed = watch;
+}
+
+static enum golioth_status coap_io_loop_once(struct golioth_client *client,
+                                             coap_context_t *context,
+                                             coap_session_t *session)
+{
+    struct golioth_coap_request_msg *request_msgs[CONFIG_GOLIOTH_COAP_REQUEST_BATCH_SIZE];
+    size_t num_request_msgs = 0;
+    struct epoll_event events[NUM_EPOLL_EVENTS];
+    bool ready[NUM_EPOLL_EVENTS] = {0};
+    coap_tick_t now;
+
+    size_t max_request_msgs = num_requests_to_send(client, ARRAY_SIZE(request_msgs));
+    epoll_watch_request_queue(client, max_request_msgs > 0);
+
+    // Requests were sent outside of coap_io_process(), so let libcoap re-arm
+    // its retransmission timer before going to sleep
+    coap_ticks(&now);
+    coap_io_prepare_epoll(context, now);
+
+    // Everything except in-flight request deadlines wakes us up through an fd
+    int num_events = epoll_wait(client->epoll_fd,
+                                events,
+                                ARRAY_SIZE(events),
+                                next_inflight_deadline_ms(client));
+    if (num_events < 0)
+    {
+        if (errno == EINTR)
         {
-            golioth_event_group_set_bits(request_msg.request_complete_event,
-                                         RESPONSE_TIMEOUT_EVENT_BIT);
+            return GOLIOTH_OK;
         }
+        GLTH_LOGE(TAG, "epoll_wait errno: %d", errno);
+        return GOLIOTH_ERR_IO;
+    }
 
-        // Wait for user thread to receive the event.
-        golioth_sys_sem_take(request_msg.request_complete_ack_sem, GOLIOTH_SYS_WAIT_FOREVER);
-
-        // Now it's safe to delete the event and semaphore.
-        golioth_event_group_destroy(request_msg.request_complete_event);
-        golioth_sys_sem_destroy(request_msg.request_complete_ack_sem);
+    for (int i = 0; i < num_events; i++)
+    {
+        ready[events[i].data.u32] = true;
     }
 
-    if (io_error)
+    if (ready[EPOLL_EVENT_COAP] && coap_io_process(context, COAP_IO_NO_WAIT) < 0)
     {
         GLTH_LOGE(TAG, "Error in coap_io_process");
         return GOLIOTH_ERR_IO;
     }
 
-    if (request_msg.got_nack)
+    if (ready[EPOLL_EVENT_REQUEST_QUEUE])
     {
-        return GOLIOTH_ERR_NACK;
+        // May find nothing: with CONFIG_GOLIOTH_MBOX_LOCKLESS the fd can
+        // be left readable after the last request was already received.
+        num_request_msgs = golioth_coap_request_queue_recv(client->request_queue,
+                                                           request_msgs,
+                                                           max_request_msgs,
+                                                           0);
     }
 
-    if (time_spent_waiting_ms >= timeout_ms)
+    handle_request_msgs(client, session, request_msgs, num_request_msgs);
+
+    return process_inflight_requests(client, session);
+}
+
+#else /* CONFIG_GOLIOTH_LINUX_EPOLL */
+
+static enum golioth_status coap_io_loop_once(struct golioth_client *client,
+                                             coap_context_t *context,
+                                             coap_session_t *session)
+{
+    struct golioth_coap_request_msg *request_msgs[CONFIG_GOLIOTH_COAP_REQUEST_BATCH_SIZE];
+    size_t num_request_msgs = 0;
+    int32_t num_ms = 0;
+    int32_t deadline_ms = next_inflight_deadline_ms(client);
+
+    // Drain as many requests per wakeup as there are free in-flight slots
+    size_t max_request_msgs = num_requests_to_send(client, ARRAY_SIZE(request_msgs));
+
+    // Make sure we don't block forever, and never pass 0 (COAP_IO_WAIT) when
+    // a request deadline has already been reached.
+    uint32_t io_wait_ms = (deadline_ms < 0) ? COAP_IO_WAIT : (uint32_t) max(deadline_ms, 1);
+
+    if (max_request_msgs == 0)
     {
-        GLTH_LOGE(TAG, "Receive timeout");
+        // Window is full, so only process IO until a request completes or times out
+        num_ms = coap_io_process(context, io_wait_ms);
+    }
+    else
+    {
+        int mbox_fd = golioth_sys_sem_get_fd(client->request_queue->fill_count_sem);
 
-        if (coap_session_get_state(session) == COAP_SESSION_STATE_HANDSHAKE)
+        if (mbox_fd >= 0)
         {
-            // TODO - customize error message based on PSK vs cert usage
-            GLTH_LOGE(TAG, "DTLS handshake failed. Maybe your PSK-ID or PSK is incorrect?");
-        }
+            fd_set readfds;
 
-        // Call user's callback with GOLIOTH_ERR_TIMEOUT
-        // TODO - simplify, put callback directly in request which removes if/else branches
-        enum golioth_status status = GOLIOTH_ERR_TIMEOUT;
+            FD_ZERO(&readfds);
+            FD_SET(mbox_fd, &readfds);
 
-        if (request_msg.type == GOLIOTH_COAP_REQUEST_GET && request_msg.get.callback)
-        {
-            request_msg.get
-                .callback(client, status, NULL, request_msg.path, NULL, 0, request_msg.get.arg);
-        }
-        else if (request_msg.type == GOLIOTH_COAP_REQUEST_GET_BLOCK
-                 && request_msg.get_block.callback)
-        {
-            request_msg.get_block.callback(client,
-                                           status,
-                                           NULL,
-                                           request_msg.path,
-                                           NULL,
-                                           0,
-                                           false,
-                                           request_msg.get_block.arg);
-        }
-        else if (request_msg.type == GOLIOTH_COAP_REQUEST_POST && request_msg.post.callback_post)
-        {
-            if (request_msg.post.callback_is_post)
-            {
-                request_msg.post.callback_post(client,
-                                               status,
-                                               NULL,
-                                               request_msg.path,
-                                               NULL,
-                                               0,
-                                               request_msg.post.arg);
-            }
-            else
-            {
-                request_msg.post.callback_set(client,
-                                              status,
+            num_ms = coap_io_process_with_fds(context,
+                                              io_wait_ms,
+                                              mbox_fd + 1,
+                                              &readfds,
                                               NULL,
-                                              request_msg.path,
-                                              request_msg.post.arg);
+                                              NULL);
+
+            if (num_ms >= 0 && FD_ISSET(mbox_fd, &readfds))
+            {
+                // May find nothing: with CONFIG_GOLIOTH_MBOX_LOCKLESS the fd can
+                // be left readable after the last request was already received.
+                num_request_msgs = golioth_coap_request_queue_recv(client->request_queue,
+                                                                   request_msgs,
+                                                                   max_request_msgs,
+                                                                   0);
             }
         }
-        else if (request_msg.type == GOLIOTH_COAP_REQUEST_POST_BLOCK
-                 && request_msg.post_block.callback)
-        {
-            request_msg.post_block.callback(client,
-                                            status,
-                                            NULL,
-                                            request_msg.path,
-                                            request_msg.post_block.block_szx,
-                                            request_msg.post_block.arg);
-        }
-        else if (request_msg.type == GOLIOTH_COAP_REQUEST_DELETE && request_msg.delete.callback)
+        else if (client->inflight.num_reqs == 0)
         {
-            request_msg.delete.callback(client,
-                                        status,
-                                        NULL,
-                                        request_msg.path,
-                                        request_msg.delete.arg);
+            // Wait for request message, with timeout
+            num_request_msgs =
+                golioth_coap_request_queue_recv(client->request_queue,
+                                                request_msgs,
+                                                max_request_msgs,
+                                                CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_TIMEOUT_MS);
+            if (num_request_msgs == 0)
+            {
+                // No requests, so process other pending IO (e.g. observations)
+                GLTH_LOGV(TAG, "Idle io process start");
+                coap_io_process(context, COAP_IO_NO_WAIT);
+                GLTH_LOGV(TAG, "Idle io process end");
+                return GOLIOTH_OK;
+            }
         }
-
-        golioth_sys_client_disconnected(client);
-        if (client->event_callback && client->session_connected)
+        else
         {
-            client->event_callback(client,
-                                   GOLIOTH_CLIENT_EVENT_DISCONNECTED,
-                                   client->event_callback_arg);
+            // Requests are in flight, so alternate between servicing IO and
+            // checking for new requests to send.
+            num_request_msgs = golioth_coap_request_queue_recv(client->request_queue,
+                                                               request_msgs,
+                                                               max_request_msgs,
+                                                               0);
+            if (num_request_msgs == 0)
+            {
+                num_ms = coap_io_process(context,
+                                         min(io_wait_ms,
+                                             CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_TIMEOUT_MS));
+            }
         }
-        client->session_connected = false;
-        return GOLIOTH_ERR_TIMEOUT;
     }
 
-    if (!client->session_connected)
+    if (num_ms < 0)
     {
-        // Transitioned from not connected to connected
-        GLTH_LOGI(TAG, "Golioth CoAP client connected");
-        golioth_sys_client_connected(client);
-        if (client->event_callback)
-        {
-            client->event_callback(client,
-                                   GOLIOTH_CLIENT_EVENT_CONNECTED,
-                                   client->event_callback_arg);
-        }
+        GLTH_LOGE(TAG, "Error in coap_io_process");
+        return GOLIOTH_ERR_IO;
     }
 
-    client->session_connected = true;
-    return GOLIOTH_OK;
+    handle_request_msgs(client, session, request_msgs, num_request_msgs);
+
+    return process_inflight_requests(client, session);
 }
 
+#endif /* CONFIG_GOLIOTH_LINUX_EPOLL */
+
 static void on_keepalive(golioth_sys_timer_t timer, void *arg)
 {
     struct golioth_client *client = arg;
     if (client->is_running && golioth_client_num_items_in_request_queue(client) == 0
-        && !client->pending_req)
+        && client->inflight.num_reqs == 0)
     {
         golioth_coap_client_empty(client, false, GOLIOTH_SYS_WAIT_FOREVER);
     }
 }
 
+size_t golioth_coap_client_bert_block_size(struct golioth_client *client)
+{
+    return client->bert_block_size;
+}
+
 bool golioth_client_is_running(struct golioth_client *client)
 {
     if (!client)
@@ -1180,6 +1636,58 @@ bool golioth_client_is_running(struct golioth_client *client)
     return client->is_running;
 }
 
+// Fail everything still queued while the server is unreachable
+//
+// Observations are stored instead, to be established once a session comes up.
+static void fail_queued_requests(struct golioth_client *client)
+{
+    struct golioth_coap_request_msg *req = NULL;
+
+    while (golioth_coap_request_queue_recv(client->request_queue, &req, 1, 0) == 1)
+    {
+        if (req->type == GOLIOTH_COAP_REQUEST_OBSERVE)
+        {
+            if (golioth_coap_observations_add(&client->observations, req, NULL, NULL)
+                != GOLIOTH_OK)
+            {
+                GLTH_LOGE(TAG, "Unable to store observation of path %s", req->path);
+            }
+        }
+        else if (req->type != GOLIOTH_COAP_REQUEST_OBSERVE_RELEASE)
+        {
+            golioth_coap_request_msg_release_payload(req);
+            call_request_callback_with_error(client, req, GOLIOTH_ERR_OFFLINE);
+
+            if (req->completion)
+            {
+                golioth_coap_completion_signal(req->completion, GOLIOTH_ERR_OFFLINE);
+            }
+        }
+
+        golioth_coap_request_msg_free(req);
+    }
+}
+
+// Wait before the next connection attempt, returns early if the client is stopped
+static void reconnect_delay(struct golioth_client *client, uint32_t delay_ms)
+{
+    GLTH_LOGI(TAG, "Reconnecting in %" PRIu32 " ms", delay_ms);
+
+    while (delay_ms > 0)
+    {
+        uint32_t slice_ms = min(delay_ms, 100);
+
+        golioth_sys_msleep(slice_ms);
+        delay_ms -= slice_ms;
+
+        if (!golioth_sys_sem_take(client->run_sem, 0))
+        {
+            return;
+        }
+        golioth_sys_sem_give(client->run_sem);
+    }
+}
+
 // Note: libcoap is not thread safe, so all rx/tx I/O for the session must be
 // done in this thread.
 static void golioth_coap_client_thread(void *arg)
@@ -1193,7 +1701,11 @@ static void golioth_coap_client_thread(void *arg)
         coap_session_t *coap_session = NULL;
 
         client->end_session = false;
-        client->session_connected = false;
+        client->conn_state = GOLIOTH_COAP_CONN_IDLE;
+        client->bert_block_size = 0;
+#if defined(CONFIG_GOLIOTH_LINUX_EPOLL)
+        client->epoll_fd = -1;
+#endif
 
         client->is_running = false;
         GLTH_LOGD(TAG, "Waiting for the \"run\" signal");
@@ -1201,17 +1713,30 @@ static void golioth_coap_client_thread(void *arg)
         golioth_sys_sem_give(client->run_sem);
         GLTH_LOGD(TAG, "Received \"run\" signal");
         client->is_running = true;
+        client->conn_state = GOLIOTH_COAP_CONN_CONNECTING;
 
         if (create_context(client, &coap_context) != GOLIOTH_OK)
         {
             goto cleanup;
         }
 
-        if (create_session(client, coap_context, &coap_session) != GOLIOTH_OK)
+        enum golioth_status session_status = create_session(client, coap_context, &coap_session);
+        if (session_status != GOLIOTH_OK)
         {
+            if (session_status == GOLIOTH_ERR_DNS_LOOKUP)
+            {
+                client->conn_state = GOLIOTH_COAP_CONN_OFFLINE;
+            }
             goto cleanup;
         }
 
+#if defined(CONFIG_GOLIOTH_LINUX_EPOLL)
+        if (create_epoll_set(client, coap_context) != GOLIOTH_OK)
+        {
+            goto cleanup;
+        }
+#endif
+
         // Seed the session token generator
         //
         // We should still do this even though Golioth generates CoAP tokens outside of libcoap.
@@ -1269,14 +1794,34 @@ static void golioth_coap_client_thread(void *arg)
     cleanup:
         GLTH_LOGI(TAG, "Ending session");
 
+        cancel_inflight_requests(client);
+
         golioth_sys_client_disconnected(client);
-        if (client->event_callback && client->session_connected)
+        if (client->event_callback && client->conn_state == GOLIOTH_COAP_CONN_CONNECTED)
         {
             client->event_callback(client,
                                    GOLIOTH_CLIENT_EVENT_DISCONNECTED,
                                    client->event_callback_arg);
         }
-        client->session_connected = false;
+
+        bool offline = (client->conn_state == GOLIOTH_COAP_CONN_OFFLINE);
+#if !defined(CONFIG_GOLIOTH_COAP_OFFLINE_HOLD_REQUESTS)
+        if (offline)
+        {
+            fail_queued_requests(client);
+        }
+#endif
+        if (!offline)
+        {
+            client->conn_state = GOLIOTH_COAP_CONN_CONNECTING;
+        }
+
+#if defined(CONFIG_GOLIOTH_LINUX_EPOLL)
+        if (client->epoll_fd >= 0)
+        {
+            close(client->epoll_fd);
+        }
+#endif
 
         if (coap_session)
         {
@@ -1287,8 +1832,15 @@ static void golioth_coap_client_thread(void *arg)
             coap_free_context(coap_context);
         }
 
-        // Small delay before starting a new session
-        golioth_sys_msleep(1000);
+        // Back off further with every attempt that can't reach the server,
+        // start over with a short delay after a session that was up
+        if (!offline)
+        {
+            golioth_coap_reconnect_backoff_reset(&client->reconnect_backoff);
+        }
+        reconnect_delay(client,
+                        golioth_coap_reconnect_backoff_next(&client->reconnect_backoff,
+                                                            golioth_sys_rand()));
     }
 }
 
@@ -1326,10 +1878,25 @@ struct golioth_client *golioth_client_create(const struct golioth_client_config
     }
     golioth_sys_sem_give(new_client->run_sem);
 
-    golioth_coap_token_mutex_create();
+    if (golioth_coap_observations_init(&new_client->observations) != GOLIOTH_OK)
+    {
+        GLTH_LOGE(TAG, "Failed to create observation table");
+        goto error;
+    }
+
+    if (golioth_dns_cache_init(&new_client->dns_cache) != GOLIOTH_OK)
+    {
+        GLTH_LOGE(TAG, "Failed to create DNS cache");
+        goto error;
+    }
+
+    golioth_coap_token_init();
+    golioth_coap_completion_mutex_create();
+    golioth_coap_coalesce_mutex_create();
+    golioth_coap_request_msg_slab_init();
+    golioth_payload_pool_init();
 
-    new_client->request_queue = golioth_mbox_create(CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS,
-                                                    sizeof(struct golioth_coap_request_msg));
+    new_client->request_queue = golioth_coap_request_queue_create();
     if (!new_client->request_queue)
     {
         GLTH_LOGE(TAG, "Failed to create request queue");
@@ -1386,26 +1953,25 @@ error:
 
 static void purge_request_mbox(golioth_mbox_t request_mbox)
 {
-    struct golioth_coap_request_msg request_msg = {};
+    struct golioth_coap_request_msg *request_msg = NULL;
     size_t num_messages = golioth_mbox_num_messages(request_mbox);
 
     for (size_t i = 0; i < num_messages; i++)
     {
-        bool ok = golioth_mbox_recv(request_mbox, &request_msg, 0);
+        size_t num_received = golioth_coap_request_queue_recv(request_mbox, &request_msg, 1, 0);
 
-        assert(ok);
-        (void) ok;
+        assert(num_received == 1);
+        (void) num_received;
 
-        if (request_msg.type == GOLIOTH_COAP_REQUEST_POST)
-        {
-            // free dynamically allocated user payload copy
-            golioth_sys_free(request_msg.post.payload);
-        }
-        else if (request_msg.type == GOLIOTH_COAP_REQUEST_POST_BLOCK)
+        golioth_coap_request_msg_release_payload(request_msg);
+        golioth_coap_request_msg_free_merged_callbacks(request_msg);
+
+        if (request_msg->completion)
         {
-            // free dynamically allocated user payload copy
-            golioth_sys_free(request_msg.post_block.payload);
+            golioth_coap_completion_signal(request_msg->completion, GOLIOTH_ERR_FAIL);
         }
+
+        golioth_coap_request_msg_free(request_msg);
     }
 }
 
@@ -1436,6 +2002,8 @@ void golioth_client_destroy(struct golioth_client *client)
     {
         golioth_sys_sem_destroy(client->run_sem);
     }
+    golioth_coap_observations_deinit(&client->observations);
+    golioth_dns_cache_deinit(&client->dns_cache);
     golioth_sys_free(client);
 }
 
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "coap_client.h"
+#include "coap_observations.h"
+#include "coap_reconnect.h"
+#include "coap_inflight.h"
+#include "dns_cache.h"
 #include "mbox.h"
 
 struct golioth_client
@@ -11,14 +15,34 @@ struct golioth_client
     golioth_sys_timer_t keepalive_timer;
     bool is_running;
     bool end_session;
-    bool session_connected;
+    /// Written by the coap thread, also read by application threads when they enqueue requests
+    _Atomic enum golioth_coap_conn_state conn_state;
+    struct golioth_coap_reconnect_backoff reconnect_backoff;
     struct golioth_client_config config;
-    struct golioth_coap_request_msg *pending_req;
-    struct golioth_coap_observe_info observations[CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS];
+    /// Confirmable requests sent to the server and still waiting for a response
+    struct golioth_coap_inflight inflight;
+    struct golioth_coap_observations observations;
+    struct golioth_dns_cache dns_cache;
+    /// Server address of the current session
+    struct golioth_dns_cache_addr session_addr;
+    /// Size of the BERT blocks usable on the current session, 0 if BERT can't be used
+    size_t bert_block_size;
     golioth_client_event_cb_fn event_callback;
     void *event_callback_arg;
+#if defined(CONFIG_GOLIOTH_LINUX_EPOLL)
+    /// epoll set the CoAP thread waits on, for the lifetime of a session
+    int epoll_fd;
+    bool epoll_request_queue_armed;
+#endif
 };
 
 void golioth_cancel_all_observations_by_prefix(struct golioth_client *client, const char *prefix);
 
 void golioth_cancel_all_observations(struct golioth_client *client);
+
+enum golioth_status golioth_cancel_observation(struct golioth_client *client,
+                                               const char *path_prefix,
+                                               const char *path,
+                                               enum golioth_content_type content_type,
+                                               golioth_get_cb_fn callback,
+                                               void *arg);
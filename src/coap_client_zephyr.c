@@ -4,11 +4,13 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include <assert.h>
+#include <stdlib.h>
 #include <golioth/golioth_debug.h>
 #include <golioth/golioth_sys.h>
 #include "coap_client.h"
 #include "golioth_util.h"
 #include "mbox.h"
+#include "payload_pool.h"
 
 #include "coap_client_zephyr.h"
 #include "pathv.h"
@@ -280,6 +282,10 @@ static int golioth_coap_cb(struct golioth_req_rsp *rsp)
                                            req->post.arg);
                 }
             }
+            golioth_coap_request_msg_call_merged_callbacks(client,
+                                                           req,
+                                                           rsp->status,
+                                                           golioth_ptr_to_rsp_code(rsp));
             break;
         case GOLIOTH_COAP_REQUEST_POST_BLOCK:
             if (req->post_block.callback)
@@ -303,16 +309,15 @@ static int golioth_coap_cb(struct golioth_req_rsp *rsp)
             }
             break;
         case GOLIOTH_COAP_REQUEST_OBSERVE:
-            if (req->observe.callback)
-            {
-                req->observe.callback(client,
-                                      rsp->status,
-                                      golioth_ptr_to_rsp_code(rsp),
-                                      req->path,
-                                      rsp->data,
-                                      rsp->len,
-                                      req->observe.arg);
-            }
+            /* Fan out to all local subscribers of the observation */
+            golioth_coap_observations_notify(&client->observations,
+                                             client,
+                                             req->token,
+                                             sizeof(req->token),
+                                             rsp->status,
+                                             golioth_ptr_to_rsp_code(rsp),
+                                             rsp->data,
+                                             rsp->len);
             break;
     }
 
@@ -325,10 +330,8 @@ static int golioth_coap_cb(struct golioth_req_rsp *rsp)
     }
 
     /* Handle synchronous calls */
-    if (req->request_complete_event)
+    if (req->completion)
     {
-        *req->status = rsp->status;
-
         if (rsp->status == GOLIOTH_ERR_COAP_RESPONSE)
         {
             /* Log the CoAP code as synchronous operations don't have access to it */
@@ -338,25 +341,33 @@ static int golioth_coap_cb(struct golioth_req_rsp *rsp)
                       rsp->coap_rsp_code.code_detail);
         }
 
-        golioth_event_group_set_bits(req->request_complete_event, RESPONSE_RECEIVED_EVENT_BIT);
-
-        // Wait for user thread to receive the event.
-        golioth_sys_sem_take(req->request_complete_ack_sem, GOLIOTH_SYS_WAIT_FOREVER);
-
-        // Now it's safe to delete the event and semaphore.
-        golioth_event_group_destroy(req->request_complete_event);
-        golioth_sys_sem_destroy(req->request_complete_ack_sem);
+        golioth_coap_completion_signal(req->completion, rsp->status);
     }
 
     if (req->type != GOLIOTH_COAP_REQUEST_OBSERVE)
     {
         /* don't free observations so we can reestablish later */
-        free(req);
+        golioth_coap_request_msg_free(req);
     }
 
     return rsp->status;
 }
 
+static int golioth_coap_get(struct golioth_coap_request_msg *req)
+{
+    return golioth_coap_req_cb(req->client,
+                               req->token,
+                               COAP_METHOD_GET,
+                               PATHV(req->path_prefix, req->path),
+                               golioth_content_type_to_coap_format(req->get.content_type),
+                               NULL,
+                               0,
+                               golioth_coap_cb,
+                               req,
+                               0,
+                               &req->policy);
+}
+
 static int golioth_coap_get_block(struct golioth_coap_request_msg *req)
 {
     const uint8_t **pathv = PATHV(req->path_prefix, req->path);
@@ -404,6 +415,8 @@ static int golioth_coap_get_block(struct golioth_coap_request_msg *req)
         goto free_req;
     }
 
+    coap_req->policy = req->policy;
+
     err = golioth_coap_req_schedule(coap_req);
     if (err)
     {
@@ -482,6 +495,8 @@ static int golioth_coap_post_block(struct golioth_coap_request_msg *req)
         goto free_req;
     }
 
+    coap_req->policy = req->policy;
+
     err = golioth_coap_req_schedule(coap_req);
     if (err)
     {
@@ -508,7 +523,8 @@ static int golioth_coap_observe(struct golioth_coap_request_msg *req, struct gol
                                   0,
                                   golioth_coap_cb,
                                   req,
-                                  GOLIOTH_COAP_REQ_OBSERVE);
+                                  GOLIOTH_COAP_REQ_OBSERVE,
+                                  NULL);
     if (err)
     {
         LOG_ERR("Failed to schedule CoAP OBSERVE: %d", err);
@@ -520,61 +536,89 @@ static int golioth_coap_observe(struct golioth_coap_request_msg *req, struct gol
 
 static int add_observation(struct golioth_coap_request_msg *req, struct golioth_client *client)
 {
-    // scan for available (not used) observation slot
+    /* Store request message in Golioth client */
     struct golioth_coap_observe_info *obs_info = NULL;
-    bool found_slot = false;
-    for (int i = 0; i < CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS; i++)
+    bool is_new = false;
+    enum golioth_status status =
+        golioth_coap_observations_add(&client->observations, req, &obs_info, &is_new);
+    if (status == GOLIOTH_ERR_QUEUE_FULL)
     {
-        obs_info = &client->observations[i];
-        if (!obs_info->in_use)
-        {
-            found_slot = true;
-            break;
-        }
+        GLTH_LOGE(TAG, "Unable to observe path %s, no slots available", req->path);
+        return status;
     }
-
-    if (!found_slot)
+    if (status != GOLIOTH_OK)
     {
-        GLTH_LOGE(TAG, "Unable to observe path %s, no slots available", req->path);
-        return GOLIOTH_ERR_QUEUE_FULL;
+        LOG_ERR("Unable to store observation of path %s: %d", req->path, status);
+        return -ENOMEM;
     }
 
-    /* Store request message in Golioth client */
-    memcpy(&obs_info->req, req, sizeof(obs_info->req));
+    if (!is_new)
+    {
+        /*
+         * Already observed, so only fetch the current value for the new subscriber. The request
+         * is sent as a GET right away, and owned by it from here on.
+         */
+        LOG_DBG("Sharing observation of path %s", req->path);
+        struct golioth_coap_get_params get = {
+            .content_type = req->observe.content_type,
+            .callback = req->observe.callback,
+            .arg = req->observe.arg,
+        };
+        req->type = GOLIOTH_COAP_REQUEST_GET;
+        req->get = get;
+
+        int err = golioth_coap_get(req);
+        if (err)
+        {
+            LOG_ERR("Failed to get current value of %s: %d", req->path, err);
+            if (req->get.callback)
+            {
+                req->get.callback(client,
+                                  golioth_err_to_status(err),
+                                  NULL,
+                                  req->path,
+                                  NULL,
+                                  0,
+                                  req->get.arg);
+            }
+        }
+        return err;
+    }
 
-    /* Use observation slot in client as the request message */
+    /* Use the table entry as the request message, its address is stable */
     int err = golioth_coap_observe(&obs_info->req, client);
 
     if (err)
     {
+        golioth_coap_observations_remove(&client->observations, obs_info);
         return err;
     }
 
-    /* Successfully established observation */
-    obs_info->in_use = true;
-
     return 0;
 }
 
-void golioth_cancel_all_observations_by_prefix(struct golioth_client *client, const char *prefix)
+static void release_observation(struct golioth_client *client,
+                                struct golioth_coap_observe_info *obs_info)
 {
-    for (int i = 0; i < CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS; i++)
+    /* Removes the coap_req referring to obs_info, so it can be freed afterwards */
+    int err = golioth_coap_req_find_and_cancel_observation(client, &obs_info->req);
+    if (err)
     {
-        struct golioth_coap_observe_info *obs_info = &client->observations[i];
-        if (obs_info->in_use)
-        {
-            if ((prefix != NULL) && (strcmp(prefix, obs_info->req.path_prefix) != 0))
-            {
-                continue;
-            }
+        LOG_WRN("Error sending eager release for observation: %d", err);
+    }
+    golioth_coap_observations_free(obs_info);
+}
 
-            int err = golioth_coap_req_find_and_cancel_observation(client, &obs_info->req);
-            if (err)
-            {
-                LOG_WRN("Error sending eager release for observation: %d", err);
-            }
-            obs_info->in_use = false;
-        }
+void golioth_cancel_all_observations_by_prefix(struct golioth_client *client, const char *prefix)
+{
+    struct golioth_coap_observe_info *obs_info =
+        golioth_coap_observations_take_by_prefix(&client->observations, prefix);
+
+    while (obs_info)
+    {
+        struct golioth_coap_observe_info *next = obs_info->prefix_next;
+        release_observation(client, obs_info);
+        obs_info = next;
     }
 }
 
@@ -583,6 +627,31 @@ void golioth_cancel_all_observations(struct golioth_client *client)
     golioth_cancel_all_observations_by_prefix(client, NULL);
 }
 
+enum golioth_status golioth_cancel_observation(struct golioth_client *client,
+                                               const char *path_prefix,
+                                               const char *path,
+                                               enum golioth_content_type content_type,
+                                               golioth_get_cb_fn callback,
+                                               void *arg)
+{
+    struct golioth_coap_observe_info *released = NULL;
+    enum golioth_status status = golioth_coap_observations_unsubscribe(&client->observations,
+                                                                       path_prefix,
+                                                                       path,
+                                                                       content_type,
+                                                                       callback,
+                                                                       arg,
+                                                                       &released);
+
+    /* Release the observation on the server along with its last subscriber */
+    if (released)
+    {
+        release_observation(client, released);
+    }
+
+    return status;
+}
+
 static int golioth_deregister_observation(struct golioth_coap_request_msg *req,
                                           struct golioth_client *client)
 {
@@ -639,40 +708,23 @@ static int golioth_deregister_observation(struct golioth_coap_request_msg *req,
     return err;
 }
 
+static void reestablish_observation(struct golioth_coap_observe_info *obs_info, void *arg)
+{
+    struct golioth_client *client = arg;
+
+    golioth_coap_observe(&obs_info->req, client);
+}
+
 static void reestablish_observations(struct golioth_client *client)
 {
-    struct golioth_coap_observe_info *obs_info = NULL;
-    for (int i = 0; i < CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS; i++)
-    {
-        obs_info = &client->observations[i];
-        if (obs_info->in_use)
-        {
-            golioth_coap_observe(&obs_info->req, client);
-        }
-    }
+    golioth_coap_observations_foreach(&client->observations, reestablish_observation, client);
 }
 
-static enum golioth_status coap_io_loop_once(struct golioth_client *client)
+static enum golioth_status handle_request_msg(struct golioth_client *client,
+                                              struct golioth_coap_request_msg *req)
 {
-    struct golioth_coap_request_msg *req;
     int err = 0;
 
-    req = calloc(1, sizeof(*req));
-    if (!req)
-    {
-        err = -ENOMEM;
-        goto free_req;
-    }
-
-    // Wait for request message, with timeout
-    bool got_request_msg =
-        golioth_mbox_recv(client->request_queue, req, CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_TIMEOUT_MS);
-    if (!got_request_msg)
-    {
-        // No requests, so process other pending IO (e.g. observations)
-        goto free_req;
-    }
-
     // Make sure the request isn't too old
     if (golioth_sys_now_ms() > req->ageout_ms)
     {
@@ -680,20 +732,11 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client)
                 req->type,
                 (req->path ? req->path : "N/A"));
 
-        if (req->type == GOLIOTH_COAP_REQUEST_POST && req->post.payload_size > 0)
-        {
-            golioth_sys_free(req->post.payload);
-        }
+        golioth_coap_request_msg_release_payload(req);
 
-        if (req->type == GOLIOTH_COAP_REQUEST_POST_BLOCK && req->post_block.payload_size > 0)
+        if (req->completion)
         {
-            golioth_sys_free(req->post_block.payload);
-        }
-
-        if (req->request_complete_event)
-        {
-            golioth_event_group_destroy(req->request_complete_event);
-            golioth_sys_sem_destroy(req->request_complete_ack_sem);
+            golioth_coap_completion_signal(req->completion, GOLIOTH_ERR_TIMEOUT);
         }
 
         goto free_req;
@@ -710,16 +753,7 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client)
             goto free_req;
         case GOLIOTH_COAP_REQUEST_GET:
             LOG_DBG("Handle GET %s", req->path);
-            err = golioth_coap_req_cb(req->client,
-                                      req->token,
-                                      COAP_METHOD_GET,
-                                      PATHV(req->path_prefix, req->path),
-                                      golioth_content_type_to_coap_format(req->get.content_type),
-                                      NULL,
-                                      0,
-                                      golioth_coap_cb,
-                                      req,
-                                      0);
+            err = golioth_coap_get(req);
             break;
         case GOLIOTH_COAP_REQUEST_GET_BLOCK:
             LOG_DBG("Handle GET_BLOCK %s", req->path);
@@ -736,13 +770,14 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client)
                                       req->post.payload_size,
                                       golioth_coap_cb,
                                       req,
-                                      0);
-            golioth_sys_free(req->post.payload);
+                                      0,
+                                      &req->policy);
+            golioth_coap_request_msg_release_payload(req);
             break;
         case GOLIOTH_COAP_REQUEST_POST_BLOCK:
             LOG_DBG("Handle POST_BLOCK %s", req->path);
             err = golioth_coap_post_block(req);
-            golioth_sys_free(req->post_block.payload);
+            golioth_coap_request_msg_release_payload(req);
             break;
         case GOLIOTH_COAP_REQUEST_DELETE:
             LOG_DBG("Handle DELETE %s", req->path);
@@ -755,7 +790,8 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client)
                                       0,
                                       golioth_coap_cb,
                                       req,
-                                      0);
+                                      0,
+                                      &req->policy);
             break;
         case GOLIOTH_COAP_REQUEST_OBSERVE:
             LOG_DBG("Handle OBSERVE %s", req->path);
@@ -766,7 +802,12 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client)
                 err = GOLIOTH_OK;
                 goto free_req;
             }
-            /* Need to free local req message; observations use client slots for req messages */
+            if (!err && req->type == GOLIOTH_COAP_REQUEST_GET)
+            {
+                /* Shared observation, req was sent as a GET of the current value */
+                break;
+            }
+            /* Need to free local req message; observations keep their own copy in the table */
             goto free_req;
             break;
         case GOLIOTH_COAP_REQUEST_OBSERVE_RELEASE:
@@ -784,14 +825,50 @@ static enum golioth_status coap_io_loop_once(struct golioth_client *client)
         goto free_req;
     }
 
+    golioth_coap_request_msg_mark_sent(req);
+
     return GOLIOTH_OK;
 
 free_req:
-    free(req);
+    if (err && req->completion)
+    {
+        /* Request was not sent, so there won't be a response to wait for */
+        golioth_coap_completion_signal(req->completion, golioth_err_to_status(err));
+    }
+
+    golioth_coap_request_msg_free_merged_callbacks(req);
+    golioth_coap_request_msg_free(req);
 
     return golioth_err_to_status(err);
 }
 
+static enum golioth_status coap_io_loop_once(struct golioth_client *client)
+{
+    struct golioth_coap_request_msg *reqs[CONFIG_GOLIOTH_COAP_REQUEST_BATCH_SIZE];
+    enum golioth_status status = GOLIOTH_OK;
+
+    // Wait for request messages, with timeout. The request descriptors are
+    // allocated by the producer and owned by us from here on.
+    size_t num_reqs = golioth_coap_request_queue_recv(client->request_queue,
+                                                      reqs,
+                                                      ARRAY_SIZE(reqs),
+                                                      CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_TIMEOUT_MS);
+
+    // Send the whole batch back-to-back before going back to poll(). Every
+    // request has to be handled (or failed) since it's no longer in the queue,
+    // so keep going after an error and report the first one.
+    for (size_t i = 0; i < num_reqs; i++)
+    {
+        enum golioth_status req_status = handle_request_msg(client, reqs[i]);
+        if (status == GOLIOTH_OK)
+        {
+            status = req_status;
+        }
+    }
+
+    return status;
+}
+
 static void on_keepalive(golioth_sys_timer_t timer, void *arg)
 {
     struct golioth_client *client = arg;
@@ -806,6 +883,12 @@ static void on_keepalive(golioth_sys_timer_t timer, void *arg)
     }
 }
 
+size_t golioth_coap_client_bert_block_size(struct golioth_client *client)
+{
+    /* Only CoAP over DTLS is supported */
+    return 0;
+}
+
 bool golioth_client_is_running(struct golioth_client *client)
 {
     if (!client)
@@ -970,39 +1053,151 @@ close_sock:
 #define LOG_SOCKADDR(fmt, addr)
 #endif
 
-static int golioth_connect_host_port(struct golioth_client *client,
-                                     const char *host,
-                                     const char *port)
+/* Resolve host, with the TTL of the records when the resolver reports it */
+static int golioth_dns_lookup(const char *host,
+                              struct golioth_dns_cache_addr *addrs,
+                              size_t *num_addrs,
+                              uint32_t *ttl_s)
 {
     struct zsock_addrinfo hints = {
         .ai_family = AF_UNSPEC,
         .ai_socktype = SOCK_DGRAM,
         .ai_protocol = IPPROTO_UDP,
     };
-    struct zsock_addrinfo *addrs, *addr;
+    struct zsock_addrinfo *res, *ai;
+    size_t max_addrs = *num_addrs;
     int ret;
-    int err = -ENOENT;
 
-    ret = zsock_getaddrinfo(host, port, &hints, &addrs);
+    *num_addrs = 0;
+
+    if (IS_ENABLED(CONFIG_NET_L2_OPENTHREAD))
+    {
+        uint8_t ipv6_addrs[CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS][16];
+        size_t num_ipv6_addrs = MIN(max_addrs, ARRAY_SIZE(ipv6_addrs));
+
+        ret = golioth_ot_synthesize_ipv6_addresses(host, ipv6_addrs, &num_ipv6_addrs, ttl_s);
+        if (ret)
+        {
+            LOG_ERR("Failed to synthesize Golioth Server IPv6 address: %d", ret);
+            return ret;
+        }
+
+        for (size_t i = 0; i < num_ipv6_addrs; i++)
+        {
+            addrs[i].family = GOLIOTH_DNS_CACHE_IPV6;
+            memcpy(addrs[i].addr, ipv6_addrs[i], sizeof(addrs[i].addr));
+        }
+        *num_addrs = num_ipv6_addrs;
+
+        return 0;
+    }
+
+    ret = zsock_getaddrinfo(host, NULL, &hints, &res);
     if (ret < 0)
     {
-        LOG_ERR("Fail to get address (%s %s) %d", host, port, ret);
+        LOG_ERR("Fail to get address (%s) %d", host, ret);
         return -EAGAIN;
     }
 
-    for (addr = addrs; addr != NULL; addr = addr->ai_next)
+    for (ai = res; ai != NULL && *num_addrs < max_addrs; ai = ai->ai_next)
+    {
+        struct golioth_dns_cache_addr *addr = &addrs[*num_addrs];
+
+        if (ai->ai_family == AF_INET)
+        {
+            addr->family = GOLIOTH_DNS_CACHE_IPV4;
+            memcpy(addr->addr, &net_sin(ai->ai_addr)->sin_addr, sizeof(struct in_addr));
+        }
+        else if (ai->ai_family == AF_INET6)
+        {
+            addr->family = GOLIOTH_DNS_CACHE_IPV6;
+            memcpy(addr->addr, &net_sin6(ai->ai_addr)->sin6_addr, sizeof(struct in6_addr));
+        }
+        else
+        {
+            continue;
+        }
+        (*num_addrs)++;
+    }
+
+    zsock_freeaddrinfo(res);
+
+    /* getaddrinfo() does not report the TTL of the records */
+    *ttl_s = CONFIG_GOLIOTH_DNS_CACHE_TTL_S;
+
+    return (*num_addrs > 0) ? 0 : -ENOENT;
+}
+
+static int golioth_connect_host_port(struct golioth_client *client,
+                                     const char *host,
+                                     const char *port)
+{
+    struct golioth_dns_cache_addr addrs[CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS];
+    size_t num_addrs;
+    uint16_t port_num = strtoul(port, NULL, 10);
+    int err = -ENOENT;
+
+    num_addrs = golioth_dns_cache_lookup(&client->dns_cache, false, addrs, ARRAY_SIZE(addrs));
+    if (num_addrs == 0)
+    {
+        size_t num_resolved = ARRAY_SIZE(addrs);
+        uint32_t ttl_s;
+
+        err = golioth_dns_lookup(host, addrs, &num_resolved, &ttl_s);
+        if (!err)
+        {
+            golioth_dns_cache_store(&client->dns_cache, addrs, num_resolved, ttl_s);
+        }
+
+        /* Either the addresses just stored, or stale ones if the lookup failed */
+        num_addrs = golioth_dns_cache_lookup(&client->dns_cache, true, addrs, ARRAY_SIZE(addrs));
+        if (num_addrs == 0)
+        {
+            return err;
+        }
+        if (err)
+        {
+            LOG_WRN("Using cached addresses of %s", host);
+        }
+    }
+
+    /*
+     * Addresses are ordered by the cache: the one that worked last time first, then
+     * alternating between IPv6 and IPv4, so an unreachable family costs a single attempt.
+     */
+    for (size_t i = 0; i < num_addrs; i++)
     {
-        LOG_SOCKADDR("Trying addr '%s'", addr->ai_addr);
+        struct sockaddr sa = {0};
+        struct sockaddr *addr = &sa;
+        socklen_t addrlen;
+
+        if (addrs[i].family == GOLIOTH_DNS_CACHE_IPV4)
+        {
+            net_sin(addr)->sin_family = AF_INET;
+            net_sin(addr)->sin_port = htons(port_num);
+            memcpy(&net_sin(addr)->sin_addr, addrs[i].addr, sizeof(struct in_addr));
+            addrlen = sizeof(struct sockaddr_in);
+        }
+        else
+        {
+            net_sin6(addr)->sin6_family = AF_INET6;
+            net_sin6(addr)->sin6_port = htons(port_num);
+            memcpy(&net_sin6(addr)->sin6_addr, addrs[i].addr, sizeof(struct in6_addr));
+            addrlen = sizeof(struct sockaddr_in6);
+        }
 
-        err = golioth_connect_sockaddr(client, host, addr->ai_addr, addr->ai_addrlen);
+        LOG_SOCKADDR("Trying addr '%s'", addr);
+
+        err = golioth_connect_sockaddr(client, host, addr, addrlen);
         if (!err)
         {
             /* Ready to go */
+            golioth_dns_cache_mark_good(&client->dns_cache, &addrs[i]);
             break;
         }
-    }
 
-    zsock_freeaddrinfo(addrs);
+        golioth_dns_cache_mark_bad(&client->dns_cache, &addrs[i]);
+    }
 
     return err;
 }
@@ -1011,7 +1206,6 @@ static int golioth_connect(struct golioth_client *client)
 {
     char uri[] = CONFIG_GOLIOTH_COAP_HOST_URI;
     char *host = &uri[sizeof("coaps://") - 1];
-    char ipv6_addr[40];
     const char *port = "5684";
     char *colon;
     int err;
@@ -1033,18 +1227,6 @@ static int golioth_connect(struct golioth_client *client)
         port = colon + 1;
     }
 
-    if (IS_ENABLED(CONFIG_NET_L2_OPENTHREAD))
-    {
-        err = golioth_ot_synthesize_ipv6_address(host, ipv6_addr);
-        if (err)
-        {
-            LOG_ERR("Failed to synthesize Golioth Server IPv6 address: %d", err);
-            return err;
-        }
-
-        host = ipv6_addr;
-    }
-
     err = golioth_connect_host_port(client, host, port);
     if (err)
     {
@@ -1210,6 +1392,20 @@ static int golioth_process_rx(struct golioth_client *client)
     return golioth_process_rx_data(client, client->rx_buffer, ret);
 }
 
+// Wait before the next connection attempt, returns early if the client is stopped
+static void reconnect_delay(struct golioth_client *client, uint32_t delay_ms)
+{
+    LOG_INF("Reconnecting in %u ms", (unsigned int) delay_ms);
+
+    while (delay_ms > 0 && !atomic_test_bit(client_flags, CLIENT_FLAG_STOP))
+    {
+        uint32_t slice_ms = MIN(delay_ms, 100);
+
+        golioth_sys_msleep(slice_ms);
+        delay_ms -= slice_ms;
+    }
+}
+
 static void golioth_coap_client_thread(void *arg)
 {
     struct golioth_client *client = arg;
@@ -1226,7 +1422,7 @@ static void golioth_coap_client_thread(void *arg)
 
     while (1)
     {
-        client->session_connected = false;
+        client->conn_state = GOLIOTH_COAP_CONN_IDLE;
 
         client->is_running = false;
         LOG_DBG("Waiting for the \"run\" signal");
@@ -1234,6 +1430,7 @@ static void golioth_coap_client_thread(void *arg)
         client->run_event.state = K_POLL_STATE_NOT_READY;
         LOG_DBG("Received \"run\" signal");
         client->is_running = true;
+        client->conn_state = GOLIOTH_COAP_CONN_CONNECTING;
 
         /* Flush pending events */
         (void) eventfd_read(fds[POLLFD_EVENT].fd, &eventfd_value);
@@ -1242,12 +1439,16 @@ static void golioth_coap_client_thread(void *arg)
         if (err)
         {
             LOG_WRN("Failed to connect: %d", err);
-            k_sleep(K_SECONDS(5));
+            client->conn_state = GOLIOTH_COAP_CONN_OFFLINE;
+            reconnect_delay(client,
+                            golioth_coap_reconnect_backoff_next(&client->reconnect_backoff,
+                                                                golioth_sys_rand()));
             continue;
         }
 
         LOG_INF("Golioth CoAP client connected");
-        client->session_connected = true;
+        golioth_coap_reconnect_backoff_reset(&client->reconnect_backoff);
+        client->conn_state = GOLIOTH_COAP_CONN_CONNECTED;
 
         golioth_sys_client_connected(client);
         if (client->event_callback)
@@ -1358,18 +1559,22 @@ static void golioth_coap_client_thread(void *arg)
         LOG_INF("Ending session");
 
         golioth_sys_client_disconnected(client);
-        if (client->event_callback && client->session_connected)
+        if (client->event_callback)
         {
             client->event_callback(client,
                                    GOLIOTH_CLIENT_EVENT_DISCONNECTED,
                                    client->event_callback_arg);
         }
-        client->session_connected = false;
 
         golioth_disconnect(client);
 
-        // Small delay before starting a new session
-        golioth_sys_msleep(1000);
+        // The session was up, so a lost response alone doesn't make the server unreachable.
+        // Requests keep queueing while reconnecting, unless the next connection attempt fails.
+        client->conn_state = GOLIOTH_COAP_CONN_CONNECTING;
+        golioth_coap_reconnect_backoff_reset(&client->reconnect_backoff);
+        reconnect_delay(client,
+                        golioth_coap_reconnect_backoff_next(&client->reconnect_backoff,
+                                                            golioth_sys_rand()));
     }
 }
 
@@ -1492,6 +1697,12 @@ struct golioth_client *golioth_client_create(const struct golioth_client_config
     }
     memset(new_client, 0, sizeof(struct golioth_client));
 
+    if (config->transport != GOLIOTH_CLIENT_TRANSPORT_DTLS)
+    {
+        LOG_ERR("Only the DTLS transport is supported");
+        goto error;
+    }
+
     new_client->config = *config;
 
     credentials_set(&new_client->config);
@@ -1517,10 +1728,25 @@ struct golioth_client *golioth_client_create(const struct golioth_client_config
                       K_POLL_MODE_NOTIFY_ONLY,
                       &new_client->run_sem);
 
-    golioth_coap_token_mutex_create();
+    if (golioth_coap_observations_init(&new_client->observations) != GOLIOTH_OK)
+    {
+        LOG_ERR("Failed to create observation table");
+        goto error;
+    }
+
+    if (golioth_dns_cache_init(&new_client->dns_cache) != GOLIOTH_OK)
+    {
+        LOG_ERR("Failed to create DNS cache");
+        goto error;
+    }
+
+    golioth_coap_token_init();
+    golioth_coap_completion_mutex_create();
+    golioth_coap_coalesce_mutex_create();
+    golioth_coap_request_msg_slab_init();
+    golioth_payload_pool_init();
 
-    new_client->request_queue = golioth_mbox_create(CONFIG_GOLIOTH_COAP_REQUEST_QUEUE_MAX_ITEMS,
-                                                    sizeof(struct golioth_coap_request_msg));
+    new_client->request_queue = golioth_coap_request_queue_create();
     if (!new_client->request_queue)
     {
         LOG_ERR("Failed to create request queue");
@@ -1577,26 +1803,25 @@ error:
 
 static void purge_request_mbox(golioth_mbox_t request_mbox)
 {
-    struct golioth_coap_request_msg request_msg = {};
+    struct golioth_coap_request_msg *request_msg = NULL;
     size_t num_messages = golioth_mbox_num_messages(request_mbox);
 
     for (size_t i = 0; i < num_messages; i++)
     {
-        bool ok = golioth_mbox_recv(request_mbox, &request_msg, 0);
+        size_t num_received = golioth_coap_request_queue_recv(request_mbox, &request_msg, 1, 0);
 
-        assert(ok);
-        (void) ok;
+        assert(num_received == 1);
+        (void) num_received;
 
-        if (request_msg.type == GOLIOTH_COAP_REQUEST_POST)
-        {
-            // free dynamically allocated user payload copy
-            golioth_sys_free(request_msg.post.payload);
-        }
-        else if (request_msg.type == GOLIOTH_COAP_REQUEST_POST_BLOCK)
+        golioth_coap_request_msg_release_payload(request_msg);
+        golioth_coap_request_msg_free_merged_callbacks(request_msg);
+
+        if (request_msg->completion)
         {
-            // free dynamically allocated user payload copy
-            golioth_sys_free(request_msg.post_block.payload);
+            golioth_coap_completion_signal(request_msg->completion, GOLIOTH_ERR_FAIL);
         }
+
+        golioth_coap_request_msg_free(request_msg);
     }
 }
 
@@ -1633,6 +1858,8 @@ void golioth_client_destroy(struct golioth_client *client)
         purge_request_mbox(client->request_queue);
         golioth_mbox_destroy(client->request_queue);
     }
+    golioth_coap_observations_deinit(&client->observations);
+    golioth_dns_cache_deinit(&client->dns_cache);
     golioth_sys_free(client);
 }
 
@@ -6,8 +6,12 @@
 #pragma once
 
 #include "coap_client.h"
+#include "coap_observations.h"
+#include "coap_reconnect.h"
+#include "dns_cache.h"
 #include <golioth/client.h>
 #include "mbox.h"
+#include "coap_rto.h"
 #include <golioth/golioth_sys.h>
 
 #include <stddef.h>
@@ -73,9 +77,12 @@ struct golioth_client
     struct k_poll_event run_event;
     golioth_sys_timer_t keepalive_timer;
     bool is_running;
-    bool session_connected;
+    /// Written by the coap thread, also read by application threads when they enqueue requests
+    _Atomic enum golioth_coap_conn_state conn_state;
+    struct golioth_coap_reconnect_backoff reconnect_backoff;
     struct golioth_client_config config;
-    struct golioth_coap_observe_info observations[CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS];
+    struct golioth_coap_observations observations;
+    struct golioth_dns_cache dns_cache;
 
     struct golioth_tls tls;
     uint8_t *rx_buffer;
@@ -89,6 +96,10 @@ struct golioth_client
     bool coap_reqs_connected;
     struct k_mutex coap_reqs_lock;
 
+#if defined(CONFIG_GOLIOTH_COAP_ADAPTIVE_RTO)
+    struct golioth_coap_rto rto;
+#endif
+
     uint16_t resend_report_count;
     uint32_t resend_report_last_ms;
 
@@ -106,3 +117,10 @@ const struct golioth_coap_rsp_code *golioth_ptr_to_rsp_code(const struct golioth
 void golioth_cancel_all_observations_by_prefix(struct golioth_client *client, const char *prefix);
 
 void golioth_cancel_all_observations(struct golioth_client *client);
+
+enum golioth_status golioth_cancel_observation(struct golioth_client *client,
+                                               const char *path_prefix,
+                                               const char *path,
+                                               enum golioth_content_type content_type,
+                                               golioth_get_cb_fn callback,
+                                               void *arg);
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <assert.h>
+#include <string.h>
+#include "coap_inflight.h"
+#include "golioth_util.h"
+
+static bool token_matches_request(const struct golioth_coap_request_msg *req,
+                                  const uint8_t *token,
+                                  size_t token_len)
+{
+    return token_len == GOLIOTH_COAP_TOKEN_LEN
+        && 0 == memcmp(token, req->token, GOLIOTH_COAP_TOKEN_LEN);
+}
+
+// Block numbers count units of the block size, or of GOLIOTH_COAP_BERT_UNIT_SIZE for BERT blocks
+static uint64_t block_unit_size(size_t szx)
+{
+    return (szx == GOLIOTH_COAP_BERT_SZX) ? GOLIOTH_COAP_BERT_UNIT_SIZE : SZX_TO_BLOCKSIZE(szx);
+}
+
+// All blocks of an upload share a token, so tell the ones in flight apart by the byte offset of
+// the block. A server asking for smaller blocks (RFC 7959 section 2.5) numbers them differently,
+// but the offset it acknowledges still falls within the block that was sent.
+static bool block1_matches_request(const struct golioth_coap_request_msg *req,
+                                   const struct golioth_coap_inflight_block1 *block1)
+{
+    if (req->type != GOLIOTH_COAP_REQUEST_POST_BLOCK || !block1)
+    {
+        return true;
+    }
+
+    uint64_t unit_size = block_unit_size(req->post_block.block_szx);
+    uint64_t start = req->post_block.block_index * unit_size;
+    // BERT blocks span several units
+    uint64_t end = start + max(unit_size, (uint64_t) req->post_block.payload_size);
+    uint64_t offset = block1->num * block_unit_size(block1->szx);
+
+    return offset >= start && offset < end;
+}
+
+static void remove_request(struct golioth_coap_inflight *inflight,
+                           struct golioth_coap_inflight_req *req,
+                           enum golioth_coap_inflight_result result,
+                           golioth_coap_inflight_done_fn done_fn,
+                           void *arg)
+{
+    struct golioth_coap_request_msg *msg = req->msg;
+
+    req->msg = NULL;
+    inflight->num_reqs--;
+    done_fn(msg, result, arg);
+}
+
+size_t golioth_coap_inflight_num_free(const struct golioth_coap_inflight *inflight)
+{
+    return ARRAY_SIZE(inflight->reqs) - inflight->num_reqs;
+}
+
+void golioth_coap_inflight_add(struct golioth_coap_inflight *inflight,
+                               struct golioth_coap_request_msg *req,
+                               uint64_t deadline_ms)
+{
+    struct golioth_coap_inflight_req *slot = NULL;
+    for (size_t i = 0; i < ARRAY_SIZE(inflight->reqs); i++)
+    {
+        if (!inflight->reqs[i].msg)
+        {
+            slot = &inflight->reqs[i];
+            break;
+        }
+    }
+
+    // Caller only sends requests if there is a free slot
+    assert(slot);
+
+    req->got_response = false;
+    req->got_nack = false;
+    slot->msg = req;
+    slot->deadline_ms = deadline_ms;
+    inflight->num_reqs++;
+}
+
+struct golioth_coap_request_msg *golioth_coap_inflight_find(
+    struct golioth_coap_inflight *inflight,
+    const uint8_t *token,
+    size_t token_len,
+    const struct golioth_coap_inflight_block1 *block1)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(inflight->reqs); i++)
+    {
+        struct golioth_coap_inflight_req *req = &inflight->reqs[i];
+        if (req->msg && token_matches_request(req->msg, token, token_len)
+            && block1_matches_request(req->msg, block1))
+        {
+            return req->msg;
+        }
+    }
+
+    return NULL;
+}
+
+void golioth_coap_inflight_nack_all(struct golioth_coap_inflight *inflight)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(inflight->reqs); i++)
+    {
+        if (inflight->reqs[i].msg)
+        {
+            inflight->reqs[i].msg->got_nack = true;
+        }
+    }
+}
+
+int32_t golioth_coap_inflight_next_deadline_ms(const struct golioth_coap_inflight *inflight,
+                                               uint64_t now_ms,
+                                               uint32_t max_wait_ms)
+{
+    if (inflight->num_reqs == 0)
+    {
+        return -1;
+    }
+
+    uint64_t nearest_ms = UINT64_MAX;
+    for (size_t i = 0; i < ARRAY_SIZE(inflight->reqs); i++)
+    {
+        const struct golioth_coap_inflight_req *req = &inflight->reqs[i];
+        if (req->msg)
+        {
+            nearest_ms = min(nearest_ms, req->deadline_ms);
+        }
+    }
+
+    if (nearest_ms <= now_ms)
+    {
+        return 0;
+    }
+
+    return (int32_t) min(nearest_ms - now_ms, (uint64_t) max_wait_ms);
+}
+
+void golioth_coap_inflight_process(struct golioth_coap_inflight *inflight,
+                                   uint64_t now_ms,
+                                   golioth_coap_inflight_done_fn done_fn,
+                                   void *arg)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(inflight->reqs); i++)
+    {
+        struct golioth_coap_inflight_req *req = &inflight->reqs[i];
+        if (!req->msg)
+        {
+            continue;
+        }
+
+        if (req->msg->got_response)
+        {
+            remove_request(inflight, req, GOLIOTH_COAP_INFLIGHT_RESPONSE, done_fn, arg);
+        }
+        else if (req->msg->got_nack)
+        {
+            remove_request(inflight, req, GOLIOTH_COAP_INFLIGHT_NACK, done_fn, arg);
+        }
+        else if (now_ms >= req->deadline_ms)
+        {
+            remove_request(inflight, req, GOLIOTH_COAP_INFLIGHT_TIMEOUT, done_fn, arg);
+        }
+    }
+}
+
+void golioth_coap_inflight_cancel_all(struct golioth_coap_inflight *inflight,
+                                      golioth_coap_inflight_done_fn done_fn,
+                                      void *arg)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(inflight->reqs); i++)
+    {
+        struct golioth_coap_inflight_req *req = &inflight->reqs[i];
+        if (req->msg)
+        {
+            remove_request(inflight, req, GOLIOTH_COAP_INFLIGHT_CANCELLED, done_fn, arg);
+        }
+    }
+}
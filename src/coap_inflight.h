@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <golioth/config.h>
+#include "coap_client.h"
+
+/// Confirmable requests sent to the server and still waiting for a response.
+///
+/// Up to CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS requests are in flight at
+/// once, each with its own deadline. Responses and NACKs are matched to their
+/// request by token and, since all blocks of an upload share a token, by the byte
+/// offset in their Block1 option. Only used from the CoAP thread, so there is no
+/// locking.
+
+struct golioth_coap_inflight_req
+{
+    /// Request descriptor taken from the request queue, NULL while the slot is free
+    struct golioth_coap_request_msg *msg;
+    /// Time at which the request is considered timed out, in ms (golioth_sys_now_ms)
+    uint64_t deadline_ms;
+};
+
+struct golioth_coap_inflight
+{
+    struct golioth_coap_inflight_req reqs[CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS];
+    size_t num_reqs;
+};
+
+/// Block1 option of a received message
+struct golioth_coap_inflight_block1
+{
+    uint32_t num;
+    uint8_t szx;
+};
+
+/// Why a request leaves the window
+enum golioth_coap_inflight_result
+{
+    GOLIOTH_COAP_INFLIGHT_RESPONSE,
+    GOLIOTH_COAP_INFLIGHT_NACK,
+    GOLIOTH_COAP_INFLIGHT_TIMEOUT,
+    GOLIOTH_COAP_INFLIGHT_CANCELLED,
+};
+
+/// Called for each request leaving the window, which then owns the request again
+typedef void (*golioth_coap_inflight_done_fn)(struct golioth_coap_request_msg *req,
+                                              enum golioth_coap_inflight_result result,
+                                              void *arg);
+
+/// Get the number of requests that can still be added
+///
+/// @param inflight The in-flight window
+size_t golioth_coap_inflight_num_free(const struct golioth_coap_inflight *inflight);
+
+/// Add a request that was just sent
+///
+/// The window keeps a pointer to the request until it's handed to the done callback. The caller
+/// must check there is a free slot first.
+///
+/// @param inflight The in-flight window
+/// @param req The request
+/// @param deadline_ms Time at which the request times out, in ms
+void golioth_coap_inflight_add(struct golioth_coap_inflight *inflight,
+                               struct golioth_coap_request_msg *req,
+                               uint64_t deadline_ms);
+
+/// Find the request a received message belongs to
+///
+/// @param inflight The in-flight window
+/// @param token Token of the message
+/// @param token_len Length of the token
+/// @param block1 Block1 option of the message, NULL if it has none
+///
+/// @return The request, or NULL if none matches
+struct golioth_coap_request_msg *golioth_coap_inflight_find(
+    struct golioth_coap_inflight *inflight,
+    const uint8_t *token,
+    size_t token_len,
+    const struct golioth_coap_inflight_block1 *block1);
+
+/// Mark all requests in flight as NACKed, e.g. on a NACK not tied to a message
+///
+/// @param inflight The in-flight window
+void golioth_coap_inflight_nack_all(struct golioth_coap_inflight *inflight);
+
+/// Get the time until the nearest deadline
+///
+/// @param inflight The in-flight window
+/// @param now_ms Current time, in ms
+/// @param max_wait_ms Upper bound of the returned time
+///
+/// @return Time in ms, 0 if a deadline has passed, -1 if nothing is in flight
+int32_t golioth_coap_inflight_next_deadline_ms(const struct golioth_coap_inflight *inflight,
+                                               uint64_t now_ms,
+                                               uint32_t max_wait_ms);
+
+/// Remove the requests that got a response, were NACKed, or timed out
+///
+/// @param inflight The in-flight window
+/// @param now_ms Current time, in ms
+/// @param done_fn Called for each removed request
+/// @param arg Passed to done_fn
+void golioth_coap_inflight_process(struct golioth_coap_inflight *inflight,
+                                   uint64_t now_ms,
+                                   golioth_coap_inflight_done_fn done_fn,
+                                   void *arg);
+
+/// Remove all requests, e.g. when the session ends
+///
+/// @param inflight The in-flight window
+/// @param done_fn Called for each removed request
+/// @param arg Passed to done_fn
+void golioth_coap_inflight_cancel_all(struct golioth_coap_inflight *inflight,
+                                      golioth_coap_inflight_done_fn done_fn,
+                                      void *arg);
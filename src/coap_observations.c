@@ -0,0 +1,522 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "coap_observations.h"
+#include "golioth_util.h"
+#include <string.h>
+
+#define INITIAL_NUM_BUCKETS 8
+
+/// FNV-1a. Tokens are a random prefix followed by a counter, so all bytes are mixed in.
+static uint32_t token_hash(const uint8_t *token, size_t token_len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < token_len; i++)
+    {
+        hash ^= token[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static struct golioth_coap_observe_info **bucket_of(
+    struct golioth_coap_observe_info **buckets,
+    size_t num_buckets,
+    const uint8_t token[GOLIOTH_COAP_TOKEN_LEN])
+{
+    // num_buckets is always a power of two
+    return &buckets[token_hash(token, GOLIOTH_COAP_TOKEN_LEN) & (num_buckets - 1)];
+}
+
+static bool grow_buckets(struct golioth_coap_observations *observations)
+{
+    size_t num_buckets = observations->buckets ? 2 * observations->num_buckets
+                                               : INITIAL_NUM_BUCKETS;
+    struct golioth_coap_observe_info **buckets =
+        golioth_sys_malloc(num_buckets * sizeof(struct golioth_coap_observe_info *));
+    if (!buckets)
+    {
+        return false;
+    }
+    memset(buckets, 0, num_buckets * sizeof(struct golioth_coap_observe_info *));
+
+    for (size_t i = 0; i < observations->num_buckets; i++)
+    {
+        struct golioth_coap_observe_info *info = observations->buckets[i];
+        while (info)
+        {
+            struct golioth_coap_observe_info *next = info->token_next;
+            struct golioth_coap_observe_info **bucket =
+                bucket_of(buckets, num_buckets, info->req.token);
+            info->token_next = *bucket;
+            *bucket = info;
+            info = next;
+        }
+    }
+
+    golioth_sys_free(observations->buckets);
+    observations->buckets = buckets;
+    observations->num_buckets = num_buckets;
+
+    return true;
+}
+
+static struct golioth_coap_observe_prefix **find_prefix(
+    struct golioth_coap_observations *observations,
+    const char *path_prefix)
+{
+    struct golioth_coap_observe_prefix **prefix = &observations->prefixes;
+    while (*prefix && strcmp((*prefix)->path_prefix, path_prefix) != 0)
+    {
+        prefix = &(*prefix)->next;
+    }
+    return prefix;
+}
+
+static void unlink_from_bucket(struct golioth_coap_observations *observations,
+                               struct golioth_coap_observe_info *info)
+{
+    struct golioth_coap_observe_info **link =
+        bucket_of(observations->buckets, observations->num_buckets, info->req.token);
+    while (*link && *link != info)
+    {
+        link = &(*link)->token_next;
+    }
+    if (*link)
+    {
+        *link = info->token_next;
+        observations->num_observations--;
+    }
+}
+
+static void unlink_from_prefix(struct golioth_coap_observations *observations,
+                               struct golioth_coap_observe_info *info)
+{
+    struct golioth_coap_observe_prefix **prefix =
+        find_prefix(observations, info->req.path_prefix);
+    if (*prefix)
+    {
+        struct golioth_coap_observe_info **link = &(*prefix)->observations;
+        while (*link && *link != info)
+        {
+            link = &(*link)->prefix_next;
+        }
+        if (*link)
+        {
+            *link = info->prefix_next;
+        }
+    }
+}
+
+static struct golioth_coap_observe_info *find_by_path(
+    struct golioth_coap_observations *observations,
+    const char *path_prefix,
+    const char *path,
+    enum golioth_content_type content_type)
+{
+    struct golioth_coap_observe_prefix *prefix = *find_prefix(observations, path_prefix);
+    if (!prefix)
+    {
+        return NULL;
+    }
+
+    for (struct golioth_coap_observe_info *info = prefix->observations; info;
+         info = info->prefix_next)
+    {
+        if (info->req.observe.content_type == content_type && strcmp(info->req.path, path) == 0)
+        {
+            return info;
+        }
+    }
+
+    return NULL;
+}
+
+static bool add_subscriber(struct golioth_coap_observe_info *info,
+                           golioth_get_cb_fn callback,
+                           void *arg)
+{
+    struct golioth_coap_observe_subscriber *subscriber =
+        golioth_sys_malloc(sizeof(struct golioth_coap_observe_subscriber));
+    if (!subscriber)
+    {
+        return false;
+    }
+    subscriber->callback = callback;
+    subscriber->arg = arg;
+    subscriber->next = NULL;
+
+    struct golioth_coap_observe_subscriber **link = &info->subscribers;
+    while (*link)
+    {
+        link = &(*link)->next;
+    }
+    *link = subscriber;
+    info->num_subscribers++;
+
+    return true;
+}
+
+enum golioth_status golioth_coap_observations_init(
+    struct golioth_coap_observations *observations)
+{
+    memset(observations, 0, sizeof(*observations));
+
+    observations->lock = golioth_sys_mutex_create();
+    if (!observations->lock)
+    {
+        return GOLIOTH_ERR_MEM_ALLOC;
+    }
+
+    return GOLIOTH_OK;
+}
+
+void golioth_coap_observations_deinit(struct golioth_coap_observations *observations)
+{
+    if (!observations->lock)
+    {
+        return;
+    }
+
+    struct golioth_coap_observe_info *info =
+        golioth_coap_observations_take_by_prefix(observations, NULL);
+    while (info)
+    {
+        struct golioth_coap_observe_info *next = info->prefix_next;
+        golioth_coap_observations_free(info);
+        info = next;
+    }
+
+    golioth_sys_free(observations->buckets);
+    golioth_sys_mutex_destroy(observations->lock);
+    memset(observations, 0, sizeof(*observations));
+}
+
+enum golioth_status golioth_coap_observations_add(struct golioth_coap_observations *observations,
+                                                  const struct golioth_coap_request_msg *req,
+                                                  struct golioth_coap_observe_info **info,
+                                                  bool *is_new)
+{
+    enum golioth_status status = GOLIOTH_OK;
+    struct golioth_coap_observe_info *new_info = NULL;
+    bool added = false;
+
+    golioth_sys_mutex_lock(observations->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    new_info =
+        find_by_path(observations, req->path_prefix, req->path, req->observe.content_type);
+    if (new_info)
+    {
+        if (new_info->num_subscribers >= CONFIG_GOLIOTH_MAX_NUM_OBSERVE_SUBSCRIBERS)
+        {
+            new_info = NULL;
+            status = GOLIOTH_ERR_QUEUE_FULL;
+        }
+        else if (!add_subscriber(new_info, req->observe.callback, req->observe.arg))
+        {
+            new_info = NULL;
+            status = GOLIOTH_ERR_MEM_ALLOC;
+        }
+        goto finish;
+    }
+
+    if (observations->num_observations >= CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS)
+    {
+        status = GOLIOTH_ERR_QUEUE_FULL;
+        goto finish;
+    }
+
+    if (observations->num_observations >= observations->num_buckets)
+    {
+        // Without any buckets there is nowhere to insert. Otherwise a failed
+        // grow only makes the chains longer.
+        if (!grow_buckets(observations) && !observations->buckets)
+        {
+            status = GOLIOTH_ERR_MEM_ALLOC;
+            goto finish;
+        }
+    }
+
+    struct golioth_coap_observe_prefix **prefix = find_prefix(observations, req->path_prefix);
+    if (!*prefix)
+    {
+        *prefix = golioth_sys_malloc(sizeof(struct golioth_coap_observe_prefix));
+        if (!*prefix)
+        {
+            status = GOLIOTH_ERR_MEM_ALLOC;
+            goto finish;
+        }
+        (*prefix)->path_prefix = req->path_prefix;
+        (*prefix)->observations = NULL;
+        (*prefix)->next = NULL;
+    }
+
+    // The path is stored right after the observation
+    size_t path_len = strlen(req->path);
+    new_info = golioth_sys_malloc(sizeof(struct golioth_coap_observe_info) + path_len + 1);
+    if (!new_info)
+    {
+        status = GOLIOTH_ERR_MEM_ALLOC;
+        goto finish;
+    }
+    memcpy(&new_info->req, req, sizeof(new_info->req));
+    memcpy(new_info + 1, req->path, path_len + 1);
+    new_info->req.path = (const char *) (new_info + 1);
+    new_info->req.observe.callback = NULL;
+    new_info->req.observe.arg = NULL;
+    new_info->subscribers = NULL;
+    new_info->num_subscribers = 0;
+
+    if (!add_subscriber(new_info, req->observe.callback, req->observe.arg))
+    {
+        golioth_sys_free(new_info);
+        new_info = NULL;
+        status = GOLIOTH_ERR_MEM_ALLOC;
+        goto finish;
+    }
+
+    struct golioth_coap_observe_info **bucket =
+        bucket_of(observations->buckets, observations->num_buckets, new_info->req.token);
+    new_info->token_next = *bucket;
+    *bucket = new_info;
+
+    new_info->prefix_next = (*prefix)->observations;
+    (*prefix)->observations = new_info;
+
+    observations->num_observations++;
+    added = true;
+
+finish:
+    golioth_sys_mutex_unlock(observations->lock);
+
+    if (info)
+    {
+        *info = new_info;
+    }
+    if (is_new)
+    {
+        *is_new = added;
+    }
+
+    return status;
+}
+
+void golioth_coap_observations_remove(struct golioth_coap_observations *observations,
+                                      struct golioth_coap_observe_info *info)
+{
+    golioth_sys_mutex_lock(observations->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    size_t num_observations = observations->num_observations;
+    unlink_from_bucket(observations, info);
+    bool was_in_table = (observations->num_observations != num_observations);
+    if (was_in_table)
+    {
+        unlink_from_prefix(observations, info);
+    }
+
+    golioth_sys_mutex_unlock(observations->lock);
+
+    if (was_in_table)
+    {
+        golioth_coap_observations_free(info);
+    }
+}
+
+enum golioth_status golioth_coap_observations_unsubscribe(
+    struct golioth_coap_observations *observations,
+    const char *path_prefix,
+    const char *path,
+    enum golioth_content_type content_type,
+    golioth_get_cb_fn callback,
+    void *arg,
+    struct golioth_coap_observe_info **released)
+{
+    enum golioth_status status = GOLIOTH_ERR_INVALID_STATE;
+
+    *released = NULL;
+
+    golioth_sys_mutex_lock(observations->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    struct golioth_coap_observe_info *info =
+        find_by_path(observations, path_prefix, path, content_type);
+    if (!info)
+    {
+        goto finish;
+    }
+
+    struct golioth_coap_observe_subscriber **link = &info->subscribers;
+    while (*link && ((*link)->callback != callback || (*link)->arg != arg))
+    {
+        link = &(*link)->next;
+    }
+    if (!*link)
+    {
+        goto finish;
+    }
+
+    struct golioth_coap_observe_subscriber *subscriber = *link;
+    *link = subscriber->next;
+    golioth_sys_free(subscriber);
+    info->num_subscribers--;
+    status = GOLIOTH_OK;
+
+    if (!info->subscribers)
+    {
+        unlink_from_bucket(observations, info);
+        unlink_from_prefix(observations, info);
+        *released = info;
+    }
+
+finish:
+    golioth_sys_mutex_unlock(observations->lock);
+
+    return status;
+}
+
+bool golioth_coap_observations_notify(struct golioth_coap_observations *observations,
+                                      struct golioth_client *client,
+                                      const uint8_t *token,
+                                      size_t token_len,
+                                      enum golioth_status status,
+                                      const struct golioth_coap_rsp_code *coap_rsp_code,
+                                      const uint8_t *data,
+                                      size_t data_len)
+{
+    struct golioth_coap_observe_info *info = NULL;
+    // Copy what the subscribers need, so they can be called without holding the lock
+    struct golioth_coap_observe_subscriber subscribers[CONFIG_GOLIOTH_MAX_NUM_OBSERVE_SUBSCRIBERS];
+    size_t num_subscribers = 0;
+    char path[CONFIG_GOLIOTH_COAP_MAX_PATH_LEN + 1];
+
+    if (token_len != GOLIOTH_COAP_TOKEN_LEN)
+    {
+        return false;
+    }
+
+    golioth_sys_mutex_lock(observations->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    if (observations->buckets)
+    {
+        info = *bucket_of(observations->buckets, observations->num_buckets, token);
+        while (info && 0 != memcmp(info->req.token, token, GOLIOTH_COAP_TOKEN_LEN))
+        {
+            info = info->token_next;
+        }
+    }
+
+    if (!info)
+    {
+        golioth_sys_mutex_unlock(observations->lock);
+        return false;
+    }
+
+    for (struct golioth_coap_observe_subscriber *subscriber = info->subscribers;
+         subscriber && num_subscribers < ARRAY_SIZE(subscribers);
+         subscriber = subscriber->next)
+    {
+        subscribers[num_subscribers++] = *subscriber;
+    }
+    strncpy(path, info->req.path, sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+
+    golioth_sys_mutex_unlock(observations->lock);
+
+    for (size_t i = 0; i < num_subscribers; i++)
+    {
+        if (subscribers[i].callback)
+        {
+            subscribers[i].callback(client,
+                                    status,
+                                    coap_rsp_code,
+                                    path,
+                                    data,
+                                    data_len,
+                                    subscribers[i].arg);
+        }
+    }
+
+    return true;
+}
+
+struct golioth_coap_observe_info *golioth_coap_observations_take_by_prefix(
+    struct golioth_coap_observations *observations,
+    const char *path_prefix)
+{
+    struct golioth_coap_observe_info *taken = NULL;
+
+    golioth_sys_mutex_lock(observations->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    struct golioth_coap_observe_prefix **prefix = &observations->prefixes;
+    while (*prefix)
+    {
+        if (path_prefix && strcmp((*prefix)->path_prefix, path_prefix) != 0)
+        {
+            prefix = &(*prefix)->next;
+            continue;
+        }
+
+        struct golioth_coap_observe_info *info = (*prefix)->observations;
+        while (info)
+        {
+            struct golioth_coap_observe_info *next = info->prefix_next;
+            unlink_from_bucket(observations, info);
+            info->prefix_next = taken;
+            taken = info;
+            info = next;
+        }
+
+        // Prefixes are few and long-lived, but drop the emptied one anyway
+        struct golioth_coap_observe_prefix *emptied = *prefix;
+        *prefix = emptied->next;
+        golioth_sys_free(emptied);
+    }
+
+    golioth_sys_mutex_unlock(observations->lock);
+
+    return taken;
+}
+
+void golioth_coap_observations_foreach(struct golioth_coap_observations *observations,
+                                       void (*fn)(struct golioth_coap_observe_info *info,
+                                                  void *arg),
+                                       void *arg)
+{
+    golioth_sys_mutex_lock(observations->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    for (struct golioth_coap_observe_prefix *prefix = observations->prefixes; prefix;
+         prefix = prefix->next)
+    {
+        for (struct golioth_coap_observe_info *info = prefix->observations; info;
+             info = info->prefix_next)
+        {
+            fn(info, arg);
+        }
+    }
+
+    golioth_sys_mutex_unlock(observations->lock);
+}
+
+size_t golioth_coap_observations_count(struct golioth_coap_observations *observations)
+{
+    golioth_sys_mutex_lock(observations->lock, GOLIOTH_SYS_WAIT_FOREVER);
+    size_t count = observations->num_observations;
+    golioth_sys_mutex_unlock(observations->lock);
+
+    return count;
+}
+
+void golioth_coap_observations_free(struct golioth_coap_observe_info *info)
+{
+    struct golioth_coap_observe_subscriber *subscriber = info->subscribers;
+    while (subscriber)
+    {
+        struct golioth_coap_observe_subscriber *next = subscriber->next;
+        golioth_sys_free(subscriber);
+        subscriber = next;
+    }
+
+    golioth_sys_free(info);
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include "coap_client.h"
+#include <golioth/golioth_sys.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Table of the observations established by a client.
+///
+/// Each observation is allocated on its own, so its address stays the same
+/// for as long as it is in the table, and is indexed twice:
+///
+///  - by token, in a hash table that doubles its number of buckets whenever
+///    it holds more observations than buckets,
+///  - by path prefix, in one list per distinct prefix (".d/", ".rpc/", ...).
+///
+/// There is a single observation per path and content type. Observing the same path again adds
+/// a local subscriber to the existing observation, and notifications are fanned out to all of
+/// its subscribers. The observation is released when its last subscriber is removed.
+///
+/// All functions are thread-safe.
+
+/// Local subscriber of an observation
+struct golioth_coap_observe_subscriber
+{
+    golioth_get_cb_fn callback;
+    void *arg;
+    struct golioth_coap_observe_subscriber *next;
+};
+
+struct golioth_coap_observe_info
+{
+    /// Observe request sent to the server. Callbacks are kept in subscribers instead, and the
+    /// path is stored right after this structure.
+    struct golioth_coap_request_msg req;
+    /// Subscribers, in the order they were added
+    struct golioth_coap_observe_subscriber *subscribers;
+    /// At most CONFIG_GOLIOTH_MAX_NUM_OBSERVE_SUBSCRIBERS
+    size_t num_subscribers;
+    /// Next observation in the same token hash bucket
+    struct golioth_coap_observe_info *token_next;
+    /// Next observation with the same path prefix
+    struct golioth_coap_observe_info *prefix_next;
+};
+
+struct golioth_coap_observe_prefix
+{
+    /// String literal, compared by value
+    const char *path_prefix;
+    struct golioth_coap_observe_info *observations;
+    struct golioth_coap_observe_prefix *next;
+};
+
+struct golioth_coap_observations
+{
+    golioth_sys_mutex_t lock;
+    /// Allocated on the first add, NULL while empty
+    struct golioth_coap_observe_info **buckets;
+    size_t num_buckets;
+    size_t num_observations;
+    struct golioth_coap_observe_prefix *prefixes;
+};
+
+/// Initialize an empty table
+///
+/// @param observations The table
+///
+/// @retval GOLIOTH_OK table initialized
+/// @retval GOLIOTH_ERR_MEM_ALLOC failed to create the lock
+enum golioth_status golioth_coap_observations_init(
+    struct golioth_coap_observations *observations);
+
+/// Free all observations and the table itself
+///
+/// @param observations The table
+void golioth_coap_observations_deinit(struct golioth_coap_observations *observations);
+
+/// Add an observe request to the table
+///
+/// If the path is already observed with the same content type, the callback of @p req is added
+/// as a subscriber of the existing observation. Otherwise a new observation is added with a copy
+/// of @p req, which the caller then establishes with the server.
+///
+/// @param observations The table
+/// @param req The observe request
+/// @param[out] info The observation, valid until it is removed from the table. Can be NULL.
+/// @param[out] is_new Whether a new observation was added. Can be NULL.
+///
+/// @retval GOLIOTH_OK observation added, or subscriber added to an existing one
+/// @retval GOLIOTH_ERR_QUEUE_FULL CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS reached, or
+///     CONFIG_GOLIOTH_MAX_NUM_OBSERVE_SUBSCRIBERS for the path
+/// @retval GOLIOTH_ERR_MEM_ALLOC failed to allocate the observation or subscriber
+enum golioth_status golioth_coap_observations_add(struct golioth_coap_observations *observations,
+                                                  const struct golioth_coap_request_msg *req,
+                                                  struct golioth_coap_observe_info **info,
+                                                  bool *is_new);
+
+/// Remove a single observation and all of its subscribers from the table and free it
+///
+/// Does nothing if the observation has already been removed from the table.
+///
+/// @param observations The table
+/// @param info Observation returned by golioth_coap_observations_add()
+void golioth_coap_observations_remove(struct golioth_coap_observations *observations,
+                                      struct golioth_coap_observe_info *info);
+
+/// Remove a single subscriber
+///
+/// @param observations The table
+/// @param path_prefix Path prefix of the observation
+/// @param path Path of the observation
+/// @param content_type Content type of the observation
+/// @param callback Callback of the subscriber
+/// @param arg Callback argument of the subscriber
+/// @param[out] released Set to the observation if this was its last subscriber, otherwise NULL.
+///     The observation has then been removed from the table, and the caller releases it and
+///     frees it with golioth_coap_observations_free().
+///
+/// @retval GOLIOTH_OK subscriber removed
+/// @retval GOLIOTH_ERR_INVALID_STATE no such subscriber
+enum golioth_status golioth_coap_observations_unsubscribe(
+    struct golioth_coap_observations *observations,
+    const char *path_prefix,
+    const char *path,
+    enum golioth_content_type content_type,
+    golioth_get_cb_fn callback,
+    void *arg,
+    struct golioth_coap_observe_info **released);
+
+/// Call all subscribers of the observation with the given token
+///
+/// The subscribers are called without holding the lock, so they may observe or unsubscribe.
+///
+/// @param observations The table
+/// @param client The client passed to the subscribers
+/// @param token The token of a received notification
+/// @param token_len Length of @p token, in bytes
+/// @param status Status passed to the subscribers
+/// @param coap_rsp_code CoAP response code passed to the subscribers. Can be NULL.
+/// @param data Payload of the notification. Can be NULL.
+/// @param data_len Size of @p data, in bytes
+///
+/// @retval true observation found
+/// @retval false no observation with this token
+bool golioth_coap_observations_notify(struct golioth_coap_observations *observations,
+                                      struct golioth_client *client,
+                                      const uint8_t *token,
+                                      size_t token_len,
+                                      enum golioth_status status,
+                                      const struct golioth_coap_rsp_code *coap_rsp_code,
+                                      const uint8_t *data,
+                                      size_t data_len);
+
+/// Remove all observations with the given path prefix from the table
+///
+/// The removed entries are returned as a list linked by prefix_next. The caller releases the
+/// observations and frees each entry with golioth_coap_observations_free().
+///
+/// @param observations The table
+/// @param path_prefix Path prefix to match, or NULL to remove all observations
+///
+/// @return First removed entry, or NULL if none matched
+struct golioth_coap_observe_info *golioth_coap_observations_take_by_prefix(
+    struct golioth_coap_observations *observations,
+    const char *path_prefix);
+
+/// Call @p fn for each observation in the table
+///
+/// The lock is held while iterating, so @p fn must not call back into the table.
+///
+/// @param observations The table
+/// @param fn Function called with each entry
+/// @param arg User argument passed to @p fn
+void golioth_coap_observations_foreach(struct golioth_coap_observations *observations,
+                                       void (*fn)(struct golioth_coap_observe_info *info,
+                                                  void *arg),
+                                       void *arg);
+
+/// Number of observations in the table, not counting additional subscribers
+size_t golioth_coap_observations_count(struct golioth_coap_observations *observations);
+
+/// Free an observation removed from the table, along with its subscribers
+///
+/// @param info Observation returned by golioth_coap_observations_unsubscribe() or
+///     golioth_coap_observations_take_by_prefix()
+void golioth_coap_observations_free(struct golioth_coap_observe_info *info);
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "coap_reconnect.h"
+#include <golioth/config.h>
+
+void golioth_coap_reconnect_backoff_reset(struct golioth_coap_reconnect_backoff *backoff)
+{
+    backoff->delay_ms = 0;
+}
+
+uint32_t golioth_coap_reconnect_backoff_next(struct golioth_coap_reconnect_backoff *backoff,
+                                             uint32_t random)
+{
+    if (backoff->delay_ms == 0)
+    {
+        backoff->delay_ms = CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MIN_MS;
+    }
+    else if (backoff->delay_ms < CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MAX_MS / 2)
+    {
+        backoff->delay_ms *= 2;
+    }
+    else
+    {
+        backoff->delay_ms = CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MAX_MS;
+    }
+
+    uint32_t half_ms = backoff->delay_ms / 2;
+
+    return backoff->delay_ms - half_ms + (random % (half_ms + 1));
+}
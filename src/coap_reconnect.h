@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+
+/// Delay between attempts to connect to the server.
+///
+/// The delay starts at CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MIN_MS and doubles
+/// with each failed attempt, up to CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MAX_MS.
+/// Each delay is randomized between half and all of its nominal value, so a
+/// fleet of devices that lost the server at the same time doesn't come back
+/// in lockstep.
+
+struct golioth_coap_reconnect_backoff
+{
+    /// Nominal value of the last delay, 0 if there was none since the last reset
+    uint32_t delay_ms;
+};
+
+/// Start over from the minimum delay, e.g. once connected
+///
+/// @param backoff The backoff state
+void golioth_coap_reconnect_backoff_reset(struct golioth_coap_reconnect_backoff *backoff);
+
+/// Get the delay before the next attempt
+///
+/// @param backoff The backoff state
+/// @param random Random number, used to spread the delay
+///
+/// @return Delay in milliseconds
+uint32_t golioth_coap_reconnect_backoff_next(struct golioth_coap_reconnect_backoff *backoff,
+                                             uint32_t random);
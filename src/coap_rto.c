@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "coap_rto.h"
+
+#define RTO_DEFAULT_MS 2000
+#define RTO_MIN_MS 100
+#define RTO_MAX_MS 60000
+
+// Variable backoff factor thresholds
+#define RTO_SMALL_MS 1000
+#define RTO_LARGE_MS 3000
+
+#define STRONG_K 4
+#define WEAK_K 1
+#define MAX_WEAK_RETRANSMISSIONS 2
+
+static uint32_t clamp_rto(uint32_t rto_ms)
+{
+    if (rto_ms < RTO_MIN_MS)
+    {
+        return RTO_MIN_MS;
+    }
+    if (rto_ms > RTO_MAX_MS)
+    {
+        return RTO_MAX_MS;
+    }
+    return rto_ms;
+}
+
+static void estimator_update(struct golioth_coap_rtt_estimator *est, uint32_t rtt_ms, uint32_t k)
+{
+    if (!est->has_samples)
+    {
+        est->srtt_ms = rtt_ms;
+        est->rttvar_ms = rtt_ms / 2;
+        est->has_samples = true;
+    }
+    else
+    {
+        uint32_t delta = (est->srtt_ms > rtt_ms) ? est->srtt_ms - rtt_ms : rtt_ms - est->srtt_ms;
+
+        // RTTVAR = 3/4 * RTTVAR + 1/4 * |SRTT - R|, SRTT = 7/8 * SRTT + 1/8 * R
+        est->rttvar_ms = (3 * est->rttvar_ms + delta) / 4;
+        est->srtt_ms = (7 * est->srtt_ms + rtt_ms) / 8;
+    }
+
+    est->rto_ms = est->srtt_ms + k * est->rttvar_ms;
+}
+
+void golioth_coap_rto_init(struct golioth_coap_rto *rto, uint32_t initial_rto_ms, uint32_t now_ms)
+{
+    *rto = (struct golioth_coap_rto) {
+        .rto_ms = clamp_rto(initial_rto_ms),
+        .updated_ms = now_ms,
+    };
+}
+
+void golioth_coap_rto_update(struct golioth_coap_rto *rto,
+                             uint32_t rtt_ms,
+                             uint8_t num_retransmissions,
+                             uint32_t now_ms)
+{
+    if (num_retransmissions == 0)
+    {
+        // RTO = 1/2 * RTO_strong + 1/2 * RTO
+        estimator_update(&rto->strong, rtt_ms, STRONG_K);
+        rto->rto_ms = (rto->strong.rto_ms + rto->rto_ms) / 2;
+    }
+    else if (num_retransmissions <= MAX_WEAK_RETRANSMISSIONS)
+    {
+        // RTO = 1/4 * RTO_weak + 3/4 * RTO
+        estimator_update(&rto->weak, rtt_ms, WEAK_K);
+        rto->rto_ms = (rto->weak.rto_ms + 3 * rto->rto_ms) / 4;
+    }
+    else
+    {
+        return;
+    }
+
+    rto->rto_ms = clamp_rto(rto->rto_ms);
+    rto->updated_ms = now_ms;
+}
+
+uint32_t golioth_coap_rto_get(struct golioth_coap_rto *rto, uint32_t now_ms)
+{
+    uint32_t idle_ms = now_ms - rto->updated_ms;
+
+    if (rto->rto_ms < RTO_SMALL_MS && idle_ms >= 16 * rto->rto_ms)
+    {
+        rto->rto_ms = clamp_rto(2 * rto->rto_ms);
+        rto->updated_ms = now_ms;
+    }
+    else if (rto->rto_ms > RTO_LARGE_MS && idle_ms >= 4 * rto->rto_ms)
+    {
+        rto->rto_ms = (RTO_DEFAULT_MS + rto->rto_ms) / 2;
+        rto->updated_ms = now_ms;
+    }
+
+    return rto->rto_ms;
+}
+
+uint32_t golioth_coap_rto_backoff(uint32_t timeout_ms, uint32_t initial_timeout_ms)
+{
+    uint32_t next_ms;
+
+    if (initial_timeout_ms < RTO_SMALL_MS)
+    {
+        next_ms = 3 * timeout_ms;
+    }
+    else if (initial_timeout_ms > RTO_LARGE_MS)
+    {
+        next_ms = timeout_ms + timeout_ms / 2;
+    }
+    else
+    {
+        next_ms = 2 * timeout_ms;
+    }
+
+    return clamp_rto(next_ms);
+}
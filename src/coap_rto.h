@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/// Adaptive CoAP retransmission timeout (RTO), based on CoCoA
+/// (draft-ietf-core-cocoa).
+///
+/// Round trip times measured on confirmable exchanges are fed into two
+/// RFC 6298 style estimators:
+///
+///  - the strong estimator, for exchanges that were answered without any
+///    retransmission,
+///  - the weak estimator, for exchanges that needed one or two
+///    retransmissions. The RTT is then measured from the first transmission,
+///    since it is not known which transmission was answered.
+///
+/// Each new estimate is blended into the overall RTO, which is used as the
+/// initial timeout of new exchanges. Retransmissions back off by a variable
+/// factor that depends on that initial timeout.
+///
+/// All times are in milliseconds. Timestamps are free-running and may wrap.
+
+struct golioth_coap_rtt_estimator
+{
+    uint32_t srtt_ms;
+    uint32_t rttvar_ms;
+    uint32_t rto_ms;
+    bool has_samples;
+};
+
+struct golioth_coap_rto
+{
+    struct golioth_coap_rtt_estimator strong;
+    struct golioth_coap_rtt_estimator weak;
+
+    /// Initial timeout of new exchanges
+    uint32_t rto_ms;
+    /// When rto_ms was last updated by a sample or by aging
+    uint32_t updated_ms;
+};
+
+/// Reset the estimator to its initial state, e.g. after reconnecting
+///
+/// @param rto The estimator
+/// @param initial_rto_ms RTO to use until the first sample arrives
+/// @param now_ms Current time
+void golioth_coap_rto_init(struct golioth_coap_rto *rto, uint32_t initial_rto_ms, uint32_t now_ms);
+
+/// Feed a measured round trip time into the estimator
+///
+/// Samples of exchanges with more than two retransmissions are ignored.
+///
+/// @param rto The estimator
+/// @param rtt_ms Time between the first transmission and the response
+/// @param num_retransmissions Number of retransmissions of the exchange
+/// @param now_ms Current time
+void golioth_coap_rto_update(struct golioth_coap_rto *rto,
+                             uint32_t rtt_ms,
+                             uint8_t num_retransmissions,
+                             uint32_t now_ms);
+
+/// Get the initial timeout for a new exchange
+///
+/// Ages the RTO towards its default when there were no samples for a while,
+/// so that a stale estimate doesn't stick forever.
+///
+/// @param rto The estimator
+/// @param now_ms Current time
+///
+/// @return Initial timeout in milliseconds, before randomization
+uint32_t golioth_coap_rto_get(struct golioth_coap_rto *rto, uint32_t now_ms);
+
+/// Compute the timeout of the next retransmission
+///
+/// @param timeout_ms Timeout of the transmission that just expired
+/// @param initial_timeout_ms Timeout of the first transmission of the exchange
+///
+/// @return Timeout of the next retransmission in milliseconds
+uint32_t golioth_coap_rto_backoff(uint32_t timeout_ms, uint32_t initial_timeout_ms);
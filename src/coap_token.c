@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "coap_client.h"
+#include <assert.h>
+#include <string.h>
+#include <golioth/golioth_sys.h>
+
+#if !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#endif
+
+/// A token is a random per-boot prefix in the upper 32 bits followed by a
+/// counter in the lower 32 bits, so generating one is a single atomic
+/// fetch-add. Targets without lock-free 32-bit atomics fall back to a mutex.
+#if !defined(__STDC_NO_ATOMICS__) && ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LONG_LOCK_FREE == 2
+#define TOKEN_LOCK_FREE 1
+#endif
+
+#if defined(TOKEN_LOCK_FREE)
+/// 0 until the prefix is chosen
+static _Atomic uint32_t token_prefix;
+static _Atomic uint32_t token_count;
+#else
+static golioth_sys_mutex_t token_mut;
+static uint32_t token_prefix;
+static uint32_t token_count;
+#endif
+
+void golioth_coap_token_init(void)
+{
+#if !defined(TOKEN_LOCK_FREE)
+    /* Called by golioth_client_create(); created once, never destroyed */
+    if (!token_mut)
+    {
+        token_mut = golioth_sys_mutex_create();
+        assert(token_mut);
+    }
+#endif
+}
+
+static uint32_t random_prefix(void)
+{
+    /* Systems without a hardware-backed random source need to seed rand. Waiting until now
+     * introduces the variability of the network connection time to receive a different ms count on
+     * each power cycle to use as the seed. */
+    golioth_sys_srand(golioth_sys_now_ms());
+
+    // rand() may only provide 15 random bits
+    uint32_t prefix = ((uint32_t) golioth_sys_rand() << 16) ^ (uint32_t) golioth_sys_rand();
+
+    return prefix ? prefix : 1;
+}
+
+static void token_from_parts(uint8_t token[GOLIOTH_COAP_TOKEN_LEN], uint32_t prefix, uint32_t count)
+{
+    uint64_t value = ((uint64_t) prefix << 32) | count;
+    memcpy(token, &value, GOLIOTH_COAP_TOKEN_LEN);
+}
+
+#if defined(TOKEN_LOCK_FREE)
+
+void golioth_coap_next_token(uint8_t token[GOLIOTH_COAP_TOKEN_LEN])
+{
+    uint32_t prefix = atomic_load_explicit(&token_prefix, memory_order_relaxed);
+    if (prefix == 0)
+    {
+        // Threads racing for the first token agree on whichever prefix is stored first
+        uint32_t new_prefix = random_prefix();
+        if (atomic_compare_exchange_strong_explicit(&token_prefix,
+                                                    &prefix,
+                                                    new_prefix,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed))
+        {
+            prefix = new_prefix;
+        }
+    }
+
+    uint32_t count = atomic_fetch_add_explicit(&token_count, 1, memory_order_relaxed);
+
+    token_from_parts(token, prefix, count);
+}
+
+#else /* TOKEN_LOCK_FREE */
+
+void golioth_coap_next_token(uint8_t token[GOLIOTH_COAP_TOKEN_LEN])
+{
+    golioth_sys_mutex_lock(token_mut, GOLIOTH_SYS_WAIT_FOREVER);
+
+    if (token_prefix == 0)
+    {
+        token_prefix = random_prefix();
+    }
+
+    token_from_parts(token, token_prefix, token_count++);
+
+    golioth_sys_mutex_unlock(token_mut);
+}
+
+#endif /* TOKEN_LOCK_FREE */
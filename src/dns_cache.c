@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "dns_cache.h"
+#include <string.h>
+
+#define SAVE_FORMAT_VERSION 2
+/// Saved without the remaining TTL, loaded stale
+#define SAVE_FORMAT_VERSION_NO_TTL 1
+#define SAVED_ADDR_SIZE (1 + sizeof(((struct golioth_dns_cache_addr *) 0)->addr))
+
+static size_t addr_len(uint8_t family)
+{
+    return (family == GOLIOTH_DNS_CACHE_IPV4) ? 4 : 16;
+}
+
+static bool addr_equal(const struct golioth_dns_cache_addr *a,
+                       const struct golioth_dns_cache_addr *b)
+{
+    return a->family == b->family && 0 == memcmp(a->addr, b->addr, addr_len(a->family));
+}
+
+static bool addr_valid(const struct golioth_dns_cache_addr *addr)
+{
+    return addr->family == GOLIOTH_DNS_CACHE_IPV4 || addr->family == GOLIOTH_DNS_CACHE_IPV6;
+}
+
+static int find_addr(const struct golioth_dns_cache *cache,
+                     const struct golioth_dns_cache_addr *addr)
+{
+    for (size_t i = 0; i < cache->num_addrs; i++)
+    {
+        if (addr_equal(&cache->addrs[i], addr))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// Move the address at index @p from to index @p to, shifting the ones in between
+static void move_addr(struct golioth_dns_cache *cache, size_t from, size_t to)
+{
+    struct golioth_dns_cache_addr addr = cache->addrs[from];
+
+    if (from < to)
+    {
+        memmove(&cache->addrs[from], &cache->addrs[from + 1], (to - from) * sizeof(addr));
+    }
+    else if (from > to)
+    {
+        memmove(&cache->addrs[to + 1], &cache->addrs[to], (from - to) * sizeof(addr));
+    }
+
+    cache->addrs[to] = addr;
+}
+
+enum golioth_status golioth_dns_cache_init(struct golioth_dns_cache *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+
+    cache->lock = golioth_sys_mutex_create();
+    if (!cache->lock)
+    {
+        return GOLIOTH_ERR_MEM_ALLOC;
+    }
+
+    return GOLIOTH_OK;
+}
+
+void golioth_dns_cache_deinit(struct golioth_dns_cache *cache)
+{
+    if (cache->lock)
+    {
+        golioth_sys_mutex_destroy(cache->lock);
+    }
+    memset(cache, 0, sizeof(*cache));
+}
+
+void golioth_dns_cache_store(struct golioth_dns_cache *cache,
+                             const struct golioth_dns_cache_addr *addrs,
+                             size_t num_addrs,
+                             uint32_t ttl_s)
+{
+    struct golioth_dns_cache_addr sorted[CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS];
+    size_t num_sorted = 0;
+    size_t next_of_family[2] = {0, 0};
+    uint8_t families[2];
+
+    if (num_addrs == 0)
+    {
+        return;
+    }
+
+    // Alternate between families, starting with the one preferred by the resolver
+    families[0] = addrs[0].family;
+    families[1] = (families[0] == GOLIOTH_DNS_CACHE_IPV4) ? GOLIOTH_DNS_CACHE_IPV6
+                                                           : GOLIOTH_DNS_CACHE_IPV4;
+
+    for (size_t turn = 0; num_sorted < CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS; turn++)
+    {
+        size_t f = turn % 2;
+        size_t i = next_of_family[f];
+        while (i < num_addrs && addrs[i].family != families[f])
+        {
+            i++;
+        }
+
+        if (i < num_addrs)
+        {
+            sorted[num_sorted++] = addrs[i];
+            next_of_family[f] = i + 1;
+        }
+        else if (next_of_family[f] >= num_addrs && next_of_family[!f] >= num_addrs)
+        {
+            break;
+        }
+        else
+        {
+            next_of_family[f] = num_addrs;
+        }
+    }
+
+    if (ttl_s > CONFIG_GOLIOTH_DNS_CACHE_TTL_S)
+    {
+        ttl_s = CONFIG_GOLIOTH_DNS_CACHE_TTL_S;
+    }
+
+    golioth_sys_mutex_lock(cache->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    struct golioth_dns_cache_addr good = cache->addrs[0];
+    bool had_good = cache->first_is_good && cache->num_addrs > 0;
+
+    memcpy(cache->addrs, sorted, num_sorted * sizeof(sorted[0]));
+    cache->num_addrs = num_sorted;
+    cache->expires_ms = golioth_sys_now_ms() + (uint64_t) ttl_s * 1000;
+    cache->first_is_good = false;
+
+    if (had_good)
+    {
+        int i = find_addr(cache, &good);
+        if (i >= 0)
+        {
+            move_addr(cache, i, 0);
+            cache->first_is_good = true;
+        }
+    }
+
+    golioth_sys_mutex_unlock(cache->lock);
+}
+
+size_t golioth_dns_cache_lookup(struct golioth_dns_cache *cache,
+                                bool include_stale,
+                                struct golioth_dns_cache_addr *addrs,
+                                size_t max_addrs)
+{
+    size_t num_addrs = 0;
+
+    golioth_sys_mutex_lock(cache->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    if (include_stale || golioth_sys_now_ms() < cache->expires_ms)
+    {
+        num_addrs = (cache->num_addrs < max_addrs) ? cache->num_addrs : max_addrs;
+        memcpy(addrs, cache->addrs, num_addrs * sizeof(addrs[0]));
+    }
+
+    golioth_sys_mutex_unlock(cache->lock);
+
+    return num_addrs;
+}
+
+void golioth_dns_cache_mark_good(struct golioth_dns_cache *cache,
+                                 const struct golioth_dns_cache_addr *addr)
+{
+    golioth_sys_mutex_lock(cache->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    int i = find_addr(cache, addr);
+    if (i >= 0)
+    {
+        move_addr(cache, i, 0);
+        cache->first_is_good = true;
+    }
+
+    golioth_sys_mutex_unlock(cache->lock);
+}
+
+void golioth_dns_cache_mark_bad(struct golioth_dns_cache *cache,
+                                const struct golioth_dns_cache_addr *addr)
+{
+    golioth_sys_mutex_lock(cache->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    int i = find_addr(cache, addr);
+    if (i >= 0)
+    {
+        if (i == 0)
+        {
+            cache->first_is_good = false;
+        }
+        move_addr(cache, i, cache->num_addrs - 1);
+    }
+
+    golioth_sys_mutex_unlock(cache->lock);
+}
+
+size_t golioth_dns_cache_save(struct golioth_dns_cache *cache, uint8_t *buf, size_t buf_size)
+{
+    size_t len = 0;
+
+    golioth_sys_mutex_lock(cache->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    if (cache->num_addrs == 0 || buf_size < 6 + cache->num_addrs * SAVED_ADDR_SIZE)
+    {
+        goto finish;
+    }
+
+    // Seconds the addresses stay fresh for, so they can be used without resolving after a reboot
+    uint64_t now_ms = golioth_sys_now_ms();
+    uint32_t ttl_s = (now_ms < cache->expires_ms) ? (cache->expires_ms - now_ms) / 1000 : 0;
+
+    buf[len++] = SAVE_FORMAT_VERSION;
+    buf[len++] = cache->num_addrs;
+    buf[len++] = ttl_s >> 24;
+    buf[len++] = ttl_s >> 16;
+    buf[len++] = ttl_s >> 8;
+    buf[len++] = ttl_s;
+    for (size_t i = 0; i < cache->num_addrs; i++)
+    {
+        buf[len++] = cache->addrs[i].family;
+        memcpy(&buf[len], cache->addrs[i].addr, sizeof(cache->addrs[i].addr));
+        len += sizeof(cache->addrs[i].addr);
+    }
+
+finish:
+    golioth_sys_mutex_unlock(cache->lock);
+
+    return len;
+}
+
+enum golioth_status golioth_dns_cache_load(struct golioth_dns_cache *cache,
+                                           const uint8_t *buf,
+                                           size_t len)
+{
+    struct golioth_dns_cache_addr addrs[CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS];
+    size_t num_addrs;
+    size_t header_len;
+    uint32_t ttl_s = 0;
+
+    if (len >= 6 && buf[0] == SAVE_FORMAT_VERSION)
+    {
+        header_len = 6;
+        ttl_s = ((uint32_t) buf[2] << 24) | ((uint32_t) buf[3] << 16) | ((uint32_t) buf[4] << 8)
+            | buf[5];
+    }
+    else if (len >= 2 && buf[0] == SAVE_FORMAT_VERSION_NO_TTL)
+    {
+        header_len = 2;
+    }
+    else
+    {
+        return GOLIOTH_ERR_INVALID_FORMAT;
+    }
+
+    if (len != header_len + buf[1] * SAVED_ADDR_SIZE)
+    {
+        return GOLIOTH_ERR_INVALID_FORMAT;
+    }
+
+    if (ttl_s > CONFIG_GOLIOTH_DNS_CACHE_TTL_S)
+    {
+        ttl_s = CONFIG_GOLIOTH_DNS_CACHE_TTL_S;
+    }
+
+    // Saved with a larger CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS, keep the preferred ones
+    num_addrs = (buf[1] < CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS) ? buf[1]
+                                                             : CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS;
+
+    for (size_t i = 0; i < num_addrs; i++)
+    {
+        const uint8_t *saved = &buf[header_len + i * SAVED_ADDR_SIZE];
+        addrs[i].family = saved[0];
+        memcpy(addrs[i].addr, &saved[1], sizeof(addrs[i].addr));
+        if (!addr_valid(&addrs[i]))
+        {
+            return GOLIOTH_ERR_INVALID_FORMAT;
+        }
+    }
+
+    golioth_sys_mutex_lock(cache->lock, GOLIOTH_SYS_WAIT_FOREVER);
+
+    memcpy(cache->addrs, addrs, num_addrs * sizeof(addrs[0]));
+    cache->num_addrs = num_addrs;
+    // The time between saving and loading isn't known, so the addresses may be used for a little
+    // longer than their TTL
+    cache->expires_ms = (ttl_s > 0) ? golioth_sys_now_ms() + (uint64_t) ttl_s * 1000 : 0;
+    // The first address was the preferred one when saved, keep it first after resolving again
+    cache->first_is_good = (num_addrs > 0);
+
+    golioth_sys_mutex_unlock(cache->lock);
+
+    return GOLIOTH_OK;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <golioth/config.h>
+#include <golioth/golioth_status.h>
+#include <golioth/golioth_sys.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Cache of the addresses the Golioth server hostname resolves to.
+///
+/// Addresses are kept in the order they should be tried when connecting:
+///
+///  - IPv6 and IPv4 addresses alternate (RFC 8305 section 4), starting with the family the
+///    resolver returned first, so a broken family costs a single failed attempt,
+///  - the last address a session was established with is tried first,
+///  - addresses that failed are moved to the back.
+///
+/// Entries expire after their TTL. Expired entries are stale: the hostname is resolved again, and
+/// stale addresses are only used if resolving fails (RFC 8767 "serve-stale").
+///
+/// Addresses are stored in a stack-independent format, so the cache can be saved with
+/// golioth_dns_cache_save() and restored after a reboot with golioth_dns_cache_load(), along with
+/// the TTL they had left.
+///
+/// All functions are thread-safe.
+
+enum golioth_dns_cache_family
+{
+    GOLIOTH_DNS_CACHE_IPV4 = 4,
+    GOLIOTH_DNS_CACHE_IPV6 = 6,
+};
+
+struct golioth_dns_cache_addr
+{
+    /// enum golioth_dns_cache_family
+    uint8_t family;
+    /// Network byte order. Only the first 4 bytes are used for IPv4.
+    uint8_t addr[16];
+};
+
+struct golioth_dns_cache
+{
+    golioth_sys_mutex_t lock;
+    struct golioth_dns_cache_addr addrs[CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS];
+    size_t num_addrs;
+    /// golioth_sys_now_ms() at which the addresses become stale. 0 if already stale.
+    uint64_t expires_ms;
+    /// Whether a session was established with addrs[0]
+    bool first_is_good;
+};
+
+/// Size of the buffer needed by golioth_dns_cache_save()
+#define GOLIOTH_DNS_CACHE_SAVE_SIZE \
+    (6 + CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS * sizeof(struct golioth_dns_cache_addr))
+
+/// Initialize an empty cache
+///
+/// @param cache The cache
+///
+/// @retval GOLIOTH_OK cache initialized
+/// @retval GOLIOTH_ERR_MEM_ALLOC failed to create the lock
+enum golioth_status golioth_dns_cache_init(struct golioth_dns_cache *cache);
+
+/// Free the resources of the cache
+///
+/// @param cache The cache
+void golioth_dns_cache_deinit(struct golioth_dns_cache *cache);
+
+/// Replace the cached addresses with the result of a resolution
+///
+/// Addresses beyond CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS, after interleaving, are dropped. If the
+/// address of the last established session is among @p addrs, it stays first.
+///
+/// @param cache The cache
+/// @param addrs Resolved addresses, in the order returned by the resolver
+/// @param num_addrs Number of addresses in @p addrs
+/// @param ttl_s Time to live of the addresses, in seconds. Capped to
+///     CONFIG_GOLIOTH_DNS_CACHE_TTL_S.
+void golioth_dns_cache_store(struct golioth_dns_cache *cache,
+                             const struct golioth_dns_cache_addr *addrs,
+                             size_t num_addrs,
+                             uint32_t ttl_s);
+
+/// Get the cached addresses, in the order they should be tried
+///
+/// @param cache The cache
+/// @param include_stale Whether to return stale addresses
+/// @param[out] addrs Buffer for the addresses
+/// @param max_addrs Capacity of @p addrs
+///
+/// @return Number of addresses copied to @p addrs. 0 if there are no (fresh) addresses.
+size_t golioth_dns_cache_lookup(struct golioth_dns_cache *cache,
+                                bool include_stale,
+                                struct golioth_dns_cache_addr *addrs,
+                                size_t max_addrs);
+
+/// Record that a session was established with @p addr, so it is tried first next time
+///
+/// @param cache The cache
+/// @param addr The address
+void golioth_dns_cache_mark_good(struct golioth_dns_cache *cache,
+                                 const struct golioth_dns_cache_addr *addr);
+
+/// Record that a session could not be established with @p addr, so it is tried last next time
+///
+/// @param cache The cache
+/// @param addr The address
+void golioth_dns_cache_mark_bad(struct golioth_dns_cache *cache,
+                                const struct golioth_dns_cache_addr *addr);
+
+/// Serialize the cached addresses, to be restored with golioth_dns_cache_load()
+///
+/// @param cache The cache
+/// @param buf Output buffer
+/// @param buf_size Size of @p buf, in bytes. GOLIOTH_DNS_CACHE_SAVE_SIZE is always enough.
+///
+/// @return Number of bytes written to @p buf, 0 if the cache is empty or @p buf too small
+size_t golioth_dns_cache_save(struct golioth_dns_cache *cache, uint8_t *buf, size_t buf_size);
+
+/// Restore addresses serialized by golioth_dns_cache_save()
+///
+/// The restored addresses are fresh for the TTL they had left when saved, not counting the time
+/// between saving and loading. Once that is over, they are only used if resolving the hostname
+/// fails.
+///
+/// @param cache The cache
+/// @param buf Data returned by golioth_dns_cache_save()
+/// @param len Size of @p buf, in bytes
+///
+/// @retval GOLIOTH_OK addresses restored
+/// @retval GOLIOTH_ERR_INVALID_FORMAT @p buf is not a saved cache
+enum golioth_status golioth_dns_cache_load(struct golioth_dns_cache *cache,
+                                           const uint8_t *buf,
+                                           size_t len);
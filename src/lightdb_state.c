@@ -40,29 +40,60 @@ typedef struct
     bool is_null;
 } lightdb_get_response_t;
 
-enum golioth_status golioth_lightdb_set_int_async(struct golioth_client *client,
-                                                  const char *path,
-                                                  int32_t value,
-                                                  golioth_set_cb_fn callback,
-                                                  void *callback_arg)
+// Asynchronous sets are state: with CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_SETS,
+// a newer value replaces an older one to the same path that is still queued.
+static enum golioth_status lightdb_set_async(struct golioth_client *client,
+                                             const char *path,
+                                             enum golioth_content_type content_type,
+                                             const uint8_t *buf,
+                                             size_t buf_len,
+                                             golioth_set_cb_fn callback,
+                                             void *callback_arg)
 {
-    char buf[16] = {};
-    snprintf(buf, sizeof(buf), "%" PRId32, value);
-
     uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
     golioth_coap_next_token(token);
 
+#if defined(CONFIG_GOLIOTH_LIGHTDB_STATE_COALESCE_SETS)
+    return golioth_coap_client_set_coalesced(client,
+                                             token,
+                                             GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
+                                             path,
+                                             content_type,
+                                             buf,
+                                             buf_len,
+                                             callback,
+                                             callback_arg);
+#else
     return golioth_coap_client_set(client,
                                    token,
                                    GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
                                    path,
-                                   GOLIOTH_CONTENT_TYPE_JSON,
-                                   (const uint8_t *) buf,
-                                   strlen(buf),
+                                   content_type,
+                                   buf,
+                                   buf_len,
                                    callback,
                                    callback_arg,
                                    false,
                                    GOLIOTH_SYS_WAIT_FOREVER);
+#endif
+}
+
+enum golioth_status golioth_lightdb_set_int_async(struct golioth_client *client,
+                                                  const char *path,
+                                                  int32_t value,
+                                                  golioth_set_cb_fn callback,
+                                                  void *callback_arg)
+{
+    char buf[16] = {};
+    snprintf(buf, sizeof(buf), "%" PRId32, value);
+
+    return lightdb_set_async(client,
+                             path,
+                             GOLIOTH_CONTENT_TYPE_JSON,
+                             (const uint8_t *) buf,
+                             strlen(buf),
+                             callback,
+                             callback_arg);
 }
 
 enum golioth_status golioth_lightdb_set_bool_async(struct golioth_client *client,
@@ -73,20 +104,13 @@ enum golioth_status golioth_lightdb_set_bool_async(struct golioth_client *client
 {
     const char *valuestr = (value ? "true" : "false");
 
-    uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
-    golioth_coap_next_token(token);
-
-    return golioth_coap_client_set(client,
-                                   token,
-                                   GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
-                                   path,
-                                   GOLIOTH_CONTENT_TYPE_JSON,
-                                   (const uint8_t *) valuestr,
-                                   strlen(valuestr),
-                                   callback,
-                                   callback_arg,
-                                   false,
-                                   GOLIOTH_SYS_WAIT_FOREVER);
+    return lightdb_set_async(client,
+                             path,
+                             GOLIOTH_CONTENT_TYPE_JSON,
+                             (const uint8_t *) valuestr,
+                             strlen(valuestr),
+                             callback,
+                             callback_arg);
 }
 
 #if defined(CONFIG_GOLIOTH_LIGHTDB_STATE_FLOAT_HELPERS)
@@ -100,20 +124,13 @@ enum golioth_status golioth_lightdb_set_float_async(struct golioth_client *clien
     char buf[32] = {};
     snprintf(buf, sizeof(buf), "%f", (double) value);
 
-    uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
-    golioth_coap_next_token(token);
-
-    return golioth_coap_client_set(client,
-                                   token,
-                                   GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
-                                   path,
-                                   GOLIOTH_CONTENT_TYPE_JSON,
-                                   (const uint8_t *) buf,
-                                   strlen(buf),
-                                   callback,
-                                   callback_arg,
-                                   false,
-                                   GOLIOTH_SYS_WAIT_FOREVER);
+    return lightdb_set_async(client,
+                             path,
+                             GOLIOTH_CONTENT_TYPE_JSON,
+                             (const uint8_t *) buf,
+                             strlen(buf),
+                             callback,
+                             callback_arg);
 }
 
 #endif  // CONFIG_GOLIOTH_LIGHTDB_STATE_FLOAT_HELPERS
@@ -136,20 +153,13 @@ enum golioth_status golioth_lightdb_set_string_async(struct golioth_client *clie
     memset(buf, 0, bufsize);
     snprintf(buf, bufsize, "\"%s\"", str);
 
-    uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
-    golioth_coap_next_token(token);
-
-    enum golioth_status status = golioth_coap_client_set(client,
-                                                         token,
-                                                         GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
-                                                         path,
-                                                         GOLIOTH_CONTENT_TYPE_JSON,
-                                                         (const uint8_t *) buf,
-                                                         bufsize - 1,  // excluding NULL
-                                                         callback,
-                                                         callback_arg,
-                                                         false,
-                                                         GOLIOTH_SYS_WAIT_FOREVER);
+    enum golioth_status status = lightdb_set_async(client,
+                                                   path,
+                                                   GOLIOTH_CONTENT_TYPE_JSON,
+                                                   (const uint8_t *) buf,
+                                                   bufsize - 1,  // excluding NULL
+                                                   callback,
+                                                   callback_arg);
 
     golioth_sys_free(buf);
     return status;
@@ -162,21 +172,33 @@ enum golioth_status golioth_lightdb_set_async(struct golioth_client *client,
                                               size_t buf_len,
                                               golioth_set_cb_fn callback,
                                               void *callback_arg)
+{
+    return lightdb_set_async(client, path, content_type, buf, buf_len, callback, callback_arg);
+}
+
+enum golioth_status golioth_lightdb_set_async_with_policy(
+    struct golioth_client *client,
+    const char *path,
+    enum golioth_content_type content_type,
+    const uint8_t *buf,
+    size_t buf_len,
+    const struct golioth_request_policy *policy,
+    golioth_set_cb_fn callback,
+    void *callback_arg)
 {
     uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
     golioth_coap_next_token(token);
 
-    return golioth_coap_client_set(client,
-                                   token,
-                                   GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
-                                   path,
-                                   content_type,
-                                   buf,
-                                   buf_len,
-                                   callback,
-                                   callback_arg,
-                                   false,
-                                   GOLIOTH_SYS_WAIT_FOREVER);
+    return golioth_coap_client_set_with_policy(client,
+                                               token,
+                                               GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
+                                               path,
+                                               content_type,
+                                               buf,
+                                               buf_len,
+                                               policy,
+                                               callback,
+                                               callback_arg);
 }
 
 enum golioth_status golioth_lightdb_get_async(struct golioth_client *client,
@@ -199,6 +221,27 @@ enum golioth_status golioth_lightdb_get_async(struct golioth_client *client,
                                    GOLIOTH_SYS_WAIT_FOREVER);
 }
 
+enum golioth_status golioth_lightdb_get_async_with_policy(
+    struct golioth_client *client,
+    const char *path,
+    enum golioth_content_type content_type,
+    const struct golioth_request_policy *policy,
+    golioth_get_cb_fn callback,
+    void *callback_arg)
+{
+    uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
+    golioth_coap_next_token(token);
+
+    return golioth_coap_client_get_with_policy(client,
+                                               token,
+                                               GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
+                                               path,
+                                               content_type,
+                                               policy,
+                                               callback,
+                                               callback_arg);
+}
+
 enum golioth_status golioth_lightdb_delete_async(struct golioth_client *client,
                                                  const char *path,
                                                  golioth_set_cb_fn callback,
@@ -213,6 +256,21 @@ enum golioth_status golioth_lightdb_delete_async(struct golioth_client *client,
                                       GOLIOTH_SYS_WAIT_FOREVER);
 }
 
+enum golioth_status golioth_lightdb_delete_async_with_policy(
+    struct golioth_client *client,
+    const char *path,
+    const struct golioth_request_policy *policy,
+    golioth_set_cb_fn callback,
+    void *callback_arg)
+{
+    return golioth_coap_client_delete_with_policy(client,
+                                                  GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
+                                                  path,
+                                                  policy,
+                                                  callback,
+                                                  callback_arg);
+}
+
 enum golioth_status golioth_lightdb_observe_async(struct golioth_client *client,
                                                   const char *path,
                                                   enum golioth_content_type content_type,
@@ -231,6 +289,20 @@ enum golioth_status golioth_lightdb_observe_async(struct golioth_client *client,
                                        arg);
 }
 
+enum golioth_status golioth_lightdb_observe_cancel(struct golioth_client *client,
+                                                   const char *path,
+                                                   enum golioth_content_type content_type,
+                                                   golioth_get_cb_fn callback,
+                                                   void *callback_arg)
+{
+    return golioth_coap_client_observe_cancel(client,
+                                              GOLIOTH_LIGHTDB_STATE_PATH_PREFIX,
+                                              path,
+                                              content_type,
+                                              callback,
+                                              callback_arg);
+}
+
 enum golioth_status golioth_lightdb_set_int_sync(struct golioth_client *client,
                                                  const char *path,
                                                  int32_t value,
@@ -11,48 +11,244 @@
 
 LOG_TAG_DEFINE(golioth_mbox);
 
+#if defined(CONFIG_GOLIOTH_MBOX_LOCKLESS)
+
+static size_t level_init(mpsc_ringbuf_t *ringbuf, size_t num_items, size_t item_size)
+{
+    uint32_t num_slots = mpsc_ringbuf_num_slots(num_items);
+
+    // Allocate storage for the items and sequence numbers in the ringbuffer
+    size_t bufsize = num_slots * item_size;
+    uint8_t *buffer = (uint8_t *) golioth_sys_malloc(bufsize);
+    assert(buffer);
+    memset(buffer, 0, bufsize);
+
+    _Atomic uint32_t *slot_seq =
+        (_Atomic uint32_t *) golioth_sys_malloc(num_slots * sizeof(_Atomic uint32_t));
+    assert(slot_seq);
+
+    mpsc_ringbuf_init(ringbuf, buffer, slot_seq, num_slots, num_items, item_size);
+
+    assert(mpsc_ringbuf_capacity(ringbuf) == num_items);
+    assert(mpsc_ringbuf_size(ringbuf) == 0);
+
+    return bufsize;
+}
+
+static void level_deinit(mpsc_ringbuf_t *ringbuf)
+{
+    golioth_sys_free(ringbuf->buffer);
+    golioth_sys_free((void *) ringbuf->slot_seq);
+}
+
+#else /* CONFIG_GOLIOTH_MBOX_LOCKLESS */
+
+static size_t level_init(ringbuf_t *ringbuf, size_t num_items, size_t item_size)
+{
+    // Allocate storage for the items in the ringbuffer
+    size_t bufsize = RINGBUF_BUFFER_SIZE(item_size, num_items);
+    ringbuf->buffer = (uint8_t *) golioth_sys_malloc(bufsize);
+    assert(ringbuf->buffer);
+    memset(ringbuf->buffer, 0, bufsize);
+
+    ringbuf->buffer_size = bufsize;
+    ringbuf->item_size = item_size;
+
+    assert(ringbuf_capacity(ringbuf) == num_items);
+    assert(ringbuf_size(ringbuf) == 0);
+
+    return bufsize;
+}
+
+static void level_deinit(ringbuf_t *ringbuf)
+{
+    golioth_sys_free(ringbuf->buffer);
+}
+
+#endif /* CONFIG_GOLIOTH_MBOX_LOCKLESS */
+
 golioth_mbox_t golioth_mbox_create(size_t num_items, size_t item_size)
 {
+    return golioth_mbox_create_prio(&num_items, 1, item_size);
+}
+
+golioth_mbox_t golioth_mbox_create_prio(const size_t *num_items,
+                                        size_t num_prios,
+                                        size_t item_size)
+{
+    assert(num_prios > 0);
+
     golioth_mbox_t new_mbox = (golioth_mbox_t) golioth_sys_malloc(sizeof(struct golioth_mbox));
     assert(new_mbox);
     memset(new_mbox, 0, sizeof(struct golioth_mbox));
 
-    // Allocate storage for the items in the ringbuffer
-    size_t bufsize = RINGBUF_BUFFER_SIZE(item_size, num_items);
-    new_mbox->ringbuf.buffer = (uint8_t *) golioth_sys_malloc(bufsize);
-    assert(new_mbox->ringbuf.buffer);
-    memset(new_mbox->ringbuf.buffer, 0, bufsize);
+    new_mbox->ringbufs = golioth_sys_malloc(num_prios * sizeof(new_mbox->ringbufs[0]));
+    assert(new_mbox->ringbufs);
+    memset(new_mbox->ringbufs, 0, num_prios * sizeof(new_mbox->ringbufs[0]));
+    new_mbox->num_prios = num_prios;
 
-    new_mbox->ringbuf.buffer_size = bufsize;
-    new_mbox->ringbuf.item_size = item_size;
-    new_mbox->fill_count_sem = golioth_sys_sem_create(num_items, 0);
-    new_mbox->ringbuf_mutex = golioth_sys_sem_create(1, 1);
+    size_t total_items = 0;
+    size_t total_bufsize = 0;
 
-    assert(ringbuf_capacity(&new_mbox->ringbuf) == num_items);
-    assert(ringbuf_size(&new_mbox->ringbuf) == 0);
+    for (size_t i = 0; i < num_prios; i++)
+    {
+        total_bufsize += level_init(&new_mbox->ringbufs[i], num_items[i], item_size);
+        total_items += num_items[i];
+    }
+
+    new_mbox->fill_count_sem = golioth_sys_sem_create(total_items, 0);
+#if defined(CONFIG_GOLIOTH_MBOX_LOCKLESS)
+    atomic_init(&new_mbox->num_items, 0);
+#else
+    new_mbox->ringbuf_mutex = golioth_sys_sem_create(1, 1);
+#endif
 
     GLTH_LOGI(TAG,
-              "Mbox created, bufsize: %" PRIu32 ", num_items: %" PRIu32 ", item_size: %" PRIu32,
-              (uint32_t) bufsize,
-              (uint32_t) num_items,
-              (uint32_t) item_size);
+              "Mbox created, bufsize: %" PRIu32 ", num_items: %" PRIu32 ", item_size: %" PRIu32
+              ", num_prios: %" PRIu32,
+              (uint32_t) total_bufsize,
+              (uint32_t) total_items,
+              (uint32_t) item_size,
+              (uint32_t) num_prios);
 
     return new_mbox;
 }
 
+bool golioth_mbox_try_send(golioth_mbox_t mbox, const void *item)
+{
+    return golioth_mbox_try_send_prio(mbox, item, 0);
+}
+
+bool golioth_mbox_recv(golioth_mbox_t mbox, void *item, int32_t timeout_ms)
+{
+    return (golioth_mbox_recv_batch(mbox, item, 1, timeout_ms) == 1);
+}
+
+#if defined(CONFIG_GOLIOTH_MBOX_LOCKLESS)
+
 size_t golioth_mbox_num_messages(golioth_mbox_t mbox)
 {
     assert(mbox);
-    return ringbuf_size(&mbox->ringbuf);
+
+    int32_t num_items = atomic_load(&mbox->num_items);
+    return (num_items > 0) ? (size_t) num_items : 0;
 }
 
-bool golioth_mbox_try_send(golioth_mbox_t mbox, const void *item)
+bool golioth_mbox_try_send_prio(golioth_mbox_t mbox, const void *item, size_t prio)
+{
+    assert(mbox);
+    assert(prio < mbox->num_prios);
+
+    bool sent = mpsc_ringbuf_put(&mbox->ringbufs[prio], item);
+
+    // Only wake up the consumer if the mbox was empty. Otherwise it will pick
+    // this item up before it waits again.
+    if (sent && atomic_fetch_add(&mbox->num_items, 1) == 0)
+    {
+        bool ret = golioth_sys_sem_give(mbox->fill_count_sem);
+        (void) ret;
+        assert(ret);
+    }
+
+    return sent;
+}
+
+static size_t get_batch_highest_prio(golioth_mbox_t mbox, void *items, size_t max_items)
+{
+    size_t item_size = mbox->ringbufs[0].item_size;
+    size_t num_items = 0;
+
+    for (size_t i = 0; i < mbox->num_prios && num_items < max_items; i++)
+    {
+        num_items += mpsc_ringbuf_get_batch(&mbox->ringbufs[i],
+                                            (uint8_t *) items + num_items * item_size,
+                                            max_items - num_items);
+    }
+    return num_items;
+}
+
+size_t golioth_mbox_recv_batch(golioth_mbox_t mbox,
+                               void *items,
+                               size_t max_items,
+                               int32_t timeout_ms)
 {
     assert(mbox);
 
+    if (max_items == 0)
+    {
+        return 0;
+    }
+
+    uint64_t deadline_ms = (timeout_ms > 0) ? golioth_sys_now_ms() + timeout_ms : 0;
+
+    while (true)
+    {
+        size_t num_items = get_batch_highest_prio(mbox, items, max_items);
+        if (num_items > 0)
+        {
+            if (atomic_fetch_sub(&mbox->num_items, (int32_t) num_items) == (int32_t) num_items)
+            {
+                // The mbox is now empty. Drain the wakeup that was given when it
+                // became non-empty, unless we already took it while waiting, so
+                // fill_count_sem's fd doesn't stay readable.
+                if (!mbox->fill_count_taken)
+                {
+                    golioth_sys_sem_take(mbox->fill_count_sem, 0);
+                }
+                mbox->fill_count_taken = false;
+            }
+            return num_items;
+        }
+
+        if (atomic_load(&mbox->num_items) > 0)
+        {
+            // An item has been published behind a slot that another producer
+            // has claimed but not finished writing yet. The item is already
+            // queued, so wait for the producer regardless of timeout_ms.
+            for (size_t i = 0; i < mbox->num_prios; i++)
+            {
+                mpsc_ringbuf_wait_published(&mbox->ringbufs[i]);
+            }
+            continue;
+        }
+
+        int32_t remaining_ms = timeout_ms;
+        if (timeout_ms > 0)
+        {
+            uint64_t now_ms = golioth_sys_now_ms();
+            remaining_ms = (now_ms < deadline_ms) ? (int32_t) (deadline_ms - now_ms) : 0;
+        }
+
+        if (!golioth_sys_sem_take(mbox->fill_count_sem, remaining_ms))
+        {
+            return 0;
+        }
+        mbox->fill_count_taken = true;
+    }
+}
+
+#else /* CONFIG_GOLIOTH_MBOX_LOCKLESS */
+
+size_t golioth_mbox_num_messages(golioth_mbox_t mbox)
+{
+    assert(mbox);
+
+    size_t num_messages = 0;
+    for (size_t i = 0; i < mbox->num_prios; i++)
+    {
+        num_messages += ringbuf_size(&mbox->ringbufs[i]);
+    }
+    return num_messages;
+}
+
+bool golioth_mbox_try_send_prio(golioth_mbox_t mbox, const void *item, size_t prio)
+{
+    assert(mbox);
+    assert(prio < mbox->num_prios);
+
     bool ret = golioth_sys_sem_take(mbox->ringbuf_mutex, GOLIOTH_SYS_WAIT_FOREVER);
     assert(ret);
-    bool sent = ringbuf_put(&mbox->ringbuf, item);
+    bool sent = ringbuf_put(&mbox->ringbufs[prio], item);
     golioth_sys_sem_give(mbox->ringbuf_mutex);
 
     if (sent)
@@ -64,26 +260,56 @@ bool golioth_mbox_try_send(golioth_mbox_t mbox, const void *item)
     return sent;
 }
 
-bool golioth_mbox_recv(golioth_mbox_t mbox, void *item, int32_t timeout_ms)
+size_t golioth_mbox_recv_batch(golioth_mbox_t mbox,
+                               void *items,
+                               size_t max_items,
+                               int32_t timeout_ms)
 {
     assert(mbox);
-    bool received = golioth_sys_sem_take(mbox->fill_count_sem, timeout_ms);
-    if (received)
+
+    if (max_items == 0 || !golioth_sys_sem_take(mbox->fill_count_sem, timeout_ms))
     {
-        bool ret = ringbuf_get(&mbox->ringbuf, item);
-        (void) ret;
-        assert(ret);
+        return 0;
+    }
+
+    // Each item has one count in fill_count_sem, so take a count for every
+    // other item we can receive without waiting.
+    size_t num_items = 1;
+    while (num_items < max_items && golioth_sys_sem_take(mbox->fill_count_sem, 0))
+    {
+        num_items++;
+    }
+
+    // Items are put in the ringbuffer before fill_count_sem is given, so
+    // the levels are guaranteed to have at least num_items items.
+    size_t item_size = mbox->ringbufs[0].item_size;
+    size_t num_received = 0;
+    for (size_t i = 0; i < mbox->num_prios && num_received < num_items; i++)
+    {
+        num_received += ringbuf_get_batch(&mbox->ringbufs[i],
+                                          (uint8_t *) items + num_received * item_size,
+                                          num_items - num_received);
     }
-    return received;
+    assert(num_received == num_items);
+
+    return num_items;
 }
 
+#endif /* CONFIG_GOLIOTH_MBOX_LOCKLESS */
+
 void golioth_mbox_destroy(golioth_mbox_t mbox)
 {
     assert(mbox);
     // free stuff in the mbox
-    golioth_sys_free(mbox->ringbuf.buffer);
+    for (size_t i = 0; i < mbox->num_prios; i++)
+    {
+        level_deinit(&mbox->ringbufs[i]);
+    }
+    golioth_sys_free(mbox->ringbufs);
     golioth_sys_sem_destroy(mbox->fill_count_sem);
+#if !defined(CONFIG_GOLIOTH_MBOX_LOCKLESS)
     golioth_sys_sem_destroy(mbox->ringbuf_mutex);
+#endif
     // free the mbox itself
     golioth_sys_free(mbox);
 }
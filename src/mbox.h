@@ -7,6 +7,9 @@
 
 #include <golioth/golioth_sys.h>
 #include "ringbuf.h"
+#if defined(CONFIG_GOLIOTH_MBOX_LOCKLESS)
+#include "mpsc_ringbuf.h"
+#endif
 
 /// A multi-producer, single-consumer queue.
 ///
@@ -14,17 +17,49 @@
 /// signaling when queue has items, so the consumer can be efficiently notified.
 /// The mutex is for preventing multiple producers from accessing the ringbuffer
 /// at once.
+///
+/// An mbox can have several priority levels, each with its own ringbuffer and
+/// capacity. Level 0 is the highest priority. The consumer always receives from
+/// the highest priority level that has items, in FIFO order within a level.
+///
+/// With CONFIG_GOLIOTH_MBOX_LOCKLESS, producers don't take a mutex. Each level
+/// is a lock-free mpsc_ringbuf_t, and fill_count_sem is only given when an item
+/// is added to an empty mbox, i.e. when the consumer may be waiting for it.
+/// While the mbox is non-empty, fill_count_sem has (at most) one count, so its
+/// fd can still be polled to find out whether there are items.
 
 struct golioth_mbox
 {
-    ringbuf_t ringbuf;
-    golioth_sys_sem_t fill_count_sem;
+#if defined(CONFIG_GOLIOTH_MBOX_LOCKLESS)
+    mpsc_ringbuf_t *ringbufs;
+    /// Number of published items, in all levels
+    _Atomic int32_t num_items;
+    /// (consumer only) fill_count_sem was taken since the mbox was last empty
+    bool fill_count_taken;
+#else
+    ringbuf_t *ringbufs;
     golioth_sys_sem_t ringbuf_mutex;
+#endif
+    size_t num_prios;
+    golioth_sys_sem_t fill_count_sem;
 };
 typedef struct golioth_mbox *golioth_mbox_t;
 
 golioth_mbox_t golioth_mbox_create(size_t num_items, size_t item_size);
+golioth_mbox_t golioth_mbox_create_prio(const size_t *num_items,
+                                        size_t num_prios,
+                                        size_t item_size);
 size_t golioth_mbox_num_messages(golioth_mbox_t mbox);
 bool golioth_mbox_try_send(golioth_mbox_t mbox, const void *item);
+bool golioth_mbox_try_send_prio(golioth_mbox_t mbox, const void *item, size_t prio);
 bool golioth_mbox_recv(golioth_mbox_t mbox, void *item, int32_t timeout_ms);
+/// Receive up to max_items items, highest priority first, into consecutive
+/// elements of items. Waits up to timeout_ms in total for the first item only,
+/// returns right away if timeout_ms is 0.
+///
+/// @return number of items received, 0 on timeout
+size_t golioth_mbox_recv_batch(golioth_mbox_t mbox,
+                               void *items,
+                               size_t max_items,
+                               int32_t timeout_ms);
 void golioth_mbox_destroy(golioth_mbox_t mbox);
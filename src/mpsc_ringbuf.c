@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <golioth/config.h>
+
+#if defined(CONFIG_GOLIOTH_MBOX_LOCKLESS)
+
+#include "mpsc_ringbuf.h"
+#include <golioth/golioth_sys.h>
+#include <string.h>
+
+// Yield this many times to a producer that is writing the oldest slot, before
+// sleeping. Yielding only lets threads of the same or higher priority run.
+#define WAIT_PUBLISHED_NUM_YIELDS 16
+
+/// A slot at position pos (modulo num_slots) is:
+///  - free for the producer claiming pos,  when slot_seq == pos
+///  - published for the consumer,          when slot_seq == pos + 1
+/// After reading, the consumer sets slot_seq to pos + num_slots, which frees
+/// the slot for the producer that claims it on the next lap.
+
+uint32_t mpsc_ringbuf_num_slots(size_t max_num_items)
+{
+    // At least two slots, so "free for pos + 1" and "published for pos" differ
+    uint32_t num_slots = 2;
+    while (num_slots < max_num_items)
+    {
+        num_slots <<= 1;
+    }
+    return num_slots;
+}
+
+void mpsc_ringbuf_init(mpsc_ringbuf_t *ringbuf,
+                       uint8_t *buffer,
+                       _Atomic uint32_t *slot_seq,
+                       uint32_t num_slots,
+                       size_t max_items,
+                       size_t item_size)
+{
+    ringbuf->buffer = buffer;
+    ringbuf->slot_seq = slot_seq;
+    ringbuf->num_slots = num_slots;
+    ringbuf->max_items = (uint32_t) max_items;
+    ringbuf->item_size = item_size;
+
+    for (uint32_t i = 0; i < num_slots; i++)
+    {
+        atomic_init(&slot_seq[i], i);
+    }
+    atomic_init(&ringbuf->write_index, 0);
+    atomic_init(&ringbuf->read_index, 0);
+}
+
+bool mpsc_ringbuf_put(mpsc_ringbuf_t *ringbuf, const void *item)
+{
+    if (!item)
+    {
+        return false;
+    }
+
+    uint32_t mask = ringbuf->num_slots - 1;
+    uint32_t pos = atomic_load_explicit(&ringbuf->write_index, memory_order_relaxed);
+
+    while (true)
+    {
+        uint32_t seq = atomic_load_explicit(&ringbuf->slot_seq[pos & mask], memory_order_acquire);
+        int32_t diff = (int32_t) (seq - pos);
+
+        if (diff == 0)
+        {
+            // Items up to pos may still be held, even though their slots are
+            // free. read_index only moves forward, so this never lets more
+            // than max_items in.
+            uint32_t read_index =
+                atomic_load_explicit(&ringbuf->read_index, memory_order_acquire);
+            if (pos - read_index >= ringbuf->max_items)
+            {
+                return false;
+            }
+
+            // Slot is free, try to claim it. On failure pos is reloaded.
+            if (atomic_compare_exchange_weak_explicit(&ringbuf->write_index,
+                                                      &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // Slot from the previous lap hasn't been read yet
+            return false;
+        }
+        else
+        {
+            // Another producer claimed this slot first
+            pos = atomic_load_explicit(&ringbuf->write_index, memory_order_relaxed);
+        }
+    }
+
+    memcpy(ringbuf->buffer + (pos & mask) * ringbuf->item_size, item, ringbuf->item_size);
+    atomic_store_explicit(&ringbuf->slot_seq[pos & mask], pos + 1, memory_order_release);
+
+    return true;
+}
+
+bool mpsc_ringbuf_get(mpsc_ringbuf_t *ringbuf, void *item)
+{
+    uint32_t mask = ringbuf->num_slots - 1;
+    uint32_t pos = atomic_load_explicit(&ringbuf->read_index, memory_order_relaxed);
+    uint32_t seq = atomic_load_explicit(&ringbuf->slot_seq[pos & mask], memory_order_acquire);
+
+    if (seq != pos + 1)
+    {
+        return false;
+    }
+
+    if (item)
+    {
+        memcpy(item, ringbuf->buffer + (pos & mask) * ringbuf->item_size, ringbuf->item_size);
+    }
+
+    atomic_store_explicit(&ringbuf->slot_seq[pos & mask],
+                          pos + ringbuf->num_slots,
+                          memory_order_release);
+    atomic_store_explicit(&ringbuf->read_index, pos + 1, memory_order_release);
+
+    return true;
+}
+
+size_t mpsc_ringbuf_get_batch(mpsc_ringbuf_t *ringbuf, void *items, size_t max_items)
+{
+    uint32_t mask = ringbuf->num_slots - 1;
+    uint32_t pos = atomic_load_explicit(&ringbuf->read_index, memory_order_relaxed);
+    size_t num_items = 0;
+
+    for (; num_items < max_items; num_items++, pos++)
+    {
+        uint32_t seq = atomic_load_explicit(&ringbuf->slot_seq[pos & mask], memory_order_acquire);
+        if (seq != pos + 1)
+        {
+            break;
+        }
+
+        memcpy((uint8_t *) items + num_items * ringbuf->item_size,
+               ringbuf->buffer + (pos & mask) * ringbuf->item_size,
+               ringbuf->item_size);
+
+        atomic_store_explicit(&ringbuf->slot_seq[pos & mask],
+                              pos + ringbuf->num_slots,
+                              memory_order_release);
+    }
+
+    // Publish the new read position once for the whole batch
+    atomic_store_explicit(&ringbuf->read_index, pos, memory_order_release);
+
+    return num_items;
+}
+
+void mpsc_ringbuf_wait_published(const mpsc_ringbuf_t *ringbuf)
+{
+    uint32_t mask = ringbuf->num_slots - 1;
+    uint32_t pos = atomic_load_explicit(&ringbuf->read_index, memory_order_relaxed);
+
+    // Nothing claimed, so nothing to wait for
+    if (atomic_load_explicit(&ringbuf->write_index, memory_order_relaxed) == pos)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0;; i++)
+    {
+        uint32_t seq = atomic_load_explicit(&ringbuf->slot_seq[pos & mask], memory_order_acquire);
+        if (seq == pos + 1)
+        {
+            return;
+        }
+
+        if (i < WAIT_PUBLISHED_NUM_YIELDS)
+        {
+            golioth_sys_thread_yield();
+        }
+        else
+        {
+            golioth_sys_msleep(1);
+        }
+    }
+}
+
+size_t mpsc_ringbuf_size(const mpsc_ringbuf_t *ringbuf)
+{
+    uint32_t read_index = atomic_load_explicit(&ringbuf->read_index, memory_order_acquire);
+    uint32_t write_index = atomic_load_explicit(&ringbuf->write_index, memory_order_acquire);
+
+    return (size_t) (write_index - read_index);
+}
+
+size_t mpsc_ringbuf_capacity(const mpsc_ringbuf_t *ringbuf)
+{
+    return ringbuf->max_items;
+}
+
+#endif /* CONFIG_GOLIOTH_MBOX_LOCKLESS */
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/// A bounded, lock-free, multi-producer single-consumer ringbuffer.
+///
+/// Same idea as ringbuf_t, except that write_index and read_index are
+/// free-running counters and every slot has a sequence number:
+///
+///  - A producer claims a slot by advancing write_index with a compare-and-swap,
+///    copies its item in, then publishes it by updating the slot's sequence number.
+///  - The consumer only reads a slot once it has been published, then hands it
+///    back to producers by updating the sequence number again.
+///
+/// The number of slots is a power of two, so the counters can wrap around. Puts
+/// fail once max_items items are claimed, so the capacity is exactly what was
+/// asked for even when that isn't a power of two.
+typedef struct
+{
+    _Atomic uint32_t write_index;
+    _Atomic uint32_t read_index;
+    _Atomic uint32_t *slot_seq;
+    uint8_t *buffer;
+    uint32_t num_slots;
+    uint32_t max_items;
+    size_t item_size;
+} mpsc_ringbuf_t;
+
+/// Number of slots needed for max_num_items (rounded up to a power of two, at least 2)
+uint32_t mpsc_ringbuf_num_slots(size_t max_num_items);
+
+/// Initialize a ringbuffer.
+///
+/// @param buffer storage for num_slots items of item_size bytes
+/// @param slot_seq storage for num_slots sequence numbers
+/// @param num_slots from mpsc_ringbuf_num_slots(max_items)
+/// @param max_items maximum number of items held at once
+void mpsc_ringbuf_init(mpsc_ringbuf_t *ringbuf,
+                       uint8_t *buffer,
+                       _Atomic uint32_t *slot_seq,
+                       uint32_t num_slots,
+                       size_t max_items,
+                       size_t item_size);
+
+/// Add an item. Safe to call from any number of threads at once.
+///
+/// Returns false if max_items items are already held.
+bool mpsc_ringbuf_put(mpsc_ringbuf_t *ringbuf, const void *item);
+
+/// Remove the oldest item. Must only be called from a single consumer thread.
+///
+/// Returns false if the ringbuffer is empty, or if the oldest slot has been
+/// claimed by a producer that hasn't finished writing it yet.
+bool mpsc_ringbuf_get(mpsc_ringbuf_t *ringbuf, void *item);
+
+/// Remove up to max_items of the oldest items, copied to consecutive elements of
+/// items. Must only be called from a single consumer thread.
+///
+/// Stops at the first slot that hasn't been published yet. Returns the number
+/// of items copied.
+size_t mpsc_ringbuf_get_batch(mpsc_ringbuf_t *ringbuf, void *items, size_t max_items);
+
+/// Wait until the oldest item can be removed, if its slot has been claimed by a
+/// producer that hasn't finished writing it yet. Must only be called from the
+/// single consumer thread.
+///
+/// Returns immediately if the ringbuffer is empty or the oldest item is already
+/// published. The producer only has to copy the item in, so this yields to it
+/// first, then falls back to sleeping in case the producer has a lower priority.
+void mpsc_ringbuf_wait_published(const mpsc_ringbuf_t *ringbuf);
+
+/// Number of claimed slots, including ones that are still being written.
+size_t mpsc_ringbuf_size(const mpsc_ringbuf_t *ringbuf);
+size_t mpsc_ringbuf_capacity(const mpsc_ringbuf_t *ringbuf);
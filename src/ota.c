@@ -479,6 +479,7 @@ enum golioth_status golioth_ota_get_block_sync(struct golioth_client *client,
                                            CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_BLOCK_SIZE,
                                            on_block_rcvd,
                                            &out_params,
+                                           NULL,
                                            true,
                                            timeout_s);
 
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "payload_pool.h"
+#include <stdbool.h>
+#include <string.h>
+#include <golioth/golioth_sys.h>
+
+// Note: This allocator is used by log.c, so it must not use GLTH_LOGX
+// statements (see log.c for details).
+
+#define POOL_BLOCK_ALIGN 8
+
+_Static_assert(CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE % POOL_BLOCK_ALIGN == 0,
+               "Small block size must be a multiple of 8");
+_Static_assert(CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE % POOL_BLOCK_ALIGN == 0,
+               "Medium block size must be a multiple of 8");
+_Static_assert(CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE % POOL_BLOCK_ALIGN == 0,
+               "Large block size must be a multiple of 8");
+_Static_assert(CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE
+                       < CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE
+                   && CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE
+                          < CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE,
+               "Payload pool block sizes must be increasing");
+
+// Storage can't be zero-length, so reserve at least one block even if a class is disabled
+#define POOL_STORAGE_BLOCKS(num_blocks) ((num_blocks) > 0 ? (num_blocks) : 1)
+
+#define POOL_CLASS_STORAGE_DEFINE(name, block_size, num_blocks)                                    \
+    static _Alignas(POOL_BLOCK_ALIGN)                                                             \
+        uint8_t name##_storage[POOL_STORAGE_BLOCKS(num_blocks) * (block_size)];                   \
+    static uint16_t name##_free_list[POOL_STORAGE_BLOCKS(num_blocks)]
+
+struct pool_class
+{
+    uint8_t *storage;
+    size_t block_size;
+    size_t num_blocks;
+    // Stack of free block indices; the first (num_blocks - num_used) entries are valid
+    uint16_t *free_list;
+    size_t num_used;
+    size_t high_water;
+};
+
+POOL_CLASS_STORAGE_DEFINE(small,
+                          CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE,
+                          CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS);
+POOL_CLASS_STORAGE_DEFINE(medium,
+                          CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE,
+                          CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_NUM_BLOCKS);
+POOL_CLASS_STORAGE_DEFINE(large,
+                          CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE,
+                          CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS);
+
+// Ordered by increasing block size
+static struct pool_class _classes[GOLIOTH_PAYLOAD_POOL_NUM_CLASSES] = {
+    {
+        .storage = small_storage,
+        .block_size = CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_BLOCK_SIZE,
+        .num_blocks = CONFIG_GOLIOTH_PAYLOAD_POOL_SMALL_NUM_BLOCKS,
+        .free_list = small_free_list,
+    },
+    {
+        .storage = medium_storage,
+        .block_size = CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_BLOCK_SIZE,
+        .num_blocks = CONFIG_GOLIOTH_PAYLOAD_POOL_MEDIUM_NUM_BLOCKS,
+        .free_list = medium_free_list,
+    },
+    {
+        .storage = large_storage,
+        .block_size = CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_BLOCK_SIZE,
+        .num_blocks = CONFIG_GOLIOTH_PAYLOAD_POOL_LARGE_NUM_BLOCKS,
+        .free_list = large_free_list,
+    },
+};
+
+static golioth_sys_mutex_t _pool_mut;
+static uint32_t _hits;
+static uint32_t _misses;
+
+void golioth_payload_pool_init(void)
+{
+    /* Called by golioth_client_create(); created once, never destroyed */
+    if (_pool_mut)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < GOLIOTH_PAYLOAD_POOL_NUM_CLASSES; i++)
+    {
+        struct pool_class *pc = &_classes[i];
+
+        for (size_t block = 0; block < pc->num_blocks; block++)
+        {
+            pc->free_list[block] = (uint16_t) (pc->num_blocks - 1 - block);
+        }
+        pc->num_used = 0;
+        pc->high_water = 0;
+    }
+
+    _pool_mut = golioth_sys_mutex_create();
+}
+
+static struct pool_class *find_owning_class(const void *ptr)
+{
+    const uint8_t *p = ptr;
+
+    for (size_t i = 0; i < GOLIOTH_PAYLOAD_POOL_NUM_CLASSES; i++)
+    {
+        struct pool_class *pc = &_classes[i];
+        const uint8_t *end = pc->storage + (pc->num_blocks * pc->block_size);
+
+        if (p >= pc->storage && p < end)
+        {
+            return pc;
+        }
+    }
+
+    return NULL;
+}
+
+void *golioth_payload_pool_alloc(size_t size)
+{
+    if (size == 0)
+    {
+        return NULL;
+    }
+
+    void *block = NULL;
+
+    if (_pool_mut && golioth_sys_mutex_lock(_pool_mut, GOLIOTH_SYS_WAIT_FOREVER))
+    {
+        // Use the smallest class that fits and still has a free block
+        for (size_t i = 0; i < GOLIOTH_PAYLOAD_POOL_NUM_CLASSES && !block; i++)
+        {
+            struct pool_class *pc = &_classes[i];
+
+            if (size > pc->block_size || pc->num_used == pc->num_blocks)
+            {
+                continue;
+            }
+
+            pc->num_used++;
+            size_t top = pc->num_blocks - pc->num_used;
+            block = pc->storage + (pc->free_list[top] * pc->block_size);
+
+            if (pc->num_used > pc->high_water)
+            {
+                pc->high_water = pc->num_used;
+            }
+        }
+
+        if (block)
+        {
+            _hits++;
+        }
+        else
+        {
+            _misses++;
+        }
+
+        golioth_sys_mutex_unlock(_pool_mut);
+    }
+
+    if (!block)
+    {
+        block = golioth_sys_malloc(size);
+    }
+
+    return block;
+}
+
+void golioth_payload_pool_free(void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    struct pool_class *pc = find_owning_class(ptr);
+    if (!pc)
+    {
+        golioth_sys_free(ptr);
+        return;
+    }
+
+    size_t index = ((const uint8_t *) ptr - pc->storage) / pc->block_size;
+
+    golioth_sys_mutex_lock(_pool_mut, GOLIOTH_SYS_WAIT_FOREVER);
+    pc->free_list[pc->num_blocks - pc->num_used] = (uint16_t) index;
+    pc->num_used--;
+    golioth_sys_mutex_unlock(_pool_mut);
+}
+
+void golioth_payload_pool_get_stats(struct golioth_payload_pool_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (_pool_mut)
+    {
+        golioth_sys_mutex_lock(_pool_mut, GOLIOTH_SYS_WAIT_FOREVER);
+    }
+
+    stats->hits = _hits;
+    stats->misses = _misses;
+
+    for (size_t i = 0; i < GOLIOTH_PAYLOAD_POOL_NUM_CLASSES; i++)
+    {
+        const struct pool_class *pc = &_classes[i];
+
+        stats->classes[i].block_size = pc->block_size;
+        stats->classes[i].num_blocks = pc->num_blocks;
+        stats->classes[i].num_used = pc->num_used;
+        stats->classes[i].high_water = pc->high_water;
+    }
+
+    if (_pool_mut)
+    {
+        golioth_sys_mutex_unlock(_pool_mut);
+    }
+}
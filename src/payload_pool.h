@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <golioth/config.h>
+
+/// A size-classed, fixed-block allocator for request payloads.
+///
+/// Blocks are carved out of statically allocated arrays, one per size class,
+/// so short-lived payload buffers on the request path don't fragment the heap.
+/// Requests larger than the biggest class, or made while the matching class
+/// is exhausted, fall back to golioth_sys_malloc().
+///
+/// Thread-safe once golioth_payload_pool_init() has been called.
+
+#define GOLIOTH_PAYLOAD_POOL_NUM_CLASSES 3
+
+struct golioth_payload_pool_class_stats
+{
+    /// Size of each block in this class, in bytes
+    size_t block_size;
+    /// Total number of blocks in this class
+    size_t num_blocks;
+    /// Number of blocks currently allocated
+    size_t num_used;
+    /// Maximum number of blocks that have been allocated at the same time
+    size_t high_water;
+};
+
+struct golioth_payload_pool_stats
+{
+    /// Number of allocations served from the pool
+    uint32_t hits;
+    /// Number of allocations that fell back to golioth_sys_malloc()
+    uint32_t misses;
+    struct golioth_payload_pool_class_stats classes[GOLIOTH_PAYLOAD_POOL_NUM_CLASSES];
+};
+
+/// Initialize the pool. Safe to call more than once.
+void golioth_payload_pool_init(void);
+
+/// Allocate a buffer of at least \p size bytes.
+///
+/// @return pointer to buffer, or NULL if \p size is 0 or allocation failed
+void *golioth_payload_pool_alloc(size_t size);
+
+/// Free a buffer allocated with golioth_payload_pool_alloc(). NULL is ignored.
+void golioth_payload_pool_free(void *ptr);
+
+/// Get a snapshot of the pool statistics
+void golioth_payload_pool_get_stats(struct golioth_payload_pool_stats *stats);
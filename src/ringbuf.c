@@ -75,6 +75,38 @@ bool ringbuf_get(ringbuf_t *ringbuf, void *item)
     return ringbuf_get_internal(ringbuf, item, true);
 }
 
+/// Get up to max_items of the oldest items, copied to consecutive elements of items.
+/// Returns the number of items copied.
+size_t ringbuf_get_batch(ringbuf_t *ringbuf, void *items, size_t max_items)
+{
+    size_t num_items = ringbuf_size(ringbuf);
+    if (num_items > max_items)
+    {
+        num_items = max_items;
+    }
+    if (num_items == 0)
+    {
+        return 0;
+    }
+
+    // Copy in (at most) two chunks: up to the end of the buffer, then from the start
+    size_t first_chunk = total_items(ringbuf) - ringbuf->read_index;
+    if (first_chunk > num_items)
+    {
+        first_chunk = num_items;
+    }
+
+    const uint8_t *buffer_rd_ptr = ringbuf->buffer + ringbuf->read_index * ringbuf->item_size;
+    memcpy(items, buffer_rd_ptr, first_chunk * ringbuf->item_size);
+    memcpy((uint8_t *) items + first_chunk * ringbuf->item_size,
+           ringbuf->buffer,
+           (num_items - first_chunk) * ringbuf->item_size);
+
+    ringbuf->read_index = (ringbuf->read_index + num_items) % total_items(ringbuf);
+
+    return num_items;
+}
+
 bool ringbuf_peek(ringbuf_t *ringbuf, void *item)
 {
     return ringbuf_get_internal(ringbuf, item, false);
@@ -36,6 +36,7 @@ typedef struct
 
 bool ringbuf_put(ringbuf_t *ringbuf, const void *item);
 bool ringbuf_get(ringbuf_t *ringbuf, void *item);
+size_t ringbuf_get_batch(ringbuf_t *ringbuf, void *items, size_t max_items);
 bool ringbuf_peek(ringbuf_t *ringbuf, void *item);
 size_t ringbuf_size(const ringbuf_t *ringbuf);
 bool ringbuf_is_empty(const ringbuf_t *ringbuf);
@@ -35,6 +35,59 @@ enum golioth_status golioth_stream_set_async(struct golioth_client *client,
                                    GOLIOTH_SYS_WAIT_FOREVER);
 }
 
+enum golioth_status golioth_stream_set_async_with_policy(
+    struct golioth_client *client,
+    const char *path,
+    enum golioth_content_type content_type,
+    const uint8_t *buf,
+    size_t buf_len,
+    const struct golioth_request_policy *policy,
+    golioth_set_cb_fn callback,
+    void *callback_arg)
+{
+    uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
+    golioth_coap_next_token(token);
+
+    return golioth_coap_client_set_with_policy(client,
+                                               token,
+                                               GOLIOTH_STREAM_PATH_PREFIX,
+                                               path,
+                                               content_type,
+                                               buf,
+                                               buf_len,
+                                               policy,
+                                               callback,
+                                               callback_arg);
+}
+
+enum golioth_status golioth_stream_set_async_nocopy(struct golioth_client *client,
+                                                    const char *path,
+                                                    enum golioth_content_type content_type,
+                                                    uint8_t *buf,
+                                                    size_t buf_len,
+                                                    golioth_payload_release_fn buf_release,
+                                                    void *buf_release_arg,
+                                                    golioth_set_cb_fn callback,
+                                                    void *callback_arg)
+{
+    uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
+    golioth_coap_next_token(token);
+
+    return golioth_coap_client_set_nocopy(client,
+                                          token,
+                                          GOLIOTH_STREAM_PATH_PREFIX,
+                                          path,
+                                          content_type,
+                                          buf,
+                                          buf_len,
+                                          buf_release,
+                                          buf_release_arg,
+                                          callback,
+                                          callback_arg,
+                                          false,
+                                          GOLIOTH_SYS_WAIT_FOREVER);
+}
+
 enum golioth_status golioth_stream_set_sync(struct golioth_client *client,
                                             const char *path,
                                             enum golioth_content_type content_type,
@@ -73,6 +126,29 @@ enum golioth_status golioth_stream_set_blockwise_sync(struct golioth_client *cli
                                   arg);
 }
 
+enum golioth_status golioth_stream_set_blockwise_sync_resumable(
+    struct golioth_client *client,
+    const char *path,
+    enum golioth_content_type content_type,
+    stream_read_block_cb cb,
+    void *arg,
+    const struct golioth_blockwise_checkpoint_store *store)
+{
+    if (NULL == store)
+    {
+        return GOLIOTH_ERR_NULL;
+    }
+
+    return golioth_blockwise_post_resumable(client,
+                                            GOLIOTH_STREAM_PATH_PREFIX,
+                                            path,
+                                            content_type,
+                                            cb,
+                                            NULL,
+                                            arg,
+                                            store);
+}
+
 struct blockwise_transfer *golioth_stream_blockwise_start(struct golioth_client *client,
                                                           const char *path,
                                                           enum golioth_content_type content_type)
@@ -80,6 +156,21 @@ struct blockwise_transfer *golioth_stream_blockwise_start(struct golioth_client
     return golioth_blockwise_upload_start(client, GOLIOTH_STREAM_PATH_PREFIX, path, content_type);
 }
 
+struct blockwise_transfer *golioth_stream_blockwise_resume(
+    struct golioth_client *client,
+    const char *path,
+    enum golioth_content_type content_type,
+    const struct golioth_blockwise_checkpoint_store *store,
+    uint32_t *block_idx)
+{
+    return golioth_blockwise_upload_resume(client,
+                                           GOLIOTH_STREAM_PATH_PREFIX,
+                                           path,
+                                           content_type,
+                                           store,
+                                           block_idx);
+}
+
 void golioth_stream_blockwise_finish(struct blockwise_transfer *ctx)
 {
     return golioth_blockwise_upload_finish(ctx);
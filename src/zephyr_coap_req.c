@@ -20,6 +20,8 @@ static const int64_t COAP_OBSERVE_TS_DIFF_NEWER = 128 * (int64_t) MSEC_PER_SEC;
 
 #define RESEND_REPORT_TIMEFRAME_S 10
 
+#define GOLIOTH_COAP_DEFAULT_RETRIES 3
+
 #define COAP_RESPONSE_CODE_CLASS(code) ((code) >> 5)
 
 void golioth_coap_reqs_init(struct golioth_client *client)
@@ -27,6 +29,9 @@ void golioth_coap_reqs_init(struct golioth_client *client)
     sys_dlist_init(&client->coap_reqs);
     client->coap_reqs_connected = false;
     k_mutex_init(&client->coap_reqs_lock);
+#if defined(CONFIG_GOLIOTH_COAP_ADAPTIVE_RTO)
+    golioth_coap_rto_init(&client->rto, CONFIG_COAP_INIT_ACK_TIMEOUT_MS, k_uptime_get_32());
+#endif
 }
 
 static int golioth_coap_req_send(struct golioth_coap_req *req)
@@ -39,8 +44,36 @@ static void golioth_coap_pending_init(struct golioth_coap_pending *pending, uint
     pending->t0 = k_uptime_get_32();
     pending->timeout = 0;
     pending->retries = retries;
+#if defined(CONFIG_GOLIOTH_COAP_ADAPTIVE_RTO)
+    pending->num_retransmissions = 0;
+    pending->rtt_sampled = false;
+#endif
 }
 
+#if defined(CONFIG_GOLIOTH_COAP_ADAPTIVE_RTO)
+/*
+ * Feed the round trip of the first reply to a request into the RTO estimator.
+ * Later observe notifications are not replies to a transmission, so skip them.
+ */
+static void golioth_coap_req_sample_rtt(struct golioth_coap_req *req)
+{
+    struct golioth_coap_pending *pending = &req->pending;
+
+    if (pending->timeout == 0 || pending->rtt_sampled)
+    {
+        return;
+    }
+
+    uint32_t now = k_uptime_get_32();
+
+    golioth_coap_rto_update(&req->client->rto,
+                            now - pending->first_tx,
+                            pending->num_retransmissions,
+                            now);
+    pending->rtt_sampled = true;
+}
+#endif /* defined(CONFIG_GOLIOTH_COAP_ADAPTIVE_RTO) */
+
 static int __golioth_coap_req_submit(struct golioth_coap_req *req)
 {
     struct golioth_client *client = req->client;
@@ -272,6 +305,27 @@ cancel_and_free:
     return 0;
 }
 
+/* All blocks of an upload share a token, so tell the ones in flight apart by block number */
+static bool golioth_coap_req_block1_matches(const struct coap_packet *request,
+                                            const struct coap_packet *rx)
+{
+    int req_block1 = coap_get_option_int(request, COAP_OPTION_BLOCK1);
+    int rx_block1 = coap_get_option_int(rx, COAP_OPTION_BLOCK1);
+
+    if (req_block1 < 0 || rx_block1 < 0)
+    {
+        return true;
+    }
+
+    /* A server asking for smaller blocks numbers them differently */
+    if ((req_block1 & 0x7) != (rx_block1 & 0x7))
+    {
+        return true;
+    }
+
+    return (req_block1 >> 4) == (rx_block1 >> 4);
+}
+
 void golioth_coap_req_process_rx(struct golioth_client *client, const struct coap_packet *rx)
 {
     struct golioth_coap_req *req;
@@ -307,6 +361,15 @@ void golioth_coap_req_process_rx(struct golioth_client *client, const struct coa
             continue;
         }
 
+        if (!golioth_coap_req_block1_matches(&req->request, rx))
+        {
+            continue;
+        }
+
+#if defined(CONFIG_GOLIOTH_COAP_ADAPTIVE_RTO)
+        golioth_coap_req_sample_rtt(req);
+#endif
+
         observe_seq = coap_get_option_int(rx, COAP_OPTION_OBSERVE);
 
         if (observe_seq == -ENOENT)
@@ -431,7 +494,14 @@ int golioth_coap_req_schedule(struct golioth_coap_req *req)
     struct golioth_client *client = req->client;
     int err;
 
-    golioth_coap_pending_init(&req->pending, 3);
+    golioth_coap_pending_init(&req->pending,
+                              req->policy.max_transmissions
+                                  ? req->policy.max_transmissions - 1
+                                  : GOLIOTH_COAP_DEFAULT_RETRIES);
+    if (req->policy.timeout_ms)
+    {
+        req->pending.deadline = req->pending.t0 + req->policy.timeout_ms;
+    }
 
     err = golioth_coap_req_submit(req);
     if (err)
@@ -515,7 +585,8 @@ int golioth_coap_req_cb(struct golioth_client *client,
                         size_t data_len,
                         golioth_req_cb_t cb,
                         void *user_data,
-                        int flags)
+                        int flags,
+                        const struct golioth_request_policy *policy)
 {
     size_t path_len = coap_pathv_estimate_alloc_len(pathv);
     struct golioth_coap_req *req;
@@ -535,6 +606,11 @@ int golioth_coap_req_cb(struct golioth_client *client,
         return err;
     }
 
+    if (policy)
+    {
+        req->policy = *policy;
+    }
+
     if (method == COAP_METHOD_GET && (flags & GOLIOTH_COAP_REQ_OBSERVE))
     {
         req->is_observe = true;
@@ -606,11 +682,17 @@ free_req:
     return err;
 }
 
-static uint32_t init_ack_timeout(void)
+static uint32_t init_ack_timeout(struct golioth_client *client, uint32_t now)
 {
+#if defined(CONFIG_GOLIOTH_COAP_ADAPTIVE_RTO)
+    const uint32_t ack_timeout = golioth_coap_rto_get(&client->rto, now);
+#else
+    const uint32_t ack_timeout = CONFIG_COAP_INIT_ACK_TIMEOUT_MS;
+#endif
+
 #if defined(CONFIG_COAP_RANDOMIZE_ACK_TIMEOUT)
-    const uint32_t max_ack = CONFIG_COAP_INIT_ACK_TIMEOUT_MS * CONFIG_COAP_ACK_RANDOM_PERCENT / 100;
-    const uint32_t min_ack = CONFIG_COAP_INIT_ACK_TIMEOUT_MS;
+    const uint32_t max_ack = ack_timeout * CONFIG_COAP_ACK_RANDOM_PERCENT / 100;
+    const uint32_t min_ack = ack_timeout;
 
     /* Randomly generated initial ACK timeout
      * ACK_TIMEOUT < INIT_ACK_TIMEOUT < ACK_TIMEOUT * ACK_RANDOM_FACTOR
@@ -618,16 +700,22 @@ static uint32_t init_ack_timeout(void)
      */
     return min_ack + (sys_rand32_get() % (max_ack - min_ack));
 #else
-    return CONFIG_COAP_INIT_ACK_TIMEOUT_MS;
+    return ack_timeout;
 #endif /* defined(CONFIG_COAP_RANDOMIZE_ACK_TIMEOUT) */
 }
 
-static bool golioth_coap_pending_cycle(struct golioth_coap_pending *pending)
+static bool golioth_coap_pending_cycle(struct golioth_coap_req *req, uint32_t now)
 {
+    struct golioth_coap_pending *pending = &req->pending;
+
     if (pending->timeout == 0)
     {
         /* Initial transmission. */
-        pending->timeout = init_ack_timeout();
+        pending->timeout = init_ack_timeout(req->client, now);
+#if defined(CONFIG_GOLIOTH_COAP_ADAPTIVE_RTO)
+        pending->first_tx = now;
+        pending->initial_timeout = pending->timeout;
+#endif
 
         return true;
     }
@@ -638,12 +726,31 @@ static bool golioth_coap_pending_cycle(struct golioth_coap_pending *pending)
     }
 
     pending->t0 += pending->timeout;
+#if defined(CONFIG_GOLIOTH_COAP_ADAPTIVE_RTO)
+    pending->timeout = golioth_coap_rto_backoff(pending->timeout, pending->initial_timeout);
+    pending->num_retransmissions++;
+#else
     pending->timeout = pending->timeout << 1;
+#endif
     pending->retries--;
 
     return true;
 }
 
+static void golioth_coap_req_time_out(struct golioth_coap_req *req)
+{
+    struct golioth_req_rsp rsp = {
+        .user_data = req->user_data,
+        .status = GOLIOTH_ERR_TIMEOUT,
+    };
+
+    LOG_WRN("Packet %p (reply %p) was not replied to", (void *) req, (void *) &req->reply);
+
+    (void) req->cb(&rsp);
+
+    golioth_coap_req_cancel_and_free(req);
+}
+
 static int64_t golioth_coap_req_poll_prepare(struct golioth_coap_req *req, uint32_t now)
 {
     int64_t timeout;
@@ -651,6 +758,13 @@ static int64_t golioth_coap_req_poll_prepare(struct golioth_coap_req *req, uint3
     bool resend = (req->pending.timeout != 0);
     int err;
 
+    if (req->policy.timeout_ms && (int32_t) (req->pending.deadline - now) <= 0)
+    {
+        golioth_coap_req_time_out(req);
+
+        return INT64_MAX;
+    }
+
     while (true)
     {
         timeout = (int32_t) (req->pending.t0 + req->pending.timeout) - (int32_t) now;
@@ -661,19 +775,10 @@ static int64_t golioth_coap_req_poll_prepare(struct golioth_coap_req *req, uint3
             break;
         }
 
-        send = golioth_coap_pending_cycle(&req->pending);
+        send = golioth_coap_pending_cycle(req, now);
         if (!send)
         {
-            struct golioth_req_rsp rsp = {
-                .user_data = req->user_data,
-                .status = GOLIOTH_ERR_TIMEOUT,
-            };
-
-            LOG_WRN("Packet %p (reply %p) was not replied to", (void *) req, (void *) &req->reply);
-
-            (void) req->cb(&rsp);
-
-            golioth_coap_req_cancel_and_free(req);
+            golioth_coap_req_time_out(req);
 
             return INT64_MAX;
         }
@@ -708,6 +813,11 @@ static int64_t golioth_coap_req_poll_prepare(struct golioth_coap_req *req, uint3
         req->client->resend_report_count = 0;
     }
 
+    if (req->policy.timeout_ms)
+    {
+        timeout = MIN(timeout, (int32_t) (req->pending.deadline - now));
+    }
+
     return timeout;
 }
 
@@ -839,6 +949,11 @@ void golioth_coap_reqs_on_connect(struct golioth_client *client)
      */
     client->coap_reqs_connected = true;
 
+#if defined(CONFIG_GOLIOTH_COAP_ADAPTIVE_RTO)
+    /* Round trips measured on the previous connection may not apply to this one */
+    golioth_coap_rto_init(&client->rto, CONFIG_COAP_INIT_ACK_TIMEOUT_MS, k_uptime_get_32());
+#endif
+
     k_mutex_unlock(&client->coap_reqs_lock);
 }
 
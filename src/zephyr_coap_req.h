@@ -32,6 +32,16 @@ struct golioth_coap_pending
     uint32_t t0;
     uint32_t timeout;
     uint8_t retries;
+    /** @brief Time after which the request fails, if its policy has a timeout */
+    uint32_t deadline;
+#if defined(CONFIG_GOLIOTH_COAP_ADAPTIVE_RTO)
+    /** @brief Time of the first transmission */
+    uint32_t first_tx;
+    /** @brief Timeout of the first transmission, selects the backoff factor */
+    uint32_t initial_timeout;
+    uint8_t num_retransmissions;
+    bool rtt_sampled;
+#endif
 };
 
 /**
@@ -60,6 +70,8 @@ struct golioth_coap_req
     struct golioth_coap_reply reply;
 
     struct golioth_coap_pending pending;
+    /** @brief Response timeout and retry budget, zero for the defaults */
+    struct golioth_request_policy policy;
     bool is_observe;
     bool is_pending;
 
@@ -118,6 +130,9 @@ void golioth_coap_req_free(struct golioth_coap_req *req);
  *
  * Schedule CoAP request for sending and
  *
+ * The number of transmissions and the response timeout follow @p req->policy, which can be set
+ * between golioth_coap_req_new() and this call.
+ *
  * @param[in] req CoAP request to be scheduled for sending
  *
  * @retval 0 On success
@@ -158,6 +173,7 @@ int golioth_coap_req_find_and_cancel_observation(struct golioth_client *client,
  * @param[in] cb Callback executed on response received, timeout or error. Can be NULL.
  * @param[in] user_data User data passed to @p cb
  * @param[in] flags Flags (@sa golioth_coap_req_flags)
+ * @param[in] policy Response timeout and retry budget. NULL for the defaults.
  *
  * @retval 0 On success
  * @retval <0 On failure
@@ -171,7 +187,8 @@ int golioth_coap_req_cb(struct golioth_client *client,
                         size_t data_len,
                         golioth_req_cb_t cb,
                         void *user_data,
-                        int flags);
+                        int flags,
+                        const struct golioth_request_policy *policy);
 
 /**
  * @brief Handle CoAP packets (re)transmission and timeout
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Measures golioth_mbox throughput with many producer threads and a single
+// consumer, the way the CoAP client request queue is used on Linux gateways.
+//
+// Usage: mbox_contention [num_producers] [msgs_per_producer] [queue_depth]
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "mbox.h"
+
+struct msg
+{
+    uint32_t producer;
+    uint32_t seq;
+};
+
+struct producer_ctx
+{
+    golioth_mbox_t mbox;
+    uint32_t id;
+    uint32_t num_msgs;
+    uint64_t num_full;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void *producer_thread(void *arg)
+{
+    struct producer_ctx *ctx = arg;
+
+    for (uint32_t seq = 0; seq < ctx->num_msgs; seq++)
+    {
+        struct msg msg = {
+            .producer = ctx->id,
+            .seq = seq,
+        };
+
+        // Like the SDK, a full queue is not fatal; just try again
+        while (!golioth_mbox_try_send(ctx->mbox, &msg))
+        {
+            ctx->num_full++;
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t num_producers = (argc > 1) ? strtoul(argv[1], NULL, 0) : 16;
+    uint32_t msgs_per_producer = (argc > 2) ? strtoul(argv[2], NULL, 0) : 100000;
+    uint32_t queue_depth = (argc > 3) ? strtoul(argv[3], NULL, 0) : 64;
+
+    golioth_mbox_t mbox = golioth_mbox_create(queue_depth, sizeof(struct msg));
+    struct producer_ctx *producers = calloc(num_producers, sizeof(*producers));
+    pthread_t *threads = calloc(num_producers, sizeof(*threads));
+    uint32_t *next_seq = calloc(num_producers, sizeof(*next_seq));
+    if (!producers || !threads || !next_seq)
+    {
+        return 1;
+    }
+
+    uint64_t total_msgs = (uint64_t) num_producers * msgs_per_producer;
+    uint64_t start_ns = now_ns();
+
+    for (uint32_t i = 0; i < num_producers; i++)
+    {
+        producers[i].mbox = mbox;
+        producers[i].id = i;
+        producers[i].num_msgs = msgs_per_producer;
+        pthread_create(&threads[i], NULL, producer_thread, &producers[i]);
+    }
+
+    uint64_t num_timeouts = 0;
+    for (uint64_t received = 0; received < total_msgs;)
+    {
+        struct msg msg;
+        if (!golioth_mbox_recv(mbox, &msg, 1000))
+        {
+            num_timeouts++;
+            continue;
+        }
+
+        if (msg.producer >= num_producers || msg.seq != next_seq[msg.producer])
+        {
+            fprintf(stderr, "Out of order message from producer %" PRIu32 "\n", msg.producer);
+            return 1;
+        }
+        next_seq[msg.producer]++;
+        received++;
+    }
+
+    uint64_t elapsed_ns = now_ns() - start_ns;
+
+    uint64_t num_full = 0;
+    for (uint32_t i = 0; i < num_producers; i++)
+    {
+        pthread_join(threads[i], NULL);
+        num_full += producers[i].num_full;
+    }
+
+    printf("%s: %" PRIu32 " producers x %" PRIu32 " msgs, queue depth %" PRIu32 "\n",
+#if defined(CONFIG_GOLIOTH_MBOX_LOCKLESS)
+           "lockless",
+#else
+           "mutex",
+#endif
+           num_producers,
+           msgs_per_producer,
+           queue_depth);
+    printf("  %.1f ms, %.0f msgs/s, %.1f ns/msg, %" PRIu64 " full retries, %" PRIu64
+           " recv timeouts\n",
+           elapsed_ns / 1e6,
+           total_msgs / (elapsed_ns / 1e9),
+           (double) elapsed_ns / total_msgs,
+           num_full,
+           num_timeouts);
+
+    golioth_mbox_destroy(mbox);
+    free(producers);
+    free(threads);
+    free(next_seq);
+
+    return 0;
+}
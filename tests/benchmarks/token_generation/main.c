@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2024 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Measures CoAP token generation throughput with many threads generating
+// tokens concurrently, the way every LightDB, Stream, log and RPC request does.
+//
+// Compares golioth_coap_next_token() against a reference generator that takes
+// a mutex per token, like the SDK used to.
+//
+// Usage: token_generation [num_threads] [tokens_per_thread]
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "coap_client.h"
+
+typedef void (*next_token_fn)(uint8_t token[GOLIOTH_COAP_TOKEN_LEN]);
+
+struct thread_ctx
+{
+    next_token_fn next_token;
+    uint32_t num_tokens;
+    uint64_t checksum;
+};
+
+static pthread_mutex_t reference_mut = PTHREAD_MUTEX_INITIALIZER;
+
+static void reference_next_token(uint8_t token[GOLIOTH_COAP_TOKEN_LEN])
+{
+    static uint64_t stored_token;
+
+    pthread_mutex_lock(&reference_mut);
+    stored_token++;
+    memcpy(token, &stored_token, GOLIOTH_COAP_TOKEN_LEN);
+    pthread_mutex_unlock(&reference_mut);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void *token_thread(void *arg)
+{
+    struct thread_ctx *ctx = arg;
+
+    for (uint32_t i = 0; i < ctx->num_tokens; i++)
+    {
+        uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
+        uint64_t value;
+
+        ctx->next_token(token);
+
+        // Use the token, so generating it can't be optimized away
+        memcpy(&value, token, sizeof(value));
+        ctx->checksum ^= value;
+    }
+
+    return NULL;
+}
+
+static int run(const char *name,
+               next_token_fn next_token,
+               uint32_t num_threads,
+               uint32_t tokens_per_thread)
+{
+    struct thread_ctx *ctxs = calloc(num_threads, sizeof(*ctxs));
+    pthread_t *threads = calloc(num_threads, sizeof(*threads));
+    if (!ctxs || !threads)
+    {
+        return 1;
+    }
+
+    uint64_t total_tokens = (uint64_t) num_threads * tokens_per_thread;
+    uint64_t start_ns = now_ns();
+
+    for (uint32_t i = 0; i < num_threads; i++)
+    {
+        ctxs[i].next_token = next_token;
+        ctxs[i].num_tokens = tokens_per_thread;
+        pthread_create(&threads[i], NULL, token_thread, &ctxs[i]);
+    }
+
+    uint64_t checksum = 0;
+    for (uint32_t i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        checksum ^= ctxs[i].checksum;
+    }
+
+    uint64_t elapsed_ns = now_ns() - start_ns;
+
+    printf("%s: %" PRIu32 " threads x %" PRIu32 " tokens\n",
+           name,
+           num_threads,
+           tokens_per_thread);
+    printf("  %.1f ms, %.0f tokens/s, %.1f ns/token (checksum %016" PRIx64 ")\n",
+           elapsed_ns / 1e6,
+           total_tokens / (elapsed_ns / 1e9),
+           (double) elapsed_ns / total_tokens,
+           checksum);
+
+    free(ctxs);
+    free(threads);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t num_threads = (argc > 1) ? strtoul(argv[1], NULL, 0) : 16;
+    uint32_t tokens_per_thread = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1000000;
+
+    golioth_coap_token_init();
+
+    if (run("mutex (reference)", reference_next_token, num_threads, tokens_per_thread))
+    {
+        return 1;
+    }
+
+    return run("golioth_coap_next_token", golioth_coap_next_token, num_threads, tokens_per_thread);
+}
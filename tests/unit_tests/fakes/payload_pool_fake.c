@@ -0,0 +1,14 @@
+#include <stdlib.h>
+#include "payload_pool.h"
+
+// Payloads come straight from the heap, so leaks and overruns show up in sanitizers
+
+void *golioth_payload_pool_alloc(size_t size)
+{
+    return malloc(size);
+}
+
+void golioth_payload_pool_free(void *ptr)
+{
+    free(ptr);
+}
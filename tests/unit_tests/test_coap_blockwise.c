@@ -0,0 +1,839 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "coap_blockwise.h"
+#include "coap_client.h"
+#include "golioth_util.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(golioth_sys_sem_t, golioth_sys_sem_create, uint32_t, uint32_t);
+FAKE_VALUE_FUNC(bool, golioth_sys_sem_give, golioth_sys_sem_t);
+FAKE_VOID_FUNC(golioth_sys_sem_destroy, golioth_sys_sem_t);
+FAKE_VALUE_FUNC(size_t, golioth_coap_client_bert_block_size, struct golioth_client *);
+FAKE_VALUE_FUNC(golioth_sys_mutex_t, golioth_sys_mutex_create);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_lock, golioth_sys_mutex_t, int32_t);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_unlock, golioth_sys_mutex_t);
+FAKE_VOID_FUNC(golioth_sys_mutex_destroy, golioth_sys_mutex_t);
+
+static uint64_t now_ms;
+
+uint64_t golioth_sys_now_ms(void)
+{
+    return now_ms;
+}
+
+void golioth_coap_next_token(uint8_t token[GOLIOTH_COAP_TOKEN_LEN])
+{
+    static uint8_t next;
+    memset(token, next++, GOLIOTH_COAP_TOKEN_LEN);
+}
+
+// Block requests are recorded, and answered by the tests in any order
+
+#define MAX_REQUESTS 32
+
+struct block_request
+{
+    uint32_t block_idx;
+    size_t block_size;
+    coap_get_block_cb_fn callback;
+    void *arg;
+    uint64_t *sent_ms;
+};
+
+static struct block_request requests[MAX_REQUESTS];
+static size_t num_requests;
+
+enum golioth_status golioth_coap_client_get_block(struct golioth_client *client,
+                                                  const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+                                                  const char *path_prefix,
+                                                  const char *path,
+                                                  enum golioth_content_type content_type,
+                                                  size_t block_index,
+                                                  size_t block_size,
+                                                  coap_get_block_cb_fn callback,
+                                                  void *callback_arg,
+                                                  uint64_t *sent_ms,
+                                                  bool is_synchronous,
+                                                  int32_t timeout_s)
+{
+    TEST_ASSERT_LESS_THAN(MAX_REQUESTS, num_requests);
+
+    // Sent right away, unless a test says otherwise
+    *sent_ms = now_ms;
+    requests[num_requests++] = (struct block_request) {
+        .block_idx = block_index,
+        .block_size = block_size,
+        .callback = callback,
+        .arg = callback_arg,
+        .sent_ms = sent_ms,
+    };
+    return GOLIOTH_OK;
+}
+
+static struct golioth_client *client_for_upload;
+
+// Uploaded blocks are recorded, and answered by the server whenever the uploader waits
+
+struct set_block_request
+{
+    uint32_t block_idx;
+    size_t block_szx;
+    bool is_last;
+    uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
+    golioth_set_block_cb_fn callback;
+    void *arg;
+};
+
+static struct set_block_request set_requests[MAX_REQUESTS];
+static size_t num_set_requests;
+static size_t num_acked;
+static size_t server_block_size;
+static uint64_t ack_delay_ms[MAX_REQUESTS];
+static enum golioth_status ack_status[MAX_REQUESTS];
+
+// Order of reads, sends and acks, e.g. "R0 S0 A0 "
+static char events[256];
+
+static void log_event(char type, uint32_t block_idx)
+{
+    size_t len = strlen(events);
+    snprintf(&events[len], sizeof(events) - len, "%c%u ", type, (unsigned int) block_idx);
+}
+
+static void record_set_block(const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+                             bool is_last,
+                             size_t block_index,
+                             size_t block_szx,
+                             golioth_set_block_cb_fn callback,
+                             void *callback_arg)
+{
+    TEST_ASSERT_LESS_THAN(MAX_REQUESTS, num_set_requests);
+
+    log_event('S', block_index);
+    set_requests[num_set_requests] = (struct set_block_request) {
+        .block_idx = block_index,
+        .block_szx = block_szx,
+        .is_last = is_last,
+        .callback = callback,
+        .arg = callback_arg,
+    };
+    memcpy(set_requests[num_set_requests].token, token, GOLIOTH_COAP_TOKEN_LEN);
+    num_set_requests++;
+}
+
+enum golioth_status golioth_coap_client_set_block(struct golioth_client *client,
+                                                  const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+                                                  const char *path_prefix,
+                                                  const char *path,
+                                                  bool is_last,
+                                                  enum golioth_content_type content_type,
+                                                  size_t block_index,
+                                                  size_t block_szx,
+                                                  const uint8_t *payload,
+                                                  size_t payload_size,
+                                                  golioth_set_block_cb_fn callback,
+                                                  void *callback_arg,
+                                                  bool is_synchronous,
+                                                  int32_t timeout_s)
+{
+    record_set_block(token, is_last, block_index, block_szx, callback, callback_arg);
+    return GOLIOTH_OK;
+}
+
+static const uint8_t *last_nocopy_payload;
+
+enum golioth_status golioth_coap_client_set_block_nocopy(
+    struct golioth_client *client,
+    const uint8_t token[GOLIOTH_COAP_TOKEN_LEN],
+    const char *path_prefix,
+    const char *path,
+    bool is_last,
+    enum golioth_content_type content_type,
+    size_t block_index,
+    size_t block_szx,
+    uint8_t *payload,
+    size_t payload_size,
+    golioth_payload_release_fn payload_release,
+    void *payload_release_arg,
+    golioth_set_block_cb_fn callback,
+    void *callback_arg,
+    uint64_t *sent_ms,
+    bool is_synchronous,
+    int32_t timeout_s)
+{
+    *sent_ms = now_ms;
+    record_set_block(token, is_last, block_index, block_szx, callback, callback_arg);
+
+    // Serialized right away, after which the payload buffer is no longer needed
+    last_nocopy_payload = payload;
+    payload_release(payload, payload_release_arg);
+    return GOLIOTH_OK;
+}
+
+bool golioth_sys_sem_take(golioth_sys_sem_t sem, int32_t ms_to_wait)
+{
+    TEST_ASSERT_LESS_THAN(num_set_requests, num_acked);
+
+    struct set_block_request *req = &set_requests[num_acked++];
+    struct golioth_coap_rsp_code rsp_code = {2, req->is_last ? 4 : 31};
+    size_t block_size = (req->block_szx == GOLIOTH_COAP_BERT_SZX)
+        ? GOLIOTH_COAP_BERT_UNIT_SIZE
+        : min(SZX_TO_BLOCKSIZE(req->block_szx), server_block_size);
+
+    now_ms += ack_delay_ms[num_acked - 1];
+    log_event('A', req->block_idx);
+    req->callback(client_for_upload,
+                  ack_status[num_acked - 1],
+                  &rsp_code,
+                  "data",
+                  block_size,
+                  req->arg);
+    return true;
+}
+
+static uint32_t num_blocks_to_upload;
+
+static const uint8_t *last_read_buffer;
+
+static enum golioth_status read_block(uint32_t block_idx,
+                                      uint8_t *block_buffer,
+                                      size_t *block_size,
+                                      bool *is_last,
+                                      void *callback_arg)
+{
+    last_read_buffer = block_buffer;
+    log_event('R', block_idx);
+    memset(block_buffer, (uint8_t) block_idx, *block_size);
+    *is_last = (block_idx + 1 >= num_blocks_to_upload);
+    return GOLIOTH_OK;
+}
+
+static size_t num_upload_end_calls;
+static enum golioth_status upload_end_status;
+
+static void on_upload_end(struct golioth_client *client,
+                          enum golioth_status status,
+                          const struct golioth_coap_rsp_code *coap_rsp_code,
+                          const char *path,
+                          void *arg)
+{
+    num_upload_end_calls++;
+    upload_end_status = status;
+}
+
+// Checkpoint store holding a single checkpoint in memory
+
+static struct golioth_blockwise_checkpoint stored_checkpoint;
+static bool has_checkpoint;
+static size_t num_checkpoint_saves;
+
+static enum golioth_status load_checkpoint_cb(const char *path,
+                                              struct golioth_blockwise_checkpoint *checkpoint,
+                                              void *arg)
+{
+    if (!has_checkpoint)
+    {
+        return GOLIOTH_ERR_NO_MORE_DATA;
+    }
+
+    *checkpoint = stored_checkpoint;
+    return GOLIOTH_OK;
+}
+
+static enum golioth_status save_checkpoint_cb(const char *path,
+                                              const struct golioth_blockwise_checkpoint *checkpoint,
+                                              void *arg)
+{
+    stored_checkpoint = *checkpoint;
+    has_checkpoint = true;
+    num_checkpoint_saves++;
+    return GOLIOTH_OK;
+}
+
+static void clear_checkpoint_cb(const char *path, void *arg)
+{
+    has_checkpoint = false;
+}
+
+static const struct golioth_blockwise_checkpoint_store checkpoint_store = {
+    .load = load_checkpoint_cb,
+    .save = save_checkpoint_cb,
+    .clear = clear_checkpoint_cb,
+};
+
+static int dummy_client;
+static struct golioth_client *client = (struct golioth_client *) &dummy_client;
+static const struct golioth_coap_rsp_code content = {2, 5};
+static const struct golioth_coap_rsp_code bad_option = {4, 2};
+
+static void respond_with_len(uint32_t block_idx,
+                             enum golioth_status status,
+                             size_t len,
+                             bool is_last)
+{
+    static uint8_t payload[4 * CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_BLOCK_SIZE];
+
+    for (size_t i = 0; i < num_requests; i++)
+    {
+        if (requests[i].callback && requests[i].block_idx == block_idx)
+        {
+            struct block_request req = requests[i];
+            requests[i].callback = NULL;
+
+            // Each block of the application's block size starts with its own index
+            size_t offset = block_idx
+                * min(req.block_size, (size_t) CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_BLOCK_SIZE);
+            for (size_t j = 0; j < sizeof(payload); j++)
+            {
+                payload[j] =
+                    (uint8_t) ((offset + j) / CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_BLOCK_SIZE);
+            }
+
+            req.callback(client,
+                         status,
+                         (status == GOLIOTH_OK) ? &content : &bad_option,
+                         "fw",
+                         payload,
+                         (status == GOLIOTH_OK) ? len : 0,
+                         is_last,
+                         req.arg);
+            return;
+        }
+    }
+
+    TEST_FAIL_MESSAGE("Block was not requested");
+}
+
+static void respond(uint32_t block_idx, enum golioth_status status, bool is_last)
+{
+    respond_with_len(block_idx, status, CONFIG_GOLIOTH_BLOCKWISE_DOWNLOAD_MAX_BLOCK_SIZE, is_last);
+}
+
+static size_t num_outstanding(void)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < num_requests; i++)
+    {
+        n += (requests[i].callback != NULL);
+    }
+    return n;
+}
+
+// Application callbacks record what they were called with
+
+static uint32_t delivered[MAX_REQUESTS];
+static size_t num_delivered;
+static size_t num_end_calls;
+static enum golioth_status end_status;
+static uint32_t end_block_idx;
+
+static enum golioth_status on_block(struct golioth_client *client,
+                                    const char *path,
+                                    uint32_t block_idx,
+                                    const uint8_t *block_buffer,
+                                    size_t block_buffer_len,
+                                    bool is_last,
+                                    size_t negotiated_block_size,
+                                    void *arg)
+{
+    TEST_ASSERT_EQUAL((uint8_t) block_idx, block_buffer[0]);
+    delivered[num_delivered++] = block_idx;
+    return GOLIOTH_OK;
+}
+
+static void on_end(struct golioth_client *client,
+                   enum golioth_status status,
+                   const struct golioth_coap_rsp_code *coap_rsp_code,
+                   const char *path,
+                   uint32_t block_idx,
+                   void *arg)
+{
+    num_end_calls++;
+    end_status = status;
+    end_block_idx = block_idx;
+}
+
+static void start_download(uint32_t block_idx)
+{
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_blockwise_get(client,
+                                            "",
+                                            "fw",
+                                            GOLIOTH_CONTENT_TYPE_OCTET_STREAM,
+                                            block_idx,
+                                            on_block,
+                                            on_end,
+                                            NULL));
+}
+
+void setUp(void)
+{
+    RESET_FAKE(golioth_coap_client_bert_block_size);
+    RESET_FAKE(golioth_sys_sem_create);
+
+    golioth_sys_sem_create_fake.return_val = (golioth_sys_sem_t) &dummy_client;
+    golioth_sys_mutex_create_fake.return_val = (golioth_sys_mutex_t) &dummy_client;
+    client_for_upload = client;
+    num_set_requests = 0;
+    num_acked = 0;
+    memset(ack_delay_ms, 0, sizeof(ack_delay_ms));
+    memset(ack_status, 0, sizeof(ack_status));
+    has_checkpoint = false;
+    num_checkpoint_saves = 0;
+    server_block_size = CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE;
+    events[0] = '\0';
+    num_upload_end_calls = 0;
+
+    now_ms = 1000;
+    num_requests = 0;
+    num_delivered = 0;
+    num_end_calls = 0;
+}
+
+void tearDown(void) {}
+
+void first_block_is_requested_alone(void)
+{
+    start_download(5);
+
+    TEST_ASSERT_EQUAL(1, num_requests);
+    TEST_ASSERT_EQUAL(5, requests[0].block_idx);
+
+    respond(5, GOLIOTH_OK, true);
+    TEST_ASSERT_EQUAL(1, num_delivered);
+    TEST_ASSERT_EQUAL(1, num_end_calls);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, end_status);
+    TEST_ASSERT_EQUAL(5, end_block_idx);
+}
+
+void window_grows_while_responses_are_timely(void)
+{
+    start_download(0);
+
+    respond(0, GOLIOTH_OK, false);
+    TEST_ASSERT_EQUAL(2, num_outstanding());
+
+    respond(1, GOLIOTH_OK, false);
+    respond(2, GOLIOTH_OK, false);
+    TEST_ASSERT_EQUAL(3, num_outstanding());
+
+    respond(3, GOLIOTH_OK, true);
+    TEST_ASSERT_EQUAL(1, num_end_calls);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, end_status);
+
+    // Requests past the last block are answered with errors, which are ignored
+    respond(4, GOLIOTH_ERR_COAP_RESPONSE, false);
+    respond(5, GOLIOTH_ERR_COAP_RESPONSE, false);
+    TEST_ASSERT_EQUAL(0, num_outstanding());
+    TEST_ASSERT_EQUAL(1, num_end_calls);
+    TEST_ASSERT_EQUAL(4, num_delivered);
+}
+
+void blocks_are_delivered_in_order(void)
+{
+    start_download(0);
+    respond(0, GOLIOTH_OK, false);
+    respond(2, GOLIOTH_OK, false);
+    TEST_ASSERT_EQUAL(1, num_delivered);
+
+    respond(1, GOLIOTH_OK, false);
+    TEST_ASSERT_EQUAL(3, num_delivered);
+    for (uint32_t i = 0; i < num_delivered; i++)
+    {
+        TEST_ASSERT_EQUAL(i, delivered[i]);
+    }
+
+    respond(3, GOLIOTH_ERR_COAP_RESPONSE, false);
+    respond(4, GOLIOTH_ERR_COAP_RESPONSE, false);
+    respond(5, GOLIOTH_ERR_COAP_RESPONSE, false);
+    TEST_ASSERT_EQUAL(0, num_outstanding());
+    TEST_ASSERT_EQUAL(1, num_end_calls);
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_COAP_RESPONSE, end_status);
+    TEST_ASSERT_EQUAL(3, end_block_idx);
+}
+
+void error_ahead_of_last_block_is_ignored(void)
+{
+    start_download(0);
+    respond(0, GOLIOTH_OK, false);
+
+    // Block 2 is past the end, and its error arrives before the last block
+    respond(2, GOLIOTH_ERR_COAP_RESPONSE, false);
+    TEST_ASSERT_EQUAL(0, num_end_calls);
+
+    respond(1, GOLIOTH_OK, true);
+    TEST_ASSERT_EQUAL(1, num_end_calls);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, end_status);
+    TEST_ASSERT_EQUAL(1, end_block_idx);
+    TEST_ASSERT_EQUAL(0, num_outstanding());
+}
+
+void delayed_response_shrinks_window(void)
+{
+    start_download(0);
+    respond(0, GOLIOTH_OK, false);
+    respond(1, GOLIOTH_OK, false);
+    respond(2, GOLIOTH_OK, false);
+    TEST_ASSERT_EQUAL(3, num_outstanding());
+
+    // Took long enough to have been retransmitted
+    now_ms += 3000;
+    respond(3, GOLIOTH_OK, false);
+    TEST_ASSERT_EQUAL(2, num_outstanding());
+
+    respond(4, GOLIOTH_OK, true);
+    respond(5, GOLIOTH_ERR_COAP_RESPONSE, false);
+    TEST_ASSERT_EQUAL(1, num_end_calls);
+}
+
+void round_trip_is_measured_from_when_block_was_sent(void)
+{
+    start_download(0);
+    respond(0, GOLIOTH_OK, false);
+    respond(1, GOLIOTH_OK, false);
+    TEST_ASSERT_EQUAL(2, num_outstanding());
+
+    // Blocks 2 and 3 waited in the request queue, and were only sent now
+    now_ms += 3000;
+    for (size_t i = 0; i < num_requests; i++)
+    {
+        if (requests[i].callback)
+        {
+            *requests[i].sent_ms = now_ms;
+        }
+    }
+
+    // Answered right after being sent, so the window keeps growing
+    respond(2, GOLIOTH_OK, false);
+    TEST_ASSERT_EQUAL(3, num_outstanding());
+
+    respond(3, GOLIOTH_OK, true);
+    respond(4, GOLIOTH_ERR_COAP_RESPONSE, false);
+    respond(5, GOLIOTH_ERR_COAP_RESPONSE, false);
+    TEST_ASSERT_EQUAL(0, num_outstanding());
+    TEST_ASSERT_EQUAL(1, num_end_calls);
+}
+
+void block_size_shrinks_when_single_block_is_lost(void)
+{
+    start_download(0);
+    respond(0, GOLIOTH_OK, false);
+
+    // Delayed with two blocks in flight halves the window, with one it halves the block size
+    now_ms += 3000;
+    respond(1, GOLIOTH_OK, false);
+    respond(2, GOLIOTH_OK, false);
+    TEST_ASSERT_EQUAL(3, num_delivered);
+
+    // Block 3 of 1024 bytes is requested as blocks 6 and 7 of 512 bytes
+    TEST_ASSERT_EQUAL(1, num_outstanding());
+    TEST_ASSERT_EQUAL(6, requests[num_requests - 1].block_idx);
+    TEST_ASSERT_EQUAL(512, requests[num_requests - 1].block_size);
+
+    respond_with_len(6, GOLIOTH_OK, 512, false);
+    TEST_ASSERT_EQUAL(3, num_delivered);
+
+    respond_with_len(7, GOLIOTH_OK, 512, false);
+    TEST_ASSERT_EQUAL(4, num_delivered);
+    TEST_ASSERT_EQUAL(3, delivered[3]);
+
+    respond_with_len(8, GOLIOTH_OK, 100, true);
+    TEST_ASSERT_EQUAL(5, num_delivered);
+    TEST_ASSERT_EQUAL(1, num_end_calls);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, end_status);
+    TEST_ASSERT_EQUAL(4, end_block_idx);
+}
+
+void timed_out_block_is_requested_again(void)
+{
+    start_download(0);
+    respond(0, GOLIOTH_OK, false);
+    respond(2, GOLIOTH_OK, false);
+
+    // Block 2 is held, while block 1 is requested again with a smaller window
+    respond(1, GOLIOTH_ERR_TIMEOUT, false);
+    TEST_ASSERT_EQUAL(0, num_end_calls);
+    TEST_ASSERT_EQUAL(1, num_outstanding());
+    TEST_ASSERT_EQUAL(1, requests[num_requests - 1].block_idx);
+
+    respond(1, GOLIOTH_OK, false);
+    TEST_ASSERT_EQUAL(3, num_delivered);
+
+    respond(3, GOLIOTH_OK, true);
+    respond(4, GOLIOTH_ERR_COAP_RESPONSE, false);
+    TEST_ASSERT_EQUAL(0, num_outstanding());
+    TEST_ASSERT_EQUAL(1, num_end_calls);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, end_status);
+    for (uint32_t i = 0; i < num_delivered; i++)
+    {
+        TEST_ASSERT_EQUAL(i, delivered[i]);
+    }
+}
+
+void download_fails_when_block_keeps_timing_out(void)
+{
+    start_download(0);
+
+    // Requested once, then three more times
+    for (size_t i = 0; i < 3; i++)
+    {
+        respond(0, GOLIOTH_ERR_TIMEOUT, false);
+        TEST_ASSERT_EQUAL(0, num_end_calls);
+        TEST_ASSERT_EQUAL(1, num_outstanding());
+    }
+
+    respond(0, GOLIOTH_ERR_TIMEOUT, false);
+    TEST_ASSERT_EQUAL(4, num_requests);
+    TEST_ASSERT_EQUAL(0, num_outstanding());
+    TEST_ASSERT_EQUAL(0, num_delivered);
+    TEST_ASSERT_EQUAL(1, num_end_calls);
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_TIMEOUT, end_status);
+}
+
+void bert_blocks_are_requested_one_at_a_time(void)
+{
+    golioth_coap_client_bert_block_size_fake.return_val = 4096;
+
+    start_download(0);
+    respond_with_len(0, GOLIOTH_OK, 4096, false);
+
+    // The first BERT block held blocks 0 to 3
+    TEST_ASSERT_EQUAL(4, num_delivered);
+    TEST_ASSERT_EQUAL(1, num_outstanding());
+    TEST_ASSERT_EQUAL(4, requests[1].block_idx);
+
+    respond(4, GOLIOTH_OK, true);
+    TEST_ASSERT_EQUAL(1, num_end_calls);
+}
+
+static void upload(uint32_t num_blocks)
+{
+    num_blocks_to_upload = num_blocks;
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_blockwise_post(client,
+                                             ".s/",
+                                             "data",
+                                             GOLIOTH_CONTENT_TYPE_OCTET_STREAM,
+                                             read_block,
+                                             on_upload_end,
+                                             NULL));
+    TEST_ASSERT_EQUAL(1, num_upload_end_calls);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, upload_end_status);
+}
+
+void next_block_is_read_while_previous_is_in_flight(void)
+{
+    upload(3);
+
+    // The first block is sent alone, until the server accepts its size
+    TEST_ASSERT_EQUAL_STRING("R0 S0 A0 R1 S1 R2 A1 S2 A2 ", events);
+    TEST_ASSERT_TRUE(set_requests[2].is_last);
+}
+
+void blocks_are_sent_from_the_buffer_they_were_read_into(void)
+{
+    upload(1);
+
+    TEST_ASSERT_NOT_NULL(last_read_buffer);
+    TEST_ASSERT_EQUAL_PTR(last_read_buffer, last_nocopy_payload);
+}
+
+void smaller_block_size_from_server_is_used(void)
+{
+    server_block_size = CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE / 2;
+
+    upload(4);
+
+    // Block 0 at full size covers blocks 0 and 1 at half size, and the new size is confirmed
+    // before reading ahead again
+    TEST_ASSERT_EQUAL_STRING("R0 S0 A0 R2 S2 A2 R3 S3 A3 ", events);
+    TEST_ASSERT_EQUAL(BLOCKSIZE_TO_SZX(server_block_size), set_requests[1].block_szx);
+}
+
+void upload_block_size_shrinks_when_block_is_lost(void)
+{
+    ack_delay_ms[1] = 3000;
+
+    upload(6);
+
+    // Block 2, read ahead at full size, is read again as block 4 of half size
+    TEST_ASSERT_EQUAL_STRING("R0 S0 A0 R1 S1 R2 A1 R4 S4 A4 R5 S5 A5 ", events);
+    TEST_ASSERT_EQUAL(BLOCKSIZE_TO_SZX(CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE / 2),
+                      set_requests[2].block_szx);
+    TEST_ASSERT_TRUE(set_requests[3].is_last);
+}
+
+void interrupted_upload_keeps_checkpoint(void)
+{
+    ack_status[2] = GOLIOTH_ERR_TIMEOUT;
+    num_blocks_to_upload = 5;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_TIMEOUT,
+                      golioth_blockwise_post_resumable(client,
+                                                       ".s/",
+                                                       "data",
+                                                       GOLIOTH_CONTENT_TYPE_OCTET_STREAM,
+                                                       read_block,
+                                                       NULL,
+                                                       NULL,
+                                                       &checkpoint_store));
+
+    // Blocks 0 and 1 were acknowledged, saved once the interval was reached
+    TEST_ASSERT_TRUE(has_checkpoint);
+    TEST_ASSERT_EQUAL(1, num_checkpoint_saves);
+    TEST_ASSERT_EQUAL(2, stored_checkpoint.block_idx);
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE, stored_checkpoint.block_size);
+    TEST_ASSERT_EQUAL_MEMORY(set_requests[0].token,
+                             stored_checkpoint.token,
+                             GOLIOTH_COAP_TOKEN_LEN);
+}
+
+void upload_resumes_from_checkpoint(void)
+{
+    stored_checkpoint = (struct golioth_blockwise_checkpoint) {
+        .token = {1, 2, 3, 4, 5, 6, 7, 8},
+        .block_idx = 2,
+        .block_size = CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE,
+    };
+    has_checkpoint = true;
+    num_blocks_to_upload = 4;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_blockwise_post_resumable(client,
+                                                       ".s/",
+                                                       "data",
+                                                       GOLIOTH_CONTENT_TYPE_OCTET_STREAM,
+                                                       read_block,
+                                                       NULL,
+                                                       NULL,
+                                                       &checkpoint_store));
+
+    TEST_ASSERT_EQUAL_STRING("R2 S2 A2 R3 S3 A3 ", events);
+    TEST_ASSERT_EQUAL_MEMORY(stored_checkpoint.token,
+                             set_requests[0].token,
+                             GOLIOTH_COAP_TOKEN_LEN);
+
+    // Block 2 alone didn't reach the interval, and the checkpoint is cleared after the last one
+    TEST_ASSERT_EQUAL(0, num_checkpoint_saves);
+    TEST_ASSERT_FALSE(has_checkpoint);
+}
+
+void multipart_upload_resumes_from_checkpoint(void)
+{
+    stored_checkpoint = (struct golioth_blockwise_checkpoint) {
+        .token = {1, 2, 3, 4, 5, 6, 7, 8},
+        .block_idx = 3,
+        .block_size = CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE,
+    };
+    has_checkpoint = true;
+
+    uint32_t block_idx;
+    struct blockwise_transfer *ctx =
+        golioth_blockwise_upload_resume(client,
+                                        ".s/",
+                                        "data",
+                                        GOLIOTH_CONTENT_TYPE_OCTET_STREAM,
+                                        &checkpoint_store,
+                                        &block_idx);
+    TEST_ASSERT_NOT_NULL(ctx);
+    TEST_ASSERT_EQUAL(3, block_idx);
+
+    static const uint8_t block[CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE];
+    for (uint32_t i = 3; i < 6; i++)
+    {
+        TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                          golioth_blockwise_upload_block(ctx,
+                                                         i,
+                                                         block,
+                                                         (i < 5) ? sizeof(block) : 10,
+                                                         i == 5,
+                                                         NULL,
+                                                         NULL,
+                                                         false,
+                                                         GOLIOTH_SYS_WAIT_FOREVER));
+
+        // Have the server answer the oldest block
+        golioth_sys_sem_take(NULL, 0);
+    }
+    TEST_ASSERT_EQUAL_MEMORY(stored_checkpoint.token,
+                             set_requests[0].token,
+                             GOLIOTH_COAP_TOKEN_LEN);
+
+    // Saved when block 5 was sent, two blocks past the checkpoint it resumed from
+    TEST_ASSERT_EQUAL(1, num_checkpoint_saves);
+    TEST_ASSERT_EQUAL(5, stored_checkpoint.block_idx);
+
+    // The last block was answered, so the checkpoint is gone once the upload is finished
+    TEST_ASSERT_TRUE(has_checkpoint);
+    golioth_blockwise_upload_finish(ctx);
+    TEST_ASSERT_FALSE(has_checkpoint);
+}
+
+void multipart_upload_saves_checkpoint_when_next_block_is_sent(void)
+{
+    uint32_t block_idx;
+    struct blockwise_transfer *ctx =
+        golioth_blockwise_upload_resume(client,
+                                        ".s/",
+                                        "data",
+                                        GOLIOTH_CONTENT_TYPE_OCTET_STREAM,
+                                        &checkpoint_store,
+                                        &block_idx);
+    TEST_ASSERT_NOT_NULL(ctx);
+    TEST_ASSERT_EQUAL(0, block_idx);
+
+    static const uint8_t block[CONFIG_GOLIOTH_BLOCKWISE_UPLOAD_MAX_BLOCK_SIZE];
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                          golioth_blockwise_upload_block(ctx,
+                                                         i,
+                                                         block,
+                                                         sizeof(block),
+                                                         false,
+                                                         NULL,
+                                                         NULL,
+                                                         false,
+                                                         GOLIOTH_SYS_WAIT_FOREVER));
+        golioth_sys_sem_take(NULL, 0);
+    }
+
+    // Responses are recorded on the COAP thread. Blocks 0 and 1 reached the interval, and were
+    // saved when block 2 was sent.
+    TEST_ASSERT_EQUAL(1, num_checkpoint_saves);
+    TEST_ASSERT_EQUAL(2, stored_checkpoint.block_idx);
+
+    // The interrupted upload keeps its checkpoint
+    golioth_blockwise_upload_finish(ctx);
+    TEST_ASSERT_TRUE(has_checkpoint);
+    TEST_ASSERT_EQUAL(1, num_checkpoint_saves);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(first_block_is_requested_alone);
+    RUN_TEST(window_grows_while_responses_are_timely);
+    RUN_TEST(blocks_are_delivered_in_order);
+    RUN_TEST(error_ahead_of_last_block_is_ignored);
+    RUN_TEST(delayed_response_shrinks_window);
+    RUN_TEST(round_trip_is_measured_from_when_block_was_sent);
+    RUN_TEST(block_size_shrinks_when_single_block_is_lost);
+    RUN_TEST(timed_out_block_is_requested_again);
+    RUN_TEST(download_fails_when_block_keeps_timing_out);
+    RUN_TEST(bert_blocks_are_requested_one_at_a_time);
+    RUN_TEST(next_block_is_read_while_previous_is_in_flight);
+    RUN_TEST(blocks_are_sent_from_the_buffer_they_were_read_into);
+    RUN_TEST(smaller_block_size_from_server_is_used);
+    RUN_TEST(upload_block_size_shrinks_when_block_is_lost);
+    RUN_TEST(interrupted_upload_keeps_checkpoint);
+    RUN_TEST(upload_resumes_from_checkpoint);
+    RUN_TEST(multipart_upload_resumes_from_checkpoint);
+    RUN_TEST(multipart_upload_saves_checkpoint_when_next_block_is_sent);
+    return UNITY_END();
+}
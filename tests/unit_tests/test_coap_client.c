@@ -0,0 +1,368 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "coap_client.h"
+#include "coap_client_libcoap.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(golioth_sys_mutex_t, golioth_sys_mutex_create);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_lock, golioth_sys_mutex_t, int32_t);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_unlock, golioth_sys_mutex_t);
+FAKE_VOID_FUNC(golioth_sys_mutex_destroy, golioth_sys_mutex_t);
+FAKE_VALUE_FUNC(golioth_sys_sem_t, golioth_sys_sem_create, uint32_t, uint32_t);
+FAKE_VALUE_FUNC(bool, golioth_sys_sem_take, golioth_sys_sem_t, int32_t);
+FAKE_VALUE_FUNC(bool, golioth_sys_sem_give, golioth_sys_sem_t);
+FAKE_VALUE_FUNC(uint64_t, golioth_sys_now_ms);
+FAKE_VOID_FUNC(golioth_sys_msleep, uint32_t);
+FAKE_VOID_FUNC(golioth_cancel_all_observations, struct golioth_client *);
+FAKE_VOID_FUNC(golioth_cancel_all_observations_by_prefix, struct golioth_client *, const char *);
+FAKE_VALUE_FUNC(enum golioth_status,
+                golioth_cancel_observation,
+                struct golioth_client *,
+                const char *,
+                const char *,
+                enum golioth_content_type,
+                golioth_get_cb_fn,
+                void *);
+
+// Request queue: a plain FIFO of request descriptor pointers
+
+#define QUEUE_SIZE 8
+
+static struct golioth_coap_request_msg *queue[QUEUE_SIZE];
+static size_t queue_head;
+static size_t queue_len;
+
+golioth_mbox_t golioth_mbox_create_prio(const size_t *num_items, size_t num_prios, size_t item_size)
+{
+    return (golioth_mbox_t) queue;
+}
+
+size_t golioth_mbox_num_messages(golioth_mbox_t mbox)
+{
+    return queue_len;
+}
+
+bool golioth_mbox_try_send_prio(golioth_mbox_t mbox, const void *item, size_t prio)
+{
+    if (queue_len == QUEUE_SIZE)
+    {
+        return false;
+    }
+    memcpy(&queue[(queue_head + queue_len) % QUEUE_SIZE], item, sizeof(queue[0]));
+    queue_len++;
+    return true;
+}
+
+size_t golioth_mbox_recv_batch(golioth_mbox_t mbox,
+                               void *items,
+                               size_t max_items,
+                               int32_t timeout_ms)
+{
+    struct golioth_coap_request_msg **msgs = items;
+    size_t num_items = 0;
+
+    while (num_items < max_items && queue_len > 0)
+    {
+        msgs[num_items++] = queue[queue_head];
+        queue_head = (queue_head + 1) % QUEUE_SIZE;
+        queue_len--;
+    }
+
+    return num_items;
+}
+
+// Set callbacks record which args they were called with, in order
+
+static void *set_cb_args[4];
+static size_t num_set_cb_calls;
+
+static void on_set(struct golioth_client *client,
+                   enum golioth_status status,
+                   const struct golioth_coap_rsp_code *coap_rsp_code,
+                   const char *path,
+                   void *arg)
+{
+    set_cb_args[num_set_cb_calls++] = arg;
+}
+
+static struct golioth_client client;
+static const uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
+
+static enum golioth_status set_coalesced(const char *path, const char *value, void *arg)
+{
+    return golioth_coap_client_set_coalesced(&client,
+                                             token,
+                                             ".d/",
+                                             path,
+                                             GOLIOTH_CONTENT_TYPE_JSON,
+                                             (const uint8_t *) value,
+                                             strlen(value),
+                                             on_set,
+                                             arg);
+}
+
+static struct golioth_coap_request_msg *recv_request(void)
+{
+    struct golioth_coap_request_msg *req = NULL;
+    TEST_ASSERT_EQUAL(1, golioth_coap_request_queue_recv(client.request_queue, &req, 1, 0));
+    return req;
+}
+
+static void free_request(struct golioth_coap_request_msg *req)
+{
+    golioth_coap_request_msg_release_payload(req);
+    golioth_coap_request_msg_free_merged_callbacks(req);
+    golioth_coap_request_msg_free(req);
+}
+
+void setUp(void)
+{
+    static int dummy_mutex;
+
+    RESET_FAKE(golioth_sys_mutex_create);
+    RESET_FAKE(golioth_sys_mutex_lock);
+    RESET_FAKE(golioth_sys_mutex_unlock);
+
+    golioth_sys_mutex_create_fake.return_val = &dummy_mutex;
+    golioth_sys_mutex_lock_fake.return_val = true;
+    golioth_sys_mutex_unlock_fake.return_val = true;
+
+    golioth_coap_coalesce_mutex_create();
+    golioth_coap_request_msg_slab_init();
+
+    memset(&client, 0, sizeof(client));
+    client.is_running = true;
+    client.request_queue = golioth_coap_request_queue_create();
+
+    queue_head = 0;
+    queue_len = 0;
+    num_set_cb_calls = 0;
+}
+
+void tearDown(void)
+{
+    while (queue_len > 0)
+    {
+        free_request(recv_request());
+    }
+}
+
+void newer_set_replaces_queued_set_to_same_path(void)
+{
+    int arg1, arg2;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, set_coalesced("counter", "1", &arg1));
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, set_coalesced("counter", "22", &arg2));
+    TEST_ASSERT_EQUAL(1, queue_len);
+
+    struct golioth_coap_request_msg *req = recv_request();
+    TEST_ASSERT_EQUAL(2, req->post.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY("22", req->post.payload, 2);
+    TEST_ASSERT_EQUAL_PTR(&arg2, req->post.arg);
+
+    // Callback of the replaced set is called along with the request's own
+    golioth_coap_request_msg_call_merged_callbacks(&client, req, GOLIOTH_OK, NULL);
+    TEST_ASSERT_EQUAL(1, num_set_cb_calls);
+    TEST_ASSERT_EQUAL_PTR(&arg1, set_cb_args[0]);
+    TEST_ASSERT_NULL(req->post.merged_callbacks);
+
+    free_request(req);
+}
+
+void sets_to_different_paths_are_not_coalesced(void)
+{
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, set_coalesced("a", "1", NULL));
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, set_coalesced("b", "2", NULL));
+    TEST_ASSERT_EQUAL(2, queue_len);
+}
+
+void set_after_request_was_received_is_queued_again(void)
+{
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, set_coalesced("counter", "1", NULL));
+    struct golioth_coap_request_msg *req = recv_request();
+
+    // The coap thread owns the first request now, so it must not be modified
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, set_coalesced("counter", "2", NULL));
+    TEST_ASSERT_EQUAL(1, queue_len);
+    TEST_ASSERT_EQUAL_MEMORY("1", req->post.payload, 1);
+
+    free_request(req);
+}
+
+void plain_set_is_not_coalesced(void)
+{
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, set_coalesced("counter", "1", NULL));
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_client_set(&client,
+                                              token,
+                                              ".d/",
+                                              "counter",
+                                              GOLIOTH_CONTENT_TYPE_JSON,
+                                              (const uint8_t *) "2",
+                                              1,
+                                              NULL,
+                                              NULL,
+                                              false,
+                                              GOLIOTH_SYS_WAIT_FOREVER));
+    TEST_ASSERT_EQUAL(2, queue_len);
+}
+
+void set_with_policy_carries_policy(void)
+{
+    struct golioth_request_policy policy = {
+        .timeout_ms = 500,
+        .max_transmissions = 1,
+    };
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_client_set_with_policy(&client,
+                                                          token,
+                                                          ".s/",
+                                                          "alarm",
+                                                          GOLIOTH_CONTENT_TYPE_JSON,
+                                                          (const uint8_t *) "1",
+                                                          1,
+                                                          &policy,
+                                                          NULL,
+                                                          NULL));
+
+    struct golioth_coap_request_msg *req = recv_request();
+    TEST_ASSERT_EQUAL(500, req->policy.timeout_ms);
+    TEST_ASSERT_EQUAL(1, req->policy.max_transmissions);
+    TEST_ASSERT_FALSE(req->post.coalesce);
+
+    free_request(req);
+}
+
+void requests_without_policy_use_defaults(void)
+{
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, set_coalesced("counter", "1", NULL));
+
+    struct golioth_coap_request_msg *req = recv_request();
+    TEST_ASSERT_EQUAL(0, req->policy.timeout_ms);
+    TEST_ASSERT_EQUAL(0, req->policy.max_transmissions);
+
+    free_request(req);
+}
+
+void get_and_delete_with_policy_carry_policy(void)
+{
+    struct golioth_request_policy policy = {
+        .timeout_ms = 60000,
+    };
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_client_get_with_policy(&client,
+                                                          token,
+                                                          ".d/",
+                                                          "config",
+                                                          GOLIOTH_CONTENT_TYPE_JSON,
+                                                          &policy,
+                                                          NULL,
+                                                          NULL));
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_client_delete_with_policy(&client,
+                                                             ".d/",
+                                                             "config",
+                                                             &policy,
+                                                             NULL,
+                                                             NULL));
+
+    struct golioth_coap_request_msg *req = recv_request();
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_REQUEST_GET, req->type);
+    TEST_ASSERT_EQUAL(60000, req->policy.timeout_ms);
+    free_request(req);
+
+    req = recv_request();
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_REQUEST_DELETE, req->type);
+    TEST_ASSERT_EQUAL(60000, req->policy.timeout_ms);
+    free_request(req);
+}
+
+void with_policy_requires_policy(void)
+{
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_NULL,
+                      golioth_coap_client_set_with_policy(&client,
+                                                          token,
+                                                          ".s/",
+                                                          "alarm",
+                                                          GOLIOTH_CONTENT_TYPE_JSON,
+                                                          (const uint8_t *) "1",
+                                                          1,
+                                                          NULL,
+                                                          NULL,
+                                                          NULL));
+    TEST_ASSERT_EQUAL(0, queue_len);
+}
+
+void requests_beyond_descriptor_pool_keep_their_path(void)
+{
+    char path[8];
+
+    // More requests than the pool has descriptors, the rest come from the heap
+    for (int i = 0; i < CONFIG_GOLIOTH_COAP_REQUEST_MSG_POOL_SIZE + 2; i++)
+    {
+        snprintf(path, sizeof(path), "p%d", i);
+        TEST_ASSERT_EQUAL(GOLIOTH_OK, set_coalesced(path, "1", NULL));
+    }
+    strcpy(path, "gone");
+
+    for (int i = 0; i < CONFIG_GOLIOTH_COAP_REQUEST_MSG_POOL_SIZE + 2; i++)
+    {
+        struct golioth_coap_request_msg *req = recv_request();
+        snprintf(path, sizeof(path), "p%d", i);
+        TEST_ASSERT_EQUAL_STRING(path, req->path);
+        free_request(req);
+    }
+}
+
+void requests_fail_fast_while_offline(void)
+{
+    client.conn_state = GOLIOTH_COAP_CONN_OFFLINE;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_OFFLINE, set_coalesced("counter", "1", NULL));
+    TEST_ASSERT_EQUAL(0, queue_len);
+
+    client.conn_state = GOLIOTH_COAP_CONN_CONNECTING;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, set_coalesced("counter", "1", NULL));
+    TEST_ASSERT_EQUAL(1, queue_len);
+}
+
+void observations_are_queued_while_offline(void)
+{
+    client.conn_state = GOLIOTH_COAP_CONN_OFFLINE;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_client_observe(&client,
+                                                  token,
+                                                  ".d/",
+                                                  "led",
+                                                  GOLIOTH_CONTENT_TYPE_JSON,
+                                                  NULL,
+                                                  NULL));
+    TEST_ASSERT_EQUAL(1, queue_len);
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_REQUEST_OBSERVE, queue[queue_head]->type);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(newer_set_replaces_queued_set_to_same_path);
+    RUN_TEST(sets_to_different_paths_are_not_coalesced);
+    RUN_TEST(set_after_request_was_received_is_queued_again);
+    RUN_TEST(plain_set_is_not_coalesced);
+    RUN_TEST(set_with_policy_carries_policy);
+    RUN_TEST(requests_without_policy_use_defaults);
+    RUN_TEST(get_and_delete_with_policy_carry_policy);
+    RUN_TEST(requests_beyond_descriptor_pool_keep_their_path);
+    RUN_TEST(with_policy_requires_policy);
+    RUN_TEST(requests_fail_fast_while_offline);
+    RUN_TEST(observations_are_queued_while_offline);
+    return UNITY_END();
+}
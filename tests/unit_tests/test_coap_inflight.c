@@ -0,0 +1,347 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "coap_inflight.h"
+#include "golioth_util.h"
+
+DEFINE_FFF_GLOBALS;
+
+#define MAX_DONE CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS
+
+static struct golioth_coap_inflight inflight;
+
+// The window only points to its requests
+static struct golioth_coap_request_msg reqs[CONFIG_GOLIOTH_COAP_MAX_INFLIGHT_REQUESTS];
+static size_t num_reqs;
+
+// Requests passed to the done callback, in call order
+static struct
+{
+    uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
+    enum golioth_coap_inflight_result result;
+} done[MAX_DONE];
+static size_t num_done;
+
+static void record_done(struct golioth_coap_request_msg *req,
+                        enum golioth_coap_inflight_result result,
+                        void *arg)
+{
+    TEST_ASSERT_LESS_THAN(MAX_DONE, num_done);
+
+    memcpy(done[num_done].token, req->token, GOLIOTH_COAP_TOKEN_LEN);
+    done[num_done].result = result;
+    num_done++;
+}
+
+static struct golioth_coap_request_msg *new_req(void)
+{
+    TEST_ASSERT_LESS_THAN(ARRAY_SIZE(reqs), num_reqs);
+
+    return &reqs[num_reqs++];
+}
+
+static void add_get(uint8_t token_id, uint64_t deadline_ms)
+{
+    struct golioth_coap_request_msg *req = new_req();
+    req->type = GOLIOTH_COAP_REQUEST_GET;
+    memset(req->token, token_id, sizeof(req->token));
+
+    golioth_coap_inflight_add(&inflight, req, deadline_ms);
+}
+
+static void add_post_block(uint8_t token_id, size_t block_index, size_t block_szx)
+{
+    struct golioth_coap_request_msg *req = new_req();
+    req->type = GOLIOTH_COAP_REQUEST_POST_BLOCK;
+    req->post_block.block_index = block_index;
+    req->post_block.block_szx = block_szx;
+    memset(req->token, token_id, sizeof(req->token));
+
+    golioth_coap_inflight_add(&inflight, req, 1000);
+}
+
+static struct golioth_coap_request_msg *find(uint8_t token_id,
+                                             const struct golioth_coap_inflight_block1 *block1)
+{
+    uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
+    memset(token, token_id, sizeof(token));
+
+    return golioth_coap_inflight_find(&inflight, token, sizeof(token), block1);
+}
+
+void setUp(void)
+{
+    memset(&inflight, 0, sizeof(inflight));
+    memset(reqs, 0, sizeof(reqs));
+    num_reqs = 0;
+    memset(done, 0, sizeof(done));
+    num_done = 0;
+}
+
+void tearDown(void) {}
+
+void window_fills_and_frees(void)
+{
+    TEST_ASSERT_EQUAL(4, golioth_coap_inflight_num_free(&inflight));
+
+    add_get(1, 1000);
+    add_get(2, 1000);
+    TEST_ASSERT_EQUAL(2, golioth_coap_inflight_num_free(&inflight));
+
+    find(1, NULL)->got_response = true;
+    golioth_coap_inflight_process(&inflight, 0, record_done, NULL);
+    TEST_ASSERT_EQUAL(3, golioth_coap_inflight_num_free(&inflight));
+}
+
+void window_points_to_the_request(void)
+{
+    add_get(1, 1000);
+
+    // Responses are recorded in the queued descriptor itself
+    TEST_ASSERT_TRUE(find(1, NULL) == &reqs[0]);
+}
+
+void responses_out_of_order(void)
+{
+    add_get(1, 1000);
+    add_get(2, 1000);
+    add_get(3, 1000);
+
+    // The last request sent is answered first
+    struct golioth_coap_request_msg *req = find(3, NULL);
+    TEST_ASSERT_NOT_NULL(req);
+    TEST_ASSERT_EQUAL(3, req->token[0]);
+    req->got_response = true;
+
+    golioth_coap_inflight_process(&inflight, 0, record_done, NULL);
+    TEST_ASSERT_EQUAL(1, num_done);
+    TEST_ASSERT_EQUAL(3, done[0].token[0]);
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_INFLIGHT_RESPONSE, done[0].result);
+    TEST_ASSERT_NULL(find(3, NULL));
+
+    find(1, NULL)->got_response = true;
+    golioth_coap_inflight_process(&inflight, 0, record_done, NULL);
+    TEST_ASSERT_EQUAL(2, num_done);
+    TEST_ASSERT_EQUAL(1, done[1].token[0]);
+
+    // The remaining request is still waiting
+    TEST_ASSERT_NOT_NULL(find(2, NULL));
+    TEST_ASSERT_EQUAL(3, golioth_coap_inflight_num_free(&inflight));
+}
+
+void unknown_token_matches_nothing(void)
+{
+    add_get(1, 1000);
+
+    TEST_ASSERT_NULL(find(2, NULL));
+
+    // Only full length tokens are ours
+    uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
+    memset(token, 1, sizeof(token));
+    TEST_ASSERT_NULL(golioth_coap_inflight_find(&inflight, token, sizeof(token) - 1, NULL));
+}
+
+void blocks_sharing_a_token_match_by_block1(void)
+{
+    add_post_block(1, 0, 6);
+    add_post_block(1, 1, 6);
+    add_post_block(1, 2, 6);
+
+    struct golioth_coap_inflight_block1 block1 = {
+        .num = 1,
+        .szx = 6,
+    };
+    struct golioth_coap_request_msg *req = find(1, &block1);
+    TEST_ASSERT_NOT_NULL(req);
+    TEST_ASSERT_EQUAL(1, req->post_block.block_index);
+
+    block1.num = 2;
+    req = find(1, &block1);
+    TEST_ASSERT_NOT_NULL(req);
+    TEST_ASSERT_EQUAL(2, req->post_block.block_index);
+
+    block1.num = 3;
+    TEST_ASSERT_NULL(find(1, &block1));
+}
+
+void block1_with_smaller_szx_matches_by_offset(void)
+{
+    // Blocks 4 and 5 of 1024 bytes, bytes 4096 to 6143
+    add_post_block(1, 4, 6);
+    add_post_block(1, 5, 6);
+
+    // Server asking for 512 byte blocks acknowledges the second block at its own numbering
+    struct golioth_coap_inflight_block1 block1 = {
+        .num = 10,
+        .szx = 5,
+    };
+    struct golioth_coap_request_msg *req = find(1, &block1);
+    TEST_ASSERT_NOT_NULL(req);
+    TEST_ASSERT_EQUAL(5, req->post_block.block_index);
+
+    block1.num = 9;
+    req = find(1, &block1);
+    TEST_ASSERT_NOT_NULL(req);
+    TEST_ASSERT_EQUAL(4, req->post_block.block_index);
+
+    // Past the blocks in flight
+    block1.num = 12;
+    TEST_ASSERT_NULL(find(1, &block1));
+
+    // Without a Block1 option only the token counts
+    TEST_ASSERT_NOT_NULL(find(1, NULL));
+}
+
+void bert_block1_matches_by_offset(void)
+{
+    // BERT block numbers count 1024 byte units, blocks 0 to 1 and 2 to 3
+    add_post_block(1, 0, GOLIOTH_COAP_BERT_SZX);
+    reqs[0].post_block.payload_size = 2048;
+    add_post_block(1, 2, GOLIOTH_COAP_BERT_SZX);
+    reqs[1].post_block.payload_size = 2048;
+
+    struct golioth_coap_inflight_block1 block1 = {
+        .num = 2,
+        .szx = GOLIOTH_COAP_BERT_SZX,
+    };
+    TEST_ASSERT_EQUAL(2, find(1, &block1)->post_block.block_index);
+
+    // Server falling back to 1024 byte blocks
+    block1.num = 1;
+    block1.szx = 6;
+    TEST_ASSERT_EQUAL(0, find(1, &block1)->post_block.block_index);
+}
+
+void block1_is_ignored_for_other_requests(void)
+{
+    add_get(1, 1000);
+
+    struct golioth_coap_inflight_block1 block1 = {
+        .num = 5,
+        .szx = 6,
+    };
+    TEST_ASSERT_NOT_NULL(find(1, &block1));
+}
+
+void requests_time_out_individually(void)
+{
+    add_get(1, 300);
+    add_get(2, 100);
+    add_get(3, 200);
+
+    TEST_ASSERT_EQUAL(100, golioth_coap_inflight_next_deadline_ms(&inflight, 0, 1000));
+
+    golioth_coap_inflight_process(&inflight, 99, record_done, NULL);
+    TEST_ASSERT_EQUAL(0, num_done);
+
+    golioth_coap_inflight_process(&inflight, 150, record_done, NULL);
+    TEST_ASSERT_EQUAL(1, num_done);
+    TEST_ASSERT_EQUAL(2, done[0].token[0]);
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_INFLIGHT_TIMEOUT, done[0].result);
+
+    // The others keep their own deadlines
+    TEST_ASSERT_NOT_NULL(find(1, NULL));
+    TEST_ASSERT_NOT_NULL(find(3, NULL));
+    TEST_ASSERT_EQUAL(50, golioth_coap_inflight_next_deadline_ms(&inflight, 150, 1000));
+}
+
+void response_before_deadline_is_not_a_timeout(void)
+{
+    add_get(1, 100);
+    find(1, NULL)->got_response = true;
+
+    golioth_coap_inflight_process(&inflight, 200, record_done, NULL);
+    TEST_ASSERT_EQUAL(1, num_done);
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_INFLIGHT_RESPONSE, done[0].result);
+}
+
+void next_deadline(void)
+{
+    TEST_ASSERT_EQUAL(-1, golioth_coap_inflight_next_deadline_ms(&inflight, 0, 1000));
+
+    add_get(1, 5000);
+    TEST_ASSERT_EQUAL(1000, golioth_coap_inflight_next_deadline_ms(&inflight, 0, 1000));
+    TEST_ASSERT_EQUAL(0, golioth_coap_inflight_next_deadline_ms(&inflight, 5000, 1000));
+}
+
+void nack_of_one_request(void)
+{
+    add_get(1, 1000);
+    add_get(2, 1000);
+    add_get(3, 1000);
+
+    find(2, NULL)->got_nack = true;
+
+    golioth_coap_inflight_process(&inflight, 0, record_done, NULL);
+    TEST_ASSERT_EQUAL(1, num_done);
+    TEST_ASSERT_EQUAL(2, done[0].token[0]);
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_INFLIGHT_NACK, done[0].result);
+    TEST_ASSERT_NOT_NULL(find(1, NULL));
+    TEST_ASSERT_NOT_NULL(find(3, NULL));
+}
+
+void nack_of_all_requests(void)
+{
+    add_get(1, 1000);
+    add_get(2, 1000);
+    add_get(3, 1000);
+
+    // A request that already got its response is not affected
+    find(1, NULL)->got_response = true;
+    golioth_coap_inflight_nack_all(&inflight);
+
+    golioth_coap_inflight_process(&inflight, 0, record_done, NULL);
+    TEST_ASSERT_EQUAL(3, num_done);
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_INFLIGHT_RESPONSE, done[0].result);
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_INFLIGHT_NACK, done[1].result);
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_INFLIGHT_NACK, done[2].result);
+    TEST_ASSERT_EQUAL(4, golioth_coap_inflight_num_free(&inflight));
+}
+
+void cancel_all_requests(void)
+{
+    add_get(1, 1000);
+    add_get(2, 1000);
+
+    golioth_coap_inflight_cancel_all(&inflight, record_done, NULL);
+    TEST_ASSERT_EQUAL(2, num_done);
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_INFLIGHT_CANCELLED, done[0].result);
+    TEST_ASSERT_EQUAL(GOLIOTH_COAP_INFLIGHT_CANCELLED, done[1].result);
+    TEST_ASSERT_EQUAL(-1, golioth_coap_inflight_next_deadline_ms(&inflight, 0, 1000));
+}
+
+void added_request_clears_flags(void)
+{
+    struct golioth_coap_request_msg *req = new_req();
+    req->type = GOLIOTH_COAP_REQUEST_GET;
+    req->got_response = true;
+    req->got_nack = true;
+    memset(req->token, 1, sizeof(req->token));
+    golioth_coap_inflight_add(&inflight, req, 1000);
+
+    golioth_coap_inflight_process(&inflight, 0, record_done, NULL);
+    TEST_ASSERT_EQUAL(0, num_done);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(window_fills_and_frees);
+    RUN_TEST(window_points_to_the_request);
+    RUN_TEST(responses_out_of_order);
+    RUN_TEST(unknown_token_matches_nothing);
+    RUN_TEST(blocks_sharing_a_token_match_by_block1);
+    RUN_TEST(block1_with_smaller_szx_matches_by_offset);
+    RUN_TEST(bert_block1_matches_by_offset);
+    RUN_TEST(block1_is_ignored_for_other_requests);
+    RUN_TEST(requests_time_out_individually);
+    RUN_TEST(response_before_deadline_is_not_a_timeout);
+    RUN_TEST(next_deadline);
+    RUN_TEST(nack_of_one_request);
+    RUN_TEST(nack_of_all_requests);
+    RUN_TEST(cancel_all_requests);
+    RUN_TEST(added_request_clears_flags);
+    return UNITY_END();
+}
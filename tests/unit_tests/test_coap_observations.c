@@ -0,0 +1,421 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coap_observations.h"
+#include "golioth_util.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(golioth_sys_mutex_t, golioth_sys_mutex_create);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_lock, golioth_sys_mutex_t, int32_t);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_unlock, golioth_sys_mutex_t);
+FAKE_VOID_FUNC(golioth_sys_mutex_destroy, golioth_sys_mutex_t);
+
+static struct golioth_coap_observations observations;
+
+// Subscriber callbacks record their args and the notified path, in order
+
+static void *notified_args[8];
+static char notified_path[CONFIG_GOLIOTH_COAP_MAX_PATH_LEN + 1];
+static size_t num_notifications;
+
+static void on_notify(struct golioth_client *client,
+                      enum golioth_status status,
+                      const struct golioth_coap_rsp_code *coap_rsp_code,
+                      const char *path,
+                      const uint8_t *payload,
+                      size_t payload_size,
+                      void *arg)
+{
+    if (num_notifications < sizeof(notified_args) / sizeof(notified_args[0]))
+    {
+        notified_args[num_notifications] = arg;
+    }
+    num_notifications++;
+    strcpy(notified_path, path);
+}
+
+// Requests only point to their path, so keep the last few paths around
+static char req_paths[4][CONFIG_GOLIOTH_COAP_MAX_PATH_LEN + 1];
+static size_t next_req_path;
+
+static struct golioth_coap_request_msg observe_req(uint32_t id, const char *path_prefix)
+{
+    char *path = req_paths[next_req_path++ % ARRAY_SIZE(req_paths)];
+    snprintf(path, sizeof(req_paths[0]), "path%u", (unsigned int) id);
+
+    struct golioth_coap_request_msg req = {
+        .type = GOLIOTH_COAP_REQUEST_OBSERVE,
+        .path_prefix = path_prefix,
+        .observe =
+            {
+                .content_type = GOLIOTH_CONTENT_TYPE_JSON,
+                .callback = on_notify,
+            },
+    };
+    memcpy(req.token, &id, sizeof(id));
+    req.path = path;
+    return req;
+}
+
+static void add(uint32_t id, const char *path_prefix)
+{
+    struct golioth_coap_request_msg req = observe_req(id, path_prefix);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_add(&observations, &req, NULL, NULL));
+}
+
+static bool notify(uint32_t id)
+{
+    struct golioth_coap_request_msg req = observe_req(id, "");
+    return golioth_coap_observations_notify(&observations,
+                                            NULL,
+                                            req.token,
+                                            sizeof(req.token),
+                                            GOLIOTH_OK,
+                                            NULL,
+                                            NULL,
+                                            0);
+}
+
+static size_t free_taken(struct golioth_coap_observe_info *info, const char *path_prefix)
+{
+    size_t num_taken = 0;
+    while (info)
+    {
+        struct golioth_coap_observe_info *next = info->prefix_next;
+        TEST_ASSERT_EQUAL_STRING(path_prefix, info->req.path_prefix);
+        golioth_coap_observations_free(info);
+        info = next;
+        num_taken++;
+    }
+    return num_taken;
+}
+
+void setUp(void)
+{
+    static int dummy_mutex;
+
+    RESET_FAKE(golioth_sys_mutex_create);
+    RESET_FAKE(golioth_sys_mutex_lock);
+    RESET_FAKE(golioth_sys_mutex_unlock);
+    RESET_FAKE(golioth_sys_mutex_destroy);
+
+    golioth_sys_mutex_create_fake.return_val = &dummy_mutex;
+    golioth_sys_mutex_lock_fake.return_val = true;
+    golioth_sys_mutex_unlock_fake.return_val = true;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_coap_observations_init(&observations));
+
+    num_notifications = 0;
+}
+
+void tearDown(void)
+{
+    golioth_coap_observations_deinit(&observations);
+}
+
+void empty_table_notifies_nothing(void)
+{
+    TEST_ASSERT_FALSE(notify(1));
+    TEST_ASSERT_EQUAL(0, num_notifications);
+    TEST_ASSERT_EQUAL(0, golioth_coap_observations_count(&observations));
+}
+
+void notify_calls_observation_with_matching_token(void)
+{
+    add(1, ".d/");
+    add(2, ".d/");
+
+    TEST_ASSERT_TRUE(notify(2));
+    TEST_ASSERT_EQUAL(1, num_notifications);
+    TEST_ASSERT_EQUAL_STRING("path2", notified_path);
+    TEST_ASSERT_TRUE(notify(1));
+    TEST_ASSERT_EQUAL_STRING("path1", notified_path);
+    TEST_ASSERT_FALSE(notify(3));
+    TEST_ASSERT_EQUAL(2, num_notifications);
+}
+
+void notify_with_other_token_length_fails(void)
+{
+    add(1, ".d/");
+    struct golioth_coap_request_msg req = observe_req(1, ".d/");
+    TEST_ASSERT_FALSE(golioth_coap_observations_notify(&observations,
+                                                       NULL,
+                                                       req.token,
+                                                       4,
+                                                       GOLIOTH_OK,
+                                                       NULL,
+                                                       NULL,
+                                                       0));
+}
+
+void table_grows_past_initial_buckets(void)
+{
+    const uint32_t num_observations = CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS;
+
+    for (uint32_t id = 0; id < num_observations; id++)
+    {
+        add(id, ".d/");
+    }
+    TEST_ASSERT_EQUAL(num_observations, golioth_coap_observations_count(&observations));
+    TEST_ASSERT_GREATER_OR_EQUAL(num_observations, observations.num_buckets);
+
+    for (uint32_t id = 0; id < num_observations; id++)
+    {
+        char path[16];
+        snprintf(path, sizeof(path), "path%u", (unsigned int) id);
+
+        TEST_ASSERT_TRUE(notify(id));
+        TEST_ASSERT_EQUAL_STRING(path, notified_path);
+    }
+}
+
+void add_beyond_limit_fails(void)
+{
+    for (uint32_t id = 0; id < CONFIG_GOLIOTH_MAX_NUM_OBSERVATIONS; id++)
+    {
+        add(id, ".d/");
+    }
+
+    struct golioth_coap_request_msg req = observe_req(1000, ".d/");
+    struct golioth_coap_observe_info *info = &(struct golioth_coap_observe_info){0};
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_QUEUE_FULL,
+                      golioth_coap_observations_add(&observations, &req, &info, NULL));
+    TEST_ASSERT_NULL(info);
+}
+
+void take_by_prefix_removes_only_matching(void)
+{
+    add(1, ".d/");
+    add(2, ".rpc/");
+    add(3, ".d/");
+    add(4, ".c/");
+
+    TEST_ASSERT_EQUAL(2,
+                      free_taken(golioth_coap_observations_take_by_prefix(&observations, ".d/"),
+                                 ".d/"));
+    TEST_ASSERT_EQUAL(2, golioth_coap_observations_count(&observations));
+    TEST_ASSERT_FALSE(notify(1));
+    TEST_ASSERT_TRUE(notify(2));
+    TEST_ASSERT_FALSE(notify(3));
+    TEST_ASSERT_TRUE(notify(4));
+
+    TEST_ASSERT_NULL(golioth_coap_observations_take_by_prefix(&observations, ".d/"));
+}
+
+void take_all_removes_everything(void)
+{
+    add(1, ".d/");
+    add(2, ".rpc/");
+
+    struct golioth_coap_observe_info *info =
+        golioth_coap_observations_take_by_prefix(&observations, NULL);
+    size_t num_taken = 0;
+    while (info)
+    {
+        struct golioth_coap_observe_info *next = info->prefix_next;
+        golioth_coap_observations_free(info);
+        info = next;
+        num_taken++;
+    }
+
+    TEST_ASSERT_EQUAL(2, num_taken);
+    TEST_ASSERT_EQUAL(0, golioth_coap_observations_count(&observations));
+    TEST_ASSERT_NULL(observations.prefixes);
+}
+
+void removed_observation_is_not_notified(void)
+{
+    struct golioth_coap_observe_info *info;
+
+    add(1, ".d/");
+    struct golioth_coap_request_msg req = observe_req(2, ".d/");
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_add(&observations, &req, &info, NULL));
+    add(3, ".d/");
+
+    golioth_coap_observations_remove(&observations, info);
+
+    TEST_ASSERT_FALSE(notify(2));
+    TEST_ASSERT_TRUE(notify(1));
+    TEST_ASSERT_TRUE(notify(3));
+    TEST_ASSERT_EQUAL(2,
+                      free_taken(golioth_coap_observations_take_by_prefix(&observations, ".d/"),
+                                 ".d/"));
+}
+
+void same_path_shares_observation(void)
+{
+    int arg1, arg2;
+    struct golioth_coap_observe_info *info1, *info2;
+    bool is_new;
+
+    struct golioth_coap_request_msg req = observe_req(1, ".d/");
+    req.observe.arg = &arg1;
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_add(&observations, &req, &info1, &is_new));
+    TEST_ASSERT_TRUE(is_new);
+
+    // Same path, new token
+    req = observe_req(1, ".d/");
+    req.token[7] = 0xff;
+    req.observe.arg = &arg2;
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_add(&observations, &req, &info2, &is_new));
+    TEST_ASSERT_FALSE(is_new);
+    TEST_ASSERT_EQUAL_PTR(info1, info2);
+    TEST_ASSERT_EQUAL(1, golioth_coap_observations_count(&observations));
+
+    // Notifications of the first observation are fanned out, in order
+    TEST_ASSERT_TRUE(notify(1));
+    TEST_ASSERT_EQUAL(2, num_notifications);
+    TEST_ASSERT_EQUAL_PTR(&arg1, notified_args[0]);
+    TEST_ASSERT_EQUAL_PTR(&arg2, notified_args[1]);
+}
+
+void other_content_type_or_prefix_is_not_shared(void)
+{
+    bool is_new;
+
+    add(1, ".d/");
+
+    struct golioth_coap_request_msg req = observe_req(1, ".d/");
+    req.observe.content_type = GOLIOTH_CONTENT_TYPE_CBOR;
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_add(&observations, &req, NULL, &is_new));
+    TEST_ASSERT_TRUE(is_new);
+
+    req = observe_req(1, ".c/");
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_add(&observations, &req, NULL, &is_new));
+    TEST_ASSERT_TRUE(is_new);
+}
+
+void last_unsubscribe_releases_observation(void)
+{
+    int arg1, arg2;
+    struct golioth_coap_observe_info *released;
+
+    struct golioth_coap_request_msg req = observe_req(1, ".d/");
+    req.observe.arg = &arg1;
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_add(&observations, &req, NULL, NULL));
+    req.observe.arg = &arg2;
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_add(&observations, &req, NULL, NULL));
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_unsubscribe(&observations,
+                                                            ".d/",
+                                                            "path1",
+                                                            GOLIOTH_CONTENT_TYPE_JSON,
+                                                            on_notify,
+                                                            &arg1,
+                                                            &released));
+    TEST_ASSERT_NULL(released);
+
+    TEST_ASSERT_TRUE(notify(1));
+    TEST_ASSERT_EQUAL(1, num_notifications);
+    TEST_ASSERT_EQUAL_PTR(&arg2, notified_args[0]);
+
+    // Already removed
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_STATE,
+                      golioth_coap_observations_unsubscribe(&observations,
+                                                            ".d/",
+                                                            "path1",
+                                                            GOLIOTH_CONTENT_TYPE_JSON,
+                                                            on_notify,
+                                                            &arg1,
+                                                            &released));
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_unsubscribe(&observations,
+                                                            ".d/",
+                                                            "path1",
+                                                            GOLIOTH_CONTENT_TYPE_JSON,
+                                                            on_notify,
+                                                            &arg2,
+                                                            &released));
+    TEST_ASSERT_NOT_NULL(released);
+    TEST_ASSERT_EQUAL_STRING("path1", released->req.path);
+    golioth_coap_observations_free(released);
+
+    TEST_ASSERT_EQUAL(0, golioth_coap_observations_count(&observations));
+    TEST_ASSERT_FALSE(notify(1));
+}
+
+void subscribers_beyond_limit_fail(void)
+{
+    int args[CONFIG_GOLIOTH_MAX_NUM_OBSERVE_SUBSCRIBERS + 1];
+    struct golioth_coap_observe_info *released;
+
+    struct golioth_coap_request_msg req = observe_req(1, ".d/");
+    for (size_t i = 0; i < CONFIG_GOLIOTH_MAX_NUM_OBSERVE_SUBSCRIBERS; i++)
+    {
+        req.observe.arg = &args[i];
+        TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                          golioth_coap_observations_add(&observations, &req, NULL, NULL));
+    }
+
+    struct golioth_coap_observe_info *info = &(struct golioth_coap_observe_info){0};
+    req.observe.arg = &args[CONFIG_GOLIOTH_MAX_NUM_OBSERVE_SUBSCRIBERS];
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_QUEUE_FULL,
+                      golioth_coap_observations_add(&observations, &req, &info, NULL));
+    TEST_ASSERT_NULL(info);
+
+    TEST_ASSERT_TRUE(notify(1));
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_MAX_NUM_OBSERVE_SUBSCRIBERS, num_notifications);
+
+    // Room for another subscriber once one is gone
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_unsubscribe(&observations,
+                                                            ".d/",
+                                                            "path1",
+                                                            GOLIOTH_CONTENT_TYPE_JSON,
+                                                            on_notify,
+                                                            &args[0],
+                                                            &released));
+    TEST_ASSERT_EQUAL(GOLIOTH_OK,
+                      golioth_coap_observations_add(&observations, &req, NULL, NULL));
+}
+
+static void count_observation(struct golioth_coap_observe_info *info, void *arg)
+{
+    size_t *count = arg;
+    (*count)++;
+}
+
+void foreach_visits_all_observations(void)
+{
+    size_t count = 0;
+
+    add(1, ".d/");
+    add(2, ".rpc/");
+    add(3, ".d/");
+
+    golioth_coap_observations_foreach(&observations, count_observation, &count);
+    TEST_ASSERT_EQUAL(3, count);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(empty_table_notifies_nothing);
+    RUN_TEST(notify_calls_observation_with_matching_token);
+    RUN_TEST(notify_with_other_token_length_fails);
+    RUN_TEST(table_grows_past_initial_buckets);
+    RUN_TEST(add_beyond_limit_fails);
+    RUN_TEST(take_by_prefix_removes_only_matching);
+    RUN_TEST(take_all_removes_everything);
+    RUN_TEST(removed_observation_is_not_notified);
+    RUN_TEST(same_path_shares_observation);
+    RUN_TEST(other_content_type_or_prefix_is_not_shared);
+    RUN_TEST(last_unsubscribe_releases_observation);
+    RUN_TEST(subscribers_beyond_limit_fail);
+    RUN_TEST(foreach_visits_all_observations);
+    return UNITY_END();
+}
@@ -0,0 +1,71 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+
+#include "coap_reconnect.h"
+
+DEFINE_FFF_GLOBALS;
+
+static struct golioth_coap_reconnect_backoff backoff;
+
+void setUp(void)
+{
+    golioth_coap_reconnect_backoff_reset(&backoff);
+}
+
+void tearDown(void) {}
+
+void first_delay_is_minimum(void)
+{
+    // Randomized between half and all of the nominal delay
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MIN_MS / 2,
+                      golioth_coap_reconnect_backoff_next(&backoff, 0));
+
+    golioth_coap_reconnect_backoff_reset(&backoff);
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MIN_MS,
+                      golioth_coap_reconnect_backoff_next(&backoff,
+                                                          CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MIN_MS
+                                                              / 2));
+}
+
+void delay_doubles_with_each_attempt(void)
+{
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MIN_MS / 2,
+                      golioth_coap_reconnect_backoff_next(&backoff, 0));
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MIN_MS,
+                      golioth_coap_reconnect_backoff_next(&backoff, 0));
+    TEST_ASSERT_EQUAL(2 * CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MIN_MS,
+                      golioth_coap_reconnect_backoff_next(&backoff, 0));
+}
+
+void delay_is_capped(void)
+{
+    for (int i = 0; i < 32; i++)
+    {
+        uint32_t delay_ms = golioth_coap_reconnect_backoff_next(&backoff, UINT32_MAX);
+        TEST_ASSERT_LESS_OR_EQUAL(CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MAX_MS, delay_ms);
+    }
+
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MAX_MS / 2,
+                      golioth_coap_reconnect_backoff_next(&backoff, 0));
+}
+
+void reset_starts_over(void)
+{
+    golioth_coap_reconnect_backoff_next(&backoff, 0);
+    golioth_coap_reconnect_backoff_next(&backoff, 0);
+    golioth_coap_reconnect_backoff_reset(&backoff);
+
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_COAP_RECONNECT_DELAY_MIN_MS / 2,
+                      golioth_coap_reconnect_backoff_next(&backoff, 0));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(first_delay_is_minimum);
+    RUN_TEST(delay_doubles_with_each_attempt);
+    RUN_TEST(delay_is_capped);
+    RUN_TEST(reset_starts_over);
+    return UNITY_END();
+}
@@ -0,0 +1,124 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+
+#include "coap_rto.h"
+
+DEFINE_FFF_GLOBALS;
+
+static struct golioth_coap_rto rto;
+
+void setUp(void)
+{
+    golioth_coap_rto_init(&rto, 2000, 0);
+}
+
+void tearDown(void) {}
+
+void initial_rto_is_used_before_first_sample(void)
+{
+    TEST_ASSERT_EQUAL(2000, golioth_coap_rto_get(&rto, 0));
+}
+
+void strong_sample_pulls_rto_halfway(void)
+{
+    // First sample: SRTT = 200, RTTVAR = 100, RTO_strong = 200 + 4 * 100 = 600
+    golioth_coap_rto_update(&rto, 200, 0, 100);
+    TEST_ASSERT_EQUAL((600 + 2000) / 2, golioth_coap_rto_get(&rto, 100));
+}
+
+void weak_sample_pulls_rto_a_quarter(void)
+{
+    // First sample: SRTT = 400, RTTVAR = 200, RTO_weak = 400 + 1 * 200 = 600
+    golioth_coap_rto_update(&rto, 400, 1, 100);
+    TEST_ASSERT_EQUAL((600 + 3 * 2000) / 4, golioth_coap_rto_get(&rto, 100));
+}
+
+void sample_with_many_retransmissions_is_ignored(void)
+{
+    golioth_coap_rto_update(&rto, 400, 3, 100);
+    TEST_ASSERT_EQUAL(2000, golioth_coap_rto_get(&rto, 100));
+    TEST_ASSERT_FALSE(rto.weak.has_samples);
+}
+
+void rto_converges_on_stable_rtt(void)
+{
+    uint32_t now = 0;
+
+    for (int i = 0; i < 50; i++)
+    {
+        now += 100;
+        golioth_coap_rto_update(&rto, 100, 0, now);
+    }
+
+    // RTTVAR decays towards zero, so the RTO approaches the RTT
+    uint32_t rto_ms = golioth_coap_rto_get(&rto, now);
+    TEST_ASSERT_TRUE(rto_ms >= 100);
+    TEST_ASSERT_TRUE(rto_ms < 200);
+}
+
+void rto_is_clamped(void)
+{
+    uint32_t now = 0;
+
+    for (int i = 0; i < 50; i++)
+    {
+        now += 10;
+        golioth_coap_rto_update(&rto, 1, 0, now);
+    }
+    TEST_ASSERT_EQUAL(100, golioth_coap_rto_get(&rto, now));
+
+    golioth_coap_rto_init(&rto, 2000, 0);
+    golioth_coap_rto_update(&rto, 100000, 0, 0);
+    TEST_ASSERT_EQUAL(60000, golioth_coap_rto_get(&rto, 0));
+}
+
+void small_rto_ages_up_when_idle(void)
+{
+    golioth_coap_rto_init(&rto, 500, 0);
+
+    TEST_ASSERT_EQUAL(500, golioth_coap_rto_get(&rto, 16 * 500 - 1));
+    TEST_ASSERT_EQUAL(1000, golioth_coap_rto_get(&rto, 16 * 500));
+}
+
+void large_rto_ages_down_when_idle(void)
+{
+    golioth_coap_rto_init(&rto, 6000, 0);
+
+    TEST_ASSERT_EQUAL(6000, golioth_coap_rto_get(&rto, 4 * 6000 - 1));
+    TEST_ASSERT_EQUAL((2000 + 6000) / 2, golioth_coap_rto_get(&rto, 4 * 6000));
+}
+
+void aging_handles_timestamp_wraparound(void)
+{
+    golioth_coap_rto_init(&rto, 500, UINT32_MAX - 100);
+
+    TEST_ASSERT_EQUAL(500, golioth_coap_rto_get(&rto, 100));
+    TEST_ASSERT_EQUAL(1000, golioth_coap_rto_get(&rto, 16 * 500));
+}
+
+void backoff_factor_depends_on_initial_timeout(void)
+{
+    TEST_ASSERT_EQUAL(1500, golioth_coap_rto_backoff(500, 500));
+    TEST_ASSERT_EQUAL(4000, golioth_coap_rto_backoff(2000, 2000));
+    TEST_ASSERT_EQUAL(6000, golioth_coap_rto_backoff(4000, 4000));
+
+    // The factor of the first transmission is kept for the whole exchange
+    TEST_ASSERT_EQUAL(4500, golioth_coap_rto_backoff(1500, 500));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(initial_rto_is_used_before_first_sample);
+    RUN_TEST(strong_sample_pulls_rto_halfway);
+    RUN_TEST(weak_sample_pulls_rto_a_quarter);
+    RUN_TEST(sample_with_many_retransmissions_is_ignored);
+    RUN_TEST(rto_converges_on_stable_rtt);
+    RUN_TEST(rto_is_clamped);
+    RUN_TEST(small_rto_ages_up_when_idle);
+    RUN_TEST(large_rto_ages_down_when_idle);
+    RUN_TEST(aging_handles_timestamp_wraparound);
+    RUN_TEST(backoff_factor_depends_on_initial_timeout);
+    return UNITY_END();
+}
@@ -0,0 +1,114 @@
+#include <unity.h>
+#include <fff.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coap_client.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(uint64_t, golioth_sys_now_ms);
+FAKE_VALUE_FUNC(golioth_sys_mutex_t, golioth_sys_mutex_create);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_lock, golioth_sys_mutex_t, int32_t);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_unlock, golioth_sys_mutex_t);
+
+static uint64_t token_value(const uint8_t token[GOLIOTH_COAP_TOKEN_LEN])
+{
+    uint64_t value;
+    memcpy(&value, token, sizeof(value));
+    return value;
+}
+
+void setUp(void)
+{
+    static int dummy_mutex;
+
+    golioth_sys_mutex_create_fake.return_val = &dummy_mutex;
+    golioth_sys_mutex_lock_fake.return_val = true;
+    golioth_sys_mutex_unlock_fake.return_val = true;
+
+    golioth_coap_token_init();
+}
+
+void tearDown(void) {}
+
+void consecutive_tokens_share_prefix_and_count_up(void)
+{
+    uint8_t token1[GOLIOTH_COAP_TOKEN_LEN];
+    uint8_t token2[GOLIOTH_COAP_TOKEN_LEN];
+
+    golioth_coap_next_token(token1);
+    golioth_coap_next_token(token2);
+
+    uint64_t value1 = token_value(token1);
+    uint64_t value2 = token_value(token2);
+
+    TEST_ASSERT_NOT_EQUAL(0, value1 >> 32);
+    TEST_ASSERT_EQUAL(value1 >> 32, value2 >> 32);
+    TEST_ASSERT_EQUAL((uint32_t) value1 + 1, (uint32_t) value2);
+}
+
+#define NUM_THREADS 4
+#define TOKENS_PER_THREAD 10000
+
+static uint64_t tokens[NUM_THREADS][TOKENS_PER_THREAD];
+
+static void *generate_tokens(void *arg)
+{
+    uint64_t *out = arg;
+
+    for (size_t i = 0; i < TOKENS_PER_THREAD; i++)
+    {
+        uint8_t token[GOLIOTH_COAP_TOKEN_LEN];
+        golioth_coap_next_token(token);
+        out[i] = token_value(token);
+    }
+
+    return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+void concurrent_tokens_are_unique(void)
+{
+    pthread_t threads[NUM_THREADS];
+    for (size_t i = 0; i < NUM_THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, generate_tokens, tokens[i]);
+    }
+    for (size_t i = 0; i < NUM_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    uint64_t *all = &tokens[0][0];
+    size_t num_tokens = NUM_THREADS * TOKENS_PER_THREAD;
+    qsort(all, num_tokens, sizeof(all[0]), compare_u64);
+
+    size_t num_duplicates = 0;
+    for (size_t i = 1; i < num_tokens; i++)
+    {
+        if (all[i] == all[i - 1])
+        {
+            num_duplicates++;
+        }
+    }
+
+    TEST_ASSERT_EQUAL(0, num_duplicates);
+    TEST_ASSERT_EQUAL(all[0] >> 32, all[num_tokens - 1] >> 32);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(consecutive_tokens_share_prefix_and_count_up);
+    RUN_TEST(concurrent_tokens_are_unique);
+    return UNITY_END();
+}
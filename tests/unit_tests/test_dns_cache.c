@@ -0,0 +1,288 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dns_cache.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(golioth_sys_mutex_t, golioth_sys_mutex_create);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_lock, golioth_sys_mutex_t, int32_t);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_unlock, golioth_sys_mutex_t);
+FAKE_VOID_FUNC(golioth_sys_mutex_destroy, golioth_sys_mutex_t);
+FAKE_VALUE_FUNC(uint64_t, golioth_sys_now_ms);
+
+static struct golioth_dns_cache cache;
+
+static struct golioth_dns_cache_addr ipv4(uint8_t last)
+{
+    struct golioth_dns_cache_addr addr = {
+        .family = GOLIOTH_DNS_CACHE_IPV4,
+        .addr = {192, 0, 2, last},
+    };
+    return addr;
+}
+
+static struct golioth_dns_cache_addr ipv6(uint8_t last)
+{
+    struct golioth_dns_cache_addr addr = {
+        .family = GOLIOTH_DNS_CACHE_IPV6,
+        .addr = {0x20, 0x01, 0x0d, 0xb8, [15] = last},
+    };
+    return addr;
+}
+
+static void assert_addr(struct golioth_dns_cache_addr expected,
+                        const struct golioth_dns_cache_addr *actual)
+{
+    TEST_ASSERT_EQUAL(expected.family, actual->family);
+    TEST_ASSERT_EQUAL_MEMORY(expected.addr, actual->addr, sizeof(expected.addr));
+}
+
+void setUp(void)
+{
+    static int dummy_mutex;
+
+    RESET_FAKE(golioth_sys_mutex_create);
+    RESET_FAKE(golioth_sys_mutex_lock);
+    RESET_FAKE(golioth_sys_mutex_unlock);
+    RESET_FAKE(golioth_sys_mutex_destroy);
+    RESET_FAKE(golioth_sys_now_ms);
+
+    golioth_sys_mutex_create_fake.return_val = &dummy_mutex;
+    golioth_sys_mutex_lock_fake.return_val = true;
+    golioth_sys_mutex_unlock_fake.return_val = true;
+    golioth_sys_now_ms_fake.return_val = 1000;
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_dns_cache_init(&cache));
+}
+
+void tearDown(void)
+{
+    golioth_dns_cache_deinit(&cache);
+}
+
+void empty_cache_returns_nothing(void)
+{
+    struct golioth_dns_cache_addr addrs[4];
+
+    TEST_ASSERT_EQUAL(0, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+    TEST_ASSERT_EQUAL(0, golioth_dns_cache_lookup(&cache, true, addrs, 4));
+}
+
+void families_are_interleaved(void)
+{
+    struct golioth_dns_cache_addr resolved[] = {ipv6(1), ipv6(2), ipv6(3), ipv4(1)};
+    struct golioth_dns_cache_addr addrs[4];
+
+    golioth_dns_cache_store(&cache, resolved, 4, 60);
+
+    TEST_ASSERT_EQUAL(4, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+    assert_addr(ipv6(1), &addrs[0]);
+    assert_addr(ipv4(1), &addrs[1]);
+    assert_addr(ipv6(2), &addrs[2]);
+    assert_addr(ipv6(3), &addrs[3]);
+}
+
+void store_keeps_at_most_max_addrs(void)
+{
+    struct golioth_dns_cache_addr resolved[] = {
+        ipv4(1), ipv4(2), ipv4(3), ipv4(4), ipv4(5), ipv6(1),
+    };
+    struct golioth_dns_cache_addr addrs[8];
+
+    golioth_dns_cache_store(&cache, resolved, 6, 60);
+
+    TEST_ASSERT_EQUAL(CONFIG_GOLIOTH_DNS_CACHE_MAX_ADDRS,
+                      golioth_dns_cache_lookup(&cache, false, addrs, 8));
+    // The only IPv6 address is not dropped
+    assert_addr(ipv4(1), &addrs[0]);
+    assert_addr(ipv6(1), &addrs[1]);
+    assert_addr(ipv4(2), &addrs[2]);
+}
+
+void expired_addresses_are_stale(void)
+{
+    struct golioth_dns_cache_addr resolved[] = {ipv4(1)};
+    struct golioth_dns_cache_addr addrs[4];
+
+    golioth_dns_cache_store(&cache, resolved, 1, 60);
+
+    golioth_sys_now_ms_fake.return_val = 1000 + 59999;
+    TEST_ASSERT_EQUAL(1, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+
+    golioth_sys_now_ms_fake.return_val = 1000 + 60000;
+    TEST_ASSERT_EQUAL(0, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+    TEST_ASSERT_EQUAL(1, golioth_dns_cache_lookup(&cache, true, addrs, 4));
+    assert_addr(ipv4(1), &addrs[0]);
+}
+
+void ttl_is_capped(void)
+{
+    struct golioth_dns_cache_addr resolved[] = {ipv4(1)};
+    struct golioth_dns_cache_addr addrs[4];
+
+    golioth_dns_cache_store(&cache, resolved, 1, UINT32_MAX);
+
+    golioth_sys_now_ms_fake.return_val = 1000 + CONFIG_GOLIOTH_DNS_CACHE_TTL_S * 1000ULL;
+    TEST_ASSERT_EQUAL(0, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+}
+
+void bad_address_is_tried_last(void)
+{
+    struct golioth_dns_cache_addr resolved[] = {ipv6(1), ipv4(1), ipv6(2)};
+    struct golioth_dns_cache_addr addrs[4];
+
+    golioth_dns_cache_store(&cache, resolved, 3, 60);
+    golioth_dns_cache_mark_bad(&cache, &resolved[0]);
+
+    TEST_ASSERT_EQUAL(3, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+    assert_addr(ipv4(1), &addrs[0]);
+    assert_addr(ipv6(2), &addrs[1]);
+    assert_addr(ipv6(1), &addrs[2]);
+}
+
+void good_address_stays_first_after_resolving_again(void)
+{
+    struct golioth_dns_cache_addr resolved[] = {ipv6(1), ipv4(1)};
+    struct golioth_dns_cache_addr addrs[4];
+
+    golioth_dns_cache_store(&cache, resolved, 2, 60);
+    golioth_dns_cache_mark_good(&cache, &resolved[1]);
+
+    golioth_dns_cache_store(&cache, resolved, 2, 60);
+
+    TEST_ASSERT_EQUAL(2, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+    assert_addr(ipv4(1), &addrs[0]);
+    assert_addr(ipv6(1), &addrs[1]);
+}
+
+void good_address_is_dropped_when_no_longer_resolved(void)
+{
+    struct golioth_dns_cache_addr first[] = {ipv4(1)};
+    struct golioth_dns_cache_addr second[] = {ipv6(1), ipv4(2)};
+    struct golioth_dns_cache_addr addrs[4];
+
+    golioth_dns_cache_store(&cache, first, 1, 60);
+    golioth_dns_cache_mark_good(&cache, &first[0]);
+
+    golioth_dns_cache_store(&cache, second, 2, 60);
+
+    TEST_ASSERT_EQUAL(2, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+    assert_addr(ipv6(1), &addrs[0]);
+    assert_addr(ipv4(2), &addrs[1]);
+}
+
+void saved_cache_is_loaded_with_remaining_ttl(void)
+{
+    struct golioth_dns_cache_addr resolved[] = {ipv6(1), ipv4(1)};
+    struct golioth_dns_cache_addr addrs[4];
+    uint8_t buf[GOLIOTH_DNS_CACHE_SAVE_SIZE];
+
+    golioth_dns_cache_store(&cache, resolved, 2, 60);
+    golioth_dns_cache_mark_good(&cache, &resolved[1]);
+
+    golioth_sys_now_ms_fake.return_val = 1000 + 20000;
+    size_t len = golioth_dns_cache_save(&cache, buf, sizeof(buf));
+    TEST_ASSERT_NOT_EQUAL(0, len);
+
+    golioth_dns_cache_deinit(&cache);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_dns_cache_init(&cache));
+
+    // After a reboot, the clock starts over
+    golioth_sys_now_ms_fake.return_val = 500;
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_dns_cache_load(&cache, buf, len));
+    TEST_ASSERT_EQUAL(2, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+    assert_addr(ipv4(1), &addrs[0]);
+    assert_addr(ipv6(1), &addrs[1]);
+
+    golioth_sys_now_ms_fake.return_val = 500 + 40000;
+    TEST_ASSERT_EQUAL(0, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+    TEST_ASSERT_EQUAL(2, golioth_dns_cache_lookup(&cache, true, addrs, 4));
+}
+
+void expired_cache_is_loaded_stale(void)
+{
+    struct golioth_dns_cache_addr resolved[] = {ipv6(1), ipv4(1)};
+    struct golioth_dns_cache_addr addrs[4];
+    uint8_t buf[GOLIOTH_DNS_CACHE_SAVE_SIZE];
+
+    golioth_dns_cache_store(&cache, resolved, 2, 60);
+    golioth_dns_cache_mark_good(&cache, &resolved[1]);
+
+    golioth_sys_now_ms_fake.return_val = 1000 + 60000;
+    size_t len = golioth_dns_cache_save(&cache, buf, sizeof(buf));
+    TEST_ASSERT_NOT_EQUAL(0, len);
+
+    golioth_dns_cache_deinit(&cache);
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_dns_cache_init(&cache));
+
+    golioth_sys_now_ms_fake.return_val = 500;
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_dns_cache_load(&cache, buf, len));
+    TEST_ASSERT_EQUAL(0, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+    TEST_ASSERT_EQUAL(2, golioth_dns_cache_lookup(&cache, true, addrs, 4));
+    assert_addr(ipv4(1), &addrs[0]);
+    assert_addr(ipv6(1), &addrs[1]);
+
+    // The address that worked is still preferred once resolved again
+    golioth_dns_cache_store(&cache, resolved, 2, 60);
+    TEST_ASSERT_EQUAL(2, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+    assert_addr(ipv4(1), &addrs[0]);
+}
+
+void cache_saved_without_ttl_is_loaded_stale(void)
+{
+    uint8_t saved[2 + 17] = {1, 1, GOLIOTH_DNS_CACHE_IPV4, 192, 0, 2, 1};
+    struct golioth_dns_cache_addr addrs[4];
+
+    TEST_ASSERT_EQUAL(GOLIOTH_OK, golioth_dns_cache_load(&cache, saved, sizeof(saved)));
+    TEST_ASSERT_EQUAL(0, golioth_dns_cache_lookup(&cache, false, addrs, 4));
+    TEST_ASSERT_EQUAL(1, golioth_dns_cache_lookup(&cache, true, addrs, 4));
+    assert_addr(ipv4(1), &addrs[0]);
+}
+
+void save_fails_with_small_buffer(void)
+{
+    struct golioth_dns_cache_addr resolved[] = {ipv4(1)};
+    uint8_t buf[GOLIOTH_DNS_CACHE_SAVE_SIZE];
+
+    TEST_ASSERT_EQUAL(0, golioth_dns_cache_save(&cache, buf, sizeof(buf)));
+
+    golioth_dns_cache_store(&cache, resolved, 1, 60);
+    TEST_ASSERT_EQUAL(0, golioth_dns_cache_save(&cache, buf, 2));
+}
+
+void load_rejects_invalid_data(void)
+{
+    const uint8_t wrong_version[] = {0xff, 0};
+    const uint8_t wrong_length[] = {2, 2, 0, 0, 0, 60, 4, 192, 0, 2, 1};
+    uint8_t wrong_family[2 + 17] = {1, 1, 5};
+
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT, golioth_dns_cache_load(&cache, NULL, 0));
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT,
+                      golioth_dns_cache_load(&cache, wrong_version, sizeof(wrong_version)));
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT,
+                      golioth_dns_cache_load(&cache, wrong_length, sizeof(wrong_length)));
+    TEST_ASSERT_EQUAL(GOLIOTH_ERR_INVALID_FORMAT,
+                      golioth_dns_cache_load(&cache, wrong_family, sizeof(wrong_family)));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(empty_cache_returns_nothing);
+    RUN_TEST(families_are_interleaved);
+    RUN_TEST(store_keeps_at_most_max_addrs);
+    RUN_TEST(expired_addresses_are_stale);
+    RUN_TEST(ttl_is_capped);
+    RUN_TEST(bad_address_is_tried_last);
+    RUN_TEST(good_address_stays_first_after_resolving_again);
+    RUN_TEST(good_address_is_dropped_when_no_longer_resolved);
+    RUN_TEST(saved_cache_is_loaded_with_remaining_ttl);
+    RUN_TEST(expired_cache_is_loaded_stale);
+    RUN_TEST(cache_saved_without_ttl_is_loaded_stale);
+    RUN_TEST(save_fails_with_small_buffer);
+    RUN_TEST(load_rejects_invalid_data);
+    return UNITY_END();
+}
@@ -0,0 +1,301 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <golioth/golioth_sys.h>
+#include "mbox.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(golioth_sys_sem_t, golioth_sys_sem_create, uint32_t, uint32_t);
+FAKE_VALUE_FUNC(bool, golioth_sys_sem_take, golioth_sys_sem_t, int32_t);
+FAKE_VALUE_FUNC(bool, golioth_sys_sem_give, golioth_sys_sem_t);
+FAKE_VOID_FUNC(golioth_sys_sem_destroy, golioth_sys_sem_t);
+FAKE_VOID_FUNC(golioth_sys_msleep, uint32_t);
+FAKE_VOID_FUNC(golioth_sys_thread_yield);
+FAKE_VALUE_FUNC(uint64_t, golioth_sys_now_ms);
+
+enum
+{
+    PRIO_HIGH,
+    PRIO_NORMAL,
+    PRIO_LOW,
+    NUM_PRIOS,
+};
+
+static const size_t num_items[NUM_PRIOS] = {2, 3, 4};
+static golioth_mbox_t mbox;
+
+// Counting semaphores, so fill_count_sem tracks the items in the mbox
+static int sem_counts[2];
+static size_t num_sems;
+
+static golioth_sys_sem_t sem_create_counting(uint32_t sem_max_count, uint32_t sem_initial_count)
+{
+    sem_counts[num_sems] = sem_initial_count;
+    return &sem_counts[num_sems++];
+}
+
+static bool sem_take_counting(golioth_sys_sem_t sem, int32_t ms_to_wait)
+{
+    int *count = sem;
+    if (*count == 0)
+    {
+        return false;
+    }
+    (*count)--;
+    return true;
+}
+
+static bool sem_give_counting(golioth_sys_sem_t sem)
+{
+    int *count = sem;
+    (*count)++;
+    return true;
+}
+
+static uint64_t now_ms;
+
+static uint64_t now_ms_fake(void)
+{
+    return now_ms;
+}
+
+static void msleep_advancing_clock(uint32_t ms)
+{
+    now_ms += ms;
+}
+
+void setUp(void)
+{
+    RESET_FAKE(golioth_sys_sem_create);
+    RESET_FAKE(golioth_sys_sem_take);
+    RESET_FAKE(golioth_sys_sem_give);
+    RESET_FAKE(golioth_sys_sem_destroy);
+    RESET_FAKE(golioth_sys_msleep);
+    RESET_FAKE(golioth_sys_thread_yield);
+    RESET_FAKE(golioth_sys_now_ms);
+
+    num_sems = 0;
+    now_ms = 1000;
+    golioth_sys_now_ms_fake.custom_fake = now_ms_fake;
+    golioth_sys_msleep_fake.custom_fake = msleep_advancing_clock;
+    golioth_sys_sem_create_fake.custom_fake = sem_create_counting;
+    golioth_sys_sem_take_fake.custom_fake = sem_take_counting;
+    golioth_sys_sem_give_fake.custom_fake = sem_give_counting;
+
+    mbox = golioth_mbox_create_prio(num_items, NUM_PRIOS, sizeof(uint32_t));
+}
+
+void tearDown(void)
+{
+    golioth_mbox_destroy(mbox);
+}
+
+void fill_count_sem_covers_all_levels(void)
+{
+    TEST_ASSERT_EQUAL(9, golioth_sys_sem_create_fake.arg0_history[0]);
+}
+
+void recv_returns_highest_priority_first(void)
+{
+    uint32_t item = 0;
+
+    item = 3;
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_LOW));
+    item = 2;
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_NORMAL));
+    item = 1;
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_HIGH));
+
+    TEST_ASSERT_EQUAL(3, golioth_mbox_num_messages(mbox));
+
+    TEST_ASSERT_TRUE(golioth_mbox_recv(mbox, &item, 0));
+    TEST_ASSERT_EQUAL(1, item);
+    TEST_ASSERT_TRUE(golioth_mbox_recv(mbox, &item, 0));
+    TEST_ASSERT_EQUAL(2, item);
+    TEST_ASSERT_TRUE(golioth_mbox_recv(mbox, &item, 0));
+    TEST_ASSERT_EQUAL(3, item);
+
+    TEST_ASSERT_EQUAL(0, golioth_mbox_num_messages(mbox));
+}
+
+void recv_is_fifo_within_a_level(void)
+{
+    uint32_t item = 0;
+
+    for (item = 10; item < 13; item++)
+    {
+        TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_LOW));
+    }
+
+    for (uint32_t expected = 10; expected < 13; expected++)
+    {
+        TEST_ASSERT_TRUE(golioth_mbox_recv(mbox, &item, 0));
+        TEST_ASSERT_EQUAL(expected, item);
+    }
+}
+
+void full_level_does_not_block_other_levels(void)
+{
+    uint32_t item = 0;
+
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_HIGH));
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_HIGH));
+    TEST_ASSERT_FALSE(golioth_mbox_try_send_prio(mbox, &item, PRIO_HIGH));
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_NORMAL));
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_LOW));
+
+    TEST_ASSERT_EQUAL(4, golioth_mbox_num_messages(mbox));
+}
+
+void level_holds_exactly_its_capacity(void)
+{
+    uint32_t item = 0;
+
+    for (size_t i = 0; i < num_items[PRIO_NORMAL]; i++)
+    {
+        TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_NORMAL));
+    }
+    TEST_ASSERT_FALSE(golioth_mbox_try_send_prio(mbox, &item, PRIO_NORMAL));
+
+    TEST_ASSERT_EQUAL(num_items[PRIO_NORMAL], golioth_mbox_num_messages(mbox));
+}
+
+void try_send_uses_highest_priority(void)
+{
+    uint32_t item = 1;
+
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_NORMAL));
+    item = 2;
+    TEST_ASSERT_TRUE(golioth_mbox_try_send(mbox, &item));
+
+    TEST_ASSERT_TRUE(golioth_mbox_recv(mbox, &item, 0));
+    TEST_ASSERT_EQUAL(2, item);
+}
+
+void recv_batch_drains_levels_in_priority_order(void)
+{
+    uint32_t item = 0;
+    uint32_t items[8] = {0};
+
+    for (item = 30; item < 33; item++)
+    {
+        TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_LOW));
+    }
+    item = 20;
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_NORMAL));
+    item = 10;
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_HIGH));
+
+    TEST_ASSERT_EQUAL(3, golioth_mbox_recv_batch(mbox, items, 3, 0));
+    TEST_ASSERT_EQUAL(10, items[0]);
+    TEST_ASSERT_EQUAL(20, items[1]);
+    TEST_ASSERT_EQUAL(30, items[2]);
+    TEST_ASSERT_EQUAL(2, golioth_mbox_num_messages(mbox));
+
+    TEST_ASSERT_EQUAL(2, golioth_mbox_recv_batch(mbox, items, 8, 0));
+    TEST_ASSERT_EQUAL(31, items[0]);
+    TEST_ASSERT_EQUAL(32, items[1]);
+    TEST_ASSERT_EQUAL(0, golioth_mbox_num_messages(mbox));
+}
+
+void recv_when_empty_times_out(void)
+{
+    uint32_t item = 0;
+
+    TEST_ASSERT_FALSE(golioth_mbox_recv(mbox, &item, 0));
+    TEST_ASSERT_EQUAL(0, golioth_mbox_recv_batch(mbox, &item, 1, 0));
+}
+
+#if defined(CONFIG_GOLIOTH_MBOX_LOCKLESS)
+
+// Slot claimed by a producer that was preempted before writing its item
+static mpsc_ringbuf_t *claimed_rb;
+static uint32_t claimed_pos;
+static uint32_t claimed_item;
+
+static void claim_slot(size_t prio, uint32_t item)
+{
+    claimed_rb = &mbox->ringbufs[prio];
+    claimed_pos = atomic_fetch_add(&claimed_rb->write_index, 1);
+    claimed_item = item;
+}
+
+// Finish what golioth_mbox_try_send_prio() started in claim_slot()
+static void write_claimed_slot(void)
+{
+    uint32_t mask = claimed_rb->num_slots - 1;
+    memcpy(claimed_rb->buffer + (claimed_pos & mask) * claimed_rb->item_size,
+           &claimed_item,
+           sizeof(claimed_item));
+    atomic_store(&claimed_rb->slot_seq[claimed_pos & mask], claimed_pos + 1);
+
+    if (atomic_fetch_add(&mbox->num_items, 1) == 0)
+    {
+        golioth_sys_sem_give(mbox->fill_count_sem);
+    }
+}
+
+static void msleep_writing_claimed_slot(uint32_t ms)
+{
+    write_claimed_slot();
+}
+
+void recv_batch_waits_for_item_being_written_without_timeout(void)
+{
+    uint32_t items[2] = {0};
+    uint32_t item = 2;
+
+    claim_slot(PRIO_NORMAL, 1);
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_NORMAL));
+    golioth_sys_thread_yield_fake.custom_fake = write_claimed_slot;
+
+    TEST_ASSERT_EQUAL(2, golioth_mbox_recv_batch(mbox, items, 2, 0));
+    TEST_ASSERT_EQUAL(1, items[0]);
+    TEST_ASSERT_EQUAL(2, items[1]);
+    TEST_ASSERT_EQUAL(1, golioth_sys_thread_yield_fake.call_count);
+    TEST_ASSERT_EQUAL(0, golioth_sys_msleep_fake.call_count);
+
+    // No wakeup left behind for items that have already been received
+    TEST_ASSERT_EQUAL(0, golioth_mbox_num_messages(mbox));
+    TEST_ASSERT_EQUAL(0, sem_counts[0]);
+}
+
+void recv_batch_sleeps_if_producer_does_not_run(void)
+{
+    uint32_t items[2] = {0};
+    uint32_t item = 2;
+
+    claim_slot(PRIO_LOW, 1);
+    TEST_ASSERT_TRUE(golioth_mbox_try_send_prio(mbox, &item, PRIO_LOW));
+    golioth_sys_msleep_fake.custom_fake = msleep_writing_claimed_slot;
+
+    TEST_ASSERT_EQUAL(2, golioth_mbox_recv_batch(mbox, items, 2, 5));
+    TEST_ASSERT_EQUAL(1, items[0]);
+    TEST_ASSERT_EQUAL(2, items[1]);
+    TEST_ASSERT_GREATER_THAN(0, golioth_sys_thread_yield_fake.call_count);
+    TEST_ASSERT_EQUAL(1, golioth_sys_msleep_fake.call_count);
+    TEST_ASSERT_EQUAL(0, sem_counts[0]);
+}
+
+#endif /* CONFIG_GOLIOTH_MBOX_LOCKLESS */
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(fill_count_sem_covers_all_levels);
+    RUN_TEST(recv_returns_highest_priority_first);
+    RUN_TEST(recv_is_fifo_within_a_level);
+    RUN_TEST(full_level_does_not_block_other_levels);
+    RUN_TEST(level_holds_exactly_its_capacity);
+    RUN_TEST(try_send_uses_highest_priority);
+    RUN_TEST(recv_batch_drains_levels_in_priority_order);
+    RUN_TEST(recv_when_empty_times_out);
+#if defined(CONFIG_GOLIOTH_MBOX_LOCKLESS)
+    RUN_TEST(recv_batch_waits_for_item_being_written_without_timeout);
+    RUN_TEST(recv_batch_sleeps_if_producer_does_not_run);
+#endif
+    return UNITY_END();
+}
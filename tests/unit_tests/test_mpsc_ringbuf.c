@@ -0,0 +1,316 @@
+#include <unity.h>
+#include <fff.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <golioth/golioth_sys.h>
+#include "mpsc_ringbuf.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VOID_FUNC(golioth_sys_thread_yield);
+FAKE_VOID_FUNC(golioth_sys_msleep, uint32_t);
+
+#define MPSC_RINGBUF_DEFINE(name, item_sz, num_slots) \
+    uint8_t name##_buffer[(item_sz) * (num_slots)];   \
+    _Atomic uint32_t name##_seq[num_slots];           \
+    mpsc_ringbuf_t name;                              \
+    mpsc_ringbuf_init(&name, name##_buffer, name##_seq, num_slots, num_slots, item_sz)
+
+void setUp(void)
+{
+    RESET_FAKE(golioth_sys_thread_yield);
+    RESET_FAKE(golioth_sys_msleep);
+}
+
+void tearDown(void) {}
+
+void num_slots_is_rounded_up_to_a_power_of_two(void)
+{
+    TEST_ASSERT_EQUAL(2, mpsc_ringbuf_num_slots(1));
+    TEST_ASSERT_EQUAL(2, mpsc_ringbuf_num_slots(2));
+    TEST_ASSERT_EQUAL(4, mpsc_ringbuf_num_slots(3));
+    TEST_ASSERT_EQUAL(16, mpsc_ringbuf_num_slots(10));
+}
+
+void empty_ringbuf_has_zero_size(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, 1, 8);
+    TEST_ASSERT_EQUAL(0, mpsc_ringbuf_size(&rb));
+    TEST_ASSERT_EQUAL(8, mpsc_ringbuf_capacity(&rb));
+}
+
+void get_returns_the_oldest_item(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, 1, 8);
+
+    uint8_t item1 = 4;
+    uint8_t item2 = 5;
+
+    uint8_t item;
+    TEST_ASSERT_TRUE(mpsc_ringbuf_put(&rb, &item1));
+    TEST_ASSERT_TRUE(mpsc_ringbuf_put(&rb, &item2));
+    TEST_ASSERT_EQUAL(2, mpsc_ringbuf_size(&rb));
+    TEST_ASSERT_TRUE(mpsc_ringbuf_get(&rb, &item));
+    TEST_ASSERT_EQUAL(4, item);
+    TEST_ASSERT_TRUE(mpsc_ringbuf_get(&rb, &item));
+    TEST_ASSERT_EQUAL(5, item);
+}
+
+void get_when_empty_fails(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, 1, 8);
+    uint8_t item;
+    TEST_ASSERT_FALSE(mpsc_ringbuf_get(&rb, &item));
+}
+
+void put_when_full_fails(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, 1, 8);
+
+    uint8_t item = 0;
+    for (size_t i = 0; i < 8; i++)
+    {
+        TEST_ASSERT_TRUE(mpsc_ringbuf_put(&rb, &item));
+    }
+    TEST_ASSERT_FALSE(mpsc_ringbuf_put(&rb, &item));
+}
+
+void put_beyond_max_items_fails(void)
+{
+    uint8_t buffer[4];
+    _Atomic uint32_t seq[4];
+    mpsc_ringbuf_t rb;
+    mpsc_ringbuf_init(&rb, buffer, seq, mpsc_ringbuf_num_slots(3), 3, 1);
+    TEST_ASSERT_EQUAL(3, mpsc_ringbuf_capacity(&rb));
+
+    uint8_t item = 0;
+    for (size_t i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_TRUE(mpsc_ringbuf_put(&rb, &item));
+    }
+    TEST_ASSERT_FALSE(mpsc_ringbuf_put(&rb, &item));
+
+    // Room for one more once an item is removed, in the spare slot this time
+    TEST_ASSERT_TRUE(mpsc_ringbuf_get(&rb, &item));
+    TEST_ASSERT_TRUE(mpsc_ringbuf_put(&rb, &item));
+    TEST_ASSERT_FALSE(mpsc_ringbuf_put(&rb, &item));
+    TEST_ASSERT_EQUAL(3, mpsc_ringbuf_size(&rb));
+}
+
+void get_batch_stops_at_unpublished_slot(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, 1, 8);
+    uint8_t items[8] = {0};
+
+    for (uint8_t i = 1; i <= 3; i++)
+    {
+        TEST_ASSERT_TRUE(mpsc_ringbuf_put(&rb, &i));
+    }
+
+    // Claim a slot without publishing it, like a producer that was preempted
+    // between the compare-and-swap and the release store.
+    atomic_fetch_add(&rb.write_index, 1);
+
+    TEST_ASSERT_EQUAL(3, mpsc_ringbuf_get_batch(&rb, items, 8));
+    TEST_ASSERT_EQUAL(1, items[0]);
+    TEST_ASSERT_EQUAL(2, items[1]);
+    TEST_ASSERT_EQUAL(3, items[2]);
+    TEST_ASSERT_EQUAL(0, mpsc_ringbuf_get_batch(&rb, items, 8));
+    TEST_ASSERT_EQUAL(1, mpsc_ringbuf_size(&rb));
+}
+
+// Slot claimed by claim_slot(), written once the consumer has waited on it a few times
+static mpsc_ringbuf_t *claimed_rb;
+static uint32_t claimed_pos;
+static unsigned int num_waits_until_written;
+
+static void claim_slot(mpsc_ringbuf_t *rb, unsigned int num_waits)
+{
+    claimed_rb = rb;
+    claimed_pos = atomic_fetch_add(&rb->write_index, 1);
+    num_waits_until_written = num_waits;
+}
+
+static void write_claimed_slot_eventually(void)
+{
+    if (--num_waits_until_written == 0)
+    {
+        uint32_t mask = claimed_rb->num_slots - 1;
+        claimed_rb->buffer[(claimed_pos & mask) * claimed_rb->item_size] = 9;
+        atomic_store(&claimed_rb->slot_seq[claimed_pos & mask], claimed_pos + 1);
+    }
+}
+
+static void msleep_writing_claimed_slot(uint32_t ms)
+{
+    write_claimed_slot_eventually();
+}
+
+void wait_published_returns_when_empty(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, 1, 8);
+
+    mpsc_ringbuf_wait_published(&rb);
+    TEST_ASSERT_EQUAL(0, golioth_sys_thread_yield_fake.call_count);
+    TEST_ASSERT_EQUAL(0, golioth_sys_msleep_fake.call_count);
+}
+
+void wait_published_returns_when_oldest_item_is_published(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, 1, 8);
+    uint8_t item = 1;
+
+    TEST_ASSERT_TRUE(mpsc_ringbuf_put(&rb, &item));
+    claim_slot(&rb, 1);
+
+    mpsc_ringbuf_wait_published(&rb);
+    TEST_ASSERT_EQUAL(0, golioth_sys_thread_yield_fake.call_count);
+}
+
+void wait_published_yields_to_producer(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, 1, 8);
+    uint8_t item = 1;
+
+    claim_slot(&rb, 3);
+    TEST_ASSERT_TRUE(mpsc_ringbuf_put(&rb, &item));
+    golioth_sys_thread_yield_fake.custom_fake = write_claimed_slot_eventually;
+
+    mpsc_ringbuf_wait_published(&rb);
+    TEST_ASSERT_EQUAL(3, golioth_sys_thread_yield_fake.call_count);
+    TEST_ASSERT_EQUAL(0, golioth_sys_msleep_fake.call_count);
+
+    TEST_ASSERT_TRUE(mpsc_ringbuf_get(&rb, &item));
+    TEST_ASSERT_EQUAL(9, item);
+    TEST_ASSERT_TRUE(mpsc_ringbuf_get(&rb, &item));
+    TEST_ASSERT_EQUAL(1, item);
+}
+
+void wait_published_sleeps_if_yielding_does_not_help(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, 1, 8);
+
+    // E.g. a producer with a lower priority, which yielding doesn't run
+    claim_slot(&rb, 2);
+    golioth_sys_msleep_fake.custom_fake = msleep_writing_claimed_slot;
+
+    mpsc_ringbuf_wait_published(&rb);
+    TEST_ASSERT_GREATER_THAN(0, golioth_sys_thread_yield_fake.call_count);
+    TEST_ASSERT_EQUAL(2, golioth_sys_msleep_fake.call_count);
+    TEST_ASSERT_EQUAL(1, golioth_sys_msleep_fake.arg0_val);
+}
+
+void put_when_null_item_fails(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, 1, 8);
+    TEST_ASSERT_FALSE(mpsc_ringbuf_put(&rb, NULL));
+}
+
+void counters_wrap_around(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, sizeof(uint32_t), 4);
+
+    // Start just before the free-running counters overflow
+    uint32_t start = UINT32_MAX - 5;
+    atomic_store(&rb.write_index, start);
+    atomic_store(&rb.read_index, start);
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        atomic_store(&rb.slot_seq[(start + i) & 3], start + i);
+    }
+
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        uint32_t item;
+        TEST_ASSERT_TRUE(mpsc_ringbuf_put(&rb, &i));
+        TEST_ASSERT_EQUAL(1, mpsc_ringbuf_size(&rb));
+        TEST_ASSERT_TRUE(mpsc_ringbuf_get(&rb, &item));
+        TEST_ASSERT_EQUAL(i, item);
+    }
+}
+
+#define NUM_PRODUCERS 4
+#define ITEMS_PER_PRODUCER 10000
+
+static mpsc_ringbuf_t *shared_rb;
+
+static void *producer(void *arg)
+{
+    uint32_t id = (uint32_t) (uintptr_t) arg;
+
+    for (uint32_t seq = 0; seq < ITEMS_PER_PRODUCER; seq++)
+    {
+        uint32_t item = (id << 24) | seq;
+        while (!mpsc_ringbuf_put(shared_rb, &item))
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+void concurrent_producers_keep_per_producer_order(void)
+{
+    MPSC_RINGBUF_DEFINE(rb, sizeof(uint32_t), 16);
+    shared_rb = &rb;
+
+    pthread_t threads[NUM_PRODUCERS];
+    for (uintptr_t i = 0; i < NUM_PRODUCERS; i++)
+    {
+        pthread_create(&threads[i], NULL, producer, (void *) i);
+    }
+
+    uint32_t next_seq[NUM_PRODUCERS] = {0};
+    uint32_t num_received = 0;
+    bool in_order = true;
+
+    while (num_received < NUM_PRODUCERS * ITEMS_PER_PRODUCER)
+    {
+        uint32_t item;
+        if (!mpsc_ringbuf_get(&rb, &item))
+        {
+            sched_yield();
+            continue;
+        }
+
+        uint32_t id = item >> 24;
+        uint32_t seq = item & 0xFFFFFF;
+        if (id >= NUM_PRODUCERS || seq != next_seq[id])
+        {
+            in_order = false;
+            break;
+        }
+        next_seq[id]++;
+        num_received++;
+    }
+
+    for (size_t i = 0; i < NUM_PRODUCERS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    TEST_ASSERT_TRUE(in_order);
+    TEST_ASSERT_EQUAL(0, mpsc_ringbuf_size(&rb));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(num_slots_is_rounded_up_to_a_power_of_two);
+    RUN_TEST(empty_ringbuf_has_zero_size);
+    RUN_TEST(get_returns_the_oldest_item);
+    RUN_TEST(get_when_empty_fails);
+    RUN_TEST(put_when_full_fails);
+    RUN_TEST(put_beyond_max_items_fails);
+    RUN_TEST(get_batch_stops_at_unpublished_slot);
+    RUN_TEST(wait_published_returns_when_empty);
+    RUN_TEST(wait_published_returns_when_oldest_item_is_published);
+    RUN_TEST(wait_published_yields_to_producer);
+    RUN_TEST(wait_published_sleeps_if_yielding_does_not_help);
+    RUN_TEST(put_when_null_item_fails);
+    RUN_TEST(counters_wrap_around);
+    RUN_TEST(concurrent_producers_keep_per_producer_order);
+    return UNITY_END();
+}
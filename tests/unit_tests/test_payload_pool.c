@@ -0,0 +1,155 @@
+#include <unity.h>
+#include <fff.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <golioth/golioth_sys.h>
+#include "payload_pool.h"
+
+// The pool sizes are set in CMakeLists.txt
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(golioth_sys_mutex_t, golioth_sys_mutex_create);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_lock, golioth_sys_mutex_t, int32_t);
+FAKE_VALUE_FUNC(bool, golioth_sys_mutex_unlock, golioth_sys_mutex_t);
+
+static struct golioth_payload_pool_stats stats;
+// The pool is static and never torn down, so hits and misses are counted from here
+static struct golioth_payload_pool_stats stats_before;
+
+void setUp(void)
+{
+    RESET_FAKE(golioth_sys_mutex_create);
+    RESET_FAKE(golioth_sys_mutex_lock);
+    RESET_FAKE(golioth_sys_mutex_unlock);
+
+    static int dummy_mutex;
+    golioth_sys_mutex_create_fake.return_val = &dummy_mutex;
+    golioth_sys_mutex_lock_fake.return_val = true;
+    golioth_sys_mutex_unlock_fake.return_val = true;
+
+    golioth_payload_pool_init();
+    golioth_payload_pool_get_stats(&stats_before);
+}
+void tearDown(void) {}
+
+void alloc_of_zero_bytes_returns_null(void)
+{
+    TEST_ASSERT_NULL(golioth_payload_pool_alloc(0));
+}
+
+void alloc_uses_smallest_class_that_fits(void)
+{
+    void *small = golioth_payload_pool_alloc(10);
+    void *medium = golioth_payload_pool_alloc(17);
+    void *large = golioth_payload_pool_alloc(256);
+
+    golioth_payload_pool_get_stats(&stats);
+    TEST_ASSERT_EQUAL(3, stats.hits - stats_before.hits);
+    TEST_ASSERT_EQUAL(0, stats.misses - stats_before.misses);
+    TEST_ASSERT_EQUAL(1, stats.classes[0].num_used);
+    TEST_ASSERT_EQUAL(1, stats.classes[1].num_used);
+    TEST_ASSERT_EQUAL(1, stats.classes[2].num_used);
+
+    golioth_payload_pool_free(small);
+    golioth_payload_pool_free(medium);
+    golioth_payload_pool_free(large);
+}
+
+void exhausted_class_spills_into_next_class(void)
+{
+    void *blocks[3];
+    for (size_t i = 0; i < 3; i++)
+    {
+        blocks[i] = golioth_payload_pool_alloc(8);
+        TEST_ASSERT_NOT_NULL(blocks[i]);
+    }
+
+    golioth_payload_pool_get_stats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.classes[0].num_used);
+    TEST_ASSERT_EQUAL(1, stats.classes[1].num_used);
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        golioth_payload_pool_free(blocks[i]);
+    }
+}
+
+void oversized_alloc_falls_back_to_heap(void)
+{
+    uint8_t *buf = golioth_payload_pool_alloc(1000);
+    TEST_ASSERT_NOT_NULL(buf);
+    memset(buf, 0xAA, 1000);
+
+    golioth_payload_pool_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.hits - stats_before.hits);
+    TEST_ASSERT_EQUAL(1, stats.misses - stats_before.misses);
+
+    golioth_payload_pool_free(buf);
+}
+
+void freed_block_is_reused(void)
+{
+    void *first = golioth_payload_pool_alloc(200);
+    golioth_payload_pool_free(first);
+    void *second = golioth_payload_pool_alloc(200);
+
+    TEST_ASSERT_EQUAL_PTR(first, second);
+
+    golioth_payload_pool_get_stats(&stats);
+    TEST_ASSERT_EQUAL(1, stats.classes[2].num_used);
+
+    golioth_payload_pool_free(second);
+}
+
+void blocks_do_not_overlap(void)
+{
+    uint8_t *a = golioth_payload_pool_alloc(16);
+    uint8_t *b = golioth_payload_pool_alloc(16);
+
+    TEST_ASSERT_TRUE((b >= a + 16) || (a >= b + 16));
+
+    golioth_payload_pool_free(a);
+    golioth_payload_pool_free(b);
+}
+
+void high_water_tracks_peak_usage(void)
+{
+    // Both blocks of the small class
+    void *a = golioth_payload_pool_alloc(1);
+    void *b = golioth_payload_pool_alloc(1);
+
+    golioth_payload_pool_get_stats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.classes[0].num_used);
+    TEST_ASSERT_EQUAL(2, stats.classes[0].high_water);
+
+    golioth_payload_pool_free(a);
+    golioth_payload_pool_free(b);
+
+    golioth_payload_pool_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.classes[0].num_used);
+    TEST_ASSERT_EQUAL(2, stats.classes[0].high_water);
+}
+
+void free_of_null_is_ignored(void)
+{
+    unsigned int num_locks = golioth_sys_mutex_lock_fake.call_count;
+
+    golioth_payload_pool_free(NULL);
+    TEST_ASSERT_EQUAL(num_locks, golioth_sys_mutex_lock_fake.call_count);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(alloc_of_zero_bytes_returns_null);
+    RUN_TEST(alloc_uses_smallest_class_that_fits);
+    RUN_TEST(exhausted_class_spills_into_next_class);
+    RUN_TEST(oversized_alloc_falls_back_to_heap);
+    RUN_TEST(freed_block_is_reused);
+    RUN_TEST(blocks_do_not_overlap);
+    RUN_TEST(high_water_tracks_peak_usage);
+    RUN_TEST(free_of_null_is_ignored);
+    return UNITY_END();
+}
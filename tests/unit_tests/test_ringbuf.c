@@ -104,6 +104,57 @@ void array_wraparound(void)
     TEST_ASSERT_TRUE(ringbuf_is_empty(&rb));
 }
 
+void get_batch_returns_oldest_items_in_order(void)
+{
+    RINGBUF_DEFINE(rb, 1, 8);
+    uint8_t items[8] = {0};
+
+    for (uint8_t i = 1; i <= 5; i++)
+    {
+        TEST_ASSERT_TRUE(ringbuf_put(&rb, &i));
+    }
+
+    TEST_ASSERT_EQUAL(3, ringbuf_get_batch(&rb, items, 3));
+    TEST_ASSERT_EQUAL(1, items[0]);
+    TEST_ASSERT_EQUAL(2, items[1]);
+    TEST_ASSERT_EQUAL(3, items[2]);
+    TEST_ASSERT_EQUAL(2, ringbuf_size(&rb));
+
+    // Asking for more than is available returns what's there
+    TEST_ASSERT_EQUAL(2, ringbuf_get_batch(&rb, items, 8));
+    TEST_ASSERT_EQUAL(4, items[0]);
+    TEST_ASSERT_EQUAL(5, items[1]);
+    TEST_ASSERT_TRUE(ringbuf_is_empty(&rb));
+
+    TEST_ASSERT_EQUAL(0, ringbuf_get_batch(&rb, items, 8));
+}
+
+void get_batch_wraparound(void)
+{
+    RINGBUF_DEFINE(rb, 2, 4);
+    uint16_t items[4] = {0};
+    uint16_t rd_item;
+
+    // Move the read index near the end of the internal array
+    for (uint16_t i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_TRUE(ringbuf_put(&rb, &i));
+        TEST_ASSERT_TRUE(ringbuf_get(&rb, &rd_item));
+    }
+
+    for (uint16_t i = 100; i < 104; i++)
+    {
+        TEST_ASSERT_TRUE(ringbuf_put(&rb, &i));
+    }
+
+    TEST_ASSERT_EQUAL(4, ringbuf_get_batch(&rb, items, 4));
+    TEST_ASSERT_EQUAL(100, items[0]);
+    TEST_ASSERT_EQUAL(101, items[1]);
+    TEST_ASSERT_EQUAL(102, items[2]);
+    TEST_ASSERT_EQUAL(103, items[3]);
+    TEST_ASSERT_TRUE(ringbuf_is_empty(&rb));
+}
+
 void put_when_null_item_fails(void)
 {
     RINGBUF_DEFINE(rb, 1, 1);
@@ -120,6 +171,8 @@ int main(void)
     RUN_TEST(put_when_full_fails);
     RUN_TEST(put_when_null_item_fails);
     RUN_TEST(array_wraparound);
+    RUN_TEST(get_batch_returns_oldest_items_in_order);
+    RUN_TEST(get_batch_wraparound);
     RUN_TEST(can_peek);
     RUN_TEST(can_reset);
     return UNITY_END();